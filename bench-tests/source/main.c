@@ -0,0 +1,427 @@
+#include <stdio.h>
+#include <3ds/gpu/shaderProgram.h>
+
+#include "3dmath.h"
+#include "gpu.h"
+
+// Measuring the latency and throughput of the shader instructions
+
+// For each instruction family:
+// Generates vertex shaders made of N unrolled instructions of the family, for several N, draws
+// BENCH_VERTICES vertices with each of them and times the draws. All the vertices land on the same
+// point, the triangles are degenerate and the time goes to the vertex shader.
+// The time per vertex grows linearly with N, the slope is the cost of one instruction.
+
+// Each family is measured in two ways:
+// chain:       every instruction reads the result of the previous one (latency)
+// independent: consecutive instructions do not depend on each other (throughput)
+
+// One line per draw is written to bench-results.csv (on the SD card on the device):
+// family,mode,instructions,vertices,ticks
+// host/tools/benchfit fits the per-instruction cost to it. The system tick and the GPU both run at 268 MHz,
+// ticks are GPU cycles of the whole GPU, with its four vertex shader units.
+
+#define BENCH_VERTICES 3072
+#define BENCH_REPEATS  3 // the fastest of the repeated draws is kept
+
+static const u32 bench_lengths[] = { 0, 64, 128, 256 };
+#define BENCH_LENGTHS (sizeof(bench_lengths)/sizeof(bench_lengths[0]))
+
+//
+// Shader generator
+//
+
+// Register indices as encoded in the instructions
+#define REG_V(n) (0x00 + (n))
+#define REG_O(n) (0x00 + (n))
+#define REG_R(n) (0x10 + (n))
+#define REG_C(n) (0x20 + (n))
+
+enum {
+	OP_ADD  = 0x00,
+	OP_DP3  = 0x01,
+	OP_DP4  = 0x02,
+	OP_DPH  = 0x03,
+	OP_EX2  = 0x05,
+	OP_LG2  = 0x06,
+	OP_MUL  = 0x08,
+	OP_RCP  = 0x0E,
+	OP_RSQ  = 0x0F,
+	OP_MOVA = 0x12,
+	OP_MOV  = 0x13,
+	OP_NOP  = 0x21,
+	OP_END  = 0x22,
+	OP_IFC  = 0x28,
+	OP_LOOP = 0x29,
+	OP_CMP  = 0x2E,
+	OP_MAD  = 0x38,
+};
+
+// Operand descriptors: destination mask, then the swizzles of the three sources
+#define SWIZZLE_XYZW 0x1B
+enum { DESC_XYZW, DESC_X };
+static u32 opdescs[] = {
+	0xF | (SWIZZLE_XYZW << 5) | (SWIZZLE_XYZW << 14) | (SWIZZLE_XYZW << 23),
+	0x8 | (SWIZZLE_XYZW << 5) | (SWIZZLE_XYZW << 14) | (SWIZZLE_XYZW << 23),
+};
+
+static u32 code[512];
+static u32 code_size;
+
+static void emit(u32 instr)
+{
+	code[code_size++] = instr;
+}
+
+// op dst, src1[a0.x when rel], src2
+static void emitAlu(u32 op, u32 dst, u32 src1, bool rel, u32 src2, u32 desc)
+{
+	emit((op << 26) | (dst << 21) | ((rel ? 1 : 0) << 19) | (src1 << 12) | (src2 << 7) | desc);
+}
+
+// mad dst, src1, src2, src3
+static void emitMad(u32 dst, u32 src1, u32 src2, u32 src3, u32 desc)
+{
+	emit((OP_MAD << 26) | (dst << 24) | (src1 << 17) | (src2 << 10) | (src3 << 5) | desc);
+}
+
+// cmp src1, eq, eq, src2
+static void emitCmp(u32 src1, u32 src2)
+{
+	emit((OP_CMP << 26) | (src1 << 12) | (src2 << 7) | DESC_XYZW);
+}
+
+// ifc cmp.x with an empty block, both outcomes continue with the next instruction
+static void emitIfc(void)
+{
+	u32 next = code_size + 1;
+	emit((OP_IFC << 26) | (1 << 25) | (2 << 22) | (next << 10));
+}
+
+// Instructions under test, the independent variants rotate through r0-r7 and read r8-r9 only
+static void benchArith(u32 op, u32 n, bool chain)
+{
+	for (u32 i = 0; i < n; i++) {
+		if (chain)
+			emitAlu(op, REG_R(0), REG_R(0), false, REG_R(8), DESC_XYZW);
+		else
+			emitAlu(op, REG_R(i % 8), REG_R(8), false, REG_R(9), DESC_XYZW);
+	}
+}
+
+static void benchAdd(u32 n, bool chain) { benchArith(OP_ADD, n, chain); }
+static void benchMul(u32 n, bool chain) { benchArith(OP_MUL, n, chain); }
+static void benchDp3(u32 n, bool chain) { benchArith(OP_DP3, n, chain); }
+static void benchDp4(u32 n, bool chain) { benchArith(OP_DP4, n, chain); }
+static void benchDph(u32 n, bool chain) { benchArith(OP_DPH, n, chain); }
+static void benchRcp(u32 n, bool chain) { benchArith(OP_RCP, n, chain); }
+static void benchRsq(u32 n, bool chain) { benchArith(OP_RSQ, n, chain); }
+static void benchEx2(u32 n, bool chain) { benchArith(OP_EX2, n, chain); }
+static void benchLg2(u32 n, bool chain) { benchArith(OP_LG2, n, chain); }
+
+static void benchMad(u32 n, bool chain)
+{
+	for (u32 i = 0; i < n; i++) {
+		if (chain)
+			emitMad(REG_R(0), REG_R(0), REG_R(8), REG_R(9), DESC_XYZW);
+		else
+			emitMad(REG_R(i % 8), REG_R(8), REG_R(9), REG_R(8), DESC_XYZW);
+	}
+}
+
+// The chain alternates mova a0.x, r0 and mov r0, c0[a0.x], a0.x stays 1 since the uniforms hold ones
+static void benchMova(u32 n, bool chain)
+{
+	for (u32 i = 0; i < n; i++) {
+		if (!chain)
+			emitAlu(OP_MOVA, 0, REG_R(i % 8), false, 0, DESC_X);
+		else if (i % 2 == 0)
+			emitAlu(OP_MOVA, 0, REG_R(0), false, 0, DESC_X);
+		else
+			emitAlu(OP_MOV, REG_R(0), REG_C(0), true, 0, DESC_XYZW);
+	}
+}
+
+static void benchCmp(u32 n, bool chain)
+{
+	for (u32 i = 0; i < n; i++)
+		emitCmp(REG_R(i % 8), REG_R(8));
+}
+
+// The chain alternates cmp and an ifc reading its result, otherwise the flags come from the prologue
+static void benchIfc(u32 n, bool chain)
+{
+	for (u32 i = 0; i < n; i++) {
+		if (chain && i % 2 == 0)
+			emitCmp(REG_R(0), REG_R(8));
+		else
+			emitIfc();
+	}
+}
+
+// n iterations of a loop around a nop, the loop count comes from i0
+static void benchLoop(u32 n, bool chain)
+{
+	if (!n)
+		return;
+	emit((OP_LOOP << 26) | (0 << 22) | ((code_size + 1) << 10));
+	emit(OP_NOP << 26);
+}
+
+typedef struct {
+	const char* name;
+	void (*generate)(u32 n, bool chain);
+	bool chain; // whether the family has a chained variant
+} bench_family_t;
+
+static const bench_family_t families[] = {
+	{ "add",  benchAdd,  true },
+	{ "mul",  benchMul,  true },
+	{ "mad",  benchMad,  true },
+	{ "dp3",  benchDp3,  true },
+	{ "dp4",  benchDp4,  true },
+	{ "dph",  benchDph,  true },
+	{ "rcp",  benchRcp,  true },
+	{ "rsq",  benchRsq,  true },
+	{ "ex2",  benchEx2,  true },
+	{ "lg2",  benchLg2,  true },
+	{ "mova", benchMova, true },
+	{ "cmp",  benchCmp,  false }, // only writes the flags
+	{ "ifc",  benchIfc,  true },
+	{ "loop", benchLoop, false },
+};
+
+static int families_count = (sizeof(families)/sizeof(families[0]));
+
+// Fills r0-r9 with the ones of c0 and sets the flags, then runs the family and outputs
+// o0 = v0 (the point all the vertices share) and o1 = r0
+static void benchGenerate(const bench_family_t* family, u32 n, bool chain)
+{
+	code_size = 0;
+	for (u32 i = 0; i < 10; i++)
+		emitAlu(OP_MOV, REG_R(i), REG_C(0), false, 0, DESC_XYZW);
+	emitCmp(REG_R(8), REG_R(8));
+
+	family->generate(n, chain);
+
+	emitAlu(OP_MOV, REG_O(0), REG_V(0), false, 0, DESC_XYZW);
+	emitAlu(OP_MOV, REG_O(1), REG_R(0), false, 0, DESC_XYZW);
+	emit(OP_END << 26);
+}
+
+//
+// Results
+//
+
+typedef struct {
+	const char* family;
+	bool chain;
+	u32 instructions;
+	u64 ticks;
+} bench_result_t;
+
+static bench_result_t results[sizeof(families)/sizeof(families[0]) * 2 * BENCH_LENGTHS];
+static int results_count;
+
+static void benchLogFlush(void)
+{
+	char path[64];
+	int i;
+
+#ifdef _3DS
+	snprintf(path, sizeof(path), "sdmc:/bench-results.csv");
+#else
+	snprintf(path, sizeof(path), "bench-results.csv");
+#endif
+	FILE* f = fopen(path, "w");
+	if (!f) {
+		printf("Cannot write %s\n", path);
+		return;
+	}
+
+	fprintf(f, "family,mode,instructions,vertices,ticks\n");
+	for (i = 0; i < results_count; i++)
+		fprintf(f, "%s,%s,%u,%u,%llu\n", results[i].family, results[i].chain ? "chain" : "independent",
+			(unsigned)results[i].instructions, BENCH_VERTICES, (unsigned long long)results[i].ticks);
+	fclose(f);
+}
+
+//
+// Testing framework boilerplate
+//
+
+static void sceneInit(void);
+static void sceneRender(u32 n);
+static void sceneExit(void);
+static u64 benchRun(const bench_family_t* family, u32 n, bool chain);
+
+#define CLEAR_COLOR 0x0
+
+int main(void)
+{
+	// Initialize graphics
+	gfxInitDefault();
+	gpuInit();
+	gpuSetRegion(0, 0, 1, 1, false); // Nothing is rasterized, keep the clears small
+	consoleInit(GFX_BOTTOM, NULL);
+
+	// Initialize the scene
+	sceneInit();
+	gpuClearBuffers(CLEAR_COLOR);
+
+	// Time every family, variant and length
+	for (int i = 0; i < families_count; i++)
+	{
+		for (int chain = 0; chain < 2; chain++)
+		{
+			if (chain && !families[i].chain)
+				continue;
+
+			u64 ticks[BENCH_LENGTHS];
+			for (u32 l = 0; l < BENCH_LENGTHS; l++) {
+				ticks[l] = benchRun(&families[i], bench_lengths[l], chain);
+
+				bench_result_t* r = &results[results_count++];
+				r->family = families[i].name;
+				r->chain = chain;
+				r->instructions = bench_lengths[l];
+				r->ticks = ticks[l];
+			}
+
+			// Rough estimate from the longest and the shortest shader, benchfit does the actual fit
+			u32 last = BENCH_LENGTHS - 1;
+			float cycles = (float)(ticks[last] - ticks[0]) / ((float)bench_lengths[last] * BENCH_VERTICES);
+			printf("%-4s %-11s %6.3f cycles\n", families[i].name, chain ? "chain" : "independent", cycles);
+		}
+	}
+
+	benchLogFlush();
+	gpuProfileReport();
+#ifndef HEADLESS
+	printf("Press start to exit.\n");
+	while(true) {
+		gspWaitForVBlank();
+		hidScanInput();
+		if (hidKeysDown() & KEY_START)
+			break;
+	}
+#endif
+
+	// Deinitialize the scene
+	sceneExit();
+
+	// Deinitialize graphics
+	gpuExit();
+	gfxExit();
+	return 0;
+}
+
+static DVLP_s dvlp;
+static DVLE_s dvle;
+static DVLE_outEntry_s outputs[] = {
+	{ RESULT_POSITION, 0, 0xF, { 0 } },
+	{ RESULT_COLOR, 1, 0xF, { 0 } },
+};
+
+static shaderProgram_s program;
+
+// The fastest of BENCH_REPEATS draws of the generated shader, from the submission of the command list
+// to the end of rendering
+static u64 benchRun(const bench_family_t* family, u32 n, bool chain)
+{
+	u64 best = ~0ULL;
+	int i;
+
+	benchGenerate(family, n, chain);
+	dvlp.codeSize = code_size;
+
+	for (i = 0; i < BENCH_REPEATS; i++) {
+		gpuFrameBegin();
+		GPU_PROFILE_START(renderStart);
+			sceneRender(n);
+		GPU_PROFILE_STOP(GPU_PHASE_RENDER, renderStart);
+
+		u64 start = svcGetSystemTick();
+		gpuFrameFinish();
+		u64 ticks = svcGetSystemTick() - start;
+		if (ticks < best)
+			best = ticks;
+	}
+	return best;
+}
+
+typedef struct { float x, y, z; } vertex;
+
+static void* vbo_data;
+
+static void sceneInit(void)
+{
+	// The generated shaders go through the same path as the ones picasso assembles
+	dvlp.codeData = code;
+	dvlp.opdescSize = sizeof(opdescs)/sizeof(opdescs[0]);
+	dvlp.opcdescData = opdescs;
+	dvle.type = VERTEX_SHDR;
+	dvle.dvlp = &dvlp;
+	dvle.mainOffset = 0;
+	dvle.outTableSize = sizeof(outputs)/sizeof(outputs[0]);
+	dvle.outTableData = outputs;
+	DVLE_GenerateOutmap(&dvle);
+
+	shaderProgramInit(&program);
+	shaderProgramSetVsh(&program, &dvle);
+
+	// Create the VBO (vertex buffer object), every vertex is the center of the screen
+	vbo_data = linearAlloc(BENCH_VERTICES * sizeof(vertex));
+	vertex* vertices = (vertex*)vbo_data;
+	for (int i = 0; i < BENCH_VERTICES; i++) {
+		vertices[i].x = 0.0f;
+		vertices[i].y = 0.0f;
+		vertices[i].z = 0.5f;
+	}
+	GSPGPU_FlushDataCache(NULL, (u8*)vbo_data, BENCH_VERTICES * sizeof(vertex));
+}
+
+static void sceneRender(u32 n)
+{
+	// The loop family repeats its body n times
+	program.vertexShader->intUniforms[0] = n ? n - 1 : 0;
+
+	// Bind the shader program
+	shaderProgramUse(&program);
+
+	GPU_SetTexEnv(0,
+				  GPU_TEVSOURCES(GPU_PRIMARY_COLOR, GPU_PRIMARY_COLOR, GPU_PRIMARY_COLOR), // RGB channels
+				  GPU_TEVSOURCES(GPU_PRIMARY_COLOR, GPU_PRIMARY_COLOR, GPU_PRIMARY_COLOR), // Alpha
+				  GPU_TEVOPERANDS(0, 0, 0), // RGB
+				  GPU_TEVOPERANDS(0, 0, 0), // Alpha
+				  GPU_REPLACE, GPU_REPLACE, // RGB, Alpha
+				  0xFFFFFFFF);
+
+	// Configure the "attribute buffers" (that is, the vertex input buffers)
+	GPU_SetAttributeBuffers(
+			1, // Number of inputs per vertex
+			(u32*)osConvertVirtToPhys((u32)vbo_data), // Location of the VBO
+			GPU_ATTRIBFMT(0, 3, GPU_FLOAT), // Format of the inputs
+			0xFFE, // Unused attribute mask, in our case bit 0 is cleared since it is used
+			0x0, // Attribute permutations (here it is the identity)
+			1, // Number of buffers
+			(u32[]) { 0x0 }, // Buffer offsets (placeholders)
+			(u64[]) { 0x0 }, // Attribute permutations for each buffer (identity again)
+			(u8[])  { 1 }); // Number of attributes for each buffer
+
+	// Fill c0 and c1 with ones, c1 is what mov r0, c0[a0.x] reads
+	vector_4f ones[2] = { { { 1.0f, 1.0f, 1.0f, 1.0f } }, { { 1.0f, 1.0f, 1.0f, 1.0f } } };
+	GPU_SetFloatUniform(GPU_VERTEX_SHADER, 0, (u32*)ones, 2);
+
+	// Draw the VBO
+	GPU_DrawArray(GPU_TRIANGLES, BENCH_VERTICES);
+}
+
+static void sceneExit(void)
+{
+	// Free the VBO
+	linearFree(vbo_data);
+
+	// Free the shader program
+	shaderProgramFree(&program);
+}
@@ -4,106 +4,105 @@
 #include "3dmath.h"
 #include "gpu.h"
 #include "test.h"
+#include "batch.h"
 #include "vshader_shbin.h"
 
 // Testing the DPH shader instruction
 
-// For each test:
-// Draws a 1px by 1px quad in the bottom-left corner using a vertex shader
-// The DPH instruction is used to output the color of this quad.
-// The framebuffer is then read to verify the results
+// Each test sets the operands of its case up, batch.h draws every case as a single-pixel triangle in one draw:
+// The DPH instruction is used to output the color of each triangle, its operands are vertex attributes.
+// The framebuffer is then read once to verify all the results
 
 // The exact DPH shader command under test:
-// dph outclr.xyz, src1_uniform, src2_in_color
+// dph outclr.xyz, src1_in, src2_in_color
 
 // shader input color
 struct { float r, g, b, a; } src2_in_color;
 
-// shader uniform src1_uniform
-static vector_4f src1_uniform;
-static int uLoc_src1_uniform;
+// shader input src1_in
+static vector_4f src1_in;
 
 // Expected result
 static vector_4f expected_result;
 
 static void Test_DPH_Zeros(void) {
-	printf("Test: DPH_Zeros\n");
-	src1_uniform.x = 0.0f, src2_in_color.r = 0.0f, expected_result.x = 0.0f;
-	src1_uniform.y = 0.0f, src2_in_color.g = 0.0f, expected_result.y = 0.0f;
-	src1_uniform.z = 0.0f, src2_in_color.b = 0.0f, expected_result.z = 0.0f;
-	src1_uniform.w = 0.0f, src2_in_color.a = 0.0f;
+	testBegin("DPH_Zeros");
+	src1_in.x = 0.0f, src2_in_color.r = 0.0f, expected_result.x = 0.0f;
+	src1_in.y = 0.0f, src2_in_color.g = 0.0f, expected_result.y = 0.0f;
+	src1_in.z = 0.0f, src2_in_color.b = 0.0f, expected_result.z = 0.0f;
+	src1_in.w = 0.0f, src2_in_color.a = 0.0f;
 }
 
 static void Test_DPH_Zeros2(void) {
-	printf("Test: DPH_Zeros\n");
-	src1_uniform.x = 1.0f, src2_in_color.r = 0.0f, expected_result.x = 0.0f;
-	src1_uniform.y = 0.0f, src2_in_color.g = 1.0f, expected_result.y = 0.0f;
-	src1_uniform.z = 0.0f, src2_in_color.b = 1.0f, expected_result.z = 0.0f;
-	src1_uniform.w = 0.0f, src2_in_color.a = 0.0f;
+	testBegin("DPH_Zeros");
+	src1_in.x = 1.0f, src2_in_color.r = 0.0f, expected_result.x = 0.0f;
+	src1_in.y = 0.0f, src2_in_color.g = 1.0f, expected_result.y = 0.0f;
+	src1_in.z = 0.0f, src2_in_color.b = 1.0f, expected_result.z = 0.0f;
+	src1_in.w = 0.0f, src2_in_color.a = 0.0f;
 }
 
 static void Test_DPH_X(void) {
-	printf("Test: DPH_X\n");
-	src1_uniform.x = 1.0f, src2_in_color.r = 1.0f, expected_result.x = 1.0f;
-	src1_uniform.y = 0.0f, src2_in_color.g = 0.0f, expected_result.y = 1.0f;
-	src1_uniform.z = 0.0f, src2_in_color.b = 0.0f, expected_result.z = 1.0f;
-	src1_uniform.w = 0.0f, src2_in_color.a = 0.0f;
+	testBegin("DPH_X");
+	src1_in.x = 1.0f, src2_in_color.r = 1.0f, expected_result.x = 1.0f;
+	src1_in.y = 0.0f, src2_in_color.g = 0.0f, expected_result.y = 1.0f;
+	src1_in.z = 0.0f, src2_in_color.b = 0.0f, expected_result.z = 1.0f;
+	src1_in.w = 0.0f, src2_in_color.a = 0.0f;
 }
 
 static void Test_DPH_Y(void) {
-	printf("Test: DPH_Y\n");
-	src1_uniform.x = 0.0f, src2_in_color.r = 0.0f, expected_result.x = 1.0f;
-	src1_uniform.y = 1.0f, src2_in_color.g = 1.0f, expected_result.y = 1.0f;
-	src1_uniform.z = 0.0f, src2_in_color.b = 0.0f, expected_result.z = 1.0f;
-	src1_uniform.w = 0.0f, src2_in_color.a = 0.0f;
+	testBegin("DPH_Y");
+	src1_in.x = 0.0f, src2_in_color.r = 0.0f, expected_result.x = 1.0f;
+	src1_in.y = 1.0f, src2_in_color.g = 1.0f, expected_result.y = 1.0f;
+	src1_in.z = 0.0f, src2_in_color.b = 0.0f, expected_result.z = 1.0f;
+	src1_in.w = 0.0f, src2_in_color.a = 0.0f;
 }
 
 static void Test_DPH_Z(void) {
-	printf("Test: DPH_Z\n");
-	src1_uniform.x = 0.0f, src2_in_color.r = 0.0f, expected_result.x = 1.0f;
-	src1_uniform.y = 0.0f, src2_in_color.g = 0.0f, expected_result.y = 1.0f;
-	src1_uniform.z = 1.0f, src2_in_color.b = 1.0f, expected_result.z = 1.0f;
-	src1_uniform.w = 0.0f, src2_in_color.a = 0.0f;
+	testBegin("DPH_Z");
+	src1_in.x = 0.0f, src2_in_color.r = 0.0f, expected_result.x = 1.0f;
+	src1_in.y = 0.0f, src2_in_color.g = 0.0f, expected_result.y = 1.0f;
+	src1_in.z = 1.0f, src2_in_color.b = 1.0f, expected_result.z = 1.0f;
+	src1_in.w = 0.0f, src2_in_color.a = 0.0f;
 }
 
 static void Test_DPH_W(void) {
-	printf("Test: DPH_W\n");
-	src1_uniform.x = 0.0f, src2_in_color.r = 0.0f, expected_result.x = 1.0f;
-	src1_uniform.y = 0.0f, src2_in_color.g = 0.0f, expected_result.y = 1.0f;
-	src1_uniform.z = 0.0f, src2_in_color.b = 0.0f, expected_result.z = 1.0f;
-	src1_uniform.w = 0.0f, src2_in_color.a = 1.0f;
+	testBegin("DPH_W");
+	src1_in.x = 0.0f, src2_in_color.r = 0.0f, expected_result.x = 1.0f;
+	src1_in.y = 0.0f, src2_in_color.g = 0.0f, expected_result.y = 1.0f;
+	src1_in.z = 0.0f, src2_in_color.b = 0.0f, expected_result.z = 1.0f;
+	src1_in.w = 0.0f, src2_in_color.a = 1.0f;
 }
 
 static void Test_DPH_W2(void) {
-	printf("Test: DPH_W2\n");
-	src1_uniform.x = 0.0f, src2_in_color.r = 0.0f, expected_result.x = 0.0f;
-	src1_uniform.y = 0.0f, src2_in_color.g = 0.0f, expected_result.y = 0.0f;
-	src1_uniform.z = 0.0f, src2_in_color.b = 0.0f, expected_result.z = 0.0f;
-	src1_uniform.w = 1.0f, src2_in_color.a = 0.0f;
+	testBegin("DPH_W2");
+	src1_in.x = 0.0f, src2_in_color.r = 0.0f, expected_result.x = 0.0f;
+	src1_in.y = 0.0f, src2_in_color.g = 0.0f, expected_result.y = 0.0f;
+	src1_in.z = 0.0f, src2_in_color.b = 0.0f, expected_result.z = 0.0f;
+	src1_in.w = 1.0f, src2_in_color.a = 0.0f;
 }
 
 static void Test_DPH_Simple(void) {
-	printf("Test: DPH_Simple\n");
-	src1_uniform.x = 0.5f, src2_in_color.r = 0.5f, expected_result.x = 1.0f;
-	src1_uniform.y = 0.0f, src2_in_color.g = 0.0f, expected_result.y = 1.0f;
-	src1_uniform.z = 0.5f, src2_in_color.b = 0.5f, expected_result.z = 1.0f;
-	src1_uniform.w = 0.0f, src2_in_color.a = 0.5f;
+	testBegin("DPH_Simple");
+	src1_in.x = 0.5f, src2_in_color.r = 0.5f, expected_result.x = 1.0f;
+	src1_in.y = 0.0f, src2_in_color.g = 0.0f, expected_result.y = 1.0f;
+	src1_in.z = 0.5f, src2_in_color.b = 0.5f, expected_result.z = 1.0f;
+	src1_in.w = 0.0f, src2_in_color.a = 0.5f;
 }
 
 static void Test_DPH_Simple2(void) {
-	printf("Test: DPH_Simple2\n");
-	src1_uniform.x = 0.0f, src2_in_color.r = 0.0f, expected_result.x = 0.75f;
-	src1_uniform.y = 0.5f, src2_in_color.g = 0.5f, expected_result.y = 0.75f;
-	src1_uniform.z = 0.0f, src2_in_color.b = 0.0f, expected_result.z = 0.75f;
-	src1_uniform.w = 0.0f, src2_in_color.a = 0.5f;
+	testBegin("DPH_Simple2");
+	src1_in.x = 0.0f, src2_in_color.r = 0.0f, expected_result.x = 0.75f;
+	src1_in.y = 0.5f, src2_in_color.g = 0.5f, expected_result.y = 0.75f;
+	src1_in.z = 0.0f, src2_in_color.b = 0.0f, expected_result.z = 0.75f;
+	src1_in.w = 0.0f, src2_in_color.a = 0.5f;
 }
 
 static void Test_DPH_Simple3(void) {
-	printf("Test: DPH_Simple3\n");
-	src1_uniform.x = 0.0f, src2_in_color.r = 0.0f, expected_result.x = 1.0f;
-	src1_uniform.y = 0.0f, src2_in_color.g = 0.0f, expected_result.y = 1.0f;
-	src1_uniform.z = 0.0f, src2_in_color.b = 0.0f, expected_result.z = 1.0f;
-	src1_uniform.w = 0.5f, src2_in_color.a = 1.0f;
+	testBegin("DPH_Simple3");
+	src1_in.x = 0.0f, src2_in_color.r = 0.0f, expected_result.x = 1.0f;
+	src1_in.y = 0.0f, src2_in_color.g = 0.0f, expected_result.y = 1.0f;
+	src1_in.z = 0.0f, src2_in_color.b = 0.0f, expected_result.z = 1.0f;
+	src1_in.w = 0.5f, src2_in_color.a = 1.0f;
 }
 
 static test_t tests[] = {
@@ -128,7 +127,6 @@ static int tests_count =  (sizeof(tests)/sizeof(tests[0]));
 static void sceneInit(void);
 static void sceneRender(void);
 static void sceneExit(void);
-static void Verify(void);
 
 #define CLEAR_COLOR 0x0
 
@@ -139,35 +137,47 @@ int main(void)
 	gpuInit();
 	consoleInit(GFX_BOTTOM, NULL);
 
-	// Initialize the scene
-	sceneInit();
-	gpuClearBuffers(CLEAR_COLOR);
-
-	// Run one test per frame
+	// Set every test up, then render and verify them all in one frame
 	for (int i = 0; i < tests_count; i++)
 	{
 		tests[i]();
-			gpuFrameBegin();
-				sceneRender();
-			gpuFrameEnd();
-		Verify();
+		float src1[] = { src1_in.x, src1_in.y, src1_in.z, src1_in.w };
+		float src2[] = { src2_in_color.r, src2_in_color.g, src2_in_color.b, src2_in_color.a };
+		batchAdd(src1, src2, (float[]) { expected_result.x, expected_result.y, expected_result.z });
+	}
+
+	// Initialize the scene
+	sceneInit();
+	gpuSetRegion(0, 0, BATCH_WIDTH, batchRows(), false); // Tests only write the pixels batchVerify reads
+	gpuClearBuffers(CLEAR_COLOR);
 
-		gpuClearBuffers(CLEAR_COLOR);
-		gspWaitForVBlank();  // Synchronize with the start of VBlank
-		gfxSwapBuffersGpu(); // Swap the framebuffers so that the frame that we rendered last frame is now visible
+	gpuFrameBegin();
+	GPU_PROFILE_START(renderStart);
+		sceneRender();
+	GPU_PROFILE_STOP(GPU_PHASE_RENDER, renderStart);
+	gpuFrameFinish();
+	GPU_PROFILE_START(verifyStart);
+	batchVerify();
+	GPU_PROFILE_STOP(GPU_PHASE_VERIFY, verifyStart);
 
-		// Flush the framebuffers out of the data cache (not necessary with pure GPU rendering)
-		//gfxFlushBuffers();
-	}
+#ifndef HEADLESS
+	gspWaitForVBlank();  // Synchronize with the start of VBlank
+	gfxSwapBuffersGpu(); // Swap the framebuffers so that the frame that we rendered last frame is now visible
+#endif
 
 	// End of tests
-	printf("Tests ends. Press start to exit.\n");
+	testSummary(tests_count);
+	testLogFlush("dph");
+	gpuProfileReport();
+#ifndef HEADLESS
+	printf("Press start to exit.\n");
 	while(true) {
 		gspWaitForVBlank();
 		hidScanInput();
 		if (hidKeysDown() & KEY_START)
 			break;
 	}
+#endif
 
 	// Deinitialize the scene
 	sceneExit();
@@ -178,36 +188,11 @@ int main(void)
 	return 0;
 }
 
-static void Verify(void) {
-	u32 final_result = ((unsigned*)gfxGetFramebuffer(GFX_TOP, GFX_LEFT, NULL, NULL))[0];
-	if ((unsigned)(expected_result.z * 255.0f) != (final_result & 0xFF))
-		printf("Failure final.z = %x\n, expected = %x\n", (unsigned)(final_result & 0xFF), (unsigned)(expected_result.z*255.0f));
-	if ((unsigned)(expected_result.y * 255.0f) != ((final_result >> 8) & 0xFF))
-		printf("Failure final.y = %x\n, expected = %x\n", (unsigned)((final_result >> 8) & 0xFF), (unsigned)(expected_result.y*255.0f));
-	if ((unsigned)(expected_result.x * 255.0f) != ((final_result >> 16) & 0xFF))
-		printf("Failure final.x = %x\n, expected = %x\n", (unsigned)((final_result >> 16) & 0xFF), (unsigned)(expected_result.x*255.0f));
-}
-
-typedef struct { float x, y, z; float r, g, b, a; } vertex;
-
-static vertex vertex_list[] =
-{
-		{ 0.0f, 1.0f, 0.5f, 1.0f, 1.0f, 1.0f, 1.0f },
-		{ 1.0f, 0.0f, 0.5f, 1.0f, 1.0f, 1.0f, 1.0f },
-		{ 1.0f, 1.0f, 0.5f, 1.0f, 1.0f, 1.0f, 1.0f },
-		{ 0.0f, 1.0f, 0.5f, 1.0f, 1.0f, 1.0f, 1.0f },
-
-};
-
-static int vertex_list_count = sizeof(vertex_list)/sizeof(vertex_list[0]);
-
 static DVLB_s* vshader_dvlb;
 static shaderProgram_s program;
 static int uLoc_projection;
 static matrix_4x4 projection;
 
-static void* vbo_data;
-
 static void sceneInit(void)
 {
 	// Load the vertex shader and create a shader program
@@ -217,26 +202,16 @@ static void sceneInit(void)
 
 	// Get the location of the projection matrix uniform
 	uLoc_projection = shaderInstanceGetUniformLocation(program.vertexShader, "projection");
-	uLoc_src1_uniform = shaderInstanceGetUniformLocation(program.vertexShader, "src1_uniform");
 
 	// Compute the projection matrix
 	m4x4_ortho_tilt(&projection, 0.0, 400.0, 0.0, 240.0, 0.0, 1.0);
 
-	// Create the VBO (vertex buffer object)
-	vbo_data = linearAlloc(sizeof(vertex_list));
-	memcpy(vbo_data, vertex_list, sizeof(vertex_list));
+	// Create the VBO (vertex buffer object) holding every test
+	batchUpload();
 }
 
 static void sceneRender(void)
 {
-	for (int i = 0; i < vertex_list_count; i++) {
-		vertex_list[i].r = src2_in_color.r;
-		vertex_list[i].g = src2_in_color.g;
-		vertex_list[i].b = src2_in_color.b;
-		vertex_list[i].a = src2_in_color.a;
-	}
-	memcpy(vbo_data, vertex_list, sizeof(vertex_list));
-
 	// Bind the shader program
 	shaderProgramUse(&program);
 
@@ -250,32 +225,17 @@ static void sceneRender(void)
 				  GPU_REPLACE, GPU_REPLACE, // RGB, Alpha
 				  0xFFFFFFFF);
 
-	// Configure the "attribute buffers" (that is, the vertex input buffers)
-	GPU_SetAttributeBuffers(
-			2, // Number of inputs per vertex
-			(u32*)osConvertVirtToPhys((u32)vbo_data), // Location of the VBO
-			GPU_ATTRIBFMT(0, 3, GPU_FLOAT) | GPU_ATTRIBFMT(1, 4, GPU_FLOAT), // Format of the inputs (in this case the only input is a 3-element float vector)
-			0xFFC, // Unused attribute mask, in our case bit 0 is cleared since it is used
-			0x10, // Attribute permutations (here it is the identity)
-			1, // Number of buffers
-			(u32[]) { 0x0 }, // Buffer offsets (placeholders)
-			(u64[]) { 0x10 }, // Attribute permutations for each buffer (identity again)
-			(u8[])  { 2 }); // Number of attributes for each buffer
-
 	// Upload the projection matrix
 	GPU_SetFloatUniformMatrix(GPU_VERTEX_SHADER, uLoc_projection, &projection);
 
-	// Upload the test vector uniform
-	GPU_SetFloatUniform(GPU_VERTEX_SHADER, (u32) uLoc_src1_uniform, (u32*)&src1_uniform, 1);
-
 	// Draw the VBO
-	GPU_DrawArray(GPU_TRIANGLE_STRIP, vertex_list_count);
+	batchDraw();
 }
 
 static void sceneExit(void)
 {
 	// Free the VBO
-	linearFree(vbo_data);
+	batchFree();
 
 	// Free the shader program
 	shaderProgramFree(&program);
@@ -0,0 +1,520 @@
+#include <stdio.h>
+#include <3ds/gpu/shaderProgram.h>
+
+#include "3dmath.h"
+#include "gpu.h"
+
+// Dumping the results of rcp, rsq, ex2 and lg2 for every float24 input
+
+// For each instruction:
+// Draws one triangle per input, DUMP_WIDTH x DUMP_HEIGHT of them per frame, each covering the center of
+// a single pixel. The vertex shader runs the instruction on the input its vertices carry and encodes
+// the float24 result into the color of the pixel, which the colors' 8 bits per channel keep exactly.
+// The framebuffer is then read back, decoded and appended to <op>-dump.bin (on the SD card on the device).
+// host/tools/golden imports the dumps as reference sweeps the host model is checked against.
+
+// Encoding of a result r in the pixel, each channel holding an integer n as (n + 0.25) / 255 so that
+// both truncating and rounding the color to 8 bits give n back:
+// R: biased exponent, 1 to 126
+// G: high byte of the mantissa
+// B: low byte of the mantissa
+// A: class, bit 0 sign, bit 1 zero, bit 2 infinity, bit 3 NaN
+// The exponent and the mantissa come from normalizing |r| to [1, 2) with multiplications by powers of two,
+// which are exact, and the class from comparisons, so that R, G and B are only meaningful for finite non-zero
+// results. The sign of zeros is the sign of their reciprocal, NaNs all decode to 0x7FFFFF.
+
+#define DUMP_WIDTH  128
+#define DUMP_HEIGHT 256
+#define DUMP_PER_FRAME (DUMP_WIDTH * DUMP_HEIGHT)
+
+// Inputs [DUMP_FIRST, DUMP_FIRST + DUMP_COUNT) are dumped, all of them by default
+#ifndef DUMP_FIRST
+#define DUMP_FIRST 0
+#endif
+#ifndef DUMP_COUNT
+#define DUMP_COUNT (1 << 24)
+#endif
+
+// <op>-dump.bin is a header followed by the count results as 3-byte little endian float24 values
+#define DUMP_MAGIC   0x504D4450 // "PDMP"
+#define DUMP_VERSION 1
+
+typedef struct {
+	u32 magic;
+	u32 version;
+	u32 op;          // opcode of the instruction
+	u32 first;       // float24 bits of the first input
+	u32 count;       // results following the header, one per input
+	u32 checksum;    // CRC-32 of the results
+	u32 reserved[2];
+} dump_header_t;
+
+//
+// Shader generator
+//
+
+// Register indices as encoded in the instructions
+#define REG_V(n) (0x00 + (n))
+#define REG_O(n) (0x00 + (n))
+#define REG_R(n) (0x10 + (n))
+#define REG_C(n) (0x20 + (n))
+
+enum {
+	OP_ADD  = 0x00,
+	OP_DP4  = 0x02,
+	OP_EX2  = 0x05,
+	OP_LG2  = 0x06,
+	OP_MUL  = 0x08,
+	OP_SGE  = 0x09,
+	OP_FLR  = 0x0B,
+	OP_MAX  = 0x0C,
+	OP_RCP  = 0x0E,
+	OP_RSQ  = 0x0F,
+	OP_MOV  = 0x13,
+	OP_SGEI = 0x1A,
+	OP_SLTI = 0x1B,
+	OP_END  = 0x22,
+	OP_MAD  = 0x38,
+};
+
+// Source swizzles, and the negation of a source
+#define SW_XYZW 0x1B
+#define SW_X    0x00
+#define SW_Y    0x55
+#define SW_Z    0xAA
+#define SW_W    0xFF
+#define NEG     0x100
+
+// Destination masks
+#define MASK_XYZW 0xF
+#define MASK_X    0x8
+#define MASK_Y    0x4
+#define MASK_Z    0x2
+#define MASK_W    0x1
+
+static u32 opdescs[128];
+static u32 opdescs_count;
+static u32 code[512];
+static u32 code_size;
+
+// Index of the operand descriptor, added the first time it is used
+static u32 desc(u32 mask, u32 src1, u32 src2, u32 src3)
+{
+	u32 d = mask | ((src1 & 0xFF) << 5) | ((src1 & NEG) ? 1 << 4 : 0) |
+		((src2 & 0xFF) << 14) | ((src2 & NEG) ? 1 << 13 : 0) |
+		((src3 & 0xFF) << 23) | ((src3 & NEG) ? 1 << 22 : 0);
+	u32 i;
+
+	for (i = 0; i < opdescs_count; i++)
+		if (opdescs[i] == d)
+			return i;
+	opdescs[opdescs_count] = d;
+	return opdescs_count++;
+}
+
+static void emit(u32 instr)
+{
+	code[code_size++] = instr;
+}
+
+// op dst, src1, src2: src1 may be a uniform, src2 may not
+static void emitAlu(u32 op, u32 dst, u32 mask, u32 src1, u32 sw1, u32 src2, u32 sw2)
+{
+	emit((op << 26) | (dst << 21) | (src1 << 12) | (src2 << 7) | desc(mask, sw1, sw2, SW_XYZW));
+}
+
+// sgei and slti: src2 may be a uniform, src1 may not
+static void emitAluI(u32 op, u32 dst, u32 mask, u32 src1, u32 sw1, u32 src2, u32 sw2)
+{
+	emit((op << 26) | (dst << 21) | (src1 << 14) | (src2 << 7) | desc(mask, sw1, sw2, SW_XYZW));
+}
+
+// mad dst, src1, src2, src3: src2 may be a uniform. Its operand descriptor must be among the first 32.
+static void emitMad(u32 dst, u32 src1, u32 src2, u32 sw2, u32 src3)
+{
+	u32 d = desc(MASK_XYZW, SW_XYZW, sw2, SW_XYZW);
+	emit((OP_MAD << 26) | (dst << 24) | (src1 << 17) | (src2 << 10) | (src3 << 5) | d);
+}
+
+// Uniforms: c0-c3 the projection, then the constants and one vector per normalization step
+#define C_CONST0 REG_C(4) // 0, 1, 0.5, 2^63
+#define C_CONST1 REG_C(5) // 2^-62, 65536, 63, 0.25
+#define C_CONST2 REG_C(6) // 1/256, -256, 1/255, 8
+#define C_CONST3 REG_C(7) // 2, 4, -8, 0
+#define C_STEPS  REG_C(8) // threshold, factor, exponent change
+
+static const u32 steps[] = { 32, 16, 8, 4, 2, 1 };
+#define NUM_STEPS (sizeof(steps)/sizeof(steps[0]))
+
+// a *= c ? factor : 1, e += c * change, with c the comparison in r10. Both products are exact, so is the sum
+// since one of them is zero.
+static void emitStep(u32 step, bool down)
+{
+	u32 c = C_STEPS + step;
+
+	emitAluI(down ? OP_SGEI : OP_SLTI, REG_R(10), MASK_XYZW, REG_R(2), SW_XYZW, c, SW_X);
+	emitAlu(OP_MUL, REG_R(11), MASK_XYZW, c, SW_Y, REG_R(2), SW_XYZW);
+	emitAlu(OP_ADD, REG_R(12), MASK_XYZW, C_CONST0, SW_Y, REG_R(10), SW_XYZW | NEG);
+	emitAlu(OP_MUL, REG_R(12), MASK_XYZW, REG_R(12), SW_XYZW, REG_R(2), SW_XYZW);
+	emitAlu(OP_MUL, REG_R(11), MASK_XYZW, REG_R(11), SW_XYZW, REG_R(10), SW_XYZW);
+	emitAlu(OP_ADD, REG_R(2), MASK_XYZW, REG_R(11), SW_XYZW, REG_R(12), SW_XYZW);
+	emitMad(REG_R(9), REG_R(10), c, SW_Z, REG_R(9));
+}
+
+// o0 = the position in v0.xy, o1 = the encoded result of op on v0.z. Every register holds the same value
+// in its four components.
+static void dumpGenerate(u32 op)
+{
+	u32 i;
+
+	code_size = 0;
+	opdescs_count = 0;
+
+	// Position
+	emitAlu(OP_MOV, REG_R(1), MASK_XYZW, REG_V(0), SW_XYZW, 0, SW_XYZW);
+	emitAlu(OP_MOV, REG_R(1), MASK_Z, C_CONST0, SW_Z, 0, SW_XYZW);
+	emitAlu(OP_MOV, REG_R(1), MASK_W, C_CONST0, SW_Y, 0, SW_XYZW);
+	for (i = 0; i < 4; i++)
+		emitAlu(OP_DP4, REG_O(0), MASK_X >> i, REG_C(i), SW_XYZW, REG_R(1), SW_XYZW);
+
+	// r0 = op(input), r2 = |r0|
+	emitAlu(op, REG_R(0), MASK_XYZW, REG_V(0), SW_Z, 0, SW_XYZW);
+	emitAlu(OP_MAX, REG_R(2), MASK_XYZW, REG_R(0), SW_XYZW, REG_R(0), SW_XYZW | NEG);
+
+	// Class: r3 negative, r4 reciprocal negative, r5 zero, r6 infinite (|r0| / 2 >= 2^63), r7 not NaN
+	emitAluI(OP_SLTI, REG_R(3), MASK_XYZW, REG_R(0), SW_XYZW, C_CONST0, SW_X);
+	emitAlu(OP_RCP, REG_R(4), MASK_XYZW, REG_R(0), SW_XYZW, 0, SW_XYZW);
+	emitAluI(OP_SLTI, REG_R(4), MASK_XYZW, REG_R(4), SW_XYZW, C_CONST0, SW_X);
+	emitAluI(OP_SLTI, REG_R(5), MASK_XYZW, REG_R(2), SW_XYZW, C_CONST1, SW_X);
+	emitAlu(OP_MUL, REG_R(6), MASK_XYZW, C_CONST0, SW_Z, REG_R(2), SW_XYZW);
+	emitAluI(OP_SGEI, REG_R(6), MASK_XYZW, REG_R(6), SW_XYZW, C_CONST0, SW_W);
+	emitAlu(OP_SGE, REG_R(7), MASK_XYZW, REG_R(0), SW_XYZW, REG_R(0), SW_XYZW);
+
+	// r8 = sign + 2 zero + 4 infinite + 8 NaN, zeros take the sign of their reciprocal
+	emitAlu(OP_ADD, REG_R(4), MASK_XYZW, REG_R(4), SW_XYZW, REG_R(3), SW_XYZW | NEG);
+	emitMad(REG_R(3), REG_R(5), REG_R(4), SW_XYZW, REG_R(3));
+	emitMad(REG_R(8), REG_R(5), C_CONST3, SW_X, REG_R(3));
+	emitMad(REG_R(8), REG_R(6), C_CONST3, SW_Y, REG_R(8));
+	emitMad(REG_R(8), REG_R(7), C_CONST3, SW_Z, REG_R(8));
+	emitAlu(OP_ADD, REG_R(8), MASK_XYZW, C_CONST2, SW_W, REG_R(8), SW_XYZW);
+
+	// Normalize r2 to [1, 2), r9 = its exponent
+	emitAlu(OP_MOV, REG_R(9), MASK_XYZW, C_CONST0, SW_X, 0, SW_XYZW);
+	for (i = 0; i < 2 * NUM_STEPS; i++)
+		emitStep(i, i < NUM_STEPS);
+
+	// r2 = mantissa, r13 = its high byte, r14 = its low byte, r9 = biased exponent
+	emitAlu(OP_ADD, REG_R(2), MASK_XYZW, C_CONST0, SW_Y | NEG, REG_R(2), SW_XYZW);
+	emitAlu(OP_MUL, REG_R(2), MASK_XYZW, C_CONST1, SW_Y, REG_R(2), SW_XYZW);
+	emitAlu(OP_FLR, REG_R(2), MASK_XYZW, REG_R(2), SW_XYZW, 0, SW_XYZW);
+	emitAlu(OP_MUL, REG_R(13), MASK_XYZW, C_CONST2, SW_X, REG_R(2), SW_XYZW);
+	emitAlu(OP_FLR, REG_R(13), MASK_XYZW, REG_R(13), SW_XYZW, 0, SW_XYZW);
+	emitMad(REG_R(14), REG_R(13), C_CONST2, SW_Y, REG_R(2));
+	emitAlu(OP_ADD, REG_R(9), MASK_XYZW, C_CONST1, SW_Z, REG_R(9), SW_XYZW);
+
+	// o1 = (exponent, high, low, class) + 0.25, divided by 255
+	emitAlu(OP_MOV, REG_R(15), MASK_X, REG_R(9), SW_XYZW, 0, SW_XYZW);
+	emitAlu(OP_MOV, REG_R(15), MASK_Y, REG_R(13), SW_XYZW, 0, SW_XYZW);
+	emitAlu(OP_MOV, REG_R(15), MASK_Z, REG_R(14), SW_XYZW, 0, SW_XYZW);
+	emitAlu(OP_MOV, REG_R(15), MASK_W, REG_R(8), SW_XYZW, 0, SW_XYZW);
+	emitAlu(OP_ADD, REG_R(15), MASK_XYZW, C_CONST1, SW_W, REG_R(15), SW_XYZW);
+	emitAlu(OP_MUL, REG_O(1), MASK_XYZW, C_CONST2, SW_Z, REG_R(15), SW_XYZW);
+	emit(OP_END << 26);
+}
+
+// Float24 bits of the result a pixel encodes
+static u32 dumpDecode(u32 pixel)
+{
+	u32 cls = pixel >> 24, exponent = (pixel >> 16) & 0xFF, mantissa = pixel & 0xFFFF;
+	u32 sign = (cls & 1) << 23;
+
+	if (cls & 8)
+		return 0x7FFFFF;
+	if (cls & 4)
+		return sign | (0x7F << 16);
+	if (cls & 2)
+		return sign;
+	return sign | ((exponent & 0x7F) << 16) | mantissa;
+}
+
+// Float32 value of float24 bits, all the inputs are representable
+static float dumpInput(u32 value)
+{
+	union { u32 u; float f; } bits;
+	u32 sign = (value >> 23) & 1;
+	u32 exponent = (value >> 16) & 0x7F;
+	u32 mantissa = value & 0xFFFF;
+
+	if (exponent == 0)
+		bits.u = sign << 31;
+	else if (exponent == 0x7F)
+		bits.u = (sign << 31) | (0xFF << 23) | (mantissa << 7);
+	else
+		bits.u = (sign << 31) | ((exponent + 64) << 23) | (mantissa << 7);
+	return bits.f;
+}
+
+//
+// Dump files
+//
+
+static u32 crc_table[256];
+
+static void crcInit(void)
+{
+	u32 i, j;
+	for (i = 0; i < 256; i++) {
+		u32 c = i;
+		for (j = 0; j < 8; j++)
+			c = (c >> 1) ^ (c & 1 ? 0xEDB88320 : 0);
+		crc_table[i] = c;
+	}
+}
+
+static u32 crcUpdate(u32 crc, const u8* data, u32 size)
+{
+	crc = ~crc;
+	while (size--)
+		crc = crc_table[(crc ^ *data++) & 0xFF] ^ (crc >> 8);
+	return ~crc;
+}
+
+typedef struct {
+	const char* name;
+	u32 op;
+} dump_op_t;
+
+static const dump_op_t ops[] = {
+	{ "rcp", OP_RCP },
+	{ "rsq", OP_RSQ },
+	{ "ex2", OP_EX2 },
+	{ "lg2", OP_LG2 },
+};
+
+static int ops_count = (sizeof(ops)/sizeof(ops[0]));
+
+//
+// Testing framework boilerplate
+//
+
+static void sceneInit(void);
+static void sceneRender(u32 first, u32 count);
+static void sceneExit(void);
+static bool dumpRun(const dump_op_t* op);
+
+#define CLEAR_COLOR 0x0
+
+int main(void)
+{
+	// Initialize graphics
+	gfxInitDefault();
+	gpuInit();
+	gpuSetRegion(0, 0, DUMP_WIDTH, DUMP_HEIGHT, false);
+	consoleInit(GFX_BOTTOM, NULL);
+	crcInit();
+
+	// Initialize the scene
+	sceneInit();
+	gpuClearBuffers(CLEAR_COLOR);
+
+	// Dump every instruction
+	for (int i = 0; i < ops_count; i++)
+		if (!dumpRun(&ops[i]))
+			break;
+
+	gpuProfileReport();
+#ifndef HEADLESS
+	printf("Press start to exit.\n");
+	while(true) {
+		gspWaitForVBlank();
+		hidScanInput();
+		if (hidKeysDown() & KEY_START)
+			break;
+	}
+#endif
+
+	// Deinitialize the scene
+	sceneExit();
+
+	// Deinitialize graphics
+	gpuExit();
+	gfxExit();
+	return 0;
+}
+
+static DVLP_s dvlp;
+static DVLE_s dvle;
+static DVLE_outEntry_s outputs[] = {
+	{ RESULT_POSITION, 0, 0xF, { 0 } },
+	{ RESULT_COLOR, 1, 0xF, { 0 } },
+};
+
+static shaderProgram_s program;
+
+static u32 pixels[DUMP_PER_FRAME];
+static u8 results[DUMP_PER_FRAME * 3];
+
+// Renders the inputs DUMP_PER_FRAME at a time and appends the decoded results to the dump, the header
+// is written again with the count and the checksum once every frame is
+static bool dumpRun(const dump_op_t* op)
+{
+	char path[64];
+	dump_header_t header = { DUMP_MAGIC, DUMP_VERSION, op->op, DUMP_FIRST, 0, 0, { 0, 0 } };
+	u32 first, i;
+
+#ifdef _3DS
+	snprintf(path, sizeof(path), "sdmc:/%s-dump.bin", op->name);
+#else
+	snprintf(path, sizeof(path), "%s-dump.bin", op->name);
+#endif
+	FILE* f = fopen(path, "wb");
+	if (!f || fwrite(&header, sizeof(header), 1, f) != 1) {
+		printf("Cannot write %s\n", path);
+		if (f)
+			fclose(f);
+		return false;
+	}
+
+	dumpGenerate(op->op);
+	dvlp.codeSize = code_size;
+	dvlp.opdescSize = opdescs_count;
+	printf("%s: %u inputs\n", op->name, (unsigned)DUMP_COUNT);
+
+	for (first = DUMP_FIRST; first < DUMP_FIRST + DUMP_COUNT; first += DUMP_PER_FRAME) {
+		u32 count = DUMP_FIRST + DUMP_COUNT - first;
+		if (count > DUMP_PER_FRAME)
+			count = DUMP_PER_FRAME;
+
+		gpuFrameBegin();
+		GPU_PROFILE_START(renderStart);
+			sceneRender(first, count);
+		GPU_PROFILE_STOP(GPU_PHASE_RENDER, renderStart);
+		gpuFrameFinish();
+
+		GPU_PROFILE_START(verifyStart);
+		gpuReadPixels(0, 0, DUMP_WIDTH, DUMP_HEIGHT, pixels);
+		for (i = 0; i < count; i++) {
+			u32 value = dumpDecode(pixels[i]);
+			results[3 * i] = value;
+			results[3 * i + 1] = value >> 8;
+			results[3 * i + 2] = value >> 16;
+		}
+		header.checksum = crcUpdate(header.checksum, results, 3 * count);
+		header.count += count;
+		GPU_PROFILE_STOP(GPU_PHASE_VERIFY, verifyStart);
+
+		if (fwrite(results, 3, count, f) != count) {
+			printf("Cannot write %s\n", path);
+			fclose(f);
+			return false;
+		}
+		gpuClearBuffers(CLEAR_COLOR);
+	}
+
+	if (fseek(f, 0, SEEK_SET) || fwrite(&header, sizeof(header), 1, f) != 1 || fclose(f)) {
+		printf("Cannot write %s\n", path);
+		return false;
+	}
+	printf("%s: crc %08x\n", path, (unsigned)header.checksum);
+	return true;
+}
+
+typedef struct { float x, y, input; } vertex;
+
+static vertex* vbo_data;
+
+static void sceneInit(void)
+{
+	// The generated shaders go through the same path as the ones picasso assembles
+	dvlp.codeData = code;
+	dvlp.opcdescData = opdescs;
+	dvle.type = VERTEX_SHDR;
+	dvle.dvlp = &dvlp;
+	dvle.mainOffset = 0;
+	dvle.outTableSize = sizeof(outputs)/sizeof(outputs[0]);
+	dvle.outTableData = outputs;
+	DVLE_GenerateOutmap(&dvle);
+
+	shaderProgramInit(&program);
+	shaderProgramSetVsh(&program, &dvle);
+
+	// Create the VBO (vertex buffer object), three vertices per input. Input i is the triangle around the
+	// center of pixel i of gpuReadPixels' rectangle: vertex x runs along the rows, vertex y along the columns.
+	// The sides are 1.5 pixels long, the triangles cover no other pixel center.
+	vbo_data = linearAlloc(DUMP_PER_FRAME * 3 * sizeof(vertex));
+	for (int i = 0; i < DUMP_PER_FRAME; i++) {
+		float x = (float)(i / DUMP_WIDTH), y = (float)(i % DUMP_WIDTH);
+		vertex* v = &vbo_data[3 * i];
+		v[0].x = x;        v[0].y = y;
+		v[1].x = x + 1.5f; v[1].y = y;
+		v[2].x = x;        v[2].y = y + 1.5f;
+		v[0].input = v[1].input = v[2].input = 0.0f;
+	}
+}
+
+static void sceneRender(u32 first, u32 count)
+{
+	// The inputs of this frame, the vertices of the rest of the frame are left as they were
+	for (u32 i = 0; i < count; i++) {
+		float input = dumpInput(first + i);
+		vbo_data[3 * i].input = vbo_data[3 * i + 1].input = vbo_data[3 * i + 2].input = input;
+	}
+	GSPGPU_FlushDataCache(NULL, (u8*)vbo_data, count * 3 * sizeof(vertex));
+
+	// Bind the shader program
+	shaderProgramUse(&program);
+
+	GPU_SetTexEnv(0,
+				  GPU_TEVSOURCES(GPU_PRIMARY_COLOR, GPU_PRIMARY_COLOR, GPU_PRIMARY_COLOR), // RGB channels
+				  GPU_TEVSOURCES(GPU_PRIMARY_COLOR, GPU_PRIMARY_COLOR, GPU_PRIMARY_COLOR), // Alpha
+				  GPU_TEVOPERANDS(0, 0, 0), // RGB
+				  GPU_TEVOPERANDS(0, 0, 0), // Alpha
+				  GPU_REPLACE, GPU_REPLACE, // RGB, Alpha
+				  0xFFFFFFFF);
+
+	// The alpha channel holds data, store the colors as they are
+	GPU_SetAlphaBlending(GPU_BLEND_ADD, GPU_BLEND_ADD, GPU_ONE, GPU_ZERO, GPU_ONE, GPU_ZERO);
+
+	// Configure the "attribute buffers" (that is, the vertex input buffers)
+	GPU_SetAttributeBuffers(
+			1, // Number of inputs per vertex
+			(u32*)osConvertVirtToPhys((u32)vbo_data), // Location of the VBO
+			GPU_ATTRIBFMT(0, 3, GPU_FLOAT), // Format of the inputs
+			0xFFE, // Unused attribute mask, in our case bit 0 is cleared since it is used
+			0x0, // Attribute permutations (here it is the identity)
+			1, // Number of buffers
+			(u32[]) { 0x0 }, // Buffer offsets (placeholders)
+			(u64[]) { 0x0 }, // Attribute permutations for each buffer (identity again)
+			(u8[])  { 1 }); // Number of attributes for each buffer
+
+	// Projection, then the constants of the generated shader
+	matrix_4x4 projection;
+	m4x4_ortho_tilt(&projection, 0.0, 400.0, 0.0, 240.0, 0.0, 1.0);
+	GPU_SetFloatUniformMatrix(GPU_VERTEX_SHADER, 0, &projection);
+
+	vector_4f constants[4 + 2 * NUM_STEPS] = {
+		{ .x = 0.0f, .y = 1.0f, .z = 0.5f, .w = 9223372036854775808.0f },
+		{ .x = 1.0f / 4611686018427387904.0f, .y = 65536.0f, .z = 63.0f, .w = 0.25f },
+		{ .x = 1.0f / 256.0f, .y = -256.0f, .z = 1.0f / 255.0f, .w = 8.0f },
+		{ .x = 2.0f, .y = 4.0f, .z = -8.0f, .w = 0.0f },
+	};
+	for (u32 i = 0; i < NUM_STEPS; i++) {
+		float k = (float)steps[i], scale = (float)(1ull << steps[i]);
+		// Down: |r| >= 2^k is divided by 2^k. Up: |r| < 2^(1-k) is multiplied by 2^k.
+		constants[4 + i] = (vector_4f){ .x = scale, .y = 1.0f / scale, .z = k, .w = 0.0f };
+		constants[4 + NUM_STEPS + i] = (vector_4f){ .x = 2.0f / scale, .y = scale, .z = -k, .w = 0.0f };
+	}
+	GPU_SetFloatUniform(GPU_VERTEX_SHADER, 4, (u32*)constants, 4 + 2 * NUM_STEPS);
+
+	// Draw the VBO
+	GPU_DrawArray(GPU_TRIANGLES, DUMP_PER_FRAME * 3);
+}
+
+static void sceneExit(void)
+{
+	// Free the VBO
+	linearFree(vbo_data);
+
+	// Free the shader program
+	shaderProgramFree(&program);
+}
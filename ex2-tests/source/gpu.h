@@ -11,11 +11,47 @@
 void gpuInit(void);
 void gpuExit(void);
 
+// Restricts clears and rendering to the w x h pixels at (x, y), in the coordinates of gpuReadPixel.
+// Clears cover the 8x8 tiles holding the region. Without depth, the depth buffer is neither cleared nor used.
+void gpuSetRegion(u32 x, u32 y, u32 w, u32 h, bool depth);
+
 void gpuClearBuffers(u32 clearColor);
 
 void gpuFrameBegin(void);
 void gpuFrameEnd(void);
 
+// Runs the frame's commands and waits for the GPU like gpuFrameEnd, without the transfer to the screen
+void gpuFrameFinish(void);
+
+// Read the color buffer directly, (x, y) is the pixel the display transfer copies to
+// framebuffer[y*240 + x] and pixels are returned as 0xAARRGGBB. Call after gpuFrameFinish or gpuFrameEnd.
+u32 gpuReadPixel(u32 x, u32 y);
+void gpuReadPixels(u32 x, u32 y, u32 w, u32 h, u32* out);
+
+// Phases timed when the suite is built with make PROFILE=1, gpuProfileReport() prints their distribution
+typedef enum {
+	GPU_PHASE_CLEAR,       // gpuClearBuffers
+	GPU_PHASE_FRAME_BEGIN, // gpuFrameBegin
+	GPU_PHASE_RENDER,      // the suite's sceneRender
+	GPU_PHASE_FLUSH,       // finalizing and submitting the command list
+	GPU_PHASE_P3D_WAIT,    // waiting for the GPU to render
+	GPU_PHASE_TRANSFER,    // starting the display transfer
+	GPU_PHASE_PPF_WAIT,    // waiting for the display transfer
+	GPU_PHASE_VERIFY,      // the suite's Verify
+	GPU_PHASE_COUNT,
+} gpuPhase;
+
+#ifdef PROFILE
+#define GPU_PROFILE_START(start) u64 start = svcGetSystemTick()
+#define GPU_PROFILE_STOP(phase, start) gpuProfileAdd((phase), svcGetSystemTick() - (start))
+void gpuProfileAdd(gpuPhase phase, u64 ticks);
+void gpuProfileReport(void);
+#else
+#define GPU_PROFILE_START(start)
+#define GPU_PROFILE_STOP(phase, start)
+#define gpuProfileReport()
+#endif
+
 // Configures the specified fixed-function fragment shading substage to be a no-operation
 void GPU_SetDummyTexEnv(int id);
 
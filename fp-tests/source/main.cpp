@@ -6,24 +6,23 @@ extern "C" {
 #include "gpu.h"
 #include "vshader_shbin.h"
 }
+#include "test.h"
+#include "batch.h"
 
 // Testing shader floating-point behavior
 //
-// Each test draws a full-screen quad, the color of which is determined by the
-// vertex shader. The single shader contains several tests, selected by setting
-// the `src1_uniform.x` uniform to specific values. For each test, the shader
+// Each test draws a single-pixel triangle, the color of which is determined by
+// the vertex shader. The single shader contains several tests, selected by the
+// test number batch.h passes as the x of vertex attribute v1, so that one draw
+// renders every test. For each test, the shader
 // executes an instruction and then classifies the output to determine if it's
 // NaN, +inf, -inf or a regular number. Based on this classification, the
-// output color of the quad is set differently. It is then read by the test
+// output color of the triangle is set differently. It is then read by the test
 // driver to compare against the expected result. This is used to check several
 // attributes of the floating-point engine in the PICA200.
 //
 // See the shader file (vshader.pica) for specific details on each test.
 
-// shader uniform src1_uniform
-static vector_4f src1_uniform;
-static int uLoc_src1_uniform;
-
 struct vec3 {
 	float x, y, z;
 };
@@ -98,7 +97,6 @@ static size_t tests_count = (sizeof(tests)/sizeof(tests[0]));
 static void sceneInit();
 static void sceneRender();
 static void sceneExit();
-static void Verify(vec3 expected);
 
 #define CLEAR_COLOR 0x0
 
@@ -108,9 +106,24 @@ int main() {
 	gpuInit();
 	consoleInit(GFX_BOTTOM, NULL);
 
+	// Set every test up, then render and verify them all in one frame
+	using namespace Tests;
+
+	for (size_t i = 0; i < tests_count; i++)
+	{
+		testBegin(tests[i].description);
+		float src1[] = { (float)tests[i].id, 0.0f, 0.0f, 0.0f };
+		float src2[] = { 0.0f, 0.0f, 0.0f, 0.0f };
+		float expected[] = { tests[i].result.x, tests[i].result.y, tests[i].result.z };
+		batchAdd(src1, src2, expected);
+	}
+
 	// Initialize the scene
 	sceneInit();
+	gpuSetRegion(0, 0, BATCH_WIDTH, batchRows(), false); // Tests only write the pixels batchVerify reads
+	gpuClearBuffers(CLEAR_COLOR);
 
+#ifndef HEADLESS
 	printf("Press A to begin.\n");
 	while(true) {
 		gspWaitForVBlank();
@@ -118,36 +131,37 @@ int main() {
 		if (hidKeysDown() & KEY_A)
 			break;
 	}
+#endif
 
-	// Run one test per frame
-	using namespace Tests;
-
-	for (size_t i = 0; i < tests_count; i++)
-	{
-		gpuClearBuffers(CLEAR_COLOR);
-
-		printf("Test %d: %s\n", tests[i].id, tests[i].description);
-		src1_uniform.x = (float)tests[i].id;
+	gpuFrameBegin();
+	GPU_PROFILE_START(renderStart);
+	sceneRender();
+	GPU_PROFILE_STOP(GPU_PHASE_RENDER, renderStart);
+	gpuFrameFinish();
 
-		gpuFrameBegin();
-		sceneRender();
-		gpuFrameEnd();
+	GPU_PROFILE_START(verifyStart);
+	batchVerify();
+	GPU_PROFILE_STOP(GPU_PHASE_VERIFY, verifyStart);
 
-		Verify(tests[i].result);
-
-		//Wait for the screen to be updated
-		gfxSwapBuffersGpu();
-		gspWaitForVBlank();
-	}
+#ifndef HEADLESS
+	//Wait for the screen to be updated
+	gfxSwapBuffersGpu();
+	gspWaitForVBlank();
+#endif
 
 	// End of tests
-	printf("Tests ends. Press start to exit.\n");
+	testSummary((int)tests_count);
+	testLogFlush("fp");
+	gpuProfileReport();
+#ifndef HEADLESS
+	printf("Press start to exit.\n");
 	while(true) {
 		gspWaitForVBlank();
 		hidScanInput();
 		if (hidKeysDown() & KEY_START)
 			break;
 	}
+#endif
 
 	// Deinitialize the scene
 	sceneExit();
@@ -158,50 +172,10 @@ int main() {
 	return 0;
 }
 
-static void Verify(vec3 expected_result) {
-	u8* framebuffer = gfxGetFramebuffer(GFX_TOP, GFX_LEFT, NULL, NULL);
-	GSPGPU_InvalidateDataCache(NULL, framebuffer, 3);
-
-	u8 final_result[3];
-	memcpy(final_result, framebuffer, 3);
-
-	u8 expected[3] = {
-		(u8)(expected_result.z * 255.0f),
-		(u8)(expected_result.y * 255.0f),
-		(u8)(expected_result.x * 255.0f),
-	};
-
-	if (expected[0] != final_result[0] || expected[1] != final_result[1] || expected[2] != final_result[2]) {
-		printf("Failure: final=(%02X %02X %02X)\n"
-		       "      expected=(%02X %02X %02X)\n",
-			   (unsigned)final_result[2], (unsigned)final_result[1], (unsigned)final_result[0],
-			   (unsigned)expected[2],     (unsigned)expected[1],     (unsigned)expected[0]);
-		while(true) {
-			gspWaitForVBlank();
-			hidScanInput();
-			if (hidKeysDown() & KEY_A)
-				break;
-		}
-	}
-}
-
-typedef struct { float x, y, z; } vertex;
-
-static vertex vertex_list[] =
-{
-		{ -1.0f, -1.0f, -0.5f },
-		{  1.0f, -1.0f, -0.5f },
-		{ -1.0f,  1.0f, -0.5f },
-		{  1.0f,  1.0f, -0.5f },
-
-};
-
-static int vertex_list_count = sizeof(vertex_list)/sizeof(vertex_list[0]);
-
 static DVLB_s* vshader_dvlb;
 static shaderProgram_s program;
-
-static void* vbo_data;
+static int uLoc_projection;
+static matrix_4x4 projection;
 
 static void sceneInit()
 {
@@ -211,13 +185,13 @@ static void sceneInit()
 	shaderProgramSetVsh(&program, &vshader_dvlb->DVLE[0]);
 
 	// Get the location of the projection matrix uniform
-	uLoc_src1_uniform = shaderInstanceGetUniformLocation(program.vertexShader, "src1_uniform");
+	uLoc_projection = shaderInstanceGetUniformLocation(program.vertexShader, "projection");
 
-	// Create the VBO (vertex buffer object)
-	vbo_data = linearAlloc(sizeof(vertex_list));
-	memcpy(vbo_data, vertex_list, sizeof(vertex_list));
+	// Compute the projection matrix
+	m4x4_ortho_tilt(&projection, 0.0, 400.0, 0.0, 240.0, 0.0, 1.0);
 
-	GSPGPU_FlushDataCache(nullptr, (u8*)vbo_data, sizeof(vertex_list));
+	// Create the VBO (vertex buffer object) holding every test
+	batchUpload();
 }
 
 static void sceneRender()
@@ -235,32 +209,17 @@ static void sceneRender()
 				  GPU_REPLACE, GPU_REPLACE, // RGB, Alpha
 				  0xFFFFFFFF);
 
-	// Configure the "attribute buffers" (that is, the vertex input buffers)
-	u32 buffer_offsets[1] = { 0x0 };
-	u64 attribute_map[1] = { 0x0 };
-	u8 num_attributes[1] = { 1 };
-	GPU_SetAttributeBuffers(
-			1, // Number of inputs per vertex
-			(u32*)osConvertVirtToPhys((u32)vbo_data), // Location of the VBO
-			GPU_ATTRIBFMT(0, 3, GPU_FLOAT), // Format of the inputs (in this case the only input is a 3-element float vector)
-			0xFFE, // Unused attribute mask, in our case bit 0 is cleared since it is used
-			0x0, // Attribute permutations (here it is the identity)
-			1, // Number of buffers
-			buffer_offsets, // Buffer offsets (placeholders)
-			attribute_map, // Attribute permutations for each buffer (identity again)
-			num_attributes); // Number of attributes for each buffer
-
-	// Upload the test vector uniform
-	GPU_SetFloatUniform(GPU_VERTEX_SHADER, (u32) uLoc_src1_uniform, (u32*)&src1_uniform, 1);
+	// Upload the projection matrix
+	GPU_SetFloatUniformMatrix(GPU_VERTEX_SHADER, uLoc_projection, &projection);
 
 	// Draw the VBO
-	GPU_DrawArray(GPU_TRIANGLE_STRIP, vertex_list_count);
+	batchDraw();
 }
 
 static void sceneExit()
 {
 	// Free the VBO
-	linearFree(vbo_data);
+	batchFree();
 
 	// Free the shader program
 	shaderProgramFree(&program);
@@ -0,0 +1,8 @@
+# Turns a binary file into the C array and header bin2s and the device Makefile produce:
+# cmake -DIN=x.shbin -DOUT=x -DNAME=x_shbin -P bin2c.cmake writes x.c and x.h
+file(READ ${IN} data HEX)
+string(LENGTH "${data}" length)
+math(EXPR size "${length} / 2")
+string(REGEX REPLACE "([0-9a-f][0-9a-f])" "0x\\1," bytes "${data}")
+file(WRITE ${OUT}.c "#include <3ds/types.h>\nconst u8 ${NAME}[] __attribute__((aligned(4))) = { ${bytes} };\nconst u32 ${NAME}_size = ${size};\n")
+file(WRITE ${OUT}.h "#pragma once\n#include <3ds/types.h>\nextern const u8 ${NAME}[];\nextern const u32 ${NAME}_size;\n")
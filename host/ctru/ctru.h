@@ -0,0 +1,48 @@
+/*
+ * Internals shared by the files of the libctru stand-in
+ */
+
+#pragma once
+#include <3ds/types.h>
+#include <snapshot.h>
+
+// The regions live at the virtual addresses they have on the 3DS, so the suites' (u32) pointer casts work
+#define LINEAR_VADDR 0x14000000
+#define LINEAR_PADDR 0x20000000
+#define LINEAR_SIZE  0x02000000
+#define VRAM_VADDR   0x1F000000
+#define VRAM_PADDR   0x18000000
+#define VRAM_SIZE    0x00600000
+
+// Maps the linear heap and VRAM, called by the first allocation
+void ctru_memory_init(void);
+
+// Saves the allocations of the linear heap and VRAM. Rewinding returns to them at once, releasing everything
+// allocated since, and returns how many of those allocations were still live: the leaks of a test.
+void ctru_memory_checkpoint(void);
+u32 ctru_memory_rewind(void);
+
+// Write protects the linear heap and VRAM and saves each page the first time it is written. Restoring copies
+// the pages written since back and write protects them again, returning how many there were. Writes by the
+// kernel, such as fread into a protected buffer, fail with EFAULT instead of being tracked.
+void ctru_memory_track_writes(void);
+u32 ctru_memory_restore_writes(void);
+
+// Prints the allocations never freed and the frees of unknown pointers, called by ctru_report
+void ctru_memory_report(void);
+
+// Live allocations and frees of unknown pointers, of the linear heap and VRAM together
+typedef struct {
+	u32 live;
+	u32 bad_frees;
+} ctru_memory_stats;
+
+void ctru_memory_get_stats(ctru_memory_stats* stats);
+
+// Prints the number of frames, of VBlank waits, the vertex cache hits, the heap leaks and the snapshot restores
+// to stderr, registered with atexit by gfxInitDefault
+void ctru_report(void);
+
+// Buffer gfxGetFramebuffer returns for the top screen, for snapshots
+int ctru_gfx_get_buffer(void);
+void ctru_gfx_set_buffer(int buffer);
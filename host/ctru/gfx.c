@@ -0,0 +1,57 @@
+#include <stdlib.h>
+#include <3ds.h>
+#include "ctru.h"
+
+// Double buffered like on the device: the suites render to the back buffer and swap after each frame
+static u8* top[2];
+static u8* bottom;
+static int current;
+
+void gfxInitDefault(void)
+{
+	top[0] = linearAlloc(240 * 400 * 3);
+	top[1] = linearAlloc(240 * 400 * 3);
+	bottom = linearAlloc(240 * 320 * 3);
+	current = 0;
+	atexit(ctru_report);
+}
+
+void gfxExit(void)
+{
+	linearFree(bottom);
+	linearFree(top[1]);
+	linearFree(top[0]);
+}
+
+u8* gfxGetFramebuffer(gfxScreen_t screen, gfx3dSide_t side, u16* width, u16* height)
+{
+	if (width)
+		*width = 240;
+	if (screen == GFX_BOTTOM) {
+		if (height)
+			*height = 320;
+		return bottom;
+	}
+	if (height)
+		*height = 400;
+	return top[current];
+}
+
+void gfxFlushBuffers(void)
+{
+}
+
+void gfxSwapBuffersGpu(void)
+{
+	current ^= 1;
+}
+
+int ctru_gfx_get_buffer(void)
+{
+	return current;
+}
+
+void ctru_gfx_set_buffer(int buffer)
+{
+	current = buffer;
+}
@@ -0,0 +1,342 @@
+#include <string.h>
+#include <3ds.h>
+#include "pica.h"
+#include "float24.h"
+
+u32* gpuCmdBuf;
+u32 gpuCmdBufSize;
+u32 gpuCmdBufOffset;
+
+void GPU_Init(Handle* gsphandle)
+{
+	gpuCmdBuf = NULL;
+	gpuCmdBufSize = 0;
+	gpuCmdBufOffset = 0;
+}
+
+void GPU_Reset(u32* gxbuf, u32* gpuBuf, u32 gpuBufSize)
+{
+	pica_reset();
+	GPUCMD_SetBuffer(gpuBuf, gpuBufSize, 0);
+}
+
+void GPUCMD_SetBuffer(u32* adr, u32 size, u32 offset)
+{
+	gpuCmdBuf = adr;
+	gpuCmdBufSize = size;
+	gpuCmdBufOffset = offset;
+}
+
+void GPUCMD_SetBufferOffset(u32 offset)
+{
+	gpuCmdBufOffset = offset;
+}
+
+void GPUCMD_GetBuffer(u32** adr, u32* size, u32* offset)
+{
+	if (adr) *adr = gpuCmdBuf;
+	if (size) *size = gpuCmdBufSize;
+	if (offset) *offset = gpuCmdBufOffset;
+}
+
+void GPUCMD_AddRawCommands(u32* cmd, u32 size)
+{
+	if (!cmd || !size || gpuCmdBufOffset + size > gpuCmdBufSize)
+		return;
+	memcpy(&gpuCmdBuf[gpuCmdBufOffset], cmd, size * 4);
+	gpuCmdBufOffset += size;
+}
+
+// The host model executes the command list right away, there is no P3D interrupt to wait for
+void GPUCMD_Run(u32* gxbuf)
+{
+	pica_process_cmdlist(gpuCmdBuf, gpuCmdBufOffset);
+}
+
+void GPUCMD_FlushAndRun(u32* gxbuf)
+{
+	GPUCMD_Run(gxbuf);
+}
+
+void GPUCMD_Add(u32 header, u32* param, u32 paramlength)
+{
+	u32 zero = 0;
+	if (!param || !paramlength) {
+		paramlength = 1;
+		param = &zero;
+	}
+	if (!gpuCmdBuf || gpuCmdBufOffset + paramlength + 1 > gpuCmdBufSize)
+		return;
+
+	paramlength--;
+	header |= (paramlength & 0x7FF) << 20;
+	gpuCmdBuf[gpuCmdBufOffset] = param[0];
+	gpuCmdBuf[gpuCmdBufOffset + 1] = header;
+	if (paramlength)
+		memcpy(&gpuCmdBuf[gpuCmdBufOffset + 2], &param[1], paramlength * 4);
+	gpuCmdBufOffset += paramlength + 2;
+	if (paramlength & 1)
+		gpuCmdBuf[gpuCmdBufOffset++] = 0; // alignment
+}
+
+void GPUCMD_Finalize(void)
+{
+	GPUCMD_AddMaskedWrite(GPUREG_PRIMITIVE_CONFIG, 0x8, 0x00000000);
+	GPUCMD_AddWrite(GPUREG_0111, 0x00000001);
+	GPUCMD_AddWrite(GPUREG_0110, 0x00000001);
+	GPUCMD_AddWrite(GPUREG_FINALIZE, 0x12345678);
+	GPUCMD_AddWrite(GPUREG_FINALIZE, 0x12345678); // not the first time libctru does this
+}
+
+void GPU_SetFloatUniform(GPU_SHADER_TYPE type, u32 startreg, u32* data, u32 numreg)
+{
+	if (!data)
+		return;
+
+	int regOffset = (type == GPU_GEOMETRY_SHADER) ? -0x30 : 0x0;
+	GPUCMD_AddWrite(GPUREG_VSH_FLOATUNIFORM_CONFIG + regOffset, 0x80000000 | startreg);
+	GPUCMD_AddWrites(GPUREG_VSH_FLOATUNIFORM_DATA + regOffset, data, numreg * 4);
+}
+
+// 2/val as the 1.7.23 float the viewport registers expect
+static u32 computeInvValue(u32 val)
+{
+	u32 bits = f32_to_bits(2.0f / val);
+	u32 mantissa = bits & 0x7FFFFF;
+	s32 exponent = ((bits >> 23) & 0xFF) - 0x40;
+
+	if (exponent < 0)
+		return (bits >> 31) << 31;
+	return (mantissa | ((u32)exponent << 23) | ((bits >> 31) << 30)) << 1;
+}
+
+void GPU_SetViewport(u32* depthBuffer, u32* colorBuffer, u32 x, u32 y, u32 w, u32 h)
+{
+	u32 param[0x4];
+	float fw = (float)w;
+	float fh = (float)h;
+
+	GPUCMD_AddWrite(GPUREG_0111, 0x00000001);
+	GPUCMD_AddWrite(GPUREG_0110, 0x00000001);
+
+	u32 f116e = 0x01000000 | (((h - 1) & 0xFFF) << 12) | (w & 0xFFF);
+
+	param[0x0] = ((u32)(uintptr_t)depthBuffer) >> 3;
+	param[0x1] = ((u32)(uintptr_t)colorBuffer) >> 3;
+	param[0x2] = f116e;
+	GPUCMD_AddIncrementalWrites(GPUREG_DEPTHBUFFER_LOC, param, 0x00000003);
+
+	GPUCMD_AddWrite(GPUREG_006E, f116e);
+	GPUCMD_AddWrite(GPUREG_DEPTHBUFFER_FORMAT, 0x00000003); // depth buffer format
+	GPUCMD_AddWrite(GPUREG_COLORBUFFER_FORMAT, 0x00000002); // color buffer format
+	GPUCMD_AddWrite(GPUREG_011B, 0x00000000); // ?
+
+	param[0x0] = f32_to_f24(fw / 2);
+	param[0x1] = computeInvValue(fw);
+	param[0x2] = f32_to_f24(fh / 2);
+	param[0x3] = computeInvValue(fh);
+	GPUCMD_AddIncrementalWrites(GPUREG_0041, param, 0x00000004);
+
+	GPUCMD_AddWrite(GPUREG_0068, (y << 16) | (x & 0xFFFF));
+
+	param[0x0] = 0x00000000;
+	param[0x1] = 0x00000000;
+	param[0x2] = ((h - 1) << 16) | ((w - 1) & 0xFFFF);
+	GPUCMD_AddIncrementalWrites(GPUREG_SCISSORTEST_MODE, param, 0x00000003);
+
+	// enable depth buffer
+	param[0x0] = 0x0000000F;
+	param[0x1] = 0x0000000F;
+	param[0x2] = 0x00000002;
+	param[0x3] = 0x00000002;
+	GPUCMD_AddIncrementalWrites(GPUREG_COLORBUFFER_READ, param, 0x00000004);
+}
+
+// w and h are the right and top edges of the rectangle, exclusive
+void GPU_SetScissorTest(GPU_SCISSORMODE mode, u32 x, u32 y, u32 w, u32 h)
+{
+	u32 param[3];
+
+	param[0x0] = mode;
+	param[0x1] = (y << 16) | (x & 0xFFFF);
+	param[0x2] = ((h - 1) << 16) | ((w - 1) & 0xFFFF);
+	GPUCMD_AddIncrementalWrites(GPUREG_SCISSORTEST_MODE, param, 0x00000003);
+}
+
+void GPU_DepthMap(float zScale, float zOffset)
+{
+	GPUCMD_AddWrite(GPUREG_006D, 0x00000001); // ?
+	GPUCMD_AddWrite(GPUREG_DEPTHMAP_SCALE, f32_to_f24(zScale));
+	GPUCMD_AddWrite(GPUREG_DEPTHMAP_OFFSET, f32_to_f24(zOffset));
+}
+
+void GPU_SetAlphaTest(bool enable, GPU_TESTFUNC function, u8 ref)
+{
+	GPUCMD_AddWrite(GPUREG_ALPHATEST_CONFIG, (enable & 1) | ((function & 7) << 4) | (ref << 8));
+}
+
+void GPU_SetStencilTest(bool enable, GPU_TESTFUNC function, u8 ref, u8 mask, u8 replace)
+{
+	GPUCMD_AddWrite(GPUREG_STENCILTEST_CONFIG, (enable & 1) | ((function & 7) << 4) | (replace << 8) | (ref << 16) | (mask << 24));
+}
+
+void GPU_SetStencilOp(GPU_STENCILOP sfail, GPU_STENCILOP dfail, GPU_STENCILOP pass)
+{
+	GPUCMD_AddWrite(GPUREG_STENCILOP_CONFIG, sfail | (dfail << 4) | (pass << 8));
+}
+
+void GPU_SetDepthTestAndWriteMask(bool enable, GPU_TESTFUNC function, GPU_WRITEMASK writemask)
+{
+	GPUCMD_AddWrite(GPUREG_DEPTHTEST_CONFIG, (enable & 1) | ((function & 7) << 4) | (writemask << 8));
+}
+
+void GPU_SetFaceCulling(GPU_CULLMODE mode)
+{
+	GPUCMD_AddWrite(GPUREG_FACECULLING_CONFIG, mode & 0x3);
+}
+
+void GPU_SetAlphaBlending(GPU_BLENDEQUATION colorEquation, GPU_BLENDEQUATION alphaEquation,
+	GPU_BLENDFACTOR colorSrc, GPU_BLENDFACTOR colorDst,
+	GPU_BLENDFACTOR alphaSrc, GPU_BLENDFACTOR alphaDst)
+{
+	GPUCMD_AddWrite(GPUREG_BLEND_CONFIG, colorEquation | (alphaEquation << 8) | (colorSrc << 16) | (colorDst << 20) | (alphaSrc << 24) | (alphaDst << 28));
+	GPUCMD_AddMaskedWrite(GPUREG_COLOROUTPUT_CONFIG, 0x2, 0x00000100);
+}
+
+void GPU_SetBlendingColor(u8 r, u8 g, u8 b, u8 a)
+{
+	GPUCMD_AddWrite(GPUREG_BLEND_COLOR, r | (g << 8) | (b << 16) | (a << 24));
+}
+
+void GPU_SetAttributeBuffers(u8 totalAttributes, u32* baseAddress, u64 attributeFormats, u16 attributeMask,
+	u64 attributePermutation, u8 numBuffers, u32 bufferOffsets[], u64 bufferPermutations[], u8 bufferNumAttributes[])
+{
+	static const u8 sizeTable[] = { 1, 1, 2, 4 };
+	u32 param[0x28];
+	int i, j;
+
+	memset(param, 0x00, 0x28 * 4);
+
+	param[0x0] = ((u32)(uintptr_t)baseAddress) >> 3;
+	param[0x1] = attributeFormats & 0xFFFFFFFF;
+	param[0x2] = ((totalAttributes - 1) << 28) | ((attributeMask & 0xFFF) << 16) | ((attributeFormats >> 32) & 0xFFFF);
+
+	for (i = 0; i < numBuffers; i++) {
+		u16 stride = 0;
+		param[3 * (i + 1) + 0] = bufferOffsets[i];
+		param[3 * (i + 1) + 1] = bufferPermutations[i] & 0xFFFFFFFF;
+		for (j = 0; j < bufferNumAttributes[i]; j++) {
+			u32 attr = (bufferPermutations[i] >> (j * 4)) & 0xF;
+			u32 fmt = (attributeFormats >> (attr * 4)) & 0xF;
+			stride += (((fmt >> 2) & 3) + 1) * sizeTable[fmt & 3];
+		}
+		param[3 * (i + 1) + 2] = (bufferNumAttributes[i] << 28) | ((stride & 0xFFF) << 16) | ((bufferPermutations[i] >> 32) & 0xFFFF);
+	}
+
+	GPUCMD_AddIncrementalWrites(GPUREG_ATTRIBBUFFERS_LOC, param, 0x00000027);
+
+	GPUCMD_AddMaskedWrite(GPUREG_VSH_INPUTBUFFER_CONFIG, 0xB, 0xA0000000 | (totalAttributes - 1));
+	GPUCMD_AddWrite(GPUREG_0242, (totalAttributes - 1));
+
+	param[0x0] = attributePermutation & 0xFFFFFFFF;
+	param[0x1] = (attributePermutation >> 32) & 0xFFFF;
+	GPUCMD_AddIncrementalWrites(GPUREG_VSH_ATTRIBUTES_PERMUTATION_LOW, param, 2);
+}
+
+static const u16 texEnvRegs[6] = {
+	GPUREG_TEXENV0_CONFIG, GPUREG_TEXENV1_CONFIG, GPUREG_TEXENV2_CONFIG,
+	GPUREG_TEXENV3_CONFIG, GPUREG_TEXENV4_CONFIG, GPUREG_TEXENV5_CONFIG,
+};
+
+void GPU_SetTexEnv(u8 id, u16 rgbSources, u16 alphaSources, u16 rgbOperands, u16 alphaOperands,
+	GPU_COMBINEFUNC rgbCombine, GPU_COMBINEFUNC alphaCombine, u32 constantColor)
+{
+	u32 param[0x5];
+	if (id > 6)
+		return;
+
+	param[0x0] = (alphaSources << 16) | rgbSources;
+	param[0x1] = (alphaOperands << 12) | rgbOperands;
+	param[0x2] = (alphaCombine << 16) | rgbCombine;
+	param[0x3] = constantColor;
+	param[0x4] = 0x00000000; // ?
+
+	GPUCMD_AddIncrementalWrites(texEnvRegs[id], param, 0x00000005);
+}
+
+void GPU_DrawArray(GPU_Primitive_t primitive, u32 n)
+{
+	// set primitive type
+	GPUCMD_AddMaskedWrite(GPUREG_PRIMITIVE_CONFIG, 0x2, primitive);
+	GPUCMD_AddMaskedWrite(GPUREG_RESTART_PRIMITIVE, 0x2, 0x00000001);
+	// index buffer address register should be cleared (except bit 31) before drawing
+	GPUCMD_AddWrite(GPUREG_INDEXBUFFER_CONFIG, 0x80000000);
+	// pass number of vertices
+	GPUCMD_AddWrite(GPUREG_NUMVERTICES, n);
+
+	GPUCMD_AddMaskedWrite(GPUREG_0253, 0x1, 0x00000000);
+	GPUCMD_AddMaskedWrite(GPUREG_0245, 0x1, 0x00000000);
+	GPUCMD_AddWrite(GPUREG_DRAWARRAYS, 0x00000001);
+	GPUCMD_AddMaskedWrite(GPUREG_0245, 0x1, 0x00000001);
+	GPUCMD_AddWrite(GPUREG_0231, 0x00000001);
+}
+
+// indexArray is an offset relative to the attribute buffers base address
+void GPU_DrawElements(GPU_Primitive_t primitive, u32* indexArray, u32 n)
+{
+	// set primitive type
+	GPUCMD_AddMaskedWrite(GPUREG_PRIMITIVE_CONFIG, 0x2, primitive);
+	GPUCMD_AddMaskedWrite(GPUREG_RESTART_PRIMITIVE, 0x2, 0x00000001);
+	// index buffer (TODO : support multiple types)
+	GPUCMD_AddWrite(GPUREG_INDEXBUFFER_CONFIG, 0x80000000 | ((u32)(uintptr_t)indexArray));
+	// pass number of vertices
+	GPUCMD_AddWrite(GPUREG_NUMVERTICES, n);
+
+	GPUCMD_AddWrite(GPUREG_VERTEX_OFFSET, 0x00000000);
+
+	GPUCMD_AddMaskedWrite(GPUREG_GEOSTAGE_CONFIG, 0x2, 0x00000100);
+	GPUCMD_AddMaskedWrite(GPUREG_0253, 0x2, 0x00000100);
+
+	GPUCMD_AddMaskedWrite(GPUREG_0245, 0x1, 0x00000000);
+	GPUCMD_AddWrite(GPUREG_DRAWELEMENTS, 0x00000001);
+	GPUCMD_AddMaskedWrite(GPUREG_0245, 0x1, 0x00000001);
+	GPUCMD_AddWrite(GPUREG_0231, 0x00000001);
+}
+
+void GPU_FinishDrawing(void)
+{
+	GPUCMD_AddWrite(GPUREG_0111, 0x00000001);
+	GPUCMD_AddWrite(GPUREG_0110, 0x00000001);
+	GPUCMD_AddWrite(GPUREG_0063, 0x00000001);
+}
+
+void GPU_SetShaderOutmap(u32 outmapData[8])
+{
+	GPUCMD_AddMaskedWrite(GPUREG_PRIMITIVE_CONFIG, 0x1, outmapData[0] - 1);
+	GPUCMD_AddIncrementalWrites(GPUREG_SH_OUTMAP_TOTAL, outmapData, 8);
+}
+
+void GPU_SendShaderCode(GPU_SHADER_TYPE type, u32* data, u16 offset, u16 length)
+{
+	if (!data)
+		return;
+
+	int regOffset = (type == GPU_GEOMETRY_SHADER) ? -0x30 : 0x0;
+	int i;
+
+	GPUCMD_AddWrite(GPUREG_VSH_CODETRANSFER_CONFIG + regOffset, offset);
+	for (i = 0; i < length; i += 0x80)
+		GPUCMD_AddWrites(GPUREG_VSH_CODETRANSFER_DATA + regOffset, &data[i], ((length - i) < 0x80) ? (length - i) : 0x80);
+	GPUCMD_AddWrite(GPUREG_VSH_CODETRANSFER_END + regOffset, 0x00000001);
+}
+
+void GPU_SendOperandDescriptors(GPU_SHADER_TYPE type, u32* data, u16 offset, u16 length)
+{
+	if (!data)
+		return;
+
+	int regOffset = (type == GPU_GEOMETRY_SHADER) ? -0x30 : 0x0;
+
+	GPUCMD_AddWrite(GPUREG_VSH_OPDESCS_CONFIG + regOffset, offset);
+	GPUCMD_AddWrites(GPUREG_VSH_OPDESCS_DATA + regOffset, data, length);
+}
@@ -0,0 +1,27 @@
+#include <3ds.h>
+#include "pica.h"
+#include "gx.h"
+
+// The GX commands run to completion before returning, gxbuf is ignored
+
+Result GX_SetCommandList_Last(u32* gxbuf, u32* buf0a, u32 buf0s, u8 flags)
+{
+	pica_process_cmdlist(buf0a, buf0s / 4);
+	return 0;
+}
+
+Result GX_SetMemoryFill(u32* gxbuf, u32* buf0a, u32 buf0v, u32* buf0e, u16 width0,
+	u32* buf1a, u32 buf1v, u32* buf1e, u16 width1)
+{
+	if (buf0a && (width0 & GX_FILL_TRIGGER))
+		pica_memory_fill(buf0a, buf0e, buf0v, width0);
+	if (buf1a && (width1 & GX_FILL_TRIGGER))
+		pica_memory_fill(buf1a, buf1e, buf1v, width1);
+	return 0;
+}
+
+Result GX_SetDisplayTransfer(u32* gxbuf, u32* inadr, u32 indim, u32* outadr, u32 outdim, u32 flags)
+{
+	pica_display_transfer(inadr, indim, outadr, outdim, flags);
+	return 0;
+}
@@ -0,0 +1,372 @@
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <3ds.h>
+#include "pica.h"
+#include "ctru.h"
+
+#define ALLOC_ALIGN 0x80
+#define MAX_BLOCKS  512
+
+typedef struct {
+	u32 offset;
+	u32 size;
+} block;
+
+// Each region is an arena: allocations come from the free list first, then from the top. Both lists are
+// fixed arrays sorted by offset, free blocks are coalesced and the ones reaching the top give it back.
+typedef struct {
+	const char* name;
+	u8* base;
+	u32 size;
+	u32 top;
+	u32 peak;
+	block live[MAX_BLOCKS];
+	u32 num_live;
+	block free[MAX_BLOCKS];
+	u32 num_free;
+	u32 bad_frees;
+} region;
+
+static region linear_heap = { "linear heap" }, vram = { "VRAM" };
+
+// Copy-on-write tracking of a region: once tracking starts, the region is read-only and the first write to a page
+// saves it to the shadow copy and makes it writable again. Restoring copies the dirty pages back. The shadow of a
+// page stays valid across restores, only its first write ever copies it.
+enum { PAGE_CLEAN, PAGE_COPYING, PAGE_DIRTY };
+
+typedef struct {
+	u8* base;
+	u32 size;
+	u8* shadow;
+	u8* state;     // PAGE_*
+	u8* shadowed;  // the shadow holds the page
+	u32* dirty;    // pages written since tracking started or the last restore
+	u32 num_dirty;
+} write_tracker;
+
+static write_tracker linear_tracker, vram_tracker;
+static long page_size;
+
+// State saved by ctru_memory_checkpoint
+static region linear_saved, vram_saved;
+static bool saved;
+
+static void map_region(region* r, u32 vaddr, u32 paddr, u32 size)
+{
+	void* p = mmap((void*)(uintptr_t)vaddr, size, PROT_READ | PROT_WRITE,
+		MAP_PRIVATE | MAP_ANONYMOUS | MAP_FIXED_NOREPLACE, -1, 0);
+	if (p != (void*)(uintptr_t)vaddr) {
+		fprintf(stderr, "cannot map 0x%08X bytes at 0x%08X\n", size, vaddr);
+		exit(1);
+	}
+	r->base = p;
+	r->size = size;
+	pica_map(paddr, p, size);
+}
+
+void ctru_memory_init(void)
+{
+	if (linear_heap.base)
+		return;
+	map_region(&linear_heap, LINEAR_VADDR, LINEAR_PADDR, LINEAR_SIZE);
+	map_region(&vram, VRAM_VADDR, VRAM_PADDR, VRAM_SIZE);
+}
+
+// First block of the list whose offset is not below offset
+static u32 lower_bound(const block* list, u32 count, u32 offset)
+{
+	u32 lo = 0, hi = count;
+	while (lo < hi) {
+		u32 mid = (lo + hi) / 2;
+		if (list[mid].offset < offset)
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+	return lo;
+}
+
+static void insert_block(block* list, u32* count, u32 at, u32 offset, u32 size)
+{
+	memmove(&list[at + 1], &list[at], (*count - at) * sizeof(block));
+	list[at].offset = offset;
+	list[at].size = size;
+	(*count)++;
+}
+
+static void remove_block(block* list, u32* count, u32 at)
+{
+	memmove(&list[at], &list[at + 1], (*count - at - 1) * sizeof(block));
+	(*count)--;
+}
+
+static void* region_alloc(region* r, size_t size)
+{
+	ctru_memory_init();
+
+	if (size == 0 || size > r->size || r->num_live == MAX_BLOCKS)
+		return NULL;
+	u32 length = (size + ALLOC_ALIGN - 1) & ~(ALLOC_ALIGN - 1);
+	u32 offset;
+
+	// First fit in the free list, then the top
+	u32 i;
+	for (i = 0; i < r->num_free && r->free[i].size < length; i++)
+		;
+	if (i < r->num_free) {
+		offset = r->free[i].offset;
+		r->free[i].offset += length;
+		r->free[i].size -= length;
+		if (!r->free[i].size)
+			remove_block(r->free, &r->num_free, i);
+	} else {
+		if (length > r->size - r->top)
+			return NULL;
+		offset = r->top;
+		r->top += length;
+		if (r->top > r->peak)
+			r->peak = r->top;
+	}
+
+	// The lists are sorted, a new block overlaps a live one only if one of its neighbours does
+	u32 at = lower_bound(r->live, r->num_live, offset);
+	if ((at < r->num_live && r->live[at].offset < offset + length) ||
+		(at > 0 && r->live[at - 1].offset + r->live[at - 1].size > offset)) {
+		fprintf(stderr, "%s: block at 0x%X overlaps a live allocation\n", r->name, offset);
+		abort();
+	}
+	insert_block(r->live, &r->num_live, at, offset, length);
+	return r->base + offset;
+}
+
+static void region_free(region* r, void* mem)
+{
+	if (!mem)
+		return;
+
+	u32 offset = (u8*)mem - r->base;
+	u32 at = lower_bound(r->live, r->num_live, offset);
+	if ((u8*)mem < r->base || offset >= r->size || at == r->num_live || r->live[at].offset != offset) {
+		fprintf(stderr, "%s: %p is not an allocation, freed twice or never allocated\n", r->name, mem);
+		r->bad_frees++;
+		return;
+	}
+	u32 size = r->live[at].size;
+	remove_block(r->live, &r->num_live, at);
+
+	// Coalesce with the free neighbours
+	at = lower_bound(r->free, r->num_free, offset);
+	if (at < r->num_free && r->free[at].offset == offset + size) {
+		size += r->free[at].size;
+		remove_block(r->free, &r->num_free, at);
+	}
+	if (at > 0 && r->free[at - 1].offset + r->free[at - 1].size == offset) {
+		offset = r->free[at - 1].offset;
+		size += r->free[at - 1].size;
+		remove_block(r->free, &r->num_free, --at);
+	}
+
+	if (offset + size == r->top)
+		r->top = offset;
+	else
+		insert_block(r->free, &r->num_free, at, offset, size);
+}
+
+void* linearAlloc(size_t size)
+{
+	return region_alloc(&linear_heap, size);
+}
+
+void linearFree(void* mem)
+{
+	region_free(&linear_heap, mem);
+}
+
+void* vramAlloc(size_t size)
+{
+	return region_alloc(&vram, size);
+}
+
+void vramFree(void* mem)
+{
+	region_free(&vram, mem);
+}
+
+u32 osConvertVirtToPhys(u32 vaddr)
+{
+	if (vaddr >= LINEAR_VADDR && vaddr < LINEAR_VADDR + LINEAR_SIZE)
+		return vaddr - LINEAR_VADDR + LINEAR_PADDR;
+	if (vaddr >= VRAM_VADDR && vaddr < VRAM_VADDR + VRAM_SIZE)
+		return vaddr - VRAM_VADDR + VRAM_PADDR;
+	return 0;
+}
+
+void ctru_memory_checkpoint(void)
+{
+	ctru_memory_init();
+	linear_saved = linear_heap;
+	vram_saved = vram;
+	saved = true;
+}
+
+// Allocations of now that the checkpoint did not have
+static u32 count_leaks(const region* now, const region* then)
+{
+	u32 leaks = 0;
+	for (u32 i = 0; i < now->num_live; i++) {
+		u32 at = lower_bound(then->live, then->num_live, now->live[i].offset);
+		if (at == then->num_live || then->live[at].offset != now->live[i].offset)
+			leaks++;
+	}
+	return leaks;
+}
+
+u32 ctru_memory_rewind(void)
+{
+	if (!saved)
+		return 0;
+
+	u32 leaks = count_leaks(&linear_heap, &linear_saved) + count_leaks(&vram, &vram_saved);
+
+	// The peaks and the bad frees describe the whole run, they survive the rewind
+	u32 linear_peak = linear_heap.peak, vram_peak = vram.peak;
+	u32 linear_bad_frees = linear_heap.bad_frees, vram_bad_frees = vram.bad_frees;
+	linear_heap = linear_saved;
+	vram = vram_saved;
+	linear_heap.peak = linear_peak;
+	vram.peak = vram_peak;
+	linear_heap.bad_frees = linear_bad_frees;
+	vram.bad_frees = vram_bad_frees;
+	return leaks;
+}
+
+static void report_region(const region* r)
+{
+	u32 bytes = 0;
+	for (u32 i = 0; i < r->num_live; i++)
+		bytes += r->live[i].size;
+
+	if (r->num_live || r->bad_frees)
+		fprintf(stderr, "%s: %u allocations (%u bytes) never freed, %u bad frees, peak %u KiB\n", r->name,
+			r->num_live, bytes, r->bad_frees, r->peak / 1024);
+}
+
+void ctru_memory_report(void)
+{
+	report_region(&linear_heap);
+	report_region(&vram);
+}
+
+void ctru_memory_get_stats(ctru_memory_stats* stats)
+{
+	stats->live = linear_heap.num_live + vram.num_live;
+	stats->bad_frees = linear_heap.bad_frees + vram.bad_frees;
+}
+
+//
+// Write tracking
+//
+
+static write_tracker* tracker_of(const u8* addr)
+{
+	if (linear_tracker.state && addr >= linear_tracker.base && addr < linear_tracker.base + linear_tracker.size)
+		return &linear_tracker;
+	if (vram_tracker.state && addr >= vram_tracker.base && addr < vram_tracker.base + vram_tracker.size)
+		return &vram_tracker;
+	return NULL;
+}
+
+// Runs on the thread that wrote, the shaders' workers included. Two threads writing to the same clean page race
+// for it, the loser waits until the winner has saved the page and unprotected it.
+static void on_write_fault(int sig, siginfo_t* info, void* context)
+{
+	write_tracker* t = tracker_of(info->si_addr);
+	if (!t) {
+		// Not ours, the faulting instruction runs again and crashes as it would have
+		signal(SIGSEGV, SIG_DFL);
+		return;
+	}
+
+	u32 page = ((u8*)info->si_addr - t->base) / page_size;
+	u8* p = t->base + page * page_size;
+	u8 expected = PAGE_CLEAN;
+
+	if (!__atomic_compare_exchange_n(&t->state[page], &expected, PAGE_COPYING, false, __ATOMIC_ACQUIRE, __ATOMIC_ACQUIRE)) {
+		while (__atomic_load_n(&t->state[page], __ATOMIC_ACQUIRE) != PAGE_DIRTY)
+			;
+		return;
+	}
+
+	if (!t->shadowed[page]) {
+		memcpy(t->shadow + page * page_size, p, page_size);
+		t->shadowed[page] = 1;
+	}
+	mprotect(p, page_size, PROT_READ | PROT_WRITE);
+	t->dirty[__atomic_fetch_add(&t->num_dirty, 1, __ATOMIC_RELAXED)] = page;
+	__atomic_store_n(&t->state[page], PAGE_DIRTY, __ATOMIC_RELEASE);
+}
+
+static void start_tracking(write_tracker* t, const region* r)
+{
+	u32 pages = r->size / page_size;
+
+	if (!t->state) {
+		t->base = r->base;
+		t->size = r->size;
+		t->shadow = mmap(NULL, r->size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+		t->state = calloc(pages, 1);
+		t->shadowed = calloc(pages, 1);
+		t->dirty = calloc(pages, sizeof(u32));
+		if (t->shadow == MAP_FAILED || !t->state || !t->shadowed || !t->dirty) {
+			fprintf(stderr, "%s: cannot allocate the write tracking\n", r->name);
+			exit(1);
+		}
+	}
+
+	// The contents of the region change from here, what the shadow holds is stale
+	memset(t->state, PAGE_CLEAN, pages);
+	memset(t->shadowed, 0, pages);
+	t->num_dirty = 0;
+	mprotect(t->base, t->size, PROT_READ);
+}
+
+static u32 restore_pages(write_tracker* t)
+{
+	u32 count = t->num_dirty;
+	for (u32 i = 0; i < count; i++) {
+		u32 page = t->dirty[i];
+		u8* p = t->base + page * page_size;
+		memcpy(p, t->shadow + page * page_size, page_size);
+		mprotect(p, page_size, PROT_READ);
+		t->state[page] = PAGE_CLEAN;
+	}
+	t->num_dirty = 0;
+	return count;
+}
+
+void ctru_memory_track_writes(void)
+{
+	ctru_memory_init();
+
+	if (!page_size) {
+		struct sigaction action;
+		page_size = sysconf(_SC_PAGESIZE);
+		memset(&action, 0, sizeof(action));
+		action.sa_sigaction = on_write_fault;
+		action.sa_flags = SA_SIGINFO;
+		sigemptyset(&action.sa_mask);
+		sigaction(SIGSEGV, &action, NULL);
+	}
+
+	start_tracking(&linear_tracker, &linear_heap);
+	start_tracking(&vram_tracker, &vram);
+}
+
+u32 ctru_memory_restore_writes(void)
+{
+	return restore_pages(&linear_tracker) + restore_pages(&vram_tracker);
+}
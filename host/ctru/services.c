@@ -0,0 +1,82 @@
+#include <stdio.h>
+#include <time.h>
+#include <3ds.h>
+#include "ctru.h"
+#include "pica.h"
+
+// Every frame waits for the GPU once, frames that were not followed by a VBlank wait saved one on the device
+static u32 frames, vblank_waits;
+
+#define SYSCLOCK_ARM11 268111856
+
+u64 svcGetSystemTick(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (u64)ts.tv_sec * SYSCLOCK_ARM11 + (u64)ts.tv_nsec * SYSCLOCK_ARM11 / 1000000000;
+}
+
+bool aptMainLoop(void)
+{
+	return true;
+}
+
+void gspWaitForEvent(GSP_Event id, bool nextEvent)
+{
+	if (id == GSPEVENT_P3D)
+		frames++;
+	else if (id == GSPEVENT_VBlank0 || id == GSPEVENT_VBlank1)
+		vblank_waits++;
+}
+
+void ctru_report(void)
+{
+	u32 saved = frames > vblank_waits ? frames - vblank_waits : 0;
+	fprintf(stderr, "%u frames, %u VBlank waits, %u saved (%.2f s at 60 Hz)\n",
+		frames, vblank_waits, saved, saved / 60.0);
+
+	pica_vertex_cache_stats cache;
+	pica_vertex_cache_get_stats(&cache);
+	if (cache.hits + cache.misses)
+		fprintf(stderr, "vertex cache: %llu hits, %llu misses\n",
+			(unsigned long long)cache.hits, (unsigned long long)cache.misses);
+
+	ctru_memory_report();
+
+	ctru_snapshot_stats snapshots;
+	ctru_snapshot_get_stats(&snapshots);
+	if (snapshots.restores)
+		fprintf(stderr, "snapshots: %llu restores, %.1f pages copied back per restore, %llu blocks leaked\n",
+			(unsigned long long)snapshots.restores, (double)snapshots.pages / snapshots.restores,
+			(unsigned long long)snapshots.leaks);
+}
+
+// The GPU and the CPU share the host's coherent caches
+Result GSPGPU_FlushDataCache(Handle* handle, u8* adr, u32 size)
+{
+	return 0;
+}
+
+Result GSPGPU_InvalidateDataCache(Handle* handle, u8* adr, u32 size)
+{
+	return 0;
+}
+
+void hidScanInput(void)
+{
+}
+
+u32 hidKeysDown(void)
+{
+	return KEY_A | KEY_B | KEY_SELECT | KEY_START;
+}
+
+u32 hidKeysHeld(void)
+{
+	return KEY_A | KEY_B | KEY_SELECT | KEY_START;
+}
+
+PrintConsole* consoleInit(gfxScreen_t screen, PrintConsole* console)
+{
+	return console;
+}
@@ -0,0 +1,169 @@
+#include <stdlib.h>
+#include <string.h>
+#include <3ds.h>
+
+Result shaderInstanceInit(shaderInstance_s* si, DVLE_s* dvle)
+{
+	if (!si || !dvle)
+		return -1;
+
+	si->dvle = dvle;
+
+	si->boolUniforms = 0x0000;
+	si->intUniforms[0] = 0x00000000;
+	si->intUniforms[1] = 0x00000000;
+	si->intUniforms[2] = 0x00000000;
+	si->intUniforms[3] = 0x00000000;
+	si->float24Uniforms = NULL;
+	si->numFloat24Uniforms = 0;
+
+	int i;
+	DVLE_constEntry_s* cnst = dvle->constTableData;
+	if (cnst) {
+		int float24cnt = 0;
+		for (i = 0; i < dvle->constTableSize; i++) {
+			switch (cnst[i].type) {
+			case DVLE_CONST_BOOL:
+				shaderInstanceSetBool(si, cnst[i].id, cnst[i].data[0] & 1);
+				break;
+			case DVLE_CONST_u8:
+				if (cnst[i].id < 4)
+					si->intUniforms[cnst[i].id] = cnst[i].data[0];
+				break;
+			case DVLE_CONST_FLOAT24:
+				float24cnt++;
+				break;
+			}
+		}
+
+		if (float24cnt) {
+			si->float24Uniforms = malloc(sizeof(float24Uniform_s) * float24cnt);
+			if (si->float24Uniforms) {
+				float24cnt = 0;
+				for (i = 0; i < dvle->constTableSize; i++) {
+					if (cnst[i].type == DVLE_CONST_FLOAT24) {
+						// pack the 4 float24 values of the entry (x, y, z, w) into three words
+						u32 x = cnst[i].data[0], y = cnst[i].data[1];
+						u32 z = cnst[i].data[2], w = cnst[i].data[3];
+						si->float24Uniforms[float24cnt].id = cnst[i].id & 0xFF;
+						si->float24Uniforms[float24cnt].data[0] = (w << 8) | (z >> 16);
+						si->float24Uniforms[float24cnt].data[1] = (z << 16) | (y >> 8);
+						si->float24Uniforms[float24cnt].data[2] = (y << 24) | x;
+						float24cnt++;
+					}
+				}
+			}
+			si->numFloat24Uniforms = float24cnt;
+		}
+	}
+
+	return 0;
+}
+
+Result shaderInstanceFree(shaderInstance_s* si)
+{
+	if (!si)
+		return -1;
+
+	free(si->float24Uniforms);
+	free(si);
+	return 0;
+}
+
+Result shaderInstanceSetBool(shaderInstance_s* si, int id, bool value)
+{
+	if (!si || id < 0 || id > 15)
+		return -1;
+
+	si->boolUniforms &= ~(1 << id);
+	si->boolUniforms |= (value) << id;
+	return 0;
+}
+
+Result shaderInstanceGetBool(shaderInstance_s* si, int id, bool* value)
+{
+	if (!si || id < 0 || id > 15 || !value)
+		return -1;
+
+	*value = ((si->boolUniforms >> id) & 1);
+	return 0;
+}
+
+s8 shaderInstanceGetUniformLocation(shaderInstance_s* si, const char* name)
+{
+	if (!si)
+		return -1;
+
+	return DVLE_GetUniformRegister(si->dvle, name);
+}
+
+Result shaderProgramInit(shaderProgram_s* sp)
+{
+	if (!sp)
+		return -1;
+
+	sp->vertexShader = NULL;
+	sp->geometryShader = NULL;
+	return 0;
+}
+
+Result shaderProgramFree(shaderProgram_s* sp)
+{
+	if (!sp)
+		return -1;
+
+	shaderInstanceFree(sp->vertexShader);
+	shaderInstanceFree(sp->geometryShader);
+	return 0;
+}
+
+Result shaderProgramSetVsh(shaderProgram_s* sp, DVLE_s* dvle)
+{
+	if (!sp || !dvle || dvle->type != VERTEX_SHDR)
+		return -1;
+
+	if (sp->vertexShader)
+		shaderInstanceFree(sp->vertexShader);
+
+	sp->vertexShader = malloc(sizeof(shaderInstance_s));
+	if (!sp->vertexShader)
+		return -2;
+
+	return shaderInstanceInit(sp->vertexShader, dvle);
+}
+
+// Geometry shaders are not modelled, only the vertex shader is bound
+Result shaderProgramUse(shaderProgram_s* sp)
+{
+	if (!sp || !sp->vertexShader)
+		return -1;
+
+	int i;
+	shaderInstance_s* vs = sp->vertexShader;
+	DVLE_s* dvle = vs->dvle;
+
+	// upload the shader code and the operand descriptors
+	GPU_SendShaderCode(dvle->type, dvle->dvlp->codeData, 0, dvle->dvlp->codeSize);
+	GPU_SendOperandDescriptors(dvle->type, dvle->dvlp->opcdescData, 0, dvle->dvlp->opdescSize);
+
+	// set up the uniforms
+	GPUCMD_AddWrite(GPUREG_VSH_BOOLUNIFORM, 0x7FFF0000 | vs->boolUniforms);
+	GPUCMD_AddIncrementalWrites(GPUREG_VSH_INTUNIFORM_I0, vs->intUniforms, 4);
+	for (i = 0; i < vs->numFloat24Uniforms; i++)
+		GPUCMD_AddIncrementalWrites(GPUREG_VSH_FLOATUNIFORM_CONFIG, (u32*)&vs->float24Uniforms[i], 4);
+	GPUCMD_AddWrite(GPUREG_VSH_ENTRYPOINT, 0x7FFF0000 | (dvle->mainOffset & 0xFFFF));
+	GPUCMD_AddWrite(GPUREG_VSH_OUTMAP_MASK, dvle->outmapMask);
+
+	GPUCMD_AddWrite(GPUREG_024A, dvle->outmapData[0] - 1); // ?
+	GPUCMD_AddWrite(GPUREG_0251, dvle->outmapData[0] - 1); // ?
+
+	GPUCMD_AddMaskedWrite(GPUREG_GEOSTAGE_CONFIG, 0x8, 0x00000000); // ?
+	GPUCMD_AddWrite(GPUREG_0252, 0x00000000); // ?
+
+	GPU_SetShaderOutmap(dvle->outmapData);
+
+	GPUCMD_AddWrite(GPUREG_0064, 0x00000001); // ?
+	GPUCMD_AddWrite(GPUREG_006F, 0x00000703); // ?
+
+	return 0;
+}
@@ -0,0 +1,127 @@
+#include <stdlib.h>
+#include <string.h>
+#include <3ds.h>
+
+static void DVLE_ParseFile(u32* data, DVLE_s* dvle, DVLP_s* dvlp)
+{
+	u8* base = (u8*)data;
+
+	dvle->dvlp = dvlp;
+	dvle->type = (data[1] >> 16) & 0xFF;
+	dvle->mainOffset = data[2];
+	dvle->endmainOffset = data[3];
+
+	dvle->constTableData = (DVLE_constEntry_s*)&base[data[6]];
+	dvle->constTableSize = data[7];
+
+	dvle->outTableData = (DVLE_outEntry_s*)&base[data[10]];
+	dvle->outTableSize = data[11];
+
+	dvle->uniformTableData = (DVLE_uniformEntry_s*)&base[data[12]];
+	dvle->uniformTableSize = data[13];
+
+	dvle->symbolTableData = (char*)&base[data[14]];
+
+	DVLE_GenerateOutmap(dvle);
+}
+
+DVLB_s* DVLB_ParseFile(u32* shbinData, u32 shbinSize)
+{
+	if (!shbinData)
+		return NULL;
+
+	DVLB_s* ret = malloc(sizeof(DVLB_s));
+	if (!ret)
+		return NULL;
+
+	// parse DVLB
+	ret->numDVLE = shbinData[1];
+	ret->DVLE = malloc(sizeof(DVLE_s) * ret->numDVLE);
+	if (!ret->DVLE) {
+		free(ret);
+		return NULL;
+	}
+
+	// parse DVLP
+	u32* dvlpData = &shbinData[2 + ret->numDVLE];
+	ret->DVLP.codeSize = dvlpData[3];
+	ret->DVLP.codeData = &dvlpData[dvlpData[2] / 4];
+	ret->DVLP.opdescSize = dvlpData[5];
+	ret->DVLP.opcdescData = malloc(sizeof(u32) * ret->DVLP.opdescSize);
+	if (!ret->DVLP.opcdescData) {
+		free(ret->DVLE);
+		free(ret);
+		return NULL;
+	}
+	// the operand descriptor table has 8 byte entries, only the first word is sent to the GPU
+	for (u32 i = 0; i < ret->DVLP.opdescSize; i++)
+		ret->DVLP.opcdescData[i] = dvlpData[dvlpData[4] / 4 + i * 2];
+
+	// parse DVLE
+	for (u32 i = 0; i < ret->numDVLE; i++)
+		DVLE_ParseFile(&shbinData[shbinData[2 + i] / 4], &ret->DVLE[i], &ret->DVLP);
+
+	return ret;
+}
+
+void DVLB_Free(DVLB_s* dvlb)
+{
+	if (!dvlb)
+		return;
+	free(dvlb->DVLP.opcdescData);
+	free(dvlb->DVLE);
+	free(dvlb);
+}
+
+s8 DVLE_GetUniformRegister(DVLE_s* dvle, const char* name)
+{
+	if (!dvle || !name)
+		return -1;
+
+	for (u32 i = 0; i < dvle->uniformTableSize; i++) {
+		if (!strcmp(&dvle->symbolTableData[dvle->uniformTableData[i].symbolOffset], name))
+			return dvle->uniformTableData[i].startReg - 0x10;
+	}
+	return -1;
+}
+
+void DVLE_GenerateOutmap(DVLE_s* dvle)
+{
+	if (!dvle)
+		return;
+
+	memset(dvle->outmapData, 0x1F, sizeof(dvle->outmapData));
+
+	int i;
+	u8 numAttr = 0;
+	u8 attrMask = 0;
+
+	for (i = 0; i < dvle->outTableSize; i++) {
+		u32* out = &dvle->outmapData[dvle->outTableData[i].regID + 1];
+		u32 mask = 0x00000000;
+		u8 tmpmask = dvle->outTableData[i].mask;
+		mask = (mask << 8) | ((tmpmask & 8) ? 0xFF : 0x00); tmpmask <<= 1;
+		mask = (mask << 8) | ((tmpmask & 8) ? 0xFF : 0x00); tmpmask <<= 1;
+		mask = (mask << 8) | ((tmpmask & 8) ? 0xFF : 0x00); tmpmask <<= 1;
+		mask = (mask << 8) | ((tmpmask & 8) ? 0xFF : 0x00); tmpmask <<= 1;
+
+		if (*out == 0x1F1F1F1F)
+			numAttr++;
+
+		switch (dvle->outTableData[i].type) {
+		case RESULT_POSITION:   *out = (*out & ~mask) | (0x03020100 & mask); break;
+		case RESULT_NORMALQUAT: *out = (*out & ~mask) | (0x07060504 & mask); break;
+		case RESULT_COLOR:      *out = (*out & ~mask) | (0x0B0A0908 & mask); break;
+		case RESULT_TEXCOORD0:  *out = (*out & ~mask) | (0x1F1F0D0C & mask); break;
+		case RESULT_TEXCOORD0W: *out = (*out & ~mask) | (0x10101010 & mask); break;
+		case RESULT_TEXCOORD1:  *out = (*out & ~mask) | (0x1F1F0F0E & mask); break;
+		case RESULT_TEXCOORD2:  *out = (*out & ~mask) | (0x1F1F1716 & mask); break;
+		case RESULT_VIEW:       *out = (*out & ~mask) | (0x1F141312 & mask); break;
+		}
+
+		attrMask |= 1 << dvle->outTableData[i].regID;
+	}
+
+	dvle->outmapData[0] = numAttr;
+	dvle->outmapMask = attrMask;
+}
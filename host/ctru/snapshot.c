@@ -0,0 +1,52 @@
+#include <3ds.h>
+#include "pica.h"
+#include "ctru.h"
+
+static struct {
+	bool taken;
+	pica_state pica;
+	u32* cmd_buf;
+	u32 cmd_buf_size;
+	u32 cmd_buf_offset;
+	int gfx_buffer;
+} snapshot;
+
+static ctru_snapshot_stats stats;
+
+void ctru_snapshot_take(void)
+{
+	snapshot.pica = pica;
+	snapshot.cmd_buf = gpuCmdBuf;
+	snapshot.cmd_buf_size = gpuCmdBufSize;
+	snapshot.cmd_buf_offset = gpuCmdBufOffset;
+	snapshot.gfx_buffer = ctru_gfx_get_buffer();
+	snapshot.taken = true;
+
+	ctru_memory_checkpoint();
+	ctru_memory_track_writes();
+}
+
+u32 ctru_snapshot_restore(void)
+{
+	if (!snapshot.taken)
+		return 0;
+
+	pica_restore(&snapshot.pica);
+	gpuCmdBuf = snapshot.cmd_buf;
+	gpuCmdBufSize = snapshot.cmd_buf_size;
+	gpuCmdBufOffset = snapshot.cmd_buf_offset;
+	ctru_gfx_set_buffer(snapshot.gfx_buffer);
+
+	u32 leaks = ctru_memory_rewind();
+	u32 pages = ctru_memory_restore_writes();
+
+	stats.restores++;
+	stats.pages += pages;
+	stats.leaks += leaks;
+	return leaks;
+}
+
+void ctru_snapshot_get_stats(ctru_snapshot_stats* out)
+{
+	*out = stats;
+}
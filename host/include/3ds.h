@@ -0,0 +1,31 @@
+/*
+ * Host stand-in for libctru's <3ds.h>
+ * Declares the subset of libctru the suites use. The implementation in host/ctru drives the host
+ * PICA200 model instead of the GPU, so the suites' gpu.c and main.c build unchanged on the host.
+ */
+
+#pragma once
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <3ds/types.h>
+#include <3ds/linear.h>
+#include <3ds/vram.h>
+#include <3ds/os.h>
+#include <3ds/svc.h>
+#include <3ds/gfx.h>
+#include <3ds/console.h>
+#include <3ds/services/apt.h>
+#include <3ds/services/gsp.h>
+#include <3ds/services/hid.h>
+#include <3ds/gpu/registers.h>
+#include <3ds/gpu/gpu.h>
+#include <3ds/gpu/gx.h>
+#include <3ds/gpu/shbin.h>
+#include <3ds/gpu/shaderProgram.h>
+
+#ifdef __cplusplus
+}
+#endif
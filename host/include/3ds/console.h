@@ -0,0 +1,7 @@
+#pragma once
+#include <3ds/gfx.h>
+
+typedef struct PrintConsole PrintConsole;
+
+// Console output goes to stdout on the host
+PrintConsole* consoleInit(gfxScreen_t screen, PrintConsole* console);
@@ -0,0 +1,13 @@
+#pragma once
+#include <3ds/types.h>
+
+typedef enum { GFX_TOP = 0, GFX_BOTTOM = 1 } gfxScreen_t;
+typedef enum { GFX_LEFT = 0, GFX_RIGHT = 1 } gfx3dSide_t;
+
+void gfxInitDefault(void);
+void gfxExit(void);
+
+// The top screen framebuffers are 240x400 BGR8, the bottom ones 240x320
+u8* gfxGetFramebuffer(gfxScreen_t screen, gfx3dSide_t side, u16* width, u16* height);
+void gfxFlushBuffers(void);
+void gfxSwapBuffersGpu(void);
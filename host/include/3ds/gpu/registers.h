@@ -0,0 +1,78 @@
+#pragma once
+
+// Register names of the libctru version the suites were written against
+#define GPUREG_FINALIZE                  0x0010
+#define GPUREG_FACECULLING_CONFIG        0x0040
+#define GPUREG_0041                      0x0041
+#define GPUREG_DEPTHMAP_SCALE            0x004D
+#define GPUREG_DEPTHMAP_OFFSET           0x004E
+#define GPUREG_SH_OUTMAP_TOTAL           0x004F
+#define GPUREG_0062                      0x0062
+#define GPUREG_0063                      0x0063
+#define GPUREG_0064                      0x0064
+#define GPUREG_SCISSORTEST_MODE          0x0065
+#define GPUREG_SCISSORTEST_POS           0x0066
+#define GPUREG_SCISSORTEST_DIM           0x0067
+#define GPUREG_0068                      0x0068
+#define GPUREG_006D                      0x006D
+#define GPUREG_006E                      0x006E
+#define GPUREG_006F                      0x006F
+#define GPUREG_TEXENV0_CONFIG            0x00C0
+#define GPUREG_TEXENV1_CONFIG            0x00C8
+#define GPUREG_TEXENV2_CONFIG            0x00D0
+#define GPUREG_TEXENV3_CONFIG            0x00D8
+#define GPUREG_TEXENV4_CONFIG            0x00F0
+#define GPUREG_TEXENV5_CONFIG            0x00F8
+#define GPUREG_COLOROUTPUT_CONFIG        0x0100
+#define GPUREG_BLEND_CONFIG              0x0101
+#define GPUREG_LOGICOP_CONFIG            0x0102
+#define GPUREG_BLEND_COLOR               0x0103
+#define GPUREG_ALPHATEST_CONFIG          0x0104
+#define GPUREG_STENCILTEST_CONFIG        0x0105
+#define GPUREG_STENCILOP_CONFIG          0x0106
+#define GPUREG_DEPTHTEST_CONFIG          0x0107
+#define GPUREG_0110                      0x0110
+#define GPUREG_0111                      0x0111
+#define GPUREG_COLORBUFFER_READ          0x0112
+#define GPUREG_COLORBUFFER_WRITE         0x0113
+#define GPUREG_DEPTHBUFFER_READ          0x0114
+#define GPUREG_DEPTHBUFFER_WRITE         0x0115
+#define GPUREG_DEPTHBUFFER_FORMAT        0x0116
+#define GPUREG_COLORBUFFER_FORMAT        0x0117
+#define GPUREG_0118                      0x0118
+#define GPUREG_011B                      0x011B
+#define GPUREG_DEPTHBUFFER_LOC           0x011C
+#define GPUREG_COLORBUFFER_LOC           0x011D
+#define GPUREG_011E                      0x011E
+#define GPUREG_ATTRIBBUFFERS_LOC         0x0200
+#define GPUREG_ATTRIBBUFFERS_FORMAT_LOW  0x0201
+#define GPUREG_ATTRIBBUFFERS_FORMAT_HIGH 0x0202
+#define GPUREG_INDEXBUFFER_CONFIG        0x0227
+#define GPUREG_NUMVERTICES               0x0228
+#define GPUREG_VERTEX_OFFSET             0x022A
+#define GPUREG_DRAWARRAYS                0x022E
+#define GPUREG_DRAWELEMENTS              0x022F
+#define GPUREG_0231                      0x0231
+#define GPUREG_0242                      0x0242
+#define GPUREG_0245                      0x0245
+#define GPUREG_GEOSTAGE_CONFIG           0x0244
+#define GPUREG_024A                      0x024A
+#define GPUREG_0251                      0x0251
+#define GPUREG_0252                      0x0252
+#define GPUREG_0253                      0x0253
+#define GPUREG_PRIMITIVE_CONFIG          0x025E
+#define GPUREG_RESTART_PRIMITIVE         0x025F
+#define GPUREG_VSH_BOOLUNIFORM           0x02B0
+#define GPUREG_VSH_INTUNIFORM_I0         0x02B1
+#define GPUREG_VSH_INPUTBUFFER_CONFIG    0x02B9
+#define GPUREG_VSH_ENTRYPOINT            0x02BA
+#define GPUREG_VSH_ATTRIBUTES_PERMUTATION_LOW  0x02BB
+#define GPUREG_VSH_ATTRIBUTES_PERMUTATION_HIGH 0x02BC
+#define GPUREG_VSH_OUTMAP_MASK           0x02BD
+#define GPUREG_VSH_CODETRANSFER_END      0x02BF
+#define GPUREG_VSH_FLOATUNIFORM_CONFIG   0x02C0
+#define GPUREG_VSH_FLOATUNIFORM_DATA     0x02C1
+#define GPUREG_VSH_CODETRANSFER_CONFIG   0x02CB
+#define GPUREG_VSH_CODETRANSFER_DATA     0x02CC
+#define GPUREG_VSH_OPDESCS_CONFIG        0x02D5
+#define GPUREG_VSH_OPDESCS_DATA          0x02D6
@@ -0,0 +1,6 @@
+#pragma once
+#include <3ds/types.h>
+
+// Linear heap, the GPU sees it at physical address 0x20000000
+void* linearAlloc(size_t size);
+void linearFree(void* mem);
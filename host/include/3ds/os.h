@@ -0,0 +1,5 @@
+#pragma once
+#include <3ds/types.h>
+
+// The host maps the linear heap and VRAM at their 3DS virtual addresses, so pointers fit in a u32
+u32 osConvertVirtToPhys(u32 vaddr);
@@ -0,0 +1,4 @@
+#pragma once
+#include <3ds/types.h>
+
+bool aptMainLoop(void);
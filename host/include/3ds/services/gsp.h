@@ -0,0 +1,23 @@
+#pragma once
+#include <3ds/types.h>
+
+typedef enum {
+	GSPEVENT_PSC0 = 0, // memory fill completed
+	GSPEVENT_PSC1,
+	GSPEVENT_VBlank0,
+	GSPEVENT_VBlank1,
+	GSPEVENT_PPF,      // display transfer finished
+	GSPEVENT_P3D,      // command list processing finished
+	GSPEVENT_DMA,
+} GSP_Event;
+
+// The host model runs GPU work synchronously, waiting for an event returns at once
+void gspWaitForEvent(GSP_Event id, bool nextEvent);
+#define gspWaitForPSC0() gspWaitForEvent(GSPEVENT_PSC0, false)
+#define gspWaitForPSC1() gspWaitForEvent(GSPEVENT_PSC1, false)
+#define gspWaitForVBlank() gspWaitForEvent(GSPEVENT_VBlank0, true)
+#define gspWaitForPPF() gspWaitForEvent(GSPEVENT_PPF, false)
+#define gspWaitForP3D() gspWaitForEvent(GSPEVENT_P3D, false)
+
+Result GSPGPU_FlushDataCache(Handle* handle, u8* adr, u32 size);
+Result GSPGPU_InvalidateDataCache(Handle* handle, u8* adr, u32 size);
@@ -0,0 +1,15 @@
+#pragma once
+#include <3ds/types.h>
+
+enum {
+	KEY_A      = BIT(0),
+	KEY_B      = BIT(1),
+	KEY_SELECT = BIT(2),
+	KEY_START  = BIT(3),
+};
+
+void hidScanInput(void);
+
+// Nobody sits in front of the host, every key reads as pressed so that prompts never block
+u32 hidKeysDown(void);
+u32 hidKeysHeld(void);
@@ -0,0 +1,5 @@
+#pragma once
+#include <3ds/types.h>
+
+// Ticks of the 268 MHz ARM11 system clock, derived from the host's monotonic clock
+u64 svcGetSystemTick(void);
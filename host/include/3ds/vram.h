@@ -0,0 +1,6 @@
+#pragma once
+#include <3ds/types.h>
+
+// VRAM, the GPU sees it at physical address 0x18000000
+void* vramAlloc(size_t size);
+void vramFree(void* mem);
@@ -0,0 +1,28 @@
+/*
+ * Host-only extension of the libctru stand-in, for harnesses running many tests in one process
+ */
+
+#pragma once
+#include <3ds/types.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Snapshot of the whole emulated state: the PICA registers and shader setup, the command buffer, the heap
+// allocations and contents, the framebuffers in them. Take it once the state every test starts from is set up,
+// restore it before each test: only the pages the test wrote to are copied back. Restoring returns the number
+// of heap blocks the test allocated and never freed.
+typedef struct {
+	u64 restores;
+	u64 pages;    // copied back by all the restores
+	u64 leaks;
+} ctru_snapshot_stats;
+
+void ctru_snapshot_take(void);
+u32 ctru_snapshot_restore(void);
+void ctru_snapshot_get_stats(ctru_snapshot_stats* stats);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,65 @@
+/*
+ * float24 helpers
+ * The PICA200 shader units work on 24-bit floats: 1 sign bit, 7 exponent bits (bias 63) and 16 mantissa bits.
+ * The host model computes in float32 and only rounds values to float24 where they enter the GPU.
+ */
+
+#pragma once
+#include <string.h>
+#include <3ds/types.h>
+
+static inline float f32_from_bits(u32 bits)
+{
+	float f;
+	memcpy(&f, &bits, sizeof(f));
+	return f;
+}
+
+static inline u32 f32_to_bits(float f)
+{
+	u32 bits;
+	memcpy(&bits, &f, sizeof(bits));
+	return bits;
+}
+
+// Denormals are flushed to zero, exponent 0x7F encodes infinities and NaNs just like in float32
+static inline float f24_to_f32(u32 value)
+{
+	u32 sign = (value >> 23) & 1;
+	u32 exponent = (value >> 16) & 0x7F;
+	u32 mantissa = value & 0xFFFF;
+
+	if (exponent == 0)
+		return f32_from_bits(sign << 31);
+	if (exponent == 0x7F)
+		return f32_from_bits((sign << 31) | (0xFF << 23) | (mantissa << 7));
+	return f32_from_bits((sign << 31) | ((exponent + 64) << 23) | (mantissa << 7));
+}
+
+// Truncates the mantissa like the hardware does when it converts float32 uniforms and attributes
+static inline u32 f32_to_f24(float f)
+{
+	u32 bits = f32_to_bits(f);
+	u32 sign = bits >> 31;
+	s32 exponent = (bits >> 23) & 0xFF;
+	u32 mantissa = (bits >> 7) & 0xFFFF;
+
+	if (exponent == 0xFF) {
+		if ((bits & 0x7FFFFF) && !mantissa)
+			mantissa = 1; // keep NaNs NaN
+		return (sign << 23) | (0x7F << 16) | mantissa;
+	}
+
+	exponent -= 64;
+	if (exponent <= 0)
+		return sign << 23;
+	if (exponent >= 0x7F)
+		return (sign << 23) | (0x7F << 16);
+	return (sign << 23) | ((u32)exponent << 16) | mantissa;
+}
+
+// Rounds a float32 to the nearest value representable as float24
+static inline float f24_round(float f)
+{
+	return f24_to_f32(f32_to_f24(f));
+}
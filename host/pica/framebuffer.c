@@ -0,0 +1,13 @@
+#include "pica.h"
+#include "framebuffer.h"
+
+void pica_framebuffer_get(pica_framebuffer* fb)
+{
+	u32 dim = pica.regs[PICA_REG_FRAMEBUFFER_DIM];
+
+	fb->width = dim & 0x7FF;
+	fb->height = ((dim >> 12) & 0x3FF) + 1;
+	fb->color = pica_phys_to_ptr(pica.regs[PICA_REG_COLORBUFFER_LOC] << 3);
+	fb->depth = pica_phys_to_ptr(pica.regs[PICA_REG_DEPTHBUFFER_LOC] << 3);
+	fb->depth_format = pica.regs[PICA_REG_DEPTHBUFFER_FORMAT] & 3;
+}
@@ -0,0 +1,37 @@
+/*
+ * Render target access
+ * Color and depth buffers are stored in 8x8 tiles, pixels inside a tile follow a Morton (Z-order) curve
+ * and the rows of the buffer are stored bottom to top.
+ */
+
+#pragma once
+#include <3ds/types.h>
+
+// Offset in pixels of (x, y) in a tiled buffer that is width pixels wide
+static inline u32 pica_morton_offset(u32 x, u32 y, u32 width)
+{
+	u32 i = (x & 1) | ((y & 1) << 1) | ((x & 2) << 1) | ((y & 2) << 2) | ((x & 4) << 2) | ((y & 4) << 3);
+	return (y & ~7u) * width + (x & ~7u) * 8 + i;
+}
+
+typedef struct {
+	u32 width, height;
+	u8* color;  // RGBA8, NULL when not mapped
+	u8* depth;  // NULL when not mapped
+	u32 depth_format; // 0: D16, 2: D24, 3: D24S8
+} pica_framebuffer;
+
+// Reads the framebuffer registers of the current GPU state
+void pica_framebuffer_get(pica_framebuffer* fb);
+
+// Offset in pixels of the window coordinates (x, y), y grows upwards
+static inline u32 pica_framebuffer_offset(const pica_framebuffer* fb, u32 x, u32 y)
+{
+	return pica_morton_offset(x, fb->height - 1 - y, fb->width);
+}
+
+// A rasterized fragment, depth is a 24-bit value
+typedef struct {
+	u16 x, y;
+	u32 depth;
+} pica_fragment;
@@ -0,0 +1,245 @@
+#include <string.h>
+#include "framebuffer.h"
+#include "gx.h"
+
+#if defined(__SSE2__)
+#include <immintrin.h>
+#endif
+
+//
+// Memory fill
+//
+
+void pica_memory_fill(void* start, void* end, u32 value, u32 control)
+{
+	static const u32 widths[4] = { 2, 3, 4, 4 };
+	u32 width = widths[PICA_FILL_WIDTH(control)];
+	u8* dst = start;
+	size_t size = (u8*)end - dst;
+
+	// 48 bytes hold a whole number of 2, 3 and 4 byte values and of 16 byte vectors, the extra
+	// bytes let any rotation of the pattern be read at once
+	u8 pattern[48 + 48];
+	for (u32 i = 0; i < sizeof(pattern); i++)
+		pattern[i] = value >> (8 * (i % width));
+
+	if (size < 64) {
+		for (size_t i = 0; i < size; i++)
+			dst[i] = pattern[i % width];
+		return;
+	}
+
+#if defined(__SSE2__)
+	size_t head = -(uintptr_t)dst & 15;
+	memcpy(dst, pattern, head);
+
+	const u8* phase = pattern + head % width;
+	__m128i v0 = _mm_loadu_si128((const __m128i*)phase);
+	__m128i v1 = _mm_loadu_si128((const __m128i*)(phase + 16));
+	__m128i v2 = _mm_loadu_si128((const __m128i*)(phase + 32));
+
+	size_t i = head;
+	for (; i + 48 <= size; i += 48) {
+		_mm_stream_si128((__m128i*)(dst + i), v0);
+		_mm_stream_si128((__m128i*)(dst + i + 16), v1);
+		_mm_stream_si128((__m128i*)(dst + i + 32), v2);
+	}
+	_mm_sfence();
+
+	memcpy(dst + i, pattern + i % width, size - i);
+#else
+	size_t i = 0;
+	for (; i + 48 <= size; i += 48)
+		memcpy(dst + i, pattern, 48);
+	memcpy(dst + i, pattern, size - i);
+#endif
+}
+
+//
+// Display transfer
+//
+
+static const u32 bytes_per_pixel[8] = { 4, 3, 2, 2, 2, 4, 4, 4 };
+
+static void decode_pixel(u32 format, const u8* p, u8 rgba[4])
+{
+	u32 v;
+	switch (format) {
+	case PICA_TRANSFER_RGB8:
+		rgba[0] = p[2], rgba[1] = p[1], rgba[2] = p[0], rgba[3] = 255;
+		break;
+	case PICA_TRANSFER_RGB565:
+		v = p[0] | (p[1] << 8);
+		rgba[0] = ((v >> 11) << 3) | (v >> 13);
+		rgba[1] = (((v >> 5) & 0x3F) << 2) | ((v >> 9) & 3);
+		rgba[2] = ((v & 0x1F) << 3) | ((v >> 2) & 7);
+		rgba[3] = 255;
+		break;
+	case PICA_TRANSFER_RGB5A1:
+		v = p[0] | (p[1] << 8);
+		rgba[0] = ((v >> 11) << 3) | (v >> 13);
+		rgba[1] = (((v >> 6) & 0x1F) << 3) | ((v >> 8) & 7);
+		rgba[2] = (((v >> 1) & 0x1F) << 3) | ((v >> 3) & 7);
+		rgba[3] = (v & 1) ? 255 : 0;
+		break;
+	case PICA_TRANSFER_RGBA4:
+		v = p[0] | (p[1] << 8);
+		rgba[0] = (v >> 12) * 0x11;
+		rgba[1] = ((v >> 8) & 0xF) * 0x11;
+		rgba[2] = ((v >> 4) & 0xF) * 0x11;
+		rgba[3] = (v & 0xF) * 0x11;
+		break;
+	default:
+		rgba[0] = p[3], rgba[1] = p[2], rgba[2] = p[1], rgba[3] = p[0];
+		break;
+	}
+}
+
+static void encode_pixel(u32 format, u8* p, const u8 rgba[4])
+{
+	u32 v;
+	switch (format) {
+	case PICA_TRANSFER_RGB8:
+		p[0] = rgba[2], p[1] = rgba[1], p[2] = rgba[0];
+		return;
+	case PICA_TRANSFER_RGB565:
+		v = ((rgba[0] >> 3) << 11) | ((rgba[1] >> 2) << 5) | (rgba[2] >> 3);
+		break;
+	case PICA_TRANSFER_RGB5A1:
+		v = ((rgba[0] >> 3) << 11) | ((rgba[1] >> 3) << 6) | ((rgba[2] >> 3) << 1) | (rgba[3] >> 7);
+		break;
+	case PICA_TRANSFER_RGBA4:
+		v = ((rgba[0] >> 4) << 12) | ((rgba[1] >> 4) << 8) | ((rgba[2] >> 4) << 4) | (rgba[3] >> 4);
+		break;
+	default:
+		p[0] = rgba[3], p[1] = rgba[2], p[2] = rgba[1], p[3] = rgba[0];
+		return;
+	}
+	p[0] = v, p[1] = v >> 8;
+}
+
+// Handles every combination of formats, scaling, flipping and tiling direction a pixel at a time
+static void transfer_generic(const u8* in, u32 in_w, u32 in_h, u8* out, u32 out_w, u32 out_h, u32 flags)
+{
+	u32 in_format = PICA_TRANSFER_IN_FORMAT(flags), out_format = PICA_TRANSFER_OUT_FORMAT(flags);
+	u32 in_bpp = bytes_per_pixel[in_format], out_bpp = bytes_per_pixel[out_format];
+	u32 scaling = PICA_TRANSFER_SCALING(flags);
+	u32 shift_x = scaling >= 1, shift_y = scaling == 2;
+	bool out_tiled = PICA_TRANSFER_OUT_TILED(flags);
+
+	for (u32 y = 0; y < out_h; y++) {
+		for (u32 x = 0; x < out_w; x++) {
+			u32 sum[4] = { 0, 0, 0, 0 };
+			u32 samples = 0;
+
+			// Downscaling averages the 2x1 or 2x2 input pixels
+			for (u32 dy = 0; dy <= shift_y; dy++) {
+				for (u32 dx = 0; dx <= shift_x; dx++) {
+					u32 sx = (x << shift_x) + dx, sy = (y << shift_y) + dy;
+					if (sx >= in_w || sy >= in_h)
+						continue;
+					u32 offset = out_tiled ? sy * in_w + sx : pica_morton_offset(sx, sy, in_w);
+					u8 rgba[4];
+					decode_pixel(in_format, in + in_bpp * offset, rgba);
+					for (int c = 0; c < 4; c++)
+						sum[c] += rgba[c];
+					samples++;
+				}
+			}
+			if (!samples)
+				continue;
+
+			u8 rgba[4];
+			for (int c = 0; c < 4; c++)
+				rgba[c] = sum[c] / samples;
+
+			u32 oy = PICA_TRANSFER_FLIP_VERT(flags) ? out_h - 1 - y : y;
+			u32 offset = out_tiled ? pica_morton_offset(x, oy, out_w) : oy * out_w + x;
+			encode_pixel(out_format, out + out_bpp * offset, rgba);
+		}
+	}
+}
+
+// The 8 pixels of a tile row are spread over four pairs, at these pixel offsets from the row pair's start
+static const u32 tile_row_pairs[4] = { 0, 4, 16, 20 };
+
+static void detile_rgba8_to_rgb8(const u8* in, u8* out, u32 width, u32 height)
+{
+	for (u32 ty = 0; ty < height; ty += 8) {
+		for (u32 tx = 0; tx < width; tx += 8) {
+			const u8* tile = in + 4 * (ty * width + tx * 8);
+			for (u32 y = 0; y < 8; y++) {
+				const u8* row = tile + 4 * pica_morton_offset(0, y, 8);
+				u8* dst = out + 3 * ((ty + y) * width + tx);
+				for (u32 pair = 0; pair < 4; pair++) {
+					const u8* p = row + 4 * tile_row_pairs[pair];
+					dst[0] = p[1], dst[1] = p[2], dst[2] = p[3];
+					dst[3] = p[5], dst[4] = p[6], dst[5] = p[7];
+					dst += 6;
+				}
+			}
+		}
+	}
+}
+
+#if defined(__SSE2__)
+// Each 4x2 block of a tile holds (0,0) (1,0) (0,1) (1,1) (2,0) (3,0) (2,1) (3,1), so two tile rows come
+// out of four loads with 64-bit unpacks and a byte shuffle drops the alpha channel
+__attribute__((target("ssse3")))
+static void detile_rgba8_to_rgb8_ssse3(const u8* in, u8* out, u32 width, u32 height)
+{
+	const __m128i drop_alpha = _mm_setr_epi8(1, 2, 3, 5, 6, 7, 9, 10, 11, 13, 14, 15, -1, -1, -1, -1);
+
+	for (u32 ty = 0; ty < height; ty += 8) {
+		for (u32 tx = 0; tx < width; tx += 8) {
+			const u8* tile = in + 4 * (ty * width + tx * 8);
+			for (u32 y = 0; y < 8; y += 2) {
+				const u8* block = tile + 4 * pica_morton_offset(0, y, 8);
+				__m128i a = _mm_loadu_si128((const __m128i*)block);
+				__m128i b = _mm_loadu_si128((const __m128i*)(block + 16));
+				__m128i c = _mm_loadu_si128((const __m128i*)(block + 64));
+				__m128i d = _mm_loadu_si128((const __m128i*)(block + 80));
+
+				for (u32 row = 0; row < 2; row++) {
+					__m128i lo = row ? _mm_unpackhi_epi64(a, b) : _mm_unpacklo_epi64(a, b);
+					__m128i hi = row ? _mm_unpackhi_epi64(c, d) : _mm_unpacklo_epi64(c, d);
+					lo = _mm_shuffle_epi8(lo, drop_alpha);
+					hi = _mm_shuffle_epi8(hi, drop_alpha);
+
+					// 12 + 12 bytes make up the 24 bytes of the output row
+					u8* dst = out + 3 * ((ty + y + row) * width + tx);
+					_mm_storeu_si128((__m128i*)dst, _mm_or_si128(lo, _mm_slli_si128(hi, 12)));
+					_mm_storel_epi64((__m128i*)(dst + 16), _mm_srli_si128(hi, 4));
+				}
+			}
+		}
+	}
+}
+#endif
+
+void pica_display_transfer(const void* in, u32 in_dim, void* out, u32 out_dim, u32 flags)
+{
+	u32 in_w = PICA_BUFFER_WIDTH(in_dim), in_h = PICA_BUFFER_HEIGHT(in_dim);
+	u32 out_w = PICA_BUFFER_WIDTH(out_dim), out_h = PICA_BUFFER_HEIGHT(out_dim);
+
+	if (PICA_TRANSFER_RAW_COPY(flags)) {
+		memcpy(out, in, in_w * in_h * bytes_per_pixel[PICA_TRANSFER_IN_FORMAT(flags)]);
+		return;
+	}
+
+	// The transfer of the suites' color buffer to the screen gets a dedicated kernel
+	bool plain = !PICA_TRANSFER_FLIP_VERT(flags) && !PICA_TRANSFER_OUT_TILED(flags) && !PICA_TRANSFER_SCALING(flags);
+	if (plain && in_w == out_w && in_h == out_h && !(in_w & 7) && !(in_h & 7) &&
+		PICA_TRANSFER_IN_FORMAT(flags) == PICA_TRANSFER_RGBA8 && PICA_TRANSFER_OUT_FORMAT(flags) == PICA_TRANSFER_RGB8) {
+#if defined(__SSE2__)
+		if (__builtin_cpu_supports("ssse3")) {
+			detile_rgba8_to_rgb8_ssse3(in, out, in_w, in_h);
+			return;
+		}
+#endif
+		detile_rgba8_to_rgb8(in, out, in_w, in_h);
+		return;
+	}
+
+	transfer_generic(in, in_w, in_h, out, out_w, out_h, flags);
+}
@@ -0,0 +1,34 @@
+/*
+ * GX engines: memory fill and display transfer
+ * These run outside of the PICA command processor, the suites start them with GX_SetMemoryFill()
+ * to clear the render targets and GX_SetDisplayTransfer() to copy the color buffer to the screen.
+ */
+
+#pragma once
+#include <3ds/types.h>
+
+// Memory fill control, as passed to GX_SetMemoryFill
+#define PICA_FILL_TRIGGER       0x001
+#define PICA_FILL_WIDTH(control) (((control) >> 8) & 3) // 0: 16-bit, 1: 24-bit, 2: 32-bit
+
+// Display transfer flags, as passed to GX_SetDisplayTransfer
+#define PICA_TRANSFER_FLIP_VERT(flags)  ((flags) & 1)
+#define PICA_TRANSFER_OUT_TILED(flags)  (((flags) >> 1) & 1)
+#define PICA_TRANSFER_RAW_COPY(flags)   (((flags) >> 3) & 1)
+#define PICA_TRANSFER_IN_FORMAT(flags)  (((flags) >> 8) & 7)
+#define PICA_TRANSFER_OUT_FORMAT(flags) (((flags) >> 12) & 7)
+#define PICA_TRANSFER_SCALING(flags)    (((flags) >> 24) & 3) // 0: none, 1: halve x, 2: halve x and y
+
+enum {
+	PICA_TRANSFER_RGBA8, PICA_TRANSFER_RGB8, PICA_TRANSFER_RGB565, PICA_TRANSFER_RGB5A1, PICA_TRANSFER_RGBA4,
+};
+
+// Dimensions are encoded like GX_BUFFER_DIM: width in the low half, height in the high half
+#define PICA_BUFFER_WIDTH(dim)  ((dim) & 0xFFFF)
+#define PICA_BUFFER_HEIGHT(dim) ((dim) >> 16)
+
+// Fills [start, end) with value, uses non-temporal stores since the filled buffer is not read back by the CPU
+void pica_memory_fill(void* start, void* end, u32 value, u32 control);
+
+// Converts a tiled buffer to a linear one (or the other way around with PICA_TRANSFER_OUT_TILED)
+void pica_display_transfer(const void* in, u32 in_dim, void* out, u32 out_dim, u32 flags);
@@ -0,0 +1,364 @@
+#include <string.h>
+#include "pica.h"
+#include "output_merger.h"
+
+// One lane per fragment, channels and depth are widened to 32 bits so products of two bytes fit
+typedef u32 om_vec __attribute__((vector_size(4 * PICA_OM_LANES)));
+typedef s32 om_mask __attribute__((vector_size(4 * PICA_OM_LANES)));
+
+#define ALWAYS_INLINE static inline __attribute__((always_inline))
+
+//
+// Lane helpers
+//
+
+ALWAYS_INLINE om_vec select(om_mask mask, om_vec a, om_vec b)
+{
+	return (a & (om_vec)mask) | (b & ~(om_vec)mask);
+}
+
+ALWAYS_INLINE om_vec vmin(om_vec a, om_vec b)
+{
+	return select(a < b, a, b);
+}
+
+ALWAYS_INLINE om_vec vmax(om_vec a, om_vec b)
+{
+	return select(a > b, a, b);
+}
+
+// Exact x / 255 for 0 <= x <= 255 * 255
+ALWAYS_INLINE om_vec div255(om_vec x)
+{
+	return (x * 0x8081) >> 23;
+}
+
+ALWAYS_INLINE om_mask compare(u32 func, om_vec a, om_vec b)
+{
+	switch (func) {
+	case PICA_TEST_NEVER:    return (om_mask)(a ^ a);
+	case PICA_TEST_ALWAYS:   return ~(om_mask)(a ^ a);
+	case PICA_TEST_EQUAL:    return a == b;
+	case PICA_TEST_NOTEQUAL: return a != b;
+	case PICA_TEST_LESS:     return a < b;
+	case PICA_TEST_LEQUAL:   return a <= b;
+	case PICA_TEST_GREATER:  return a > b;
+	default:                 return a >= b;
+	}
+}
+
+ALWAYS_INLINE om_vec stencil_op(u32 op, om_vec s, u32 ref)
+{
+	switch (op) {
+	case PICA_STENCIL_KEEP:      return s;
+	case PICA_STENCIL_ZERO:      return s ^ s;
+	case PICA_STENCIL_REPLACE:   return (s ^ s) + ref;
+	case PICA_STENCIL_INCR:      return s - (om_vec)(s != 255); // a true comparison is all ones, i.e. -1
+	case PICA_STENCIL_DECR:      return s + (om_vec)(s != 0);
+	case PICA_STENCIL_INVERT:    return ~s & 0xFF;
+	case PICA_STENCIL_INCR_WRAP: return (s + 1) & 0xFF;
+	default:                     return (s - 1) & 0xFF;
+	}
+}
+
+ALWAYS_INLINE om_vec blend_factor(const pica_output_merger* om, u32 factor, int c, const om_vec* src, const om_vec* dst)
+{
+	om_vec zero = src[0] ^ src[0];
+
+	switch (factor) {
+	case PICA_BLEND_ZERO:                     return zero;
+	case PICA_BLEND_ONE:                      return zero + 255;
+	case PICA_BLEND_SRC_COLOR:                return src[c];
+	case PICA_BLEND_ONE_MINUS_SRC_COLOR:      return 255 - src[c];
+	case PICA_BLEND_DST_COLOR:                return dst[c];
+	case PICA_BLEND_ONE_MINUS_DST_COLOR:      return 255 - dst[c];
+	case PICA_BLEND_SRC_ALPHA:                return src[3];
+	case PICA_BLEND_ONE_MINUS_SRC_ALPHA:      return 255 - src[3];
+	case PICA_BLEND_DST_ALPHA:                return dst[3];
+	case PICA_BLEND_ONE_MINUS_DST_ALPHA:      return 255 - dst[3];
+	case PICA_BLEND_CONSTANT_COLOR:           return zero + om->blend_color[c];
+	case PICA_BLEND_ONE_MINUS_CONSTANT_COLOR: return zero + (255 - om->blend_color[c]);
+	case PICA_BLEND_CONSTANT_ALPHA:           return zero + om->blend_color[3];
+	case PICA_BLEND_ONE_MINUS_CONSTANT_ALPHA: return zero + (255 - om->blend_color[3]);
+	default:
+		return c == 3 ? zero + 255 : vmin(src[3], 255 - dst[3]);
+	}
+}
+
+// The weighted sums are truncated after the division by 255, like the hardware does
+ALWAYS_INLINE om_vec blend_channel(const pica_output_merger* om, int c, const om_vec* src, const om_vec* dst)
+{
+	int part = c == 3;
+	om_vec s = src[c] * blend_factor(om, om->blend_src[part], c, src, dst);
+	om_vec d = dst[c] * blend_factor(om, om->blend_dst[part], c, src, dst);
+
+	switch (om->blend_eq[part]) {
+	case PICA_BLEND_ADD:              return div255(vmin(s + d, (s ^ s) + 255 * 255));
+	case PICA_BLEND_SUBTRACT:         return div255(select(s > d, s - d, s ^ s));
+	case PICA_BLEND_REVERSE_SUBTRACT: return div255(select(d > s, d - s, s ^ s));
+	case PICA_BLEND_MIN:              return vmin(src[c], dst[c]);
+	default:                          return vmax(src[c], dst[c]);
+	}
+}
+
+ALWAYS_INLINE om_vec logic_op(u32 op, om_vec s, om_vec d)
+{
+	switch (op) {
+	case PICA_LOGIC_CLEAR:         return s ^ s;
+	case PICA_LOGIC_AND:           return s & d;
+	case PICA_LOGIC_AND_REVERSE:   return s & ~d;
+	case PICA_LOGIC_COPY:          return s;
+	case PICA_LOGIC_SET:           return (s ^ s) + 0xFF;
+	case PICA_LOGIC_COPY_INVERTED: return ~s;
+	case PICA_LOGIC_NOOP:          return d;
+	case PICA_LOGIC_INVERT:        return ~d;
+	case PICA_LOGIC_NAND:          return ~(s & d);
+	case PICA_LOGIC_OR:            return s | d;
+	case PICA_LOGIC_NOR:           return ~(s | d);
+	case PICA_LOGIC_XOR:           return s ^ d;
+	case PICA_LOGIC_EQUIV:         return ~(s ^ d);
+	case PICA_LOGIC_AND_INVERTED:  return ~s & d;
+	case PICA_LOGIC_OR_REVERSE:    return s | ~d;
+	default:                       return ~s | d;
+	}
+}
+
+//
+// Framebuffer access
+//
+
+static u32 read_depth(const pica_framebuffer* fb, u32 offset)
+{
+	const u8* p;
+	switch (fb->depth_format) {
+	case 0:
+		p = fb->depth + 2 * offset;
+		return (p[0] | (p[1] << 8)) << 8; // D16 is compared with the top 16 bits of the fragment depth
+	case 3:
+		p = fb->depth + 4 * offset;
+		return p[0] | (p[1] << 8) | (p[2] << 16) | ((u32)p[3] << 24);
+	default:
+		p = fb->depth + 3 * offset;
+		return p[0] | (p[1] << 8) | (p[2] << 16);
+	}
+}
+
+static void write_depth(const pica_framebuffer* fb, u32 offset, u32 value)
+{
+	u8* p;
+	switch (fb->depth_format) {
+	case 0:
+		p = fb->depth + 2 * offset;
+		p[0] = value >> 8, p[1] = value >> 16;
+		break;
+	case 3:
+		p = fb->depth + 4 * offset;
+		p[0] = value, p[1] = value >> 8, p[2] = value >> 16, p[3] = value >> 24;
+		break;
+	default:
+		p = fb->depth + 3 * offset;
+		p[0] = value, p[1] = value >> 8, p[2] = value >> 16;
+		break;
+	}
+}
+
+//
+// Kernels
+//
+
+// Every fragment lands unchanged: no test can fail, the color is replaced and all channels are written
+static void run_copy(const pica_output_merger* om, const pica_framebuffer* fb,
+	const pica_fragment* frags, const u8 (*colors)[4], u32 count)
+{
+	for (u32 i = 0; i < count; i++) {
+		u8* dst = fb->color + 4 * pica_framebuffer_offset(fb, frags[i].x, frags[i].y);
+		dst[0] = colors[i][3];
+		dst[1] = colors[i][2];
+		dst[2] = colors[i][1];
+		dst[3] = colors[i][0];
+	}
+}
+
+// Generic path, the flags are compile-time constants in each of the instances below
+ALWAYS_INLINE void run_lanes(const pica_output_merger* om, const pica_framebuffer* fb,
+	const pica_fragment* frags, const u8 (*colors)[4], u32 count, bool depth_test, bool blend)
+{
+	bool has_color = fb->color && (om->color_mask[0] | om->color_mask[1] | om->color_mask[2] | om->color_mask[3]);
+	bool has_depth = fb->depth && (depth_test || om->depth_write || om->stencil_test);
+
+	for (u32 base = 0, n; base < count; base += n) {
+		u32 offset[PICA_OM_LANES];
+		om_vec src[4], dst[4], z, ds, lane;
+		om_mask live;
+
+		// A group ends early when a fragment hits a pixel an earlier lane already covers,
+		// the second fragment has to see what the first one wrote
+		n = count - base < PICA_OM_LANES ? count - base : PICA_OM_LANES;
+		for (u32 l = 0; l < n; l++) {
+			offset[l] = pica_framebuffer_offset(fb, frags[base + l].x, frags[base + l].y);
+			for (u32 k = 0; k < l; k++)
+				if (offset[k] == offset[l])
+					n = l;
+		}
+
+		// Gather the fragments and what the framebuffer holds under them, unused lanes are dead
+		for (u32 l = 0; l < PICA_OM_LANES; l++) {
+			lane[l] = l;
+			if (l >= n) {
+				src[0][l] = src[1][l] = src[2][l] = src[3][l] = 0;
+				dst[0][l] = dst[1][l] = dst[2][l] = dst[3][l] = 0;
+				z[l] = ds[l] = 0;
+				continue;
+			}
+
+			const pica_fragment* f = &frags[base + l];
+			for (int c = 0; c < 4; c++)
+				src[c][l] = colors[base + l][c];
+			z[l] = f->depth;
+
+			if (fb->color && om->color_read) {
+				const u8* p = fb->color + 4 * offset[l];
+				dst[0][l] = p[3], dst[1][l] = p[2], dst[2][l] = p[1], dst[3][l] = p[0];
+			} else {
+				dst[0][l] = dst[1][l] = dst[2][l] = dst[3][l] = 0;
+			}
+			ds[l] = has_depth ? read_depth(fb, offset[l]) : 0;
+		}
+		live = lane < n;
+
+		if (om->alpha_test)
+			live &= compare(om->alpha_func, src[3], (lane ^ lane) + om->alpha_ref);
+		om_mask touched = live; // fragments that may update the depth/stencil buffer
+
+		om_vec stored_z = ds & 0xFFFFFF;
+		if (fb->depth_format == 0)
+			z &= 0xFFFF00;
+
+		if (om->stencil_test) {
+			om_vec s = ds >> 24;
+			om_vec ref = (s ^ s) + (om->stencil_ref & om->stencil_mask);
+			om_mask pass = compare(om->stencil_func, ref, s & om->stencil_mask);
+			om_mask zpass = depth_test ? compare(om->depth_func, z, stored_z) : pass;
+
+			om_vec fail_s = stencil_op(om->stencil_fail, s, om->stencil_ref);
+			om_vec zfail_s = stencil_op(om->stencil_zfail, s, om->stencil_ref);
+			om_vec zpass_s = stencil_op(om->stencil_zpass, s, om->stencil_ref);
+			om_vec new_s = select(pass, select(zpass, zpass_s, zfail_s), fail_s);
+
+			new_s = (s & ~om->stencil_write_mask) | (new_s & om->stencil_write_mask);
+			ds = (ds & 0xFFFFFF) | (new_s << 24);
+			live &= pass;
+		}
+
+		if (depth_test)
+			live &= compare(om->depth_func, z, stored_z);
+		if (om->depth_write)
+			ds = select(live, (ds & 0xFF000000) | z, ds);
+
+		if (has_color) {
+			om_vec out[4];
+			for (int c = 0; c < 4; c++) {
+				out[c] = blend ? blend_channel(om, c, src, dst) : logic_op(om->logic_op, src[c], dst[c]) & 0xFF;
+				out[c] = (out[c] & om->color_mask[c]) | (dst[c] & (u8)~om->color_mask[c]);
+			}
+
+			for (u32 l = 0; l < n; l++) {
+				if (!live[l])
+					continue;
+				u8* p = fb->color + 4 * offset[l];
+				p[0] = out[3][l], p[1] = out[2][l], p[2] = out[1][l], p[3] = out[0][l];
+			}
+		}
+
+		if (has_depth && (om->depth_write || om->stencil_test)) {
+			for (u32 l = 0; l < n; l++)
+				if (touched[l])
+					write_depth(fb, offset[l], ds[l]);
+		}
+	}
+}
+
+#define DEFINE_KERNEL(name, depth_test, blend) \
+	static void name(const pica_output_merger* om, const pica_framebuffer* fb, \
+		const pica_fragment* frags, const u8 (*colors)[4], u32 count) \
+	{ \
+		run_lanes(om, fb, frags, colors, count, depth_test, blend); \
+	}
+
+DEFINE_KERNEL(run_depth_blend, true, true)
+DEFINE_KERNEL(run_depth_logic, true, false)
+DEFINE_KERNEL(run_blend, false, true)
+DEFINE_KERNEL(run_logic, false, false)
+
+#undef DEFINE_KERNEL
+
+//
+// Setup
+//
+
+static bool color_unchanged(const pica_output_merger* om)
+{
+	if (!om->blend)
+		return om->logic_op == PICA_LOGIC_COPY;
+	for (int part = 0; part < 2; part++)
+		if (om->blend_eq[part] != PICA_BLEND_ADD || om->blend_src[part] != PICA_BLEND_ONE || om->blend_dst[part] != PICA_BLEND_ZERO)
+			return false;
+	return true;
+}
+
+void pica_output_merger_setup(pica_output_merger* om, const pica_framebuffer* fb)
+{
+	const u32* regs = pica.regs;
+	u32 alpha = regs[PICA_REG_FRAGOP_ALPHA_TEST];
+	u32 stencil = regs[PICA_REG_STENCIL_TEST];
+	u32 stencil_op = regs[PICA_REG_STENCIL_OP];
+	u32 depth = regs[PICA_REG_DEPTH_COLOR_MASK];
+	u32 blend = regs[PICA_REG_BLEND_FUNC];
+	bool color_write = regs[PICA_REG_COLORBUFFER_WRITE] & 0xF;
+	bool depth_read = regs[PICA_REG_DEPTHBUFFER_READ] & 0x3;
+	bool depth_write = regs[PICA_REG_DEPTHBUFFER_WRITE] & 0x3;
+
+	memset(om, 0, sizeof(*om));
+
+	om->alpha_func = (alpha >> 4) & 7;
+	om->alpha_ref = (alpha >> 8) & 0xFF;
+	om->alpha_test = (alpha & 1) && om->alpha_func != PICA_TEST_ALWAYS;
+
+	// The stencil is only stored by the D24S8 format, without reads the buffer contents are not seen
+	om->stencil_test = (stencil & 1) && fb->depth_format == 3 && depth_read;
+	om->stencil_func = (stencil >> 4) & 7;
+	om->stencil_write_mask = (stencil >> 8) & 0xFF;
+	om->stencil_ref = (stencil >> 16) & 0xFF;
+	om->stencil_mask = (stencil >> 24) & 0xFF;
+	om->stencil_fail = stencil_op & 7;
+	om->stencil_zfail = (stencil_op >> 4) & 7;
+	om->stencil_zpass = (stencil_op >> 8) & 7;
+
+	om->depth_func = (depth >> 4) & 7;
+	om->depth_test = (depth & 1) && depth_read && om->depth_func != PICA_TEST_ALWAYS;
+	om->depth_write = ((depth >> 12) & 1) && depth_write;
+
+	om->blend = (regs[PICA_REG_COLOR_OPERATION] >> 8) & 1;
+	om->blend_eq[0] = blend & 7;
+	om->blend_eq[1] = (blend >> 8) & 7;
+	om->blend_src[0] = (blend >> 16) & 0xF;
+	om->blend_dst[0] = (blend >> 20) & 0xF;
+	om->blend_src[1] = (blend >> 24) & 0xF;
+	om->blend_dst[1] = (blend >> 28) & 0xF;
+	for (int c = 0; c < 4; c++) {
+		om->blend_color[c] = regs[PICA_REG_BLEND_COLOR] >> (8 * c);
+		om->color_mask[c] = (color_write && ((depth >> (8 + c)) & 1)) ? 0xFF : 0;
+	}
+	om->logic_op = regs[PICA_REG_LOGIC_OP] & 0xF;
+	om->color_read = regs[PICA_REG_COLORBUFFER_READ] & 0xF;
+
+	// Pick the cheapest kernel that implements the configuration
+	bool full_mask = om->color_mask[0] & om->color_mask[1] & om->color_mask[2] & om->color_mask[3];
+	if (!om->alpha_test && !om->stencil_test && !om->depth_test && !(om->depth_write && fb->depth) &&
+		fb->color && full_mask && color_unchanged(om))
+		om->run = run_copy;
+	else if (om->depth_test)
+		om->run = om->blend ? run_depth_blend : run_depth_logic;
+	else
+		om->run = om->blend ? run_blend : run_logic;
+}
@@ -0,0 +1,84 @@
+/*
+ * Output merger: alpha test, stencil test, depth test, blending or logic op and the color write mask
+ * Fragments are processed PICA_OM_LANES at a time with one vector operation per step. The register
+ * state is decoded once per draw and common configurations get kernels that skip the unused steps.
+ */
+
+#pragma once
+#include <3ds/types.h>
+#include "framebuffer.h"
+
+#define PICA_OM_LANES 16
+
+// Compare functions of the alpha, stencil and depth tests
+enum {
+	PICA_TEST_NEVER, PICA_TEST_ALWAYS, PICA_TEST_EQUAL, PICA_TEST_NOTEQUAL,
+	PICA_TEST_LESS, PICA_TEST_LEQUAL, PICA_TEST_GREATER, PICA_TEST_GEQUAL,
+};
+
+enum {
+	PICA_STENCIL_KEEP, PICA_STENCIL_ZERO, PICA_STENCIL_REPLACE, PICA_STENCIL_INCR,
+	PICA_STENCIL_DECR, PICA_STENCIL_INVERT, PICA_STENCIL_INCR_WRAP, PICA_STENCIL_DECR_WRAP,
+};
+
+enum {
+	PICA_BLEND_ADD, PICA_BLEND_SUBTRACT, PICA_BLEND_REVERSE_SUBTRACT, PICA_BLEND_MIN, PICA_BLEND_MAX,
+};
+
+enum {
+	PICA_BLEND_ZERO, PICA_BLEND_ONE,
+	PICA_BLEND_SRC_COLOR, PICA_BLEND_ONE_MINUS_SRC_COLOR,
+	PICA_BLEND_DST_COLOR, PICA_BLEND_ONE_MINUS_DST_COLOR,
+	PICA_BLEND_SRC_ALPHA, PICA_BLEND_ONE_MINUS_SRC_ALPHA,
+	PICA_BLEND_DST_ALPHA, PICA_BLEND_ONE_MINUS_DST_ALPHA,
+	PICA_BLEND_CONSTANT_COLOR, PICA_BLEND_ONE_MINUS_CONSTANT_COLOR,
+	PICA_BLEND_CONSTANT_ALPHA, PICA_BLEND_ONE_MINUS_CONSTANT_ALPHA,
+	PICA_BLEND_SRC_ALPHA_SATURATE,
+};
+
+enum {
+	PICA_LOGIC_CLEAR, PICA_LOGIC_AND, PICA_LOGIC_AND_REVERSE, PICA_LOGIC_COPY,
+	PICA_LOGIC_SET, PICA_LOGIC_COPY_INVERTED, PICA_LOGIC_NOOP, PICA_LOGIC_INVERT,
+	PICA_LOGIC_NAND, PICA_LOGIC_OR, PICA_LOGIC_NOR, PICA_LOGIC_XOR,
+	PICA_LOGIC_EQUIV, PICA_LOGIC_AND_INVERTED, PICA_LOGIC_OR_REVERSE, PICA_LOGIC_OR_INVERTED,
+};
+
+typedef struct pica_output_merger pica_output_merger;
+
+// Colors are r, g, b, a bytes as they leave the texture combiners
+typedef void (*pica_om_func)(const pica_output_merger* om, const pica_framebuffer* fb,
+	const pica_fragment* frags, const u8 (*colors)[4], u32 count);
+
+struct pica_output_merger {
+	pica_om_func run;
+
+	bool alpha_test;
+	u32 alpha_func, alpha_ref;
+
+	bool stencil_test;
+	u32 stencil_func, stencil_ref, stencil_mask, stencil_write_mask;
+	u32 stencil_fail, stencil_zfail, stencil_zpass;
+
+	bool depth_test;  // false when the test cannot reject anything
+	bool depth_write;
+	u32 depth_func;
+
+	bool blend;       // blending when set, logic op otherwise
+	u32 blend_eq[2];  // [rgb, alpha]
+	u32 blend_src[2];
+	u32 blend_dst[2];
+	u8 blend_color[4];
+	u32 logic_op;
+
+	bool color_read;
+	u8 color_mask[4]; // 0xFF for the written channels
+};
+
+// Decodes the output merger registers of the current GPU state and picks the kernel
+void pica_output_merger_setup(pica_output_merger* om, const pica_framebuffer* fb);
+
+static inline void pica_output_merger_run(const pica_output_merger* om, const pica_framebuffer* fb,
+	const pica_fragment* frags, const u8 (*colors)[4], u32 count)
+{
+	om->run(om, fb, frags, colors, count);
+}
@@ -0,0 +1,185 @@
+#include <string.h>
+#include "pica.h"
+#include "float24.h"
+
+pica_state pica;
+
+// Mapping + 1 covering each 1 MiB page of the physical address space, 0 for none. Mappings sharing a page, or not
+// aligned to them, mark it with PAGE_SHARED and are looked up one by one.
+#define PAGE_SHIFT 20
+#define PAGE_SHARED 0xFF
+
+static u8 pages[1 << (32 - PAGE_SHIFT)];
+
+static void update_pages(void)
+{
+	memset(pages, 0, sizeof(pages));
+	for (u32 i = 0; i < pica.num_mappings; i++) {
+		const pica_mapping* m = &pica.mappings[i];
+		bool aligned = !(m->paddr & ((1 << PAGE_SHIFT) - 1)) && !(m->size & ((1 << PAGE_SHIFT) - 1));
+		u32 first = m->paddr >> PAGE_SHIFT;
+		u32 last = (m->paddr + m->size - 1) >> PAGE_SHIFT;
+		for (u32 page = first; page <= last; page++)
+			pages[page] = (aligned && !pages[page]) ? i + 1 : PAGE_SHARED;
+	}
+}
+
+void pica_reset(void)
+{
+	u32 num_mappings = pica.num_mappings;
+	pica_mapping mappings[PICA_MAX_MAPPINGS];
+	memcpy(mappings, pica.mappings, sizeof(mappings));
+
+	memset(&pica, 0, sizeof(pica));
+
+	// Memory mappings belong to the host, not to the GPU state
+	memcpy(pica.mappings, mappings, sizeof(mappings));
+	pica.num_mappings = num_mappings;
+}
+
+void pica_restore(const pica_state* state)
+{
+	u32 num_mappings = pica.num_mappings;
+	pica_mapping mappings[PICA_MAX_MAPPINGS];
+	memcpy(mappings, pica.mappings, sizeof(mappings));
+
+	pica = *state;
+
+	memcpy(pica.mappings, mappings, sizeof(mappings));
+	pica.num_mappings = num_mappings;
+}
+
+void pica_map(u32 paddr, void* ptr, u32 size)
+{
+	if (pica.num_mappings == PICA_MAX_MAPPINGS || !size)
+		return;
+
+	pica_mapping* m = &pica.mappings[pica.num_mappings++];
+	m->paddr = paddr;
+	m->size = size;
+	m->ptr = ptr;
+	update_pages();
+}
+
+void pica_unmap(u32 paddr)
+{
+	for (u32 i = 0; i < pica.num_mappings; i++) {
+		if (pica.mappings[i].paddr == paddr) {
+			pica.mappings[i] = pica.mappings[--pica.num_mappings];
+			update_pages();
+			return;
+		}
+	}
+}
+
+void* pica_phys_to_ptr(u32 paddr)
+{
+	u32 page = pages[paddr >> PAGE_SHIFT];
+	if (page == 0)
+		return NULL;
+	if (page != PAGE_SHARED) {
+		const pica_mapping* m = &pica.mappings[page - 1];
+		return m->ptr + (paddr - m->paddr);
+	}
+
+	for (u32 i = 0; i < pica.num_mappings; i++) {
+		const pica_mapping* m = &pica.mappings[i];
+		if (paddr >= m->paddr && paddr - m->paddr < m->size)
+			return m->ptr + (paddr - m->paddr);
+	}
+	return NULL;
+}
+
+// Collects the words of a float uniform upload, in w, z, y, x order
+static void write_float_uniform(u32 value)
+{
+	bool f32_mode = pica.regs[PICA_REG_VSH_FLOATUNIFORM_CONFIG] >> 31;
+	u32* w = pica.vs_uniform_words;
+
+	w[pica.vs_uniform_count++] = value;
+	if (pica.vs_uniform_count < (f32_mode ? 4u : 3u))
+		return;
+	pica.vs_uniform_count = 0;
+
+	if (pica.vs_uniform_index >= PICA_SHADER_NUM_FLOAT_UNIFORMS)
+		return;
+	float* f = pica.vs.f[pica.vs_uniform_index++];
+
+	if (f32_mode) {
+		f[0] = f24_round(f32_from_bits(w[3]));
+		f[1] = f24_round(f32_from_bits(w[2]));
+		f[2] = f24_round(f32_from_bits(w[1]));
+		f[3] = f24_round(f32_from_bits(w[0]));
+	} else {
+		f[3] = f24_to_f32(w[0] >> 8);
+		f[2] = f24_to_f32(((w[0] & 0xFF) << 16) | (w[1] >> 16));
+		f[1] = f24_to_f32(((w[1] & 0xFFFF) << 8) | (w[2] >> 24));
+		f[0] = f24_to_f32(w[2] & 0xFFFFFF);
+	}
+}
+
+void pica_write_reg(u32 id, u32 value, u32 mask)
+{
+	if (id >= PICA_NUM_REGS)
+		return;
+
+	u32 bytes = 0;
+	for (int i = 0; i < 4; i++)
+		if (mask & (1 << i))
+			bytes |= 0xFFu << (i * 8);
+	pica.regs[id] = (pica.regs[id] & ~bytes) | (value & bytes);
+	value = pica.regs[id];
+
+	switch (id) {
+	case PICA_REG_DRAWARRAYS:
+	case PICA_REG_DRAWELEMENTS:
+		pica_draw(id == PICA_REG_DRAWELEMENTS);
+		break;
+
+	case PICA_REG_VSH_FLOATUNIFORM_CONFIG:
+		pica.vs_uniform_index = value & 0xFF;
+		pica.vs_uniform_count = 0;
+		break;
+
+	case PICA_REG_VSH_FLOATUNIFORM_DATA ... PICA_REG_VSH_FLOATUNIFORM_DATA + 7:
+		write_float_uniform(value);
+		break;
+
+	case PICA_REG_VSH_CODETRANSFER_CONFIG:
+		pica.vs_code_offset = value & 0xFFF;
+		break;
+
+	case PICA_REG_VSH_CODETRANSFER_DATA ... PICA_REG_VSH_CODETRANSFER_DATA + 7:
+		if (pica.vs_code_offset < PICA_SHADER_CODE_SIZE)
+			pica.vs.code[pica.vs_code_offset++] = value;
+		break;
+
+	case PICA_REG_VSH_OPDESCS_CONFIG:
+		pica.vs_opdesc_offset = value & 0x7F;
+		break;
+
+	case PICA_REG_VSH_OPDESCS_DATA ... PICA_REG_VSH_OPDESCS_DATA + 7:
+		if (pica.vs_opdesc_offset < PICA_SHADER_OPDESC_SIZE)
+			pica.vs.opdesc[pica.vs_opdesc_offset++] = value;
+		break;
+	}
+}
+
+void pica_process_cmdlist(const u32* list, u32 size)
+{
+	u32 i = 0;
+	while (i + 1 < size) {
+		u32 header = list[i + 1];
+		u32 id = header & 0xFFFF;
+		u32 mask = (header >> 16) & 0xF;
+		u32 extra = (header >> 20) & 0x7FF;
+		bool consecutive = header >> 31;
+
+		pica_write_reg(id, list[i], mask);
+		for (u32 k = 1; k <= extra && i + 1 + k < size; k++)
+			pica_write_reg(consecutive ? id + k : id, list[i + 1 + k], mask);
+
+		// Commands are padded to a multiple of 8 bytes
+		i += 2 + extra + (extra & 1);
+	}
+}
@@ -0,0 +1,68 @@
+/*
+ * Host-side model of the PICA200 GPU
+ * Consumes the same command lists libctru builds on the device: register writes are stored in
+ * a flat register file and the writes with side effects (shader uploads, draws) are acted upon.
+ */
+
+#pragma once
+#include <3ds/types.h>
+#include "regs.h"
+#include "shader.h"
+
+#define PICA_MAX_MAPPINGS 16
+
+// A region of host memory visible to the GPU at a physical address
+typedef struct {
+	u32 paddr;
+	u32 size;
+	u8* ptr;
+} pica_mapping;
+
+typedef struct {
+	u32 regs[PICA_NUM_REGS];
+
+	// Vertex shader state, filled through the VSH upload registers
+	pica_shader_setup vs;
+	u32 vs_code_offset;
+	u32 vs_opdesc_offset;
+	u32 vs_uniform_index;
+	u32 vs_uniform_words[4];
+	u32 vs_uniform_count;
+
+	pica_mapping mappings[PICA_MAX_MAPPINGS];
+	u32 num_mappings;
+} pica_state;
+
+extern pica_state pica;
+
+void pica_reset(void);
+
+// Returns to a copy of the state taken earlier, the memory mappings stay as they are
+void pica_restore(const pica_state* state);
+
+// Makes host memory addressable by the GPU, addresses of mappings aligned to 1 MiB resolve with a single lookup
+void pica_map(u32 paddr, void* ptr, u32 size);
+void pica_unmap(u32 paddr);
+void* pica_phys_to_ptr(u32 paddr);
+
+// Writes a register, mask selects the bytes to update like the command list parameter mask does
+void pica_write_reg(u32 id, u32 value, u32 mask);
+
+// Executes a command list, size in words
+void pica_process_cmdlist(const u32* list, u32 size);
+
+// Implemented in vertex.c: runs the vertex pipeline for the current draw registers
+void pica_draw(bool indexed);
+
+// Post-transform vertex cache: indexed draws shade a vertex index again only once it left the cache, a FIFO
+// emptied at the start of every draw. With deduplication, non-indexed draws look vertices up by their inputs,
+// for batches of test draws where many vertices are the same. PICA_VERTEX_DEDUP=1 enables it as well.
+#define PICA_VERTEX_CACHE_SIZE 32
+
+typedef struct {
+	u64 hits;
+	u64 misses;
+} pica_vertex_cache_stats;
+
+void pica_vertex_cache_get_stats(pica_vertex_cache_stats* stats);
+void pica_vertex_cache_set_dedup(bool enable);
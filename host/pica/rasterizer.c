@@ -0,0 +1,201 @@
+#include <math.h>
+#include "pica.h"
+#include "float24.h"
+#include "framebuffer.h"
+#include "output_merger.h"
+#include "rasterizer.h"
+#include "tev.h"
+
+// Screen positions use 4 bits of subpixel precision
+#define SUBPIXEL 16
+
+// Clipping against w > 0 keeps the perspective divide finite
+#define CLIP_EPSILON 1e-5f
+
+static const pica_tev_kernel* kernel;
+static pica_framebuffer fb;
+static pica_output_merger om;
+
+static pica_fragment frags[PICA_FRAGMENT_BATCH];
+static u8 primary[PICA_FRAGMENT_BATCH][4];
+static u8 combined[PICA_FRAGMENT_BATCH][4];
+static u32 num_frags;
+
+void pica_rasterizer_begin(void)
+{
+	pica_tev_config config;
+	pica_tev_read_config(&config);
+	kernel = pica_tev_get_kernel(&config);
+	pica_framebuffer_get(&fb);
+	pica_output_merger_setup(&om, &fb);
+	num_frags = 0;
+}
+
+static void flush(void)
+{
+	if (!num_frags)
+		return;
+	pica_tev_run(kernel, (const u8 (*)[4])primary, combined, num_frags);
+	pica_output_merger_run(&om, &fb, frags, (const u8 (*)[4])combined, num_frags);
+	num_frags = 0;
+}
+
+void pica_rasterizer_end(void)
+{
+	flush();
+}
+
+typedef struct {
+	s32 x, y;     // subpixel screen position
+	float z;      // depth after the depth map
+	float inv_w;
+	float color[4];
+} setup_vertex;
+
+static void viewport_transform(setup_vertex* out, const pica_output_vertex* v)
+{
+	const u32* regs = pica.regs;
+	float half_w = f24_to_f32(regs[PICA_REG_VIEWPORT_WIDTH] & 0xFFFFFF);
+	float half_h = f24_to_f32(regs[PICA_REG_VIEWPORT_HEIGHT] & 0xFFFFFF);
+	float z_scale = f24_to_f32(regs[PICA_REG_DEPTHMAP_SCALE] & 0xFFFFFF);
+	float z_offset = f24_to_f32(regs[PICA_REG_DEPTHMAP_OFFSET] & 0xFFFFFF);
+	s32 offset_x = (s16)(regs[PICA_REG_VIEWPORT_XY] & 0xFFFF);
+	s32 offset_y = (s16)(regs[PICA_REG_VIEWPORT_XY] >> 16);
+
+	float inv_w = 1.0f / v->pos[3];
+	float x = (v->pos[0] * inv_w + 1.0f) * half_w + offset_x;
+	float y = (v->pos[1] * inv_w + 1.0f) * half_h + offset_y;
+
+	out->x = (s32)lrintf(x * SUBPIXEL);
+	out->y = (s32)lrintf(y * SUBPIXEL);
+	out->z = v->pos[2] * inv_w * z_scale + z_offset;
+	out->inv_w = inv_w;
+
+	// The hardware saturates the absolute value of vertex colors before interpolation
+	for (int i = 0; i < 4; i++)
+		out->color[i] = fminf(fabsf(v->color[i]), 1.0f);
+}
+
+static s64 edge(const setup_vertex* a, const setup_vertex* b, s32 px, s32 py)
+{
+	return (s64)(b->x - a->x) * (py - a->y) - (s64)(b->y - a->y) * (px - a->x);
+}
+
+// Top-left fill rule for counter-clockwise triangles with y growing upwards
+static s32 edge_bias(const setup_vertex* a, const setup_vertex* b)
+{
+	bool left = b->y < a->y;
+	bool top = b->y == a->y && b->x < a->x;
+	return (left || top) ? 0 : -1;
+}
+
+static void rasterize(const setup_vertex* v0, const setup_vertex* v1, const setup_vertex* v2)
+{
+	const u32* regs = pica.regs;
+	s64 area = edge(v0, v1, v2->x, v2->y);
+	u32 cull = regs[PICA_REG_CULL_MODE] & 3;
+
+	if (area == 0)
+		return;
+
+	// Cull mode 1 keeps clockwise triangles, 2 keeps counter-clockwise ones
+	if ((cull == 1 && area > 0) || (cull == 2 && area < 0))
+		return;
+	if (area < 0) {
+		const setup_vertex* tmp = v1;
+		v1 = v2;
+		v2 = tmp;
+		area = -area;
+	}
+
+	s32 min_x = v0->x, max_x = v0->x, min_y = v0->y, max_y = v0->y;
+	if (v1->x < min_x) min_x = v1->x;
+	if (v2->x < min_x) min_x = v2->x;
+	if (v1->x > max_x) max_x = v1->x;
+	if (v2->x > max_x) max_x = v2->x;
+	if (v1->y < min_y) min_y = v1->y;
+	if (v2->y < min_y) min_y = v2->y;
+	if (v1->y > max_y) max_y = v1->y;
+	if (v2->y > max_y) max_y = v2->y;
+
+	// Pixel range, clamped to the framebuffer and the scissor rectangle
+	s32 x0 = min_x / SUBPIXEL, x1 = max_x / SUBPIXEL;
+	s32 y0 = min_y / SUBPIXEL, y1 = max_y / SUBPIXEL;
+	if (x0 < 0) x0 = 0;
+	if (y0 < 0) y0 = 0;
+	if (x1 > (s32)fb.width - 1) x1 = fb.width - 1;
+	if (y1 > (s32)fb.height - 1) y1 = fb.height - 1;
+
+	if ((regs[PICA_REG_SCISSOR_MODE] & 3) == 3) {
+		s32 sx0 = regs[PICA_REG_SCISSOR_POS] & 0x3FF, sy0 = (regs[PICA_REG_SCISSOR_POS] >> 16) & 0x3FF;
+		s32 sx1 = regs[PICA_REG_SCISSOR_DIM] & 0x3FF, sy1 = (regs[PICA_REG_SCISSOR_DIM] >> 16) & 0x3FF;
+		if (x0 < sx0) x0 = sx0;
+		if (y0 < sy0) y0 = sy0;
+		if (x1 > sx1) x1 = sx1;
+		if (y1 > sy1) y1 = sy1;
+	}
+
+	s32 bias0 = edge_bias(v1, v2), bias1 = edge_bias(v2, v0), bias2 = edge_bias(v0, v1);
+
+	for (s32 y = y0; y <= y1; y++) {
+		for (s32 x = x0; x <= x1; x++) {
+			s32 px = x * SUBPIXEL + SUBPIXEL / 2, py = y * SUBPIXEL + SUBPIXEL / 2;
+			s64 w0 = edge(v1, v2, px, py), w1 = edge(v2, v0, px, py), w2 = edge(v0, v1, px, py);
+			if (w0 + bias0 < 0 || w1 + bias1 < 0 || w2 + bias2 < 0)
+				continue;
+
+			// Barycentric weights, perspective corrected for the attributes
+			float l0 = (float)w0 / area, l1 = (float)w1 / area, l2 = (float)w2 / area;
+			float p0 = l0 * v0->inv_w, p1 = l1 * v1->inv_w, p2 = l2 * v2->inv_w;
+			float norm = 1.0f / (p0 + p1 + p2);
+
+			pica_fragment* f = &frags[num_frags];
+			float z = l0 * v0->z + l1 * v1->z + l2 * v2->z;
+			f->x = x;
+			f->y = y;
+			f->depth = (u32)(fminf(fmaxf(z, 0.0f), 1.0f) * 0xFFFFFF);
+
+			for (int i = 0; i < 4; i++) {
+				float c = (p0 * v0->color[i] + p1 * v1->color[i] + p2 * v2->color[i]) * norm;
+				primary[num_frags][i] = (u8)(fminf(fmaxf(c, 0.0f), 1.0f) * 255);
+			}
+
+			if (++num_frags == PICA_FRAGMENT_BATCH)
+				flush();
+		}
+	}
+}
+
+static void lerp_vertex(pica_output_vertex* out, const pica_output_vertex* a, const pica_output_vertex* b, float t)
+{
+	const float* fa = (const float*)a;
+	const float* fb_ = (const float*)b;
+	float* fo = (float*)out;
+	for (u32 i = 0; i < sizeof(*out) / sizeof(float); i++)
+		fo[i] = fa[i] + (fb_[i] - fa[i]) * t;
+}
+
+void pica_rasterize_triangle(const pica_output_vertex* v0, const pica_output_vertex* v1, const pica_output_vertex* v2)
+{
+	const pica_output_vertex* in[3] = { v0, v1, v2 };
+	pica_output_vertex clipped[4];
+	setup_vertex s[4];
+	int n = 0;
+
+	// Sutherland-Hodgman against the w = epsilon plane, yields at most four vertices
+	for (int i = 0; i < 3; i++) {
+		const pica_output_vertex* a = in[i];
+		const pica_output_vertex* b = in[(i + 1) % 3];
+		bool a_in = a->pos[3] > CLIP_EPSILON, b_in = b->pos[3] > CLIP_EPSILON;
+
+		if (a_in)
+			clipped[n++] = *a;
+		if (a_in != b_in)
+			lerp_vertex(&clipped[n++], a, b, (CLIP_EPSILON - a->pos[3]) / (b->pos[3] - a->pos[3]));
+	}
+
+	for (int i = 0; i < n; i++)
+		viewport_transform(&s[i], &clipped[i]);
+	for (int i = 2; i < n; i++)
+		rasterize(&s[0], &s[i - 1], &s[i]);
+}
@@ -0,0 +1,33 @@
+/*
+ * Triangle setup and rasterization
+ * Fragments are collected in batches and handed to the texture combiners and the framebuffer
+ * a batch at a time.
+ */
+
+#pragma once
+#include <3ds/types.h>
+
+#define PICA_FRAGMENT_BATCH 256
+
+// Shader outputs after semantic mapping, in the order of the PICA output attribute semantics
+typedef struct {
+	float pos[4];
+	float quat[4];
+	float color[4];
+	float tc0[2];
+	float tc1[2];
+	float tc0_w;
+	float pad0;
+	float view[3];
+	float pad1;
+	float tc2[2];
+} pica_output_vertex;
+
+// Looks up the combiner kernel and framebuffer for a draw, must be called before rasterizing
+void pica_rasterizer_begin(void);
+
+// Clips, culls and rasterizes a triangle given in clip coordinates
+void pica_rasterize_triangle(const pica_output_vertex* v0, const pica_output_vertex* v1, const pica_output_vertex* v2);
+
+// Processes the fragments that are still pending
+void pica_rasterizer_end(void);
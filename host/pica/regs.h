@@ -0,0 +1,95 @@
+/*
+ * PICA200 register indices
+ * Only the registers the host model interprets are named here, the others are just stored
+ */
+
+#pragma once
+
+#define PICA_NUM_REGS 0x300
+
+// Command list control
+#define PICA_REG_FINALIZE              0x010
+
+// Rasterizer
+#define PICA_REG_CULL_MODE             0x040
+#define PICA_REG_VIEWPORT_WIDTH        0x041 // float24, half of the viewport width
+#define PICA_REG_VIEWPORT_INVW         0x042
+#define PICA_REG_VIEWPORT_HEIGHT       0x043 // float24, half of the viewport height
+#define PICA_REG_VIEWPORT_INVH         0x044
+#define PICA_REG_DEPTHMAP_SCALE        0x04D // float24
+#define PICA_REG_DEPTHMAP_OFFSET       0x04E // float24
+#define PICA_REG_SH_OUTMAP_TOTAL       0x04F
+#define PICA_REG_SH_OUTMAP_O0          0x050 // up to O6 at 0x056
+#define PICA_REG_SCISSOR_MODE          0x065
+#define PICA_REG_SCISSOR_POS           0x066
+#define PICA_REG_SCISSOR_DIM           0x067
+#define PICA_REG_VIEWPORT_XY           0x068
+
+// Texture combiners, stages 0-3 are 8 registers apart, stages 4-5 live after the buffer config
+#define PICA_REG_TEXENV0_SOURCE        0x0C0
+#define PICA_REG_TEXENV1_SOURCE        0x0C8
+#define PICA_REG_TEXENV2_SOURCE        0x0D0
+#define PICA_REG_TEXENV3_SOURCE        0x0D8
+#define PICA_REG_TEXENV_UPDATE_BUFFER  0x0E0
+#define PICA_REG_TEXENV4_SOURCE        0x0F0
+#define PICA_REG_TEXENV5_SOURCE        0x0F8
+#define PICA_REG_TEXENV_BUFFER_COLOR   0x0FD
+
+// Offsets of the registers of a single combiner stage, relative to PICA_REG_TEXENVn_SOURCE
+#define PICA_TEXENV_SOURCE             0
+#define PICA_TEXENV_OPERAND            1
+#define PICA_TEXENV_COMBINER           2
+#define PICA_TEXENV_COLOR              3
+#define PICA_TEXENV_SCALE              4
+
+// Output merger
+#define PICA_REG_COLOR_OPERATION       0x100
+#define PICA_REG_BLEND_FUNC            0x101
+#define PICA_REG_LOGIC_OP              0x102
+#define PICA_REG_BLEND_COLOR           0x103
+#define PICA_REG_FRAGOP_ALPHA_TEST     0x104
+#define PICA_REG_STENCIL_TEST          0x105
+#define PICA_REG_STENCIL_OP            0x106
+#define PICA_REG_DEPTH_COLOR_MASK      0x107
+
+// Framebuffer
+#define PICA_REG_FRAMEBUFFER_INVALIDATE 0x110
+#define PICA_REG_FRAMEBUFFER_FLUSH     0x111
+#define PICA_REG_COLORBUFFER_READ      0x112
+#define PICA_REG_COLORBUFFER_WRITE     0x113
+#define PICA_REG_DEPTHBUFFER_READ      0x114
+#define PICA_REG_DEPTHBUFFER_WRITE     0x115
+#define PICA_REG_DEPTHBUFFER_FORMAT    0x116
+#define PICA_REG_COLORBUFFER_FORMAT    0x117
+#define PICA_REG_DEPTHBUFFER_LOC       0x11C
+#define PICA_REG_COLORBUFFER_LOC       0x11D
+#define PICA_REG_FRAMEBUFFER_DIM       0x11E
+
+// Vertex loader, each of the 12 loader buffers uses three registers
+#define PICA_REG_ATTRIBBUFFERS_LOC     0x200
+#define PICA_REG_ATTRIBBUFFERS_FORMAT_LOW  0x201
+#define PICA_REG_ATTRIBBUFFERS_FORMAT_HIGH 0x202
+#define PICA_REG_ATTRIBBUFFER0_OFFSET  0x203
+#define PICA_REG_INDEXBUFFER_CONFIG    0x227
+#define PICA_REG_NUMVERTICES           0x228
+#define PICA_REG_VERTEX_OFFSET         0x22A
+#define PICA_REG_DRAWARRAYS            0x22E
+#define PICA_REG_DRAWELEMENTS          0x22F
+#define PICA_REG_PRIMITIVE_CONFIG      0x25E
+#define PICA_REG_RESTART_PRIMITIVE     0x25F
+
+// Vertex shader
+#define PICA_REG_VSH_BOOLUNIFORM       0x2B0
+#define PICA_REG_VSH_INTUNIFORM_I0     0x2B1
+#define PICA_REG_VSH_INPUTBUFFER_CONFIG 0x2B9
+#define PICA_REG_VSH_ENTRYPOINT        0x2BA
+#define PICA_REG_VSH_ATTRIBUTES_PERMUTATION_LOW  0x2BB
+#define PICA_REG_VSH_ATTRIBUTES_PERMUTATION_HIGH 0x2BC
+#define PICA_REG_VSH_OUTMAP_MASK       0x2BD
+#define PICA_REG_VSH_CODETRANSFER_END  0x2BF
+#define PICA_REG_VSH_FLOATUNIFORM_CONFIG 0x2C0
+#define PICA_REG_VSH_FLOATUNIFORM_DATA 0x2C1 // up to 0x2C8
+#define PICA_REG_VSH_CODETRANSFER_CONFIG 0x2CB
+#define PICA_REG_VSH_CODETRANSFER_DATA 0x2CC // up to 0x2D3
+#define PICA_REG_VSH_OPDESCS_CONFIG    0x2D5
+#define PICA_REG_VSH_OPDESCS_DATA      0x2D6 // up to 0x2DD
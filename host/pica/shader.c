@@ -0,0 +1,386 @@
+#include <math.h>
+#include "shader.h"
+
+void pica_shader_decode(u32 word, const u32* opdesc, pica_instr* instr)
+{
+	u32 op = word >> 26;
+
+	if (op >= PICA_OP_MAD)
+		op = PICA_OP_MAD;
+	else if (op >= PICA_OP_MADI)
+		op = PICA_OP_MADI;
+	else if (op == PICA_OP_CMP + 1)
+		op = PICA_OP_CMP;
+
+	instr->op = op;
+
+	if (op == PICA_OP_MAD || op == PICA_OP_MADI) {
+		instr->desc = opdesc[word & 0x1F];
+		instr->src[0] = (word >> 17) & 0x1F;
+		if (op == PICA_OP_MAD) {
+			instr->src[1] = (word >> 10) & 0x7F;
+			instr->src[2] = (word >> 5) & 0x1F;
+			instr->rel = 1;
+		} else {
+			instr->src[1] = (word >> 12) & 0x1F;
+			instr->src[2] = (word >> 5) & 0x7F;
+			instr->rel = 2;
+		}
+		instr->addr = (word >> 22) & 3;
+		instr->dest = (word >> 24) & 0x1F;
+		return;
+	}
+
+	// Common format, also used by CMP which stores its operators in the destination field
+	instr->desc = opdesc[word & 0x7F];
+	if (pica_op_is_inverted(op)) {
+		instr->src[0] = (word >> 14) & 0x1F;
+		instr->src[1] = (word >> 7) & 0x7F;
+		instr->rel = 1;
+	} else {
+		instr->src[0] = (word >> 12) & 0x7F;
+		instr->src[1] = (word >> 7) & 0x1F;
+		instr->rel = 0;
+	}
+	instr->src[2] = 0;
+	instr->addr = (word >> 19) & 3;
+	instr->dest = (word >> 21) & 0x1F;
+	instr->cmp[0] = (word >> 24) & 7;
+	instr->cmp[1] = (word >> 21) & 7;
+
+	// Flow control format
+	instr->num = word & 0xFF;
+	instr->offset = (word >> 10) & 0xFFF;
+	instr->cond = (word >> 22) & 3;
+	instr->refy = (word >> 24) & 1;
+	instr->refx = (word >> 25) & 1;
+	instr->uniform = (word >> 22) & 0xF;
+}
+
+typedef struct {
+	u32 final;
+	u32 ret;
+	u32 loop;
+	u32 repeat;
+	s32 increment;
+	bool is_loop;
+} stack_entry;
+
+static const float ones[4] = { 1.0f, 1.0f, 1.0f, 1.0f };
+
+static const float* lookup_source(const pica_shader_unit* unit, const pica_shader_setup* setup, u32 index, s32 offset)
+{
+	if (index < 0x10)
+		return unit->input[index];
+	if (index < 0x20)
+		return unit->temp[index - 0x10];
+
+	// Relative addressing only applies to float uniforms, out of range reads return ones
+	s32 uniform = (s32)index - 0x20 + offset;
+	if (uniform < 0 || uniform >= PICA_SHADER_NUM_FLOAT_UNIFORMS)
+		return ones;
+	return setup->f[uniform];
+}
+
+static void load_source(float* out, const pica_shader_unit* unit, const pica_shader_setup* setup, const pica_instr* instr, int src)
+{
+	s32 offset = 0;
+	if (instr->addr && instr->rel == (u32)src)
+		offset = unit->addr[instr->addr - 1];
+
+	const float* reg = lookup_source(unit, setup, instr->src[src], offset);
+	u32 selector = pica_src_selector(instr->desc, src);
+	bool negate = pica_src_negated(instr->desc, src);
+
+	for (int i = 0; i < 4; i++) {
+		float value = reg[pica_swizzle(selector, i)];
+		out[i] = negate ? -value : value;
+	}
+}
+
+static void store_dest(pica_shader_unit* unit, const pica_instr* instr, const float* value)
+{
+	float* reg = (instr->dest < 0x10) ? unit->output[instr->dest] : unit->temp[instr->dest - 0x10];
+	for (int i = 0; i < 4; i++)
+		if (pica_dest_enabled(instr->desc, i))
+			reg[i] = value[i];
+}
+
+static bool compare(u32 op, float a, float b)
+{
+	switch (op) {
+	case PICA_CMP_EQ: return a == b;
+	case PICA_CMP_NE: return a != b;
+	case PICA_CMP_LT: return a < b;
+	case PICA_CMP_LE: return a <= b;
+	case PICA_CMP_GT: return a > b;
+	case PICA_CMP_GE: return a >= b;
+	}
+	return false; // operators 6 and 7 are unknown
+}
+
+static bool evaluate_condition(const pica_shader_unit* unit, const pica_instr* instr)
+{
+	bool x = unit->cmp[0] == instr->refx;
+	bool y = unit->cmp[1] == instr->refy;
+
+	switch (instr->cond) {
+	case PICA_COND_OR:  return x || y;
+	case PICA_COND_AND: return x && y;
+	case PICA_COND_X:   return x;
+	default:            return y;
+	}
+}
+
+// Executes one arithmetic instruction
+static void execute_alu(pica_shader_unit* unit, const pica_shader_setup* setup, const pica_instr* instr)
+{
+	float src1[4], src2[4], src3[4], dest[4];
+	int i;
+
+	load_source(src1, unit, setup, instr, 0);
+	if (instr->op != PICA_OP_MOV && instr->op != PICA_OP_MOVA)
+		load_source(src2, unit, setup, instr, 1);
+
+	switch (instr->op) {
+	case PICA_OP_ADD:
+		for (i = 0; i < 4; i++)
+			dest[i] = src1[i] + src2[i];
+		break;
+
+	case PICA_OP_MUL:
+		for (i = 0; i < 4; i++)
+			dest[i] = pica_mul(src1[i], src2[i]);
+		break;
+
+	case PICA_OP_DP3:
+	case PICA_OP_DP4:
+	case PICA_OP_DPH:
+	case PICA_OP_DPHI: {
+		if (instr->op == PICA_OP_DPH || instr->op == PICA_OP_DPHI)
+			src1[3] = 1.0f;
+		int count = (instr->op == PICA_OP_DP3) ? 3 : 4;
+		float dot = 0.0f;
+		for (i = 0; i < count; i++)
+			dot += pica_mul(src1[i], src2[i]);
+		for (i = 0; i < 4; i++)
+			dest[i] = dot;
+		break;
+	}
+
+	case PICA_OP_DST:
+	case PICA_OP_DSTI:
+		dest[0] = 1.0f;
+		dest[1] = pica_mul(src1[1], src2[1]);
+		dest[2] = src1[2];
+		dest[3] = src2[3];
+		break;
+
+	// The scalar instructions only use the first component and replicate the result
+	case PICA_OP_EX2:
+	case PICA_OP_LG2:
+	case PICA_OP_RCP:
+	case PICA_OP_RSQ: {
+		float result;
+		if (instr->op == PICA_OP_EX2)
+			result = exp2f(src1[0]);
+		else if (instr->op == PICA_OP_LG2)
+			result = log2f(src1[0]);
+		else if (instr->op == PICA_OP_RCP)
+			result = 1.0f / src1[0];
+		else
+			result = 1.0f / sqrtf(src1[0]);
+		for (i = 0; i < 4; i++)
+			dest[i] = result;
+		break;
+	}
+
+	case PICA_OP_LITP:
+		dest[0] = fmaxf(src1[0], 0.0f);
+		dest[1] = fminf(fmaxf(src1[1], -127.9961f), 127.9961f);
+		dest[2] = src1[2];
+		dest[3] = fmaxf(src1[3], 0.0f);
+		unit->cmp[0] = src1[0] >= 0.0f;
+		unit->cmp[1] = src1[3] >= 0.0f;
+		break;
+
+	case PICA_OP_SGE:
+	case PICA_OP_SGEI:
+		for (i = 0; i < 4; i++)
+			dest[i] = (src1[i] >= src2[i]) ? 1.0f : 0.0f;
+		break;
+
+	case PICA_OP_SLT:
+	case PICA_OP_SLTI:
+		for (i = 0; i < 4; i++)
+			dest[i] = (src1[i] < src2[i]) ? 1.0f : 0.0f;
+		break;
+
+	case PICA_OP_FLR:
+		for (i = 0; i < 4; i++)
+			dest[i] = floorf(src1[i]);
+		break;
+
+	// Written so that a NaN in the second operand wins, matching the hardware
+	case PICA_OP_MAX:
+		for (i = 0; i < 4; i++)
+			dest[i] = (src1[i] > src2[i]) ? src1[i] : src2[i];
+		break;
+
+	case PICA_OP_MIN:
+		for (i = 0; i < 4; i++)
+			dest[i] = (src1[i] < src2[i]) ? src1[i] : src2[i];
+		break;
+
+	case PICA_OP_MOV:
+		for (i = 0; i < 4; i++)
+			dest[i] = src1[i];
+		break;
+
+	case PICA_OP_MOVA:
+		// Rounds towards zero
+		for (i = 0; i < 2; i++)
+			if (pica_dest_enabled(instr->desc, i))
+				unit->addr[i] = pica_mova(src1[i]);
+		return;
+
+	case PICA_OP_CMP:
+		for (i = 0; i < 2; i++)
+			unit->cmp[i] = compare(instr->cmp[i], src1[i], src2[i]);
+		return;
+
+	case PICA_OP_MAD:
+	case PICA_OP_MADI:
+		load_source(src3, unit, setup, instr, 2);
+		for (i = 0; i < 4; i++)
+			dest[i] = pica_mul(src1[i], src2[i]) + src3[i];
+		break;
+
+	default:
+		return;
+	}
+
+	store_dest(unit, instr, dest);
+}
+
+bool pica_shader_run(pica_shader_unit* unit, const pica_shader_setup* setup)
+{
+	stack_entry stack[PICA_SHADER_STACK_DEPTH];
+	int depth = 0;
+	u32 pc = setup->entry;
+	pica_instr instr;
+
+	#define PUSH(offset_, num_, ret_, repeat_, increment_, is_loop_) \
+		do { \
+			if (depth < PICA_SHADER_STACK_DEPTH) { \
+				stack_entry* e = &stack[depth++]; \
+				e->loop = (offset_); \
+				e->final = (offset_) + (num_); \
+				e->ret = (ret_); \
+				e->repeat = (repeat_); \
+				e->increment = (increment_); \
+				e->is_loop = (is_loop_); \
+			} \
+			pc = (offset_); \
+		} while (0)
+
+	u32 budget = unit->budget ? unit->budget : PICA_SHADER_MAX_STEPS;
+
+	for (unit->steps = 0; unit->steps < budget; ) {
+		// Returning from calls, conditional blocks and loop iterations
+		if (depth && pc == stack[depth - 1].final) {
+			stack_entry* top = &stack[depth - 1];
+			unit->addr[2] += top->increment;
+			if (top->repeat-- == 0) {
+				pc = top->ret;
+				depth--;
+			} else {
+				pc = top->loop;
+			}
+			continue;
+		}
+
+		if (pc >= PICA_SHADER_CODE_SIZE)
+			return true; // ran off the end of the program memory, treat like END
+
+		pica_shader_decode(setup->code[pc], setup->opdesc, &instr);
+		if (unit->trace && unit->steps < unit->trace_capacity)
+			unit->trace[unit->steps] = pc;
+		unit->steps++;
+
+		switch (instr.op) {
+		case PICA_OP_END:
+			return true;
+
+		case PICA_OP_NOP:
+		case PICA_OP_EMIT:
+		case PICA_OP_SETEMIT:
+			pc++;
+			break;
+
+		case PICA_OP_BREAKC:
+			if (!evaluate_condition(unit, &instr)) {
+				pc++;
+				break;
+			}
+			// fallthrough
+		case PICA_OP_BREAK:
+			while (depth && !stack[depth - 1].is_loop)
+				depth--;
+			if (depth)
+				pc = stack[--depth].ret;
+			else
+				pc++;
+			break;
+
+		case PICA_OP_CALL:
+			PUSH(instr.offset, instr.num, pc + 1, 0, 0, false);
+			break;
+
+		case PICA_OP_CALLC:
+		case PICA_OP_CALLU: {
+			bool cond = (instr.op == PICA_OP_CALLC) ? evaluate_condition(unit, &instr) : (setup->b >> instr.uniform) & 1;
+			if (cond)
+				PUSH(instr.offset, instr.num, pc + 1, 0, 0, false);
+			else
+				pc++;
+			break;
+		}
+
+		case PICA_OP_IFU:
+		case PICA_OP_IFC: {
+			bool cond = (instr.op == PICA_OP_IFC) ? evaluate_condition(unit, &instr) : (setup->b >> instr.uniform) & 1;
+			if (cond)
+				PUSH(pc + 1, instr.offset - pc - 1, instr.offset + instr.num, 0, 0, false);
+			else
+				PUSH(instr.offset, instr.num, instr.offset + instr.num, 0, 0, false);
+			break;
+		}
+
+		case PICA_OP_LOOP: {
+			const u8* i = setup->i[instr.uniform & 3];
+			unit->addr[2] = i[1];
+			PUSH(pc + 1, instr.offset - pc, instr.offset + 1, i[0], (s8)i[2], true);
+			break;
+		}
+
+		case PICA_OP_JMPC:
+			pc = evaluate_condition(unit, &instr) ? instr.offset : pc + 1;
+			break;
+
+		case PICA_OP_JMPU:
+			// The lowest bit of num inverts the condition
+			pc = (((setup->b >> instr.uniform) & 1) != (instr.num & 1)) ? instr.offset : pc + 1;
+			break;
+
+		default:
+			execute_alu(unit, setup, &instr);
+			pc++;
+			break;
+		}
+	}
+
+	#undef PUSH
+
+	return false;
+}
@@ -0,0 +1,157 @@
+/*
+ * PICA200 vertex shader unit
+ * Decodes and interprets the same binary code and operand descriptors the suites upload with shaderProgramUse()
+ */
+
+#pragma once
+#include <3ds/types.h>
+
+#define PICA_SHADER_CODE_SIZE     512
+#define PICA_SHADER_OPDESC_SIZE   128
+#define PICA_SHADER_NUM_FLOAT_UNIFORMS 96
+#define PICA_SHADER_MAX_STEPS     0x10000 // instruction budget of a single run, catches runaway loops
+#define PICA_SHADER_STACK_DEPTH   16
+
+enum {
+	PICA_OP_ADD     = 0x00,
+	PICA_OP_DP3     = 0x01,
+	PICA_OP_DP4     = 0x02,
+	PICA_OP_DPH     = 0x03,
+	PICA_OP_DST     = 0x04,
+	PICA_OP_EX2     = 0x05,
+	PICA_OP_LG2     = 0x06,
+	PICA_OP_LITP    = 0x07,
+	PICA_OP_MUL     = 0x08,
+	PICA_OP_SGE     = 0x09,
+	PICA_OP_SLT     = 0x0A,
+	PICA_OP_FLR     = 0x0B,
+	PICA_OP_MAX     = 0x0C,
+	PICA_OP_MIN     = 0x0D,
+	PICA_OP_RCP     = 0x0E,
+	PICA_OP_RSQ     = 0x0F,
+	PICA_OP_MOVA    = 0x12,
+	PICA_OP_MOV     = 0x13,
+	PICA_OP_DPHI    = 0x18,
+	PICA_OP_DSTI    = 0x19,
+	PICA_OP_SGEI    = 0x1A,
+	PICA_OP_SLTI    = 0x1B,
+	PICA_OP_BREAK   = 0x20,
+	PICA_OP_NOP     = 0x21,
+	PICA_OP_END     = 0x22,
+	PICA_OP_BREAKC  = 0x23,
+	PICA_OP_CALL    = 0x24,
+	PICA_OP_CALLC   = 0x25,
+	PICA_OP_CALLU   = 0x26,
+	PICA_OP_IFU     = 0x27,
+	PICA_OP_IFC     = 0x28,
+	PICA_OP_LOOP    = 0x29,
+	PICA_OP_EMIT    = 0x2A,
+	PICA_OP_SETEMIT = 0x2B,
+	PICA_OP_JMPC    = 0x2C,
+	PICA_OP_JMPU    = 0x2D,
+	PICA_OP_CMP     = 0x2E, // 0x2E-0x2F
+	PICA_OP_MADI    = 0x30, // 0x30-0x37
+	PICA_OP_MAD     = 0x38, // 0x38-0x3F
+};
+
+// Comparison operators of CMP
+enum { PICA_CMP_EQ, PICA_CMP_NE, PICA_CMP_LT, PICA_CMP_LE, PICA_CMP_GT, PICA_CMP_GE };
+
+// Condition combination of the flow control instructions
+enum { PICA_COND_OR, PICA_COND_AND, PICA_COND_X, PICA_COND_Y };
+
+// One decoded instruction, with the operand descriptor already looked up
+typedef struct {
+	u32 op;      // PICA_OP_*, the CMP/MADI/MAD ranges are folded to their first opcode
+	u32 dest;    // 0x00-0x0F outputs, 0x10-0x1F temporaries
+	u32 src[3];  // 0x00-0x0F inputs, 0x10-0x1F temporaries, 0x20-0x7F float uniforms
+	u32 rel;     // which of src[] is subject to relative addressing
+	u32 addr;    // 0: none, 1: a0.x, 2: a0.y, 3: aL
+	u32 desc;    // operand descriptor
+	u32 cmp[2];  // CMP operators for x and y
+
+	// Flow control
+	u32 num;
+	u32 offset;
+	u32 cond;
+	bool refx, refy;
+	u32 uniform;
+} pica_instr;
+
+// Everything a shader run reads, as uploaded through the VSH registers
+typedef struct {
+	u32 code[PICA_SHADER_CODE_SIZE];
+	u32 opdesc[PICA_SHADER_OPDESC_SIZE];
+	float f[PICA_SHADER_NUM_FLOAT_UNIFORMS][4];
+	u8 i[4][4]; // x: loop count, y: initial aL, z: aL increment
+	u16 b;
+	u32 entry;
+} pica_shader_setup;
+
+// State of one shader unit, vectors are stored in x, y, z, w order
+typedef struct {
+	float input[16][4];
+	float temp[16][4];
+	float output[16][4];
+	s32 addr[3]; // a0.x, a0.y, aL
+	bool cmp[2];
+	u32 steps;   // instructions executed by the last run
+	u32 budget;  // instructions a run may execute, 0 for PICA_SHADER_MAX_STEPS
+
+	// When set, receives the address of every instruction the run executes, up to trace_capacity of them
+	u16* trace;
+	u32 trace_capacity;
+} pica_shader_unit;
+
+static inline bool pica_op_is_inverted(u32 op)
+{
+	return (op >= PICA_OP_DPHI && op <= PICA_OP_SLTI) || op == PICA_OP_MADI;
+}
+
+// Selects the source component of an operand descriptor swizzle for destination component i (0 = x)
+static inline u32 pica_swizzle(u32 selector, int i)
+{
+	return (selector >> (6 - 2 * i)) & 3;
+}
+
+// Bit 3 of the destination mask enables x, bit 0 enables w
+static inline bool pica_dest_enabled(u32 desc, int i)
+{
+	return (desc >> (3 - i)) & 1;
+}
+
+static inline u32 pica_src_selector(u32 desc, int src)
+{
+	return (desc >> (5 + 9 * src)) & 0xFF;
+}
+
+static inline bool pica_src_negated(u32 desc, int src)
+{
+	return (desc >> (4 + 9 * src)) & 1;
+}
+
+void pica_shader_decode(u32 word, const u32* opdesc, pica_instr* instr);
+
+// PICA float semantics: multiplying infinity by zero yields zero rather than NaN
+static inline float pica_mul(float a, float b)
+{
+	float r = a * b;
+	if (r != r && a == a && b == b)
+		return 0.0f;
+	return r;
+}
+
+// MOVA rounds towards zero. Converting NaN, infinities or values beyond the s32 range is undefined in C, so the
+// result is clamped to [-128, 127] first: with 96 uniforms an offset that large makes every relative read out of
+// range, whichever its exact value. NaN gives -128, so it reads out of range too, like shaderdiff's reference.
+static inline s32 pica_mova(float value)
+{
+	if (value != value || value <= -128.0f)
+		return -128;
+	if (value >= 127.0f)
+		return 127;
+	return (s32)value;
+}
+
+// Runs the program from the setup entry point until END, returns false if the instruction budget ran out
+bool pica_shader_run(pica_shader_unit* unit, const pica_shader_setup* setup);
@@ -0,0 +1,433 @@
+#include <math.h>
+#include <string.h>
+#include "shader_batch.h"
+
+typedef s32 lanes_mask __attribute__((vector_size(4 * PICA_SHADER_LANES)));
+
+#define ALWAYS_INLINE static inline __attribute__((always_inline))
+
+// Not {} + value, which turns -0 into +0
+ALWAYS_INLINE pica_lanes splat(float value)
+{
+	pica_lanes r;
+	for (int lane = 0; lane < PICA_SHADER_LANES; lane++)
+		r[lane] = value;
+	return r;
+}
+
+ALWAYS_INLINE pica_lanes select(lanes_mask mask, pica_lanes a, pica_lanes b)
+{
+	return (pica_lanes)(((lanes_mask)a & mask) | ((lanes_mask)b & ~mask));
+}
+
+// pica_mul on every lane: infinity times zero is zero
+ALWAYS_INLINE pica_lanes mul(pica_lanes a, pica_lanes b)
+{
+	pica_lanes r = a * b;
+	lanes_mask zero = (r != r) & (a == a) & (b == b);
+	return (pica_lanes)((lanes_mask)r & ~zero);
+}
+
+//
+// Decoding
+//
+
+static void decode_operand(pica_batch_operand* operand, const pica_instr* instr, int src)
+{
+	u32 index = instr->src[src];
+	u32 selector = pica_src_selector(instr->desc, src);
+
+	if (index < 0x10) {
+		operand->kind = PICA_OPERAND_INPUT;
+		operand->index = index;
+	} else if (index < 0x20) {
+		operand->kind = PICA_OPERAND_TEMP;
+		operand->index = index - 0x10;
+	} else {
+		operand->kind = PICA_OPERAND_UNIFORM;
+		operand->index = index - 0x20;
+	}
+
+	// The swizzle becomes the choice of component plane
+	for (int i = 0; i < 4; i++)
+		operand->comp[i] = pica_swizzle(selector, i);
+	operand->negate = pica_src_negated(instr->desc, src);
+	operand->relative = (operand->kind == PICA_OPERAND_UNIFORM && instr->addr && instr->rel == (u32)src) ? instr->addr : 0;
+}
+
+static bool is_alu(u32 op)
+{
+	return op < PICA_OP_BREAK || op >= PICA_OP_CMP;
+}
+
+void pica_shader_batch_compile(pica_shader_program* program, const pica_shader_setup* setup)
+{
+	static u16 pending[PICA_SHADER_CODE_SIZE * 3];
+	bool seen[PICA_SHADER_CODE_SIZE] = { false };
+	u32 count = 0;
+
+	program->valid = true;
+	pending[count++] = setup->entry;
+
+	// Walk everything reachable from the entry point
+	while (count) {
+		u32 pc = pending[--count];
+		if (pc >= PICA_SHADER_CODE_SIZE || seen[pc])
+			continue;
+		seen[pc] = true;
+
+		pica_batch_instr* b = &program->code[pc];
+		pica_shader_decode(setup->code[pc], setup->opdesc, &b->instr);
+		const pica_instr* instr = &b->instr;
+
+		if (is_alu(instr->op)) {
+			for (int s = 0; s < 3; s++)
+				decode_operand(&b->src[s], instr, s);
+			b->mask = 0;
+			for (int i = 0; i < 4; i++)
+				if (pica_dest_enabled(instr->desc, i))
+					b->mask |= 1 << i;
+			pending[count++] = pc + 1;
+			continue;
+		}
+
+		switch (instr->op) {
+		case PICA_OP_END:
+			break;
+		case PICA_OP_IFC:
+		case PICA_OP_CALLC:
+		case PICA_OP_JMPC:
+		case PICA_OP_BREAKC:
+			program->valid = false;
+			return;
+		case PICA_OP_CALL:
+		case PICA_OP_CALLU:
+		case PICA_OP_JMPU:
+			pending[count++] = instr->offset;
+			pending[count++] = pc + 1;
+			break;
+		case PICA_OP_IFU:
+			pending[count++] = pc + 1;
+			pending[count++] = instr->offset;
+			pending[count++] = instr->offset + instr->num;
+			break;
+		case PICA_OP_LOOP:
+			pending[count++] = pc + 1;
+			pending[count++] = instr->offset + 1;
+			break;
+		default:
+			pending[count++] = pc + 1;
+			break;
+		}
+	}
+}
+
+//
+// Execution
+//
+
+static const float ones[4] = { 1.0f, 1.0f, 1.0f, 1.0f };
+
+// Component i of the operand as read by the destination component i
+ALWAYS_INLINE pica_lanes fetch(const pica_shader_batch* batch, const pica_shader_setup* setup,
+	const pica_batch_operand* operand, int i)
+{
+	u32 comp = operand->comp[i];
+	pica_lanes value;
+
+	switch (operand->kind) {
+	case PICA_OPERAND_INPUT:
+		value = batch->input[operand->index][comp];
+		break;
+	case PICA_OPERAND_TEMP:
+		value = batch->temp[operand->index][comp];
+		break;
+	default:
+		if (!operand->relative) {
+			value = splat(setup->f[operand->index][comp]);
+		} else {
+			// Out of range reads return ones, like lookup_source
+			const s32* offset = batch->addr[operand->relative - 1];
+			for (int lane = 0; lane < PICA_SHADER_LANES; lane++) {
+				s32 uniform = (s32)operand->index + offset[lane];
+				bool inside = uniform >= 0 && uniform < PICA_SHADER_NUM_FLOAT_UNIFORMS;
+				value[lane] = inside ? setup->f[uniform][comp] : ones[comp];
+			}
+		}
+		break;
+	}
+	return operand->negate ? -value : value;
+}
+
+static void store(pica_shader_batch* batch, const pica_batch_instr* b, const pica_lanes* dest)
+{
+	pica_lanes (*reg)[4] = (b->instr.dest < 0x10) ? &batch->output[b->instr.dest] : &batch->temp[b->instr.dest - 0x10];
+	for (int i = 0; i < 4; i++)
+		if (b->mask & (1 << i))
+			(*reg)[i] = dest[i];
+}
+
+static void execute_alu(pica_shader_batch* batch, const pica_shader_setup* setup, const pica_batch_instr* b)
+{
+	const pica_batch_operand* src = b->src;
+	pica_lanes dest[4];
+	int i;
+
+#define FETCH(s, i) fetch(batch, setup, &src[s], i)
+#define EACH_ENABLED(i) for (i = 0; i < 4; i++) if (b->mask & (1 << i))
+
+	switch (b->instr.op) {
+	case PICA_OP_ADD:
+		EACH_ENABLED(i)
+			dest[i] = FETCH(0, i) + FETCH(1, i);
+		break;
+
+	case PICA_OP_MUL:
+		EACH_ENABLED(i)
+			dest[i] = mul(FETCH(0, i), FETCH(1, i));
+		break;
+
+	case PICA_OP_DP3:
+	case PICA_OP_DP4:
+	case PICA_OP_DPH:
+	case PICA_OP_DPHI: {
+		int count = (b->instr.op == PICA_OP_DP3) ? 3 : 4;
+		bool homogeneous = b->instr.op == PICA_OP_DPH || b->instr.op == PICA_OP_DPHI;
+		pica_lanes dot = splat(0.0f);
+		for (i = 0; i < count; i++)
+			dot += mul((homogeneous && i == 3) ? splat(1.0f) : FETCH(0, i), FETCH(1, i));
+		for (i = 0; i < 4; i++)
+			dest[i] = dot;
+		break;
+	}
+
+	case PICA_OP_DST:
+	case PICA_OP_DSTI:
+		dest[0] = splat(1.0f);
+		dest[1] = mul(FETCH(0, 1), FETCH(1, 1));
+		dest[2] = FETCH(0, 2);
+		dest[3] = FETCH(1, 3);
+		break;
+
+	case PICA_OP_EX2:
+	case PICA_OP_LG2:
+	case PICA_OP_RCP:
+	case PICA_OP_RSQ: {
+		pica_lanes x = FETCH(0, 0), result;
+		for (int lane = 0; lane < PICA_SHADER_LANES; lane++) {
+			if (b->instr.op == PICA_OP_EX2)
+				result[lane] = exp2f(x[lane]);
+			else if (b->instr.op == PICA_OP_LG2)
+				result[lane] = log2f(x[lane]);
+			else if (b->instr.op == PICA_OP_RCP)
+				result[lane] = 1.0f / x[lane];
+			else
+				result[lane] = 1.0f / sqrtf(x[lane]);
+		}
+		for (i = 0; i < 4; i++)
+			dest[i] = result;
+		break;
+	}
+
+	case PICA_OP_LITP: {
+		pica_lanes x = FETCH(0, 0), y = FETCH(0, 1), w = FETCH(0, 3);
+		for (int lane = 0; lane < PICA_SHADER_LANES; lane++) {
+			x[lane] = fmaxf(x[lane], 0.0f);
+			y[lane] = fminf(fmaxf(y[lane], -127.9961f), 127.9961f);
+			w[lane] = fmaxf(w[lane], 0.0f);
+		}
+		dest[0] = x;
+		dest[1] = y;
+		dest[2] = FETCH(0, 2);
+		dest[3] = w;
+		break;
+	}
+
+	case PICA_OP_SGE:
+	case PICA_OP_SGEI:
+		EACH_ENABLED(i)
+			dest[i] = select(FETCH(0, i) >= FETCH(1, i), splat(1.0f), splat(0.0f));
+		break;
+
+	case PICA_OP_SLT:
+	case PICA_OP_SLTI:
+		EACH_ENABLED(i)
+			dest[i] = select(FETCH(0, i) < FETCH(1, i), splat(1.0f), splat(0.0f));
+		break;
+
+	case PICA_OP_FLR:
+		EACH_ENABLED(i) {
+			pica_lanes value = FETCH(0, i);
+			for (int lane = 0; lane < PICA_SHADER_LANES; lane++)
+				dest[i][lane] = floorf(value[lane]);
+		}
+		break;
+
+	// Written so that a NaN in the second operand wins, matching the interpreter
+	case PICA_OP_MAX:
+		EACH_ENABLED(i) {
+			pica_lanes a = FETCH(0, i), c = FETCH(1, i);
+			dest[i] = select(a > c, a, c);
+		}
+		break;
+
+	case PICA_OP_MIN:
+		EACH_ENABLED(i) {
+			pica_lanes a = FETCH(0, i), c = FETCH(1, i);
+			dest[i] = select(a < c, a, c);
+		}
+		break;
+
+	case PICA_OP_MOV:
+		EACH_ENABLED(i)
+			dest[i] = FETCH(0, i);
+		break;
+
+	case PICA_OP_MOVA:
+		// Rounds towards zero. Both components are read first, the source may be addressed by a0.x.
+		dest[0] = FETCH(0, 0);
+		dest[1] = FETCH(0, 1);
+		for (i = 0; i < 2; i++) {
+			if (!(b->mask & (1 << i)))
+				continue;
+			for (int lane = 0; lane < PICA_SHADER_LANES; lane++)
+				batch->addr[i][lane] = pica_mova(dest[i][lane]);
+		}
+		return;
+
+	case PICA_OP_MAD:
+	case PICA_OP_MADI:
+		EACH_ENABLED(i)
+			dest[i] = mul(FETCH(0, i), FETCH(1, i)) + FETCH(2, i);
+		break;
+
+	default:
+		// CMP only sets the flags, which are not kept
+		return;
+	}
+
+#undef FETCH
+#undef EACH_ENABLED
+
+	store(batch, b, dest);
+}
+
+typedef struct {
+	u32 final;
+	u32 ret;
+	u32 loop;
+	u32 repeat;
+	s32 increment;
+	bool is_loop;
+} stack_entry;
+
+bool pica_shader_batch_run(pica_shader_batch* batch, const pica_shader_program* program, const pica_shader_setup* setup)
+{
+	stack_entry stack[PICA_SHADER_STACK_DEPTH];
+	int depth = 0;
+	u32 pc = setup->entry;
+	s32 loop_counter = 0; // aL is the same on every lane
+
+	#define PUSH(offset_, num_, ret_, repeat_, increment_, is_loop_) \
+		do { \
+			if (depth < PICA_SHADER_STACK_DEPTH) { \
+				stack_entry* e = &stack[depth++]; \
+				e->loop = (offset_); \
+				e->final = (offset_) + (num_); \
+				e->ret = (ret_); \
+				e->repeat = (repeat_); \
+				e->increment = (increment_); \
+				e->is_loop = (is_loop_); \
+			} \
+			pc = (offset_); \
+		} while (0)
+
+	#define SET_LOOP_COUNTER(value) \
+		do { \
+			loop_counter = (value); \
+			for (int lane = 0; lane < PICA_SHADER_LANES; lane++) \
+				batch->addr[2][lane] = loop_counter; \
+		} while (0)
+
+	u32 budget = batch->budget ? batch->budget : PICA_SHADER_MAX_STEPS;
+
+	for (batch->steps = 0; batch->steps < budget; ) {
+		if (depth && pc == stack[depth - 1].final) {
+			stack_entry* top = &stack[depth - 1];
+			SET_LOOP_COUNTER(loop_counter + top->increment);
+			if (top->repeat-- == 0) {
+				pc = top->ret;
+				depth--;
+			} else {
+				pc = top->loop;
+			}
+			continue;
+		}
+
+		if (pc >= PICA_SHADER_CODE_SIZE)
+			return true;
+
+		const pica_batch_instr* b = &program->code[pc];
+		const pica_instr* instr = &b->instr;
+		batch->steps++;
+
+		switch (instr->op) {
+		case PICA_OP_END:
+			return true;
+
+		case PICA_OP_NOP:
+		case PICA_OP_EMIT:
+		case PICA_OP_SETEMIT:
+			pc++;
+			break;
+
+		case PICA_OP_BREAK:
+			while (depth && !stack[depth - 1].is_loop)
+				depth--;
+			if (depth)
+				pc = stack[--depth].ret;
+			else
+				pc++;
+			break;
+
+		case PICA_OP_CALL:
+			PUSH(instr->offset, instr->num, pc + 1, 0, 0, false);
+			break;
+
+		case PICA_OP_CALLU:
+			if ((setup->b >> instr->uniform) & 1)
+				PUSH(instr->offset, instr->num, pc + 1, 0, 0, false);
+			else
+				pc++;
+			break;
+
+		case PICA_OP_IFU:
+			if ((setup->b >> instr->uniform) & 1)
+				PUSH(pc + 1, instr->offset - pc - 1, instr->offset + instr->num, 0, 0, false);
+			else
+				PUSH(instr->offset, instr->num, instr->offset + instr->num, 0, 0, false);
+			break;
+
+		case PICA_OP_LOOP: {
+			const u8* i = setup->i[instr->uniform & 3];
+			SET_LOOP_COUNTER(i[1]);
+			PUSH(pc + 1, instr->offset - pc, instr->offset + 1, i[0], (s8)i[2], true);
+			break;
+		}
+
+		case PICA_OP_JMPU:
+			pc = (((setup->b >> instr->uniform) & 1) != (instr->num & 1)) ? instr->offset : pc + 1;
+			break;
+
+		default:
+			execute_alu(batch, setup, b);
+			pc++;
+			break;
+		}
+	}
+
+	#undef PUSH
+	#undef SET_LOOP_COUNTER
+
+	return false;
+}
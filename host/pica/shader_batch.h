@@ -0,0 +1,56 @@
+/*
+ * Batched vertex shader engine
+ * Runs PICA_SHADER_LANES vertices in lockstep on a structure-of-arrays register file: registers are stored
+ * [register][component][lane], so that every component plane is one 64-byte line and an instruction works
+ * on whole planes. The program is decoded once per upload and swizzles are resolved there into the plane
+ * each destination component reads, no data is shuffled at run time.
+ *
+ * Lockstep needs every lane to take the same path: programs whose reachable code branches on the condition
+ * flags (ifc, callc, jmpc, breakc) are rejected and run on the interpreter instead. The flags are not kept
+ * since nothing else reads them. Results match pica_shader_run on a unit cleared before every vertex, up to the
+ * sign of NaNs, which the compiler is free to change by swapping the operands of an addition.
+ */
+
+#pragma once
+#include <3ds/types.h>
+#include "shader.h"
+
+#define PICA_SHADER_LANES 16
+
+typedef float pica_lanes __attribute__((vector_size(4 * PICA_SHADER_LANES)));
+
+typedef struct {
+	pica_lanes input[16][4];
+	pica_lanes temp[16][4];
+	pica_lanes output[16][4];
+	s32 addr[3][PICA_SHADER_LANES]; // a0.x, a0.y, aL
+	u32 steps;
+	u32 budget;    // like pica_shader_unit's
+} pica_shader_batch;
+
+enum { PICA_OPERAND_INPUT, PICA_OPERAND_TEMP, PICA_OPERAND_UNIFORM };
+
+typedef struct {
+	u8 kind;       // PICA_OPERAND_*
+	u8 index;      // register, or float uniform
+	u8 comp[4];    // component read for each destination component
+	bool negate;
+	u8 relative;   // uniforms only: 0, or the address register + 1 that offsets the index per lane
+} pica_batch_operand;
+
+typedef struct {
+	pica_instr instr;
+	pica_batch_operand src[3];
+	u8 mask;       // bit i enables destination component i (0 = x)
+} pica_batch_instr;
+
+typedef struct {
+	bool valid;    // false when the program needs the interpreter
+	pica_batch_instr code[PICA_SHADER_CODE_SIZE];
+} pica_shader_program;
+
+// Decodes the code and operand descriptors of setup, reachable from its entry point
+void pica_shader_batch_compile(pica_shader_program* program, const pica_shader_setup* setup);
+
+// Runs the program on every lane of the batch, like pica_shader_run does on one unit
+bool pica_shader_batch_run(pica_shader_batch* batch, const pica_shader_program* program, const pica_shader_setup* setup);
@@ -0,0 +1,428 @@
+#include <string.h>
+#include "pica.h"
+#include "tev.h"
+
+// Fragments are combined in chunks so that the per-stage intermediates stay in the L1 cache
+#define CHUNK 64
+
+pica_tev_stats pica_tev_statistics;
+
+static pica_tev_kernel cache[PICA_TEV_CACHE_SIZE];
+static bool cache_used[PICA_TEV_CACHE_SIZE];
+
+static const u32 stage_regs[PICA_TEV_NUM_STAGES] = {
+	PICA_REG_TEXENV0_SOURCE, PICA_REG_TEXENV1_SOURCE, PICA_REG_TEXENV2_SOURCE,
+	PICA_REG_TEXENV3_SOURCE, PICA_REG_TEXENV4_SOURCE, PICA_REG_TEXENV5_SOURCE,
+};
+
+void pica_tev_read_config(pica_tev_config* config)
+{
+	for (int i = 0; i < PICA_TEV_NUM_STAGES; i++) {
+		const u32* r = &pica.regs[stage_regs[i]];
+		config->stage[i].source = r[PICA_TEXENV_SOURCE];
+		config->stage[i].operand = r[PICA_TEXENV_OPERAND];
+		config->stage[i].combiner = r[PICA_TEXENV_COMBINER];
+		config->stage[i].color = r[PICA_TEXENV_COLOR];
+		config->stage[i].scale = r[PICA_TEXENV_SCALE];
+	}
+	config->update_buffer = pica.regs[PICA_REG_TEXENV_UPDATE_BUFFER] & 0xFF00;
+	config->buffer_color = pica.regs[PICA_REG_TEXENV_BUFFER_COLOR];
+}
+
+//
+// Configuration analysis
+//
+
+static int num_args(u32 combiner)
+{
+	switch (combiner) {
+	case PICA_TEV_REPLACE:
+		return 1;
+	case PICA_TEV_INTERPOLATE:
+	case PICA_TEV_MULTIPLY_ADD:
+	case PICA_TEV_ADD_MULTIPLY:
+		return 3;
+	default:
+		return 2;
+	}
+}
+
+static u32 rgb_source(const pica_tev_stage_regs* s, int arg)       { return (s->source >> (4 * arg)) & 0xF; }
+static u32 alpha_source(const pica_tev_stage_regs* s, int arg)     { return (s->source >> (16 + 4 * arg)) & 0xF; }
+static u32 rgb_operand(const pica_tev_stage_regs* s, int arg)      { return (s->operand >> (4 * arg)) & 0xF; }
+static u32 alpha_operand(const pica_tev_stage_regs* s, int arg)    { return (s->operand >> (12 + 4 * arg)) & 0x7; }
+static u32 rgb_combiner(const pica_tev_stage_regs* s)              { return s->combiner & 0xF; }
+static u32 alpha_combiner(const pica_tev_stage_regs* s)            { return (s->combiner >> 16) & 0xF; }
+
+static bool stage_reads(const pica_tev_stage_regs* s, u32 source)
+{
+	int i;
+	for (i = 0; i < num_args(rgb_combiner(s)); i++)
+		if (rgb_source(s, i) == source)
+			return true;
+	if (rgb_combiner(s) == PICA_TEV_DOT3_RGBA)
+		return false; // the alpha combiner is ignored
+	for (i = 0; i < num_args(alpha_combiner(s)); i++)
+		if (alpha_source(s, i) == source)
+			return true;
+	return false;
+}
+
+static bool stage_updates_buffer(const pica_tev_config* config, int stage)
+{
+	return stage < 4 && (config->update_buffer & (0x1100 << stage));
+}
+
+// A stage that passes the previous stage's output through unchanged
+static bool stage_is_identity(const pica_tev_stage_regs* s)
+{
+	return rgb_combiner(s) == PICA_TEV_REPLACE && alpha_combiner(s) == PICA_TEV_REPLACE &&
+		rgb_source(s, 0) == PICA_TEV_SRC_PREVIOUS && alpha_source(s, 0) == PICA_TEV_SRC_PREVIOUS &&
+		rgb_operand(s, 0) == 0 && alpha_operand(s, 0) == 0 &&
+		(s->scale & 0x30003) == 0;
+}
+
+//
+// Per-chunk building blocks of the generic kernel
+//
+
+static void apply_rgb_operand(u8 (*out)[4], const u8 (*in)[4], u32 operand, u32 count)
+{
+	u32 i;
+	int channel;
+
+	switch (operand) {
+	case 0x0: // source color
+		for (i = 0; i < count; i++)
+			out[i][0] = in[i][0], out[i][1] = in[i][1], out[i][2] = in[i][2];
+		return;
+	case 0x1: // one minus source color
+		for (i = 0; i < count; i++)
+			out[i][0] = 255 - in[i][0], out[i][1] = 255 - in[i][1], out[i][2] = 255 - in[i][2];
+		return;
+	case 0x2: case 0x3: channel = 3; break;
+	case 0x4: case 0x5: channel = 0; break;
+	case 0x8: case 0x9: channel = 1; break;
+	case 0xC: case 0xD: channel = 2; break;
+	default:
+		apply_rgb_operand(out, in, 0, count);
+		return;
+	}
+
+	// Replicate a single channel, odd operands invert it
+	u8 invert = (operand & 1) ? 255 : 0;
+	for (i = 0; i < count; i++)
+		out[i][0] = out[i][1] = out[i][2] = in[i][channel] ^ invert;
+}
+
+static void apply_alpha_operand(u8 (*out)[4], const u8 (*in)[4], u32 operand, u32 count)
+{
+	static const int channels[4] = { 3, 0, 1, 2 };
+	int channel = channels[(operand >> 1) & 3];
+	u8 invert = (operand & 1) ? 255 : 0;
+
+	for (u32 i = 0; i < count; i++)
+		out[i][3] = in[i][channel] ^ invert;
+}
+
+static inline u8 clamp255(s32 v)
+{
+	return v < 0 ? 0 : v > 255 ? 255 : v;
+}
+
+// Combines channels [first, last) of the arguments
+static void combine(u8 (*out)[4], u8 (*arg[3])[4], u32 combiner, int first, int last, u32 count)
+{
+	u32 i;
+	int c;
+
+	#define FOR_EACH(expr) \
+		for (i = 0; i < count; i++) \
+			for (c = first; c < last; c++) \
+				out[i][c] = (expr)
+
+	#define A arg[0][i][c]
+	#define B arg[1][i][c]
+	#define C arg[2][i][c]
+
+	switch (combiner) {
+	case PICA_TEV_REPLACE:      FOR_EACH(A); break;
+	case PICA_TEV_MODULATE:     FOR_EACH(A * B / 255); break;
+	case PICA_TEV_ADD:          FOR_EACH(clamp255(A + B)); break;
+	case PICA_TEV_ADD_SIGNED:   FOR_EACH(clamp255(A + B - 128)); break;
+	case PICA_TEV_INTERPOLATE:  FOR_EACH((A * C + B * (255 - C)) / 255); break;
+	case PICA_TEV_SUBTRACT:     FOR_EACH(clamp255(A - B)); break;
+	case PICA_TEV_MULTIPLY_ADD: FOR_EACH(clamp255((A * B + 255 * C) / 255)); break;
+	case PICA_TEV_ADD_MULTIPLY: FOR_EACH(clamp255(A + B) * C / 255); break;
+	case PICA_TEV_DOT3_RGB:
+	case PICA_TEV_DOT3_RGBA:
+		for (i = 0; i < count; i++) {
+			s32 dot = 0;
+			for (c = 0; c < 3; c++)
+				dot += ((arg[0][i][c] * 2 - 255) * (arg[1][i][c] * 2 - 255) + 128) / 256;
+			u8 result = clamp255(dot);
+			for (c = first; c < last; c++)
+				out[i][c] = result;
+		}
+		break;
+	default:
+		FOR_EACH(0);
+		break;
+	}
+
+	#undef FOR_EACH
+	#undef A
+	#undef B
+	#undef C
+}
+
+static void apply_scale(u8 (*out)[4], u32 scale, int first, int last, u32 count)
+{
+	if (!scale)
+		return;
+	for (u32 i = 0; i < count; i++)
+		for (int c = first; c < last; c++)
+			out[i][c] = (out[i][c] << scale) > 255 ? 255 : out[i][c] << scale;
+}
+
+//
+// Kernels
+//
+
+static void run_passthrough(const pica_tev_kernel* kernel, const u8 (*primary)[4], u8 (*out)[4], u32 count)
+{
+	memcpy(out, primary, count * 4);
+}
+
+static void run_constant(const pica_tev_kernel* kernel, const u8 (*primary)[4], u8 (*out)[4], u32 count)
+{
+	u32 value;
+	memcpy(&value, kernel->constant_output, 4);
+	for (u32 i = 0; i < count; i++)
+		memcpy(out[i], &value, 4);
+}
+
+static const u8 (*source_data(const pica_tev_stage* st, u32 source, const u8 (*primary)[4],
+	u8 (*prev)[4], u8 (*buffer)[4], u8 (*scratch)[4], u32 count))[4]
+{
+	u32 i;
+	switch (source) {
+	case PICA_TEV_SRC_PRIMARY_COLOR:   return primary;
+	case PICA_TEV_SRC_PREVIOUS:        return (const u8 (*)[4])prev;
+	case PICA_TEV_SRC_PREVIOUS_BUFFER: return (const u8 (*)[4])buffer;
+	case PICA_TEV_SRC_CONSTANT:
+		for (i = 0; i < count; i++)
+			memcpy(scratch[i], st->constant, 4);
+		return (const u8 (*)[4])scratch;
+	default:
+		// Fragment lighting and textures are not modeled and read as zero
+		memset(scratch, 0, count * 4);
+		return (const u8 (*)[4])scratch;
+	}
+}
+
+static void run_chunk(const pica_tev_kernel* kernel, const u8 (*primary)[4], u8 (*out)[4], u32 count)
+{
+	u8 prev[CHUNK][4], buffer[CHUNK][4], args[3][CHUNK][4], scratch[CHUNK][4];
+	u8 updates[PICA_TEV_NUM_STAGES][CHUNK][4];
+	const pica_tev_stage* updaters[PICA_TEV_NUM_STAGES];
+	u32 num_updates = 0, applied = 0;
+	bool buffer_loaded = false;
+	u32 i;
+
+	// The previous output of stage 0 is the primary color
+	memcpy(prev, primary, count * 4);
+	memset(buffer, 0, count * 4);
+
+	for (u32 s = 0; s < kernel->num_stages; s++) {
+		const pica_tev_stage* st = &kernel->stage[s];
+
+		// Stage 0 sees an empty combiner buffer, later stages see the buffer color
+		// overwritten by the updates of the stages up to two positions before them
+		if (st->index >= 1 && !buffer_loaded) {
+			for (i = 0; i < count; i++)
+				memcpy(buffer[i], kernel->buffer_color, 4);
+			buffer_loaded = true;
+		}
+		for (; applied < num_updates && updaters[applied]->index + 2u <= st->index; applied++) {
+			for (i = 0; i < count; i++) {
+				if (updaters[applied]->update_buffer[0])
+					memcpy(buffer[i], updates[applied][i], 3);
+				if (updaters[applied]->update_buffer[1])
+					buffer[i][3] = updates[applied][i][3];
+			}
+		}
+
+		// Gather the arguments, rgb operands fill channels 0-2 and alpha operands channel 3
+		for (int part = 0; part < 2; part++) {
+			for (int a = 0; a < num_args(st->combiner[part]); a++) {
+				const u8 (*src)[4] = source_data(st, st->source[part][a], primary, prev, buffer, scratch, count);
+				if (part == 0)
+					apply_rgb_operand(args[a], src, st->operand[0][a], count);
+				else
+					apply_alpha_operand(args[a], src, st->operand[1][a], count);
+			}
+		}
+
+		u8 (*argp[3])[4] = { args[0], args[1], args[2] };
+		if (st->combiner[0] == PICA_TEV_DOT3_RGBA) {
+			combine(prev, argp, st->combiner[0], 0, 4, count);
+			apply_scale(prev, st->scale[0], 0, 4, count);
+		} else {
+			combine(prev, argp, st->combiner[0], 0, 3, count);
+			combine(prev, argp, st->combiner[1], 3, 4, count);
+			apply_scale(prev, st->scale[0], 0, 3, count);
+			apply_scale(prev, st->scale[1], 3, 4, count);
+		}
+
+		if (st->update_buffer[0] || st->update_buffer[1]) {
+			memcpy(updates[num_updates], prev, count * 4);
+			updaters[num_updates++] = st;
+		}
+	}
+
+	memcpy(out, prev, count * 4);
+}
+
+static void run_generic(const pica_tev_kernel* kernel, const u8 (*primary)[4], u8 (*out)[4], u32 count)
+{
+	for (u32 i = 0; i < count; i += CHUNK)
+		run_chunk(kernel, primary + i, out + i, (count - i < CHUNK) ? count - i : CHUNK);
+}
+
+//
+// Compilation
+//
+
+static u32 hash_config(const pica_tev_config* config)
+{
+	const u32* words = (const u32*)config;
+	u32 hash = 2166136261u;
+	for (u32 i = 0; i < sizeof(*config) / 4; i++)
+		hash = (hash ^ words[i]) * 16777619u;
+	return hash;
+}
+
+static void decode_stage(pica_tev_stage* st, const pica_tev_config* config, int k)
+{
+	const pica_tev_stage_regs* s = &config->stage[k];
+
+	st->index = k;
+	for (int a = 0; a < 3; a++) {
+		st->source[0][a] = rgb_source(s, a);
+		st->source[1][a] = alpha_source(s, a);
+		st->operand[0][a] = rgb_operand(s, a);
+		st->operand[1][a] = alpha_operand(s, a);
+	}
+	st->combiner[0] = rgb_combiner(s);
+	st->combiner[1] = alpha_combiner(s);
+	st->scale[0] = s->scale & 3;
+	st->scale[1] = (s->scale >> 16) & 3;
+	for (int c = 0; c < 4; c++)
+		st->constant[c] = s->color >> (8 * c);
+	st->update_buffer[0] = k < 4 && (config->update_buffer & (0x100 << k));
+	st->update_buffer[1] = k < 4 && (config->update_buffer & (0x1000 << k));
+}
+
+static bool is_passthrough(const pica_tev_kernel* kernel)
+{
+	const pica_tev_stage* st = &kernel->stage[0];
+	if (kernel->num_stages == 0)
+		return true;
+	return kernel->num_stages == 1 &&
+		st->combiner[0] == PICA_TEV_REPLACE && st->combiner[1] == PICA_TEV_REPLACE &&
+		st->source[0][0] == PICA_TEV_SRC_PRIMARY_COLOR && st->source[1][0] == PICA_TEV_SRC_PRIMARY_COLOR &&
+		st->operand[0][0] == 0 && st->operand[1][0] == 0 &&
+		st->scale[0] == 0 && st->scale[1] == 0;
+}
+
+static void compile(pica_tev_kernel* kernel, const pica_tev_config* config)
+{
+	bool needed[PICA_TEV_NUM_STAGES] = { false };
+	int last_buffer_reader = -1;
+	bool constant = true;
+	int k;
+
+	memset(kernel, 0, sizeof(*kernel));
+	kernel->config = *config;
+	for (int c = 0; c < 4; c++)
+		kernel->buffer_color[c] = config->buffer_color >> (8 * c);
+
+	// Walk backwards from the last stage to find the stages that contribute to the output
+	needed[PICA_TEV_NUM_STAGES - 1] = true;
+	for (k = PICA_TEV_NUM_STAGES - 1; k >= 0; k--) {
+		const pica_tev_stage_regs* s = &config->stage[k];
+		bool buffer_used = stage_updates_buffer(config, k) && last_buffer_reader >= k + 2;
+
+		if (buffer_used)
+			needed[k] = true;
+		if (!needed[k])
+			continue;
+		if (k > 0 && stage_reads(s, PICA_TEV_SRC_PREVIOUS))
+			needed[k - 1] = true;
+		if (stage_reads(s, PICA_TEV_SRC_PREVIOUS_BUFFER) && k > last_buffer_reader)
+			last_buffer_reader = k;
+
+		// Stages passing through the previous output only need to run for their buffer update
+		if (stage_is_identity(s) && !buffer_used)
+			needed[k] = false;
+	}
+
+	for (k = 0; k < PICA_TEV_NUM_STAGES; k++) {
+		if (!needed[k])
+			continue;
+
+		pica_tev_stage* st = &kernel->stage[kernel->num_stages++];
+		decode_stage(st, config, k);
+		for (int part = 0; part < 2; part++) {
+			for (int a = 0; a < num_args(st->combiner[part]); a++) {
+				u32 source = st->source[part][a];
+				// Before the first kept stage the previous output is still the primary color
+				if (source == PICA_TEV_SRC_PRIMARY_COLOR || (source == PICA_TEV_SRC_PREVIOUS && kernel->num_stages == 1))
+					constant = false;
+			}
+		}
+	}
+
+	// Pick the cheapest kernel that implements the configuration
+	if (is_passthrough(kernel)) {
+		kernel->run = run_passthrough;
+	} else if (constant) {
+		// Nothing depends on the fragment, evaluate the combiners once
+		static const u8 dummy[1][4];
+		run_generic(kernel, dummy, (u8 (*)[4])kernel->constant_output, 1);
+		kernel->run = run_constant;
+	} else {
+		kernel->run = run_generic;
+	}
+}
+
+const pica_tev_kernel* pica_tev_get_kernel(const pica_tev_config* config)
+{
+	u32 hash = hash_config(config);
+	u32 slot = hash % PICA_TEV_CACHE_SIZE;
+
+	pica_tev_statistics.lookups++;
+
+	for (u32 probe = 0; probe < PICA_TEV_CACHE_SIZE; probe++) {
+		u32 i = (slot + probe) % PICA_TEV_CACHE_SIZE;
+		if (!cache_used[i]) {
+			slot = i;
+			break;
+		}
+		if (cache[i].hash == hash && !memcmp(&cache[i].config, config, sizeof(*config)))
+			return &cache[i];
+	}
+
+	// Either a free slot or, with a full cache, the home slot of the hash gets (re)compiled
+	pica_tev_statistics.compiles++;
+	compile(&cache[slot], config);
+	cache[slot].hash = hash;
+	cache_used[slot] = true;
+	return &cache[slot];
+}
+
+void pica_tev_flush_cache(void)
+{
+	memset(cache_used, 0, sizeof(cache_used));
+}
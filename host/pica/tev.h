@@ -0,0 +1,102 @@
+/*
+ * Texture combiner (TEV) stages
+ * Every distinct configuration of the six stages is compiled once into a kernel that only does
+ * the work the configuration needs, kernels are cached by a hash of the combiner registers.
+ */
+
+#pragma once
+#include <3ds/types.h>
+
+#define PICA_TEV_NUM_STAGES 6
+#define PICA_TEV_CACHE_SIZE 64
+
+// Sources, operands and combiners as encoded in the registers (see GPU_TEVSOURCES and friends)
+enum {
+	PICA_TEV_SRC_PRIMARY_COLOR   = 0x0,
+	PICA_TEV_SRC_FRAGMENT_PRIMARY = 0x1,
+	PICA_TEV_SRC_FRAGMENT_SECONDARY = 0x2,
+	PICA_TEV_SRC_TEXTURE0        = 0x3,
+	PICA_TEV_SRC_TEXTURE1        = 0x4,
+	PICA_TEV_SRC_TEXTURE2        = 0x5,
+	PICA_TEV_SRC_TEXTURE3        = 0x6,
+	PICA_TEV_SRC_PREVIOUS_BUFFER = 0xD,
+	PICA_TEV_SRC_CONSTANT        = 0xE,
+	PICA_TEV_SRC_PREVIOUS        = 0xF,
+};
+
+enum {
+	PICA_TEV_REPLACE      = 0,
+	PICA_TEV_MODULATE     = 1,
+	PICA_TEV_ADD          = 2,
+	PICA_TEV_ADD_SIGNED   = 3,
+	PICA_TEV_INTERPOLATE  = 4,
+	PICA_TEV_SUBTRACT     = 5,
+	PICA_TEV_DOT3_RGB     = 6,
+	PICA_TEV_DOT3_RGBA    = 7,
+	PICA_TEV_MULTIPLY_ADD = 8,
+	PICA_TEV_ADD_MULTIPLY = 9,
+};
+
+// Raw register values of one stage
+typedef struct {
+	u32 source;
+	u32 operand;
+	u32 combiner;
+	u32 color;
+	u32 scale;
+} pica_tev_stage_regs;
+
+// Everything that defines the behavior of the combiners, used as the cache key
+typedef struct {
+	pica_tev_stage_regs stage[PICA_TEV_NUM_STAGES];
+	u32 update_buffer;
+	u32 buffer_color;
+} pica_tev_config;
+
+// Decoded stage, the arrays are indexed by [rgb, alpha][argument]
+typedef struct {
+	u8 index; // position of the stage in the hardware pipeline
+	u8 source[2][3];
+	u8 operand[2][3];
+	u8 combiner[2];
+	u8 scale[2];
+	u8 constant[4];
+	bool update_buffer[2];
+} pica_tev_stage;
+
+typedef struct pica_tev_kernel pica_tev_kernel;
+
+// Fragment colors are stored as r, g, b, a bytes
+typedef void (*pica_tev_func)(const pica_tev_kernel* kernel, const u8 (*primary)[4], u8 (*out)[4], u32 count);
+
+struct pica_tev_kernel {
+	pica_tev_config config;
+	u32 hash;
+	pica_tev_func run;
+
+	// Only the stages that can influence the output are kept
+	u32 num_stages;
+	pica_tev_stage stage[PICA_TEV_NUM_STAGES];
+	u8 buffer_color[4];
+	u8 constant_output[4];
+};
+
+typedef struct {
+	u32 lookups;
+	u32 compiles;
+} pica_tev_stats;
+
+extern pica_tev_stats pica_tev_statistics;
+
+// Reads the combiner registers of the current GPU state
+void pica_tev_read_config(pica_tev_config* config);
+
+// Returns the kernel for a configuration, compiling it on the first use
+const pica_tev_kernel* pica_tev_get_kernel(const pica_tev_config* config);
+
+void pica_tev_flush_cache(void);
+
+static inline void pica_tev_run(const pica_tev_kernel* kernel, const u8 (*primary)[4], u8 (*out)[4], u32 count)
+{
+	kernel->run(kernel, primary, out, count);
+}
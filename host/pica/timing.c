@@ -0,0 +1,318 @@
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "timing.h"
+
+static const char* op_names[PICA_TIMING_OPS] = {
+	[PICA_OP_ADD] = "add", [PICA_OP_DP3] = "dp3", [PICA_OP_DP4] = "dp4", [PICA_OP_DPH] = "dph",
+	[PICA_OP_DST] = "dst", [PICA_OP_EX2] = "ex2", [PICA_OP_LG2] = "lg2", [PICA_OP_LITP] = "litp",
+	[PICA_OP_MUL] = "mul", [PICA_OP_SGE] = "sge", [PICA_OP_SLT] = "slt", [PICA_OP_FLR] = "flr",
+	[PICA_OP_MAX] = "max", [PICA_OP_MIN] = "min", [PICA_OP_RCP] = "rcp", [PICA_OP_RSQ] = "rsq",
+	[PICA_OP_MOVA] = "mova", [PICA_OP_MOV] = "mov", [PICA_OP_DPHI] = "dphi", [PICA_OP_DSTI] = "dsti",
+	[PICA_OP_SGEI] = "sgei", [PICA_OP_SLTI] = "slti", [PICA_OP_BREAK] = "break", [PICA_OP_NOP] = "nop",
+	[PICA_OP_END] = "end", [PICA_OP_BREAKC] = "breakc", [PICA_OP_CALL] = "call", [PICA_OP_CALLC] = "callc",
+	[PICA_OP_CALLU] = "callu", [PICA_OP_IFU] = "ifu", [PICA_OP_IFC] = "ifc", [PICA_OP_LOOP] = "loop",
+	[PICA_OP_EMIT] = "emit", [PICA_OP_SETEMIT] = "setemit", [PICA_OP_JMPC] = "jmpc", [PICA_OP_JMPU] = "jmpu",
+	[PICA_OP_CMP] = "cmp", [PICA_OP_MADI] = "madi", [PICA_OP_MAD] = "mad",
+};
+
+const char* pica_timing_op_name(u32 op)
+{
+	if (op >= PICA_TIMING_OPS || !op_names[op])
+		return "?";
+	return op_names[op];
+}
+
+void pica_timing_default_costs(pica_timing_costs* costs)
+{
+	for (u32 op = 0; op < PICA_TIMING_OPS; op++) {
+		costs->latency[op] = 1;
+		costs->issue[op] = 1;
+	}
+
+	static const u32 dot[] = { PICA_OP_DP3, PICA_OP_DP4, PICA_OP_DPH, PICA_OP_DPHI, PICA_OP_DST, PICA_OP_DSTI,
+		PICA_OP_LITP, PICA_OP_MAD, PICA_OP_MADI };
+	for (u32 i = 0; i < sizeof(dot) / sizeof(dot[0]); i++)
+		costs->latency[dot[i]] = 2;
+
+	// The special function unit results take the longest
+	costs->latency[PICA_OP_RCP] = costs->latency[PICA_OP_RSQ] = 4;
+	costs->latency[PICA_OP_EX2] = costs->latency[PICA_OP_LG2] = 4;
+	costs->latency[PICA_OP_MOVA] = 3;
+
+	costs->branch = 2;
+	costs->input_cycles = 1;
+	costs->output_cycles = 1;
+	costs->units = 4;
+}
+
+//
+// Costs measured by bench-tests
+//
+
+// The opcodes each bench-tests family times
+static const struct {
+	const char* family;
+	u32 ops[2];
+	u32 count;
+} families[] = {
+	{ "add",  { PICA_OP_ADD },                 1 },
+	{ "mul",  { PICA_OP_MUL },                 1 },
+	{ "mad",  { PICA_OP_MAD, PICA_OP_MADI },   2 },
+	{ "dp3",  { PICA_OP_DP3 },                 1 },
+	{ "dp4",  { PICA_OP_DP4 },                 1 },
+	{ "dph",  { PICA_OP_DPH, PICA_OP_DPHI },   2 },
+	{ "rcp",  { PICA_OP_RCP },                 1 },
+	{ "rsq",  { PICA_OP_RSQ },                 1 },
+	{ "ex2",  { PICA_OP_EX2 },                 1 },
+	{ "lg2",  { PICA_OP_LG2 },                 1 },
+	{ "mova", { PICA_OP_MOVA },                1 },
+	{ "cmp",  { PICA_OP_CMP },                 1 },
+	{ "ifc",  { PICA_OP_IFC, PICA_OP_IFU },    2 },
+	{ "loop", { PICA_OP_LOOP },                1 },
+};
+
+#define NUM_FAMILIES (sizeof(families) / sizeof(families[0]))
+
+static u8 to_cycles(double cycles)
+{
+	if (!(cycles >= 1.0))
+		return 1;
+	if (cycles > 255.0)
+		return 255;
+	return (u8)lround(cycles);
+}
+
+bool pica_timing_load_costs(pica_timing_costs* costs, const char* path)
+{
+	FILE* f = fopen(path, "r");
+	if (!f)
+		return false;
+
+	// Cycles per instruction of a single unit, negative when missing
+	double chain[NUM_FAMILIES], independent[NUM_FAMILIES];
+	for (u32 i = 0; i < NUM_FAMILIES; i++)
+		chain[i] = independent[i] = -1.0;
+
+	char line[256];
+	while (fgets(line, sizeof(line), f)) {
+		char family[16], mode[16];
+		double cycles;
+		if (sscanf(line, "%15[^,],%15[^,],%lf", family, mode, &cycles) != 3)
+			continue; // header
+		for (u32 i = 0; i < NUM_FAMILIES; i++) {
+			if (strcmp(families[i].family, family))
+				continue;
+			if (!strcmp(mode, "chain"))
+				chain[i] = cycles * costs->units;
+			else
+				independent[i] = cycles * costs->units;
+		}
+	}
+	fclose(f);
+
+	for (u32 i = 0; i < NUM_FAMILIES; i++) {
+		for (u32 j = 0; j < families[i].count; j++) {
+			u32 op = families[i].ops[j];
+			if (independent[i] >= 0)
+				costs->issue[op] = to_cycles(independent[i]);
+			if (chain[i] >= 0)
+				costs->latency[op] = to_cycles(chain[i]);
+		}
+	}
+
+	// The mova and ifc chains alternate with the instruction that consumes the result, the loop
+	// iterates over a nop
+	for (u32 i = 0; i < NUM_FAMILIES; i++) {
+		if (!strcmp(families[i].family, "mova") && chain[i] >= 0)
+			costs->latency[PICA_OP_MOVA] = to_cycles(2 * chain[i] - costs->issue[PICA_OP_MOV]);
+		else if (!strcmp(families[i].family, "ifc") && chain[i] >= 0)
+			costs->latency[PICA_OP_CMP] = to_cycles(2 * chain[i] - costs->issue[PICA_OP_IFC]);
+		else if (!strcmp(families[i].family, "loop") && independent[i] >= 0)
+			costs->branch = to_cycles(independent[i] - costs->issue[PICA_OP_NOP]);
+	}
+	return true;
+}
+
+//
+// Replay of the executed instructions
+//
+
+// Registers tracked for dependencies: r0-r15, then a0, aL and the condition flags
+enum { DEP_A0 = 16, DEP_AL, DEP_FLAGS, NUM_DEPS };
+
+static bool is_alu(u32 op)
+{
+	return op < PICA_OP_BREAK || op >= PICA_OP_CMP;
+}
+
+static u32 alu_sources(u32 op)
+{
+	switch (op) {
+	case PICA_OP_EX2: case PICA_OP_LG2: case PICA_OP_LITP: case PICA_OP_FLR:
+	case PICA_OP_RCP: case PICA_OP_RSQ: case PICA_OP_MOVA: case PICA_OP_MOV:
+		return 1;
+	case PICA_OP_MAD: case PICA_OP_MADI:
+		return 3;
+	default:
+		return 2;
+	}
+}
+
+typedef struct {
+	u32 start;
+	u32 stall;
+	s32 pred; // the instruction this one waited for, or the previous one
+} replay_step;
+
+static bool reads_flags(u32 op)
+{
+	return op == PICA_OP_IFC || op == PICA_OP_CALLC || op == PICA_OP_JMPC || op == PICA_OP_BREAKC;
+}
+
+bool pica_timing_estimate(const pica_timing_costs* costs, const pica_shader_setup* setup, pica_shader_unit* unit,
+	pica_timing_report* report)
+{
+	memset(report, 0, sizeof(*report));
+
+	u16* trace = malloc(sizeof(u16) * PICA_SHADER_MAX_STEPS);
+	replay_step* steps = malloc(sizeof(replay_step) * PICA_SHADER_MAX_STEPS);
+	if (!trace || !steps) {
+		free(trace);
+		free(steps);
+		return false;
+	}
+
+	unit->trace = trace;
+	unit->trace_capacity = PICA_SHADER_MAX_STEPS;
+	bool ended = pica_shader_run(unit, setup);
+	unit->trace = NULL;
+	unit->trace_capacity = 0;
+
+	u32 ready[NUM_DEPS] = { 0 };
+	s32 producer[NUM_DEPS];
+	u16 inputs = 0, outputs = 0;
+	u32 cycle = 0, finish = 0;
+	s32 last = -1;
+
+	for (u32 d = 0; d < NUM_DEPS; d++)
+		producer[d] = -1;
+
+	report->instructions = unit->steps;
+	for (u32 k = 0; k < report->instructions; k++) {
+		pica_instr instr;
+		pica_shader_decode(setup->code[trace[k]], setup->opdesc, &instr);
+		u32 op = instr.op;
+
+		if (k && trace[k] != trace[k - 1] + 1)
+			cycle += costs->branch;
+
+		// Dependencies
+		u32 deps[5], num_deps = 0;
+		if (is_alu(op)) {
+			for (u32 s = 0; s < alu_sources(op); s++) {
+				u32 src = instr.src[s];
+				if (src < 0x10)
+					inputs |= 1 << src;
+				else if (src < 0x20)
+					deps[num_deps++] = src - 0x10;
+			}
+			if (instr.addr == 1 || instr.addr == 2)
+				deps[num_deps++] = DEP_A0;
+			else if (instr.addr == 3)
+				deps[num_deps++] = DEP_AL;
+		} else if (reads_flags(op)) {
+			deps[num_deps++] = DEP_FLAGS;
+		}
+
+		replay_step* step = &steps[k];
+		step->start = cycle;
+		step->pred = (s32)k - 1;
+		for (u32 i = 0; i < num_deps; i++) {
+			if (ready[deps[i]] > step->start) {
+				step->start = ready[deps[i]];
+				step->pred = producer[deps[i]];
+			}
+		}
+		step->stall = step->start - cycle;
+		report->stall_cycles += step->stall;
+
+		// Results
+		u32 writes[2], num_writes = 0;
+		if (op == PICA_OP_MOVA)
+			writes[num_writes++] = DEP_A0;
+		else if (op == PICA_OP_LOOP)
+			writes[num_writes++] = DEP_AL;
+		else if (op == PICA_OP_CMP)
+			writes[num_writes++] = DEP_FLAGS;
+		else if (is_alu(op)) {
+			if (op == PICA_OP_LITP)
+				writes[num_writes++] = DEP_FLAGS;
+			if (instr.dest < 0x10)
+				outputs |= 1 << instr.dest;
+			else
+				writes[num_writes++] = instr.dest - 0x10;
+		}
+
+		u32 done = step->start + (is_alu(op) ? costs->latency[op] : costs->issue[op]);
+		for (u32 i = 0; i < num_writes; i++) {
+			ready[writes[i]] = done;
+			producer[writes[i]] = k;
+		}
+		if (done >= finish) {
+			finish = done;
+			last = k;
+		}
+
+		cycle = step->start + costs->issue[op];
+	}
+
+	report->shader_cycles = cycle > finish ? cycle : finish;
+	report->inputs = __builtin_popcount(inputs);
+	report->outputs = __builtin_popcount(outputs);
+	report->input_cycles = report->inputs * costs->input_cycles;
+	report->output_cycles = report->outputs * costs->output_cycles;
+
+	float shader = (float)report->shader_cycles / (costs->units ? costs->units : 1);
+	report->cycles_per_vertex = shader;
+	report->bound = "shader";
+	if (report->input_cycles > report->cycles_per_vertex) {
+		report->cycles_per_vertex = report->input_cycles;
+		report->bound = "input";
+	}
+	if (report->output_cycles > report->cycles_per_vertex) {
+		report->cycles_per_vertex = report->output_cycles;
+		report->bound = "output";
+	}
+
+	// Walk the critical path back from the instruction that finished last
+	for (s32 k = last; k >= 0; k = steps[k].pred)
+		report->path_length++;
+	report->path = malloc(sizeof(pica_timing_step) * (report->path_length ? report->path_length : 1));
+	if (report->path) {
+		u32 i = report->path_length;
+		for (s32 k = last; k >= 0; k = steps[k].pred) {
+			pica_timing_step* step = &report->path[--i];
+			pica_instr instr;
+			pica_shader_decode(setup->code[trace[k]], setup->opdesc, &instr);
+			step->pc = trace[k];
+			step->op = instr.op;
+			step->start = steps[k].start;
+			step->stall = steps[k].stall;
+		}
+	} else {
+		report->path_length = 0;
+	}
+
+	free(trace);
+	free(steps);
+	return ended;
+}
+
+void pica_timing_report_free(pica_timing_report* report)
+{
+	free(report->path);
+	report->path = NULL;
+	report->path_length = 0;
+}
@@ -0,0 +1,61 @@
+/*
+ * Cycle-approximate timing of the vertex shader units
+ * Replays the instructions one vertex executes on a single unit, in order: an instruction issues once the
+ * registers it reads are ready and its result is ready after the instruction's latency. The vertex loader
+ * and the output path are shared by the units, the slowest of them bounds the cycles per vertex.
+ * Dependencies are tracked per register rather than per component.
+ */
+
+#pragma once
+#include <3ds/types.h>
+#include "shader.h"
+
+#define PICA_TIMING_OPS 64
+
+typedef struct {
+	u8 latency[PICA_TIMING_OPS]; // cycles until the result can be read, by opcode
+	u8 issue[PICA_TIMING_OPS];   // cycles until the next instruction can issue
+	u32 branch;                  // extra cycles of a jump, call, return or loop iteration
+	u32 input_cycles;            // per input attribute the shader reads
+	u32 output_cycles;           // per output register the shader writes
+	u32 units;                   // vertex shader units working in parallel
+} pica_timing_costs;
+
+// One instruction of the critical path
+typedef struct {
+	u32 pc;
+	u32 op;
+	u32 start; // cycle the instruction issues at
+	u32 stall; // cycles it waited for its sources
+} pica_timing_step;
+
+typedef struct {
+	u32 instructions;      // executed for the vertex
+	u32 shader_cycles;     // on one unit, until the last result is ready
+	u32 stall_cycles;      // of them spent waiting for sources
+	u32 inputs, outputs;   // registers read and written
+	u32 input_cycles, output_cycles;
+	float cycles_per_vertex; // with every unit busy
+	const char* bound;     // "shader", "input" or "output"
+
+	// From the first instruction to the one the vertex finishes with, following the instructions
+	// each stalled on, or the previous one when it did not stall
+	pica_timing_step* path;
+	u32 path_length;
+} pica_timing_report;
+
+// Placeholder costs, to be replaced by the fit of the bench-tests timings
+void pica_timing_default_costs(pica_timing_costs* costs);
+
+// Applies the output of host/tools/benchfit: chained timings give latencies, independent ones issue
+// rates. Returns false when the file cannot be read.
+bool pica_timing_load_costs(pica_timing_costs* costs, const char* path);
+
+// Runs the shader on the unit's inputs and times the instructions it executed.
+// Returns false if the shader did not end, the report must be released with pica_timing_report_free.
+bool pica_timing_estimate(const pica_timing_costs* costs, const pica_shader_setup* setup, pica_shader_unit* unit,
+	pica_timing_report* report);
+
+void pica_timing_report_free(pica_timing_report* report);
+
+const char* pica_timing_op_name(u32 op);
@@ -0,0 +1,143 @@
+#include <pthread.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include "units.h"
+
+#define MAX_THREADS 64
+
+// A job is posted under the lock by bumping the generation. The workers join it by incrementing busy under
+// the lock, then claim batches from next without it. The poster waits for busy to drop to zero before it
+// returns or posts the next job, so the job fields never change under a worker.
+static struct {
+	pthread_mutex_t lock;
+	pthread_cond_t wake; // a job was posted
+	pthread_cond_t idle; // busy dropped to zero
+
+	u32 requested;  // pica_units_set_threads
+	u32 started;    // worker threads, they are never stopped
+	u32 active;     // workers taking part in jobs, the others keep sleeping
+	u32 generation;
+	u32 busy;
+
+	pica_units_job job;
+	void* arg;
+	u32 count;
+	u32 batches;
+	u32 next;       // next batch to claim, updated atomically
+} pool = { PTHREAD_MUTEX_INITIALIZER, PTHREAD_COND_INITIALIZER, PTHREAD_COND_INITIALIZER };
+
+static void run_batches(pica_shader_unit* unit)
+{
+	for (;;) {
+		u32 batch = __atomic_fetch_add(&pool.next, 1, __ATOMIC_RELAXED);
+		if (batch >= pool.batches)
+			return;
+
+		u32 first = batch * PICA_UNIT_BATCH;
+		u32 count = pool.count - first < PICA_UNIT_BATCH ? pool.count - first : PICA_UNIT_BATCH;
+		pool.job(pool.arg, unit, first, count);
+	}
+}
+
+typedef struct {
+	u32 index;
+	u32 generation; // the last job the worker saw
+} worker_start;
+
+static void* worker(void* arg)
+{
+	pica_shader_unit unit;
+	worker_start start = *(worker_start*)arg;
+	u32 seen = start.generation;
+	free(arg);
+
+	pthread_mutex_lock(&pool.lock);
+	for (;;) {
+		while (pool.generation == seen)
+			pthread_cond_wait(&pool.wake, &pool.lock);
+		seen = pool.generation;
+		if (start.index >= pool.active)
+			continue;
+
+		pool.busy++;
+		pthread_mutex_unlock(&pool.lock);
+		run_batches(&unit);
+		pthread_mutex_lock(&pool.lock);
+		if (--pool.busy == 0)
+			pthread_cond_signal(&pool.idle);
+	}
+	return NULL;
+}
+
+void pica_units_set_threads(u32 threads)
+{
+	pool.requested = threads;
+}
+
+static u32 thread_count(void)
+{
+	u32 threads = pool.requested;
+	if (!threads) {
+		const char* env = getenv("PICA_THREADS");
+		if (env)
+			threads = atoi(env);
+	}
+	if (!threads) {
+		long cores = sysconf(_SC_NPROCESSORS_ONLN);
+		threads = cores > 0 ? cores : 1;
+	}
+	return threads > MAX_THREADS ? MAX_THREADS : threads;
+}
+
+void pica_units_run(u32 count, pica_units_job job, void* arg)
+{
+	static pica_shader_unit unit; // the calling thread's
+	u32 batches = (count + PICA_UNIT_BATCH - 1) / PICA_UNIT_BATCH;
+	u32 threads = thread_count();
+
+	if (batches <= 1 || threads <= 1) {
+		for (u32 first = 0; first < count; first += PICA_UNIT_BATCH)
+			job(arg, &unit, first, count - first < PICA_UNIT_BATCH ? count - first : PICA_UNIT_BATCH);
+		return;
+	}
+
+	// More workers than batches would only wake up for nothing
+	u32 workers = (threads < batches ? threads : batches) - 1;
+
+	pthread_mutex_lock(&pool.lock);
+	while (pool.started < workers) {
+		worker_start* start = malloc(sizeof(*start));
+		pthread_t thread;
+		if (!start)
+			break;
+		start->index = pool.started;
+		start->generation = pool.generation;
+		if (pthread_create(&thread, NULL, worker, start)) {
+			free(start);
+			break;
+		}
+		pthread_detach(thread);
+		pool.started++;
+	}
+	while (pool.busy)
+		pthread_cond_wait(&pool.idle, &pool.lock);
+
+	pool.job = job;
+	pool.arg = arg;
+	pool.count = count;
+	pool.batches = batches;
+	pool.next = 0;
+	pool.active = workers;
+	pool.generation++;
+	pthread_cond_broadcast(&pool.wake);
+	pthread_mutex_unlock(&pool.lock);
+
+	run_batches(&unit);
+
+	// Every batch has been claimed, wait for the workers still shading theirs
+	pthread_mutex_lock(&pool.lock);
+	while (pool.busy)
+		pthread_cond_wait(&pool.idle, &pool.lock);
+	pthread_mutex_unlock(&pool.lock);
+}
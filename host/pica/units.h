@@ -0,0 +1,24 @@
+/*
+ * Vertex shader units
+ * The PICA200 spreads vertices over four shader units. The host model does the same over a pool of worker
+ * threads, each owning a pica_shader_unit: a draw is cut into fixed batches of PICA_UNIT_BATCH vertices that
+ * the workers claim with an atomic counter. Every vertex starts from cleared registers and writes its results
+ * at the vertices' positions, so the output does not depend on the number of threads or on scheduling.
+ */
+
+#pragma once
+#include <3ds/types.h>
+#include "shader.h"
+
+#define PICA_UNIT_BATCH 64
+
+// Shades the vertices [first, first + count) on unit
+typedef void (*pica_units_job)(void* arg, pica_shader_unit* unit, u32 first, u32 count);
+
+// Threads shading vertices, the calling thread included. 0 (the default) uses the PICA_THREADS environment
+// variable, or one thread per core without it.
+void pica_units_set_threads(u32 threads);
+
+// Runs job over the vertices [0, count) and returns once every batch is done.
+// Draws of a single batch run on the calling thread.
+void pica_units_run(u32 count, pica_units_job job, void* arg);
@@ -0,0 +1,392 @@
+#include <stdlib.h>
+#include <string.h>
+#include "pica.h"
+#include "float24.h"
+#include "rasterizer.h"
+#include "shader_batch.h"
+#include "units.h"
+
+#define NUM_ATTRIBUTES 12
+
+// Attribute layout of the vertex loader, decoded once per draw
+typedef struct {
+	u32 num_attributes;
+	u32 format[NUM_ATTRIBUTES];       // 0: s8, 1: u8, 2: s16, 3: float
+	u32 count[NUM_ATTRIBUTES];        // components per attribute
+	const u8* data[NUM_ATTRIBUTES];   // start of the attribute in the first vertex, NULL if not loaded
+	u32 stride[NUM_ATTRIBUTES];
+	u32 input_reg[NUM_ATTRIBUTES];    // shader input register the attribute is loaded to
+} vertex_loader;
+
+static const u32 element_size[4] = { 1, 1, 2, 4 };
+
+static void setup_loader(vertex_loader* loader)
+{
+	const u32* regs = pica.regs;
+	u32 base = regs[PICA_REG_ATTRIBBUFFERS_LOC] << 3;
+	u64 formats = regs[PICA_REG_ATTRIBBUFFERS_FORMAT_LOW] | ((u64)(regs[PICA_REG_ATTRIBBUFFERS_FORMAT_HIGH] & 0xFFFF) << 32);
+	u64 permutation = regs[PICA_REG_VSH_ATTRIBUTES_PERMUTATION_LOW] | ((u64)regs[PICA_REG_VSH_ATTRIBUTES_PERMUTATION_HIGH] << 32);
+
+	memset(loader, 0, sizeof(*loader));
+	loader->num_attributes = (regs[PICA_REG_ATTRIBBUFFERS_FORMAT_HIGH] >> 28) + 1;
+
+	for (u32 i = 0; i < NUM_ATTRIBUTES; i++) {
+		u32 fmt = (formats >> (4 * i)) & 0xF;
+		loader->format[i] = fmt & 3;
+		loader->count[i] = ((fmt >> 2) & 3) + 1;
+		loader->input_reg[i] = (permutation >> (4 * i)) & 0xF;
+	}
+
+	// Each buffer lists the attributes it holds in order, padding entries skip bytes
+	for (u32 j = 0; j < NUM_ATTRIBUTES; j++) {
+		const u32* buf = &regs[PICA_REG_ATTRIBBUFFER0_OFFSET + 3 * j];
+		u64 components = buf[1] | ((u64)(buf[2] & 0xFFFF) << 32);
+		u32 num_components = buf[2] >> 28;
+		u32 stride = (buf[2] >> 16) & 0xFFF;
+		u32 offset = 0;
+
+		for (u32 k = 0; k < num_components; k++) {
+			u32 attr = (components >> (4 * k)) & 0xF;
+			if (attr >= NUM_ATTRIBUTES) {
+				offset += (attr - 11) * 4;
+				continue;
+			}
+
+			u32 size = element_size[loader->format[attr]];
+			offset = (offset + size - 1) & ~(size - 1);
+			loader->data[attr] = pica_phys_to_ptr(base + buf[0] + offset);
+			loader->stride[attr] = stride;
+			offset += size * loader->count[attr];
+		}
+	}
+}
+
+static void load_vertex(const vertex_loader* loader, u32 index, float (*input)[4])
+{
+	for (u32 i = 0; i < loader->num_attributes; i++) {
+		float* in = input[loader->input_reg[i]];
+		in[0] = in[1] = in[2] = 0.0f;
+		in[3] = 1.0f;
+
+		if (!loader->data[i])
+			continue;
+
+		const u8* src = loader->data[i] + index * loader->stride[i];
+		for (u32 c = 0; c < loader->count[i]; c++) {
+			switch (loader->format[i]) {
+			case 0: in[c] = (s8)src[c]; break;
+			case 1: in[c] = src[c]; break;
+			case 2: { s16 v; memcpy(&v, src + 2 * c, 2); in[c] = v; break; }
+			case 3: { float v; memcpy(&v, src + 4 * c, 4); in[c] = f24_round(v); break; }
+			}
+		}
+	}
+}
+
+// Copies the shader outputs to their semantics, enabled output registers are numbered in mask order
+static void map_outputs(const float (*output)[4], pica_output_vertex* out)
+{
+	const u32* regs = pica.regs;
+	u32 mask = regs[PICA_REG_VSH_OUTMAP_MASK];
+	u32 total = regs[PICA_REG_SH_OUTMAP_TOTAL] & 7;
+	float* dst = (float*)out;
+	u32 k = 0;
+
+	memset(out, 0, sizeof(*out));
+	for (u32 reg = 0; reg < 16 && k < total; reg++) {
+		if (!(mask & (1 << reg)))
+			continue;
+
+		u32 semantics = regs[PICA_REG_SH_OUTMAP_O0 + k++];
+		for (int c = 0; c < 4; c++) {
+			u32 s = (semantics >> (8 * c)) & 0x1F;
+			if (s < sizeof(*out) / sizeof(float))
+				dst[s] = output[reg][c];
+		}
+	}
+}
+
+static void sync_shader_setup(void)
+{
+	const u32* regs = pica.regs;
+
+	pica.vs.b = regs[PICA_REG_VSH_BOOLUNIFORM] & 0xFFFF;
+	pica.vs.entry = regs[PICA_REG_VSH_ENTRYPOINT] & 0xFFFF;
+	for (int i = 0; i < 4; i++) {
+		u32 v = regs[PICA_REG_VSH_INTUNIFORM_I0 + i];
+		pica.vs.i[i][0] = v & 0xFF;
+		pica.vs.i[i][1] = (v >> 8) & 0xFF;
+		pica.vs.i[i][2] = (v >> 16) & 0xFF;
+		pica.vs.i[i][3] = (v >> 24) & 0xFF;
+	}
+}
+
+// Vertices shaded before they go through primitive assembly, bounds the memory of the outputs of large draws
+#define SHADE_CHUNK (64 * PICA_UNIT_BATCH)
+
+typedef struct {
+	const vertex_loader* loader;
+	const u8* indices;
+	u32 index_config;
+	u32 first;                 // draw vertex of out[0]
+	const u32* list;           // chunk positions to shade, NULL for all of them
+	const pica_shader_program* program; // NULL when the interpreter shades the draw
+	pica_output_vertex* out;
+} shade_job;
+
+static u32 vertex_index(const shade_job* job, u32 vertex)
+{
+	if (!job->indices)
+		return pica.regs[PICA_REG_VERTEX_OFFSET] + vertex;
+	if (job->index_config >> 31)
+		return job->indices[2 * vertex] | (job->indices[2 * vertex + 1] << 8);
+	return job->indices[vertex];
+}
+
+// Shades n <= PICA_SHADER_LANES vertices from chunk position k on the batch engine, unused lanes stay zero
+static void shade_lanes(const shade_job* job, pica_shader_batch* batch, u32 k, u32 n)
+{
+	float regs[16][4];
+
+	memset(batch, 0, sizeof(*batch));
+	for (u32 lane = 0; lane < n; lane++) {
+		u32 i = job->list ? job->list[k + lane] : k + lane;
+		memset(regs, 0, sizeof(regs));
+		load_vertex(job->loader, vertex_index(job, job->first + i), regs);
+		for (int r = 0; r < 16; r++)
+			for (int c = 0; c < 4; c++)
+				batch->input[r][c][lane] = regs[r][c];
+	}
+
+	pica_shader_batch_run(batch, job->program, &pica.vs);
+
+	for (u32 lane = 0; lane < n; lane++) {
+		u32 i = job->list ? job->list[k + lane] : k + lane;
+		for (int r = 0; r < 16; r++)
+			for (int c = 0; c < 4; c++)
+				regs[r][c] = batch->output[r][c][lane];
+		map_outputs((const float (*)[4])regs, &job->out[i]);
+	}
+}
+
+static void shade_batch(void* arg, pica_shader_unit* unit, u32 first, u32 count)
+{
+	static __thread pica_shader_batch batch;
+	const shade_job* job = arg;
+
+	if (job->program) {
+		for (u32 k = first; k < first + count; k += PICA_SHADER_LANES)
+			shade_lanes(job, &batch, k, first + count - k < PICA_SHADER_LANES ? first + count - k : PICA_SHADER_LANES);
+		return;
+	}
+
+	for (u32 k = first; k < first + count; k++) {
+		u32 i = job->list ? job->list[k] : k;
+		memset(unit, 0, sizeof(*unit));
+		load_vertex(job->loader, vertex_index(job, job->first + i), unit->input);
+		pica_shader_run(unit, &pica.vs);
+		map_outputs((const float (*)[4])unit->output, &job->out[i]);
+	}
+}
+
+static int batch_engine = -1; // -1 until PICA_SHADER_BATCH is looked up
+
+// The batch engine is on unless PICA_SHADER_BATCH=0, and only for programs it accepts
+static const pica_shader_program* batch_program(void)
+{
+	static pica_shader_program program;
+
+	if (batch_engine < 0) {
+		const char* env = getenv("PICA_SHADER_BATCH");
+		batch_engine = !env || atoi(env);
+	}
+	if (!batch_engine)
+		return NULL;
+
+	pica_shader_batch_compile(&program, &pica.vs);
+	return program.valid ? &program : NULL;
+}
+
+//
+// Post-transform vertex cache
+//
+
+// Looked up by vertex index for indexed draws. Deduplicated non-indexed draws look vertices up by their
+// inputs instead, hashed and compared in full on a hash match.
+typedef struct {
+	bool valid[PICA_VERTEX_CACHE_SIZE];
+	u32 key[PICA_VERTEX_CACHE_SIZE];
+	float inputs[PICA_VERTEX_CACHE_SIZE][NUM_ATTRIBUTES][4];
+	s32 pending[PICA_VERTEX_CACHE_SIZE]; // chunk position of the vertex filling the entry, -1 once in out
+	pica_output_vertex out[PICA_VERTEX_CACHE_SIZE];
+	u32 next;                            // entry replaced by the next miss
+} vertex_cache;
+
+static pica_vertex_cache_stats cache_stats;
+static int dedup = -1; // -1 until PICA_VERTEX_DEDUP is looked up
+
+void pica_vertex_cache_get_stats(pica_vertex_cache_stats* stats)
+{
+	*stats = cache_stats;
+}
+
+void pica_vertex_cache_set_dedup(bool enable)
+{
+	dedup = enable;
+}
+
+static bool dedup_enabled(void)
+{
+	if (dedup < 0) {
+		const char* env = getenv("PICA_VERTEX_DEDUP");
+		dedup = env && atoi(env);
+	}
+	return dedup;
+}
+
+// FNV-1a over the loaded input registers
+static u32 hash_inputs(const float (*inputs)[4], u32 num_attributes)
+{
+	const u8* p = (const u8*)inputs;
+	u32 hash = 2166136261u;
+	for (u32 i = 0; i < num_attributes * 4 * sizeof(float); i++)
+		hash = (hash ^ p[i]) * 16777619u;
+	return hash;
+}
+
+// Looks up the n vertices of the chunk in order. Hits on entries of earlier chunks get their outputs
+// copied, hits on entries this chunk fills point source at the missing vertex. Returns the number of
+// misses, listed in misses.
+static u32 cache_plan(vertex_cache* cache, const shade_job* job, bool by_inputs, u32 n,
+	pica_output_vertex* out, u32* source, u32* misses)
+{
+	const vertex_loader* loader = job->loader;
+	float inputs[NUM_ATTRIBUTES][4];
+	u32 num_misses = 0;
+
+	for (u32 i = 0; i < n; i++) {
+		u32 key = vertex_index(job, job->first + i);
+		if (by_inputs) {
+			float regs[16][4];
+			load_vertex(loader, key, regs);
+			for (u32 a = 0; a < loader->num_attributes; a++)
+				memcpy(inputs[a], regs[loader->input_reg[a]], sizeof(inputs[a]));
+			key = hash_inputs(inputs, loader->num_attributes);
+		}
+
+		u32 slot;
+		for (slot = 0; slot < PICA_VERTEX_CACHE_SIZE; slot++) {
+			if (cache->valid[slot] && cache->key[slot] == key &&
+				(!by_inputs || !memcmp(cache->inputs[slot], inputs, loader->num_attributes * sizeof(inputs[0]))))
+				break;
+		}
+
+		if (slot < PICA_VERTEX_CACHE_SIZE) {
+			cache_stats.hits++;
+			if (cache->pending[slot] >= 0) {
+				source[i] = cache->pending[slot];
+			} else {
+				out[i] = cache->out[slot];
+				source[i] = i;
+			}
+			continue;
+		}
+
+		cache_stats.misses++;
+		slot = cache->next;
+		cache->next = (cache->next + 1) % PICA_VERTEX_CACHE_SIZE;
+		cache->valid[slot] = true;
+		cache->key[slot] = key;
+		if (by_inputs)
+			memcpy(cache->inputs[slot], inputs, loader->num_attributes * sizeof(inputs[0]));
+		cache->pending[slot] = i;
+		source[i] = i;
+		misses[num_misses++] = i;
+	}
+	return num_misses;
+}
+
+// Keeps the outputs of the entries the chunk filled for the next chunks
+static void cache_fill(vertex_cache* cache, const pica_output_vertex* out)
+{
+	for (u32 slot = 0; slot < PICA_VERTEX_CACHE_SIZE; slot++) {
+		if (cache->pending[slot] >= 0) {
+			cache->out[slot] = out[cache->pending[slot]];
+			cache->pending[slot] = -1;
+		}
+	}
+}
+
+void pica_draw(bool indexed)
+{
+	const u32* regs = pica.regs;
+	u32 count = regs[PICA_REG_NUMVERTICES];
+	u32 topology = (regs[PICA_REG_PRIMITIVE_CONFIG] >> 8) & 3;
+	u32 index_config = regs[PICA_REG_INDEXBUFFER_CONFIG];
+	static pica_output_vertex shaded[SHADE_CHUNK];
+	static u32 source[SHADE_CHUNK], misses[SHADE_CHUNK];
+	static vertex_cache cache;
+
+	vertex_loader loader;
+	shade_job job = { &loader, NULL, index_config, 0, NULL, NULL, shaded };
+	pica_output_vertex tri[3];
+	bool by_inputs = !indexed && dedup_enabled();
+	bool cached = indexed || by_inputs;
+
+	sync_shader_setup();
+	setup_loader(&loader);
+	job.program = batch_program();
+	if (indexed) {
+		job.indices = pica_phys_to_ptr((regs[PICA_REG_ATTRIBBUFFERS_LOC] << 3) + (index_config & 0x0FFFFFFF));
+		if (!job.indices)
+			return;
+	}
+
+	// The cache starts empty for every draw
+	memset(cache.valid, 0, sizeof(cache.valid));
+	memset(cache.pending, -1, sizeof(cache.pending));
+	cache.next = 0;
+
+	pica_rasterizer_begin();
+
+	for (u32 i = 0; i < count; i++) {
+		// The units shade the next chunk in parallel, assembly goes through it in order
+		u32 k = i % SHADE_CHUNK;
+		if (k == 0) {
+			u32 n = count - i < SHADE_CHUNK ? count - i : SHADE_CHUNK;
+			job.first = i;
+			if (cached) {
+				job.list = misses;
+				pica_units_run(cache_plan(&cache, &job, by_inputs, n, shaded, source, misses), shade_batch, &job);
+				cache_fill(&cache, shaded);
+			} else {
+				pica_units_run(n, shade_batch, &job);
+			}
+		}
+		const pica_output_vertex* v = &shaded[cached ? source[k] : k];
+
+		// Primitive assembly: triangle lists, strips alternate their winding, fans keep the first vertex
+		if (i < 2) {
+			tri[i] = *v;
+			continue;
+		}
+
+		if (topology == 1) {
+			if (i & 1)
+				pica_rasterize_triangle(&tri[1], &tri[0], v);
+			else
+				pica_rasterize_triangle(&tri[0], &tri[1], v);
+			tri[0] = tri[1];
+			tri[1] = *v;
+		} else if (topology == 2) {
+			pica_rasterize_triangle(&tri[0], &tri[1], v);
+			tri[1] = *v;
+		} else if (i % 3 == 2) {
+			pica_rasterize_triangle(&tri[0], &tri[1], v);
+		} else {
+			tri[i % 3] = *v;
+		}
+	}
+
+	pica_rasterizer_end();
+}
@@ -0,0 +1,125 @@
+/*
+ * Fits a cost per instruction to the timings bench-tests writes to bench-results.csv
+ * usage: benchfit bench-results.csv...
+ *
+ * For each family and mode, ticks per vertex are fitted to a + b * instructions by least squares.
+ * b is the cost of one instruction and a the cost of the rest of the draw, both in GPU cycles per vertex.
+ * Prints family,mode,cycles,overhead,r2 as CSV.
+ */
+
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define MAX_SERIES 64
+#define MAX_POINTS 32
+
+typedef struct {
+	char family[16];
+	char mode[16];
+	int count;
+	double x[MAX_POINTS]; // instructions
+	double y[MAX_POINTS]; // ticks per vertex
+} series;
+
+static series all[MAX_SERIES];
+static int series_count;
+
+static series* find_series(const char* family, const char* mode)
+{
+	for (int i = 0; i < series_count; i++) {
+		if (!strcmp(all[i].family, family) && !strcmp(all[i].mode, mode))
+			return &all[i];
+	}
+	if (series_count == MAX_SERIES)
+		return NULL;
+
+	series* s = &all[series_count++];
+	snprintf(s->family, sizeof(s->family), "%s", family);
+	snprintf(s->mode, sizeof(s->mode), "%s", mode);
+	return s;
+}
+
+static bool load(const char* path)
+{
+	FILE* f = fopen(path, "r");
+	if (!f) {
+		fprintf(stderr, "%s: cannot open\n", path);
+		return false;
+	}
+
+	char line[256];
+	int number = 0;
+	while (fgets(line, sizeof(line), f)) {
+		char family[16], mode[16];
+		unsigned instructions, vertices;
+		unsigned long long ticks;
+
+		number++;
+		if (number == 1 && !strncmp(line, "family,", 7))
+			continue;
+		if (sscanf(line, "%15[^,],%15[^,],%u,%u,%llu", family, mode, &instructions, &vertices, &ticks) != 5 || !vertices) {
+			fprintf(stderr, "%s:%d: malformed line\n", path, number);
+			continue;
+		}
+
+		series* s = find_series(family, mode);
+		if (!s || s->count == MAX_POINTS) {
+			fprintf(stderr, "%s:%d: too many timings, ignored\n", path, number);
+			continue;
+		}
+		s->x[s->count] = instructions;
+		s->y[s->count] = (double)ticks / vertices;
+		s->count++;
+	}
+
+	fclose(f);
+	return true;
+}
+
+static void fit(const series* s)
+{
+	double sx = 0, sy = 0, sxx = 0, sxy = 0, syy = 0;
+	int n = s->count;
+
+	for (int i = 0; i < n; i++) {
+		sx += s->x[i];
+		sy += s->y[i];
+		sxx += s->x[i] * s->x[i];
+		sxy += s->x[i] * s->y[i];
+		syy += s->y[i] * s->y[i];
+	}
+
+	double dx = n * sxx - sx * sx;
+	if (n < 2 || dx == 0) {
+		fprintf(stderr, "%s %s: needs timings of two shader lengths\n", s->family, s->mode);
+		return;
+	}
+
+	double b = (n * sxy - sx * sy) / dx;
+	double a = (sy - b * sx) / n;
+	double dy = n * syy - sy * sy;
+	double r2 = dy > 0 ? (n * sxy - sx * sy) * (n * sxy - sx * sy) / (dx * dy) : 1.0;
+	printf("%s,%s,%.4f,%.4f,%.6f\n", s->family, s->mode, b, a, r2);
+}
+
+int main(int argc, char** argv)
+{
+	int status = 0;
+
+	if (argc < 2) {
+		fprintf(stderr, "usage: %s bench-results.csv...\n", argv[0]);
+		return 2;
+	}
+
+	for (int i = 1; i < argc; i++) {
+		if (!load(argv[i]))
+			status = 1;
+	}
+
+	printf("family,mode,cycles,overhead,r2\n");
+	for (int i = 0; i < series_count; i++)
+		fit(&all[i]);
+	return status;
+}
@@ -0,0 +1,221 @@
+/*
+ * Test case compiler
+ * usage: casec -o table.bin file.cases
+ *
+ * Compiles a text file of single instruction test cases into the packed table caserun maps (casetable.h).
+ * One case per line, ';' starts a comment:
+ *
+ *   dph (0.5, 0, 0.5, 0) (0.5, 0, 0.5, 0.5) -> 1
+ *   rcp 10 -> 0.1 ~2
+ *   mova 0.9 -> (0, 0, *, *)
+ *
+ * The instruction is followed by its sources and, after "->", by the expected result. A vector is either one
+ * value for all four components or four of them in parentheses. Values are floats, inf, -inf or nan, and the
+ * expected result may leave components out with '*'. "~n" accepts results within n ulps, NaN matches any NaN.
+ * Sources are truncated to float24 like the GPU does with uniforms, the expected values are kept as written.
+ */
+
+#include <ctype.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "float24.h"
+#include "casetable.h"
+
+typedef struct {
+	const char* path;
+	u32 line;
+	const char* p;
+} parser;
+
+static void fail(const parser* ps, const char* message)
+{
+	fprintf(stderr, "%s:%u: %s\n", ps->path, (unsigned)ps->line, message);
+	exit(1);
+}
+
+static void skip_spaces(parser* ps)
+{
+	while (*ps->p == ' ' || *ps->p == '\t')
+		ps->p++;
+}
+
+static bool accept(parser* ps, const char* token)
+{
+	skip_spaces(ps);
+	size_t length = strlen(token);
+	if (strncmp(ps->p, token, length))
+		return false;
+	ps->p += length;
+	return true;
+}
+
+// A value, or '*' when wildcard is set, which returns false
+static bool parse_scalar(parser* ps, float* value, bool wildcard)
+{
+	skip_spaces(ps);
+	if (wildcard && *ps->p == '*') {
+		ps->p++;
+		return false;
+	}
+
+	char* end;
+	*value = strtof(ps->p, &end);
+	if (end == ps->p)
+		fail(ps, "expected a number, inf or nan");
+	ps->p = end;
+	return true;
+}
+
+// Returns the mask of the components given a value
+static u8 parse_vector(parser* ps, float* v, bool wildcard)
+{
+	u8 mask = 0;
+
+	if (!accept(ps, "(")) {
+		bool set = parse_scalar(ps, &v[0], wildcard);
+		v[1] = v[2] = v[3] = v[0];
+		return set ? 0xF : 0;
+	}
+	for (int i = 0; i < 4; i++) {
+		if (i && !accept(ps, ","))
+			fail(ps, "expected ',' between the components");
+		if (parse_scalar(ps, &v[i], wildcard))
+			mask |= 1 << i;
+	}
+	if (!accept(ps, ")"))
+		fail(ps, "expected ')' after 4 components");
+	return mask;
+}
+
+static const case_instruction* parse_instruction(parser* ps)
+{
+	const char* start = ps->p;
+	while (isalnum((unsigned char)*ps->p))
+		ps->p++;
+
+	for (u32 i = 0; i < NUM_CASE_INSTRUCTIONS; i++)
+		if (strlen(case_instructions[i].name) == (size_t)(ps->p - start) &&
+			!strncmp(case_instructions[i].name, start, ps->p - start))
+			return &case_instructions[i];
+	fail(ps, "unknown instruction");
+	return NULL;
+}
+
+static void parse_case(parser* ps, case_record* r)
+{
+	const case_instruction* ins = parse_instruction(ps);
+	float src[4];
+
+	memset(r, 0, sizeof(*r));
+	r->op = ins->op;
+	r->line = ps->line;
+
+	for (int s = 0; s < ins->sources; s++) {
+		skip_spaces(ps);
+		if (!strncmp(ps->p, "->", 2))
+			fail(ps, ins->sources == 1 ? "expected 1 source" :
+				ins->sources == 2 ? "expected 2 sources" : "expected 3 sources");
+		parse_vector(ps, src, false);
+		for (int i = 0; i < 4; i++)
+			case_set_f24(r->src[s][i], f32_to_f24(src[i]));
+	}
+	if (!accept(ps, "->"))
+		fail(ps, "expected '->' after the sources");
+	r->check = parse_vector(ps, r->expected, true);
+
+	if (accept(ps, "~")) {
+		char* end;
+		long ulps = strtol(ps->p, &end, 10);
+		if (end == ps->p || ulps < 0 || ulps > 255)
+			fail(ps, "expected a tolerance of 0 to 255 ulps after '~'");
+		r->ulps = ulps;
+		ps->p = end;
+	}
+
+	skip_spaces(ps);
+	if (*ps->p && *ps->p != ';' && *ps->p != '\n' && *ps->p != '\r')
+		fail(ps, "unexpected text after the case");
+}
+
+static int by_instruction(const void* a, const void* b)
+{
+	const case_record* x = a;
+	const case_record* y = b;
+	if (x->op != y->op)
+		return x->op < y->op ? -1 : 1;
+	return x->line < y->line ? -1 : x->line > y->line;
+}
+
+int main(int argc, char** argv)
+{
+	const char* out_path = NULL;
+	const char* in_path = NULL;
+
+	for (int i = 1; i < argc; i++) {
+		if (!strcmp(argv[i], "-o") && i + 1 < argc)
+			out_path = argv[++i];
+		else
+			in_path = argv[i];
+	}
+	if (!out_path || !in_path) {
+		fprintf(stderr, "usage: %s -o table.bin file.cases\n", argv[0]);
+		return 2;
+	}
+
+	FILE* in = fopen(in_path, "r");
+	if (!in) {
+		fprintf(stderr, "cannot open %s\n", in_path);
+		return 1;
+	}
+
+	case_record* records = NULL;
+	u32 count = 0, capacity = 0;
+	char text[1024];
+	parser ps = { in_path, 0, NULL };
+
+	while (fgets(text, sizeof(text), in)) {
+		ps.line++;
+		ps.p = text;
+		skip_spaces(&ps);
+		if (!*ps.p || *ps.p == ';' || *ps.p == '\n' || *ps.p == '\r')
+			continue;
+
+		if (count == capacity) {
+			capacity = capacity ? 2 * capacity : 1024;
+			records = realloc(records, capacity * sizeof(case_record));
+			if (!records) {
+				fprintf(stderr, "out of memory\n");
+				return 1;
+			}
+		}
+		parse_case(&ps, &records[count++]);
+	}
+	fclose(in);
+
+	qsort(records, count, sizeof(case_record), by_instruction);
+
+	case_table_header header;
+	const char* name = strrchr(in_path, '/');
+	memset(&header, 0, sizeof(header));
+	header.magic = CASE_TABLE_MAGIC;
+	header.version = CASE_TABLE_VERSION;
+	header.record_size = sizeof(case_record);
+	header.count = count;
+	strncpy(header.source, name ? name + 1 : in_path, sizeof(header.source) - 1);
+
+	FILE* out = fopen(out_path, "wb");
+	if (!out) {
+		fprintf(stderr, "cannot write %s\n", out_path);
+		return 1;
+	}
+	fwrite(&header, sizeof(header), 1, out);
+	fwrite(records, sizeof(case_record), count, out);
+	if (fclose(out)) {
+		fprintf(stderr, "cannot write %s\n", out_path);
+		remove(out_path);
+		return 1;
+	}
+	free(records);
+	return 0;
+}
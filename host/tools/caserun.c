@@ -0,0 +1,593 @@
+/*
+ * Test case runner
+ * usage: caserun [--interpreter] [--shard=i/n] [--jobs=n] [--cache=dir] table.bin...
+ *
+ * Maps the tables casec compiled and runs every case on the batch engine, 16 cases of one instruction per
+ * batch, or on the interpreter with --interpreter. Each case runs "op o0, v0, v1 (, v2)" with the sources in
+ * v0-v2 and compares the components of o0 its record checks. Failures are printed with their file and line,
+ * the exit status is 1 when any case failed.
+ *
+ * The cases of all the tables are numbered in order. --shard=i/n runs only the i-th (from 0) of n contiguous
+ * parts of them, for spreading a large corpus over machines, and the parts are split again between --jobs
+ * worker processes, one per core by default. Failures are reported in case order whatever the split, so the
+ * outputs of shards 0 to n-1 put end to end list the same failures as a single run.
+ *
+ * --cache keeps the results in a content addressed directory, by pages of 256 cases keyed by this build,
+ * the programs and the sources, and runs only the pages it does not have.
+ */
+
+#include <fcntl.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include "float24.h"
+#include "shader.h"
+#include "shader_batch.h"
+#include "casetable.h"
+
+#define MIN_CASES_PER_JOB 4096 // below that a worker process costs more than it saves
+
+static void load_sources(const case_record* r, float in[3][4])
+{
+	for (int s = 0; s < 3; s++)
+		for (int c = 0; c < 4; c++)
+			in[s][c] = f24_to_f32(case_get_f24(r->src[s][c]));
+}
+
+// Distance in representable floats, across zero
+static u32 ulps(float a, float b)
+{
+	s32 x = f32_to_bits(a), y = f32_to_bits(b);
+	if (x < 0)
+		x = (s32)0x80000000 - x;
+	if (y < 0)
+		y = (s32)0x80000000 - y;
+	return x > y ? (u32)x - (u32)y : (u32)y - (u32)x;
+}
+
+static bool matches(const case_record* r, const float* result)
+{
+	for (int c = 0; c < 4; c++) {
+		if (!(r->check & (1 << c)))
+			continue;
+		float expected = r->expected[c];
+		if (isnan(expected) || isnan(result[c])) {
+			if (!isnan(expected) || !isnan(result[c]))
+				return false;
+		} else if (result[c] != expected && ulps(result[c], expected) > r->ulps) {
+			return false;
+		}
+	}
+	return true;
+}
+
+static void print_vector(const float* v, u8 check)
+{
+	printf("(");
+	for (int c = 0; c < 4; c++) {
+		if (check & (1 << c))
+			printf(c ? ", %g" : "%g", v[c]);
+		else
+			printf(c ? ", *" : "*");
+	}
+	printf(")");
+}
+
+static void print_failure(const case_table_header* header, const case_record* r, const float* result)
+{
+	const case_instruction* ins = case_instruction_of(r->op);
+	float in[3][4];
+
+	load_sources(r, in);
+	printf("%s:%u: %s", header->source, (unsigned)r->line, ins ? ins->name : "?");
+	for (int s = 0; s < (ins ? ins->sources : 0); s++) {
+		printf(" ");
+		print_vector(in[s], 0xF);
+	}
+	printf(" -> ");
+	print_vector(result, r->check);
+	printf(", expected ");
+	print_vector(r->expected, r->check);
+	if (r->ulps)
+		printf(" ~%u", (unsigned)r->ulps);
+	printf("\n");
+}
+
+//
+// Running
+//
+
+typedef struct {
+	const case_table_header* header;
+	const case_record* records;
+	size_t size;
+} table;
+
+// A failed case, by its table and record, in the order the cases come
+typedef struct {
+	u32 table;
+	u32 record;
+	float result[4];
+} failure;
+
+typedef struct {
+	bool interpreter;
+	u32 op;                      // of the program below, ~0 before the first case
+	pica_shader_setup setup;
+	pica_shader_program program;
+	pica_shader_unit unit;
+	pica_shader_batch batch;
+	failure* failures;
+	u32 num_failures;
+	u32 failures_capacity;
+
+	const char* cache_dir;       // NULL without a result cache
+	u64 build_id[2];
+	u64 program_hash[64][2];     // by opcode
+	bool program_hashed[64];
+	u64 cached;                  // cases whose results came from the cache
+} runner;
+
+static void use_program(runner* run, u32 op)
+{
+	if (run->op == op)
+		return;
+	case_build_program(&run->setup, op);
+	pica_shader_batch_compile(&run->program, &run->setup);
+	run->op = op;
+}
+
+static void add_failure(runner* run, u32 t, u32 record, const float* result)
+{
+	if (run->num_failures == run->failures_capacity) {
+		run->failures_capacity = run->failures_capacity ? 2 * run->failures_capacity : 256;
+		run->failures = realloc(run->failures, run->failures_capacity * sizeof(failure));
+		if (!run->failures) {
+			fprintf(stderr, "out of memory\n");
+			exit(1);
+		}
+	}
+	failure* f = &run->failures[run->num_failures++];
+	f->table = t;
+	f->record = record;
+	memcpy(f->result, result, sizeof(f->result));
+}
+
+// Runs count cases of one instruction, at most PICA_SHADER_LANES of them
+static void run_cases(runner* run, const case_record* r, u32 count, float (*result)[4])
+{
+	float in[3][4];
+
+	use_program(run, r->op);
+
+	if (run->interpreter || !run->program.valid) {
+		for (u32 i = 0; i < count; i++) {
+			pica_shader_unit* unit = &run->unit;
+			memset(unit, 0, sizeof(*unit));
+			load_sources(&r[i], in);
+			memcpy(unit->input, in, sizeof(in));
+			pica_shader_run(unit, &run->setup);
+			memcpy(result[i], unit->output[0], sizeof(result[i]));
+		}
+	} else {
+		pica_shader_batch* batch = &run->batch;
+		memset(batch, 0, sizeof(*batch));
+		for (u32 i = 0; i < count; i++) {
+			load_sources(&r[i], in);
+			for (int s = 0; s < 3; s++)
+				for (int c = 0; c < 4; c++)
+					batch->input[s][c][i] = in[s][c];
+		}
+		pica_shader_batch_run(batch, &run->program, &run->setup);
+		for (u32 i = 0; i < count; i++)
+			for (int c = 0; c < 4; c++)
+				result[i][c] = batch->output[0][c][i];
+	}
+}
+
+//
+// Result cache
+//
+
+// Results are cached by page: the key of a page hashes the build of this runner, the engine, and the program
+// and sources of each of its cases, the entry holds their results. Entries are files named by their key, so
+// runs, workers and machines can share a directory, and they are written to a temporary name then renamed.
+// Expected values are not part of the key, changing them needs no recomputation.
+
+#define CACHE_PAGE  256          // cases, a page of results
+#define CACHE_MAGIC 0x43524350   // "PCRC"
+
+typedef struct {
+	u32 magic;
+	u32 count;
+	u64 key[2];
+} cache_entry_header;            // followed by count results
+
+static u64 rotl64(u64 x, int r)
+{
+	return (x << r) | (x >> (64 - r));
+}
+
+static u64 fmix64(u64 k)
+{
+	k ^= k >> 33;
+	k *= 0xFF51AFD7ED558CCDull;
+	k ^= k >> 33;
+	k *= 0xC4CEB9FE1A85EC53ull;
+	k ^= k >> 33;
+	return k;
+}
+
+// MurmurHash3 x64 128
+static void hash128(const void* data, size_t length, u64 out[2])
+{
+	const u64 c1 = 0x87C37B91114253D5ull, c2 = 0x4CF5AD432745937Full;
+	const u8* p = data;
+	u64 h1 = 0, h2 = 0, k1, k2;
+	size_t i;
+
+	for (i = 0; i + 16 <= length; i += 16) {
+		memcpy(&k1, p + i, 8);
+		memcpy(&k2, p + i + 8, 8);
+		h1 ^= rotl64(k1 * c1, 31) * c2;
+		h1 = (rotl64(h1, 27) + h2) * 5 + 0x52DCE729;
+		h2 ^= rotl64(k2 * c2, 33) * c1;
+		h2 = (rotl64(h2, 31) + h1) * 5 + 0x38495AB5;
+	}
+
+	// The tail, zero padded, which leaves the missing words out
+	u8 tail[16] = { 0 };
+	memcpy(tail, p + i, length - i);
+	memcpy(&k1, tail, 8);
+	memcpy(&k2, tail + 8, 8);
+	h2 ^= rotl64(k2 * c2, 33) * c1;
+	h1 ^= rotl64(k1 * c1, 31) * c2;
+
+	h1 ^= length;
+	h2 ^= length;
+	h1 += h2;
+	h2 += h1;
+	h1 = fmix64(h1);
+	h2 = fmix64(h2);
+	h1 += h2;
+	h2 += h1;
+	out[0] = h1;
+	out[1] = h2;
+}
+
+// The model is linked in, the executable stands for the build of the emulator
+static bool hash_build(u64 out[2])
+{
+	FILE* f = fopen("/proc/self/exe", "rb");
+	if (!f)
+		return false;
+
+	size_t size = 0, capacity = 1 << 20, n;
+	u8* data = malloc(capacity);
+	while (data && (n = fread(data + size, 1, capacity - size, f)) > 0) {
+		size += n;
+		if (size == capacity)
+			data = realloc(data, capacity *= 2);
+	}
+	fclose(f);
+	if (!data)
+		return false;
+	hash128(data, size, out);
+	free(data);
+	return true;
+}
+
+static const u64* program_hash(runner* run, u32 op)
+{
+	if (!run->program_hashed[op]) {
+		static pica_shader_setup setup;
+		case_build_program(&setup, op); // clears the whole setup first, padding included
+		hash128(&setup, sizeof(setup), run->program_hash[op]);
+		run->program_hashed[op] = true;
+	}
+	return run->program_hash[op];
+}
+
+static void page_key(runner* run, const case_record* r, u32 count, u64 key[2])
+{
+	static u8 data[32 + CACHE_PAGE * (16 + sizeof(r->src))];
+	u8* p = data;
+
+	memcpy(p, run->build_id, 16);
+	memset(p + 16, 0, 16);
+	p[16] = run->interpreter;
+	p += 32;
+	for (u32 i = 0; i < count; i++) {
+		memcpy(p, program_hash(run, r[i].op), 16);
+		memcpy(p + 16, r[i].src, sizeof(r[i].src));
+		p += 16 + sizeof(r[i].src);
+	}
+	hash128(data, p - data, key);
+}
+
+static void entry_path(const runner* run, const u64 key[2], char* path, size_t size, bool directory)
+{
+	char hex[33];
+	snprintf(hex, sizeof(hex), "%016llx%016llx", (unsigned long long)key[0], (unsigned long long)key[1]);
+	if (directory)
+		snprintf(path, size, "%s/%.2s", run->cache_dir, hex);
+	else
+		snprintf(path, size, "%s/%.2s/%s", run->cache_dir, hex, hex + 2);
+}
+
+static bool cache_lookup(const runner* run, const u64 key[2], u32 count, float (*results)[4])
+{
+	char path[4096];
+	entry_path(run, key, path, sizeof(path), false);
+
+	int fd = open(path, O_RDONLY);
+	if (fd < 0)
+		return false;
+	size_t size = sizeof(cache_entry_header) + count * sizeof(results[0]);
+	struct stat st;
+	if (fstat(fd, &st) || (size_t)st.st_size != size) {
+		close(fd);
+		return false;
+	}
+	void* map = mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+	close(fd);
+	if (map == MAP_FAILED)
+		return false;
+
+	const cache_entry_header* header = map;
+	bool valid = header->magic == CACHE_MAGIC && header->count == count && header->key[0] == key[0] &&
+		header->key[1] == key[1];
+	if (valid)
+		memcpy(results, header + 1, count * sizeof(results[0]));
+	munmap(map, size);
+	return valid;
+}
+
+static void cache_store(const runner* run, const u64 key[2], u32 count, float (*results)[4])
+{
+	char path[4096], temp[4096 + 32];
+	cache_entry_header header = { CACHE_MAGIC, count, { key[0], key[1] } };
+
+	entry_path(run, key, path, sizeof(path), true);
+	mkdir(path, 0777);
+	entry_path(run, key, path, sizeof(path), false);
+	snprintf(temp, sizeof(temp), "%s.%d", path, (int)getpid());
+
+	FILE* f = fopen(temp, "wb");
+	if (!f)
+		return;
+	bool ok = fwrite(&header, sizeof(header), 1, f) == 1 && fwrite(results, sizeof(results[0]), count, f) == count;
+	if (fclose(f) || !ok || rename(temp, path))
+		remove(temp);
+}
+
+// Runs the cases first to last (excluded), numbered across the tables in order
+static void run_range(runner* run, const table* tables, u32 num_tables, u64 first, u64 last)
+{
+	float results[CACHE_PAGE][4];
+	u64 base = 0;
+
+	for (u32 t = 0; t < num_tables && base < last; t++) {
+		u32 count = tables[t].header->count;
+		u32 i = first > base ? first - base : 0;
+		u32 end = last - base < count ? last - base : count;
+		const case_record* records = tables[t].records;
+
+		while (i < end) {
+			// Pages start at multiples of CACHE_PAGE in the table, whatever range is run
+			u32 page_end = (i / CACHE_PAGE + 1) * CACHE_PAGE;
+			u32 n = (page_end < end ? page_end : end) - i;
+			const case_record* r = &records[i];
+			u64 key[2];
+
+			if (run->cache_dir)
+				page_key(run, r, n, key);
+			if (run->cache_dir && cache_lookup(run, key, n, results)) {
+				run->cached += n;
+			} else {
+				// Records are sorted by instruction, batches take the cases of one instruction in order
+				for (u32 j = 0; j < n;) {
+					u32 m = 1;
+					while (m < PICA_SHADER_LANES && j + m < n && r[j + m].op == r[j].op)
+						m++;
+					run_cases(run, &r[j], m, &results[j]);
+					j += m;
+				}
+				if (run->cache_dir)
+					cache_store(run, key, n, results);
+			}
+
+			for (u32 j = 0; j < n; j++)
+				if (!matches(&r[j], results[j]))
+					add_failure(run, t, i + j, results[j]);
+			i += n;
+		}
+		base += count;
+	}
+}
+
+static bool map_table(table* t, const char* path)
+{
+	int fd = open(path, O_RDONLY);
+	struct stat st;
+	if (fd < 0 || fstat(fd, &st) || (size_t)st.st_size < sizeof(case_table_header)) {
+		fprintf(stderr, "cannot read %s\n", path);
+		if (fd >= 0)
+			close(fd);
+		return false;
+	}
+
+	void* map = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+	close(fd);
+	if (map == MAP_FAILED) {
+		fprintf(stderr, "cannot map %s\n", path);
+		return false;
+	}
+
+	const case_table_header* header = map;
+	if (header->magic != CASE_TABLE_MAGIC || header->version != CASE_TABLE_VERSION ||
+		header->record_size != sizeof(case_record) ||
+		(size_t)st.st_size != sizeof(*header) + (size_t)header->count * sizeof(case_record)) {
+		fprintf(stderr, "%s is not a case table of this version, rebuild it with casec\n", path);
+		munmap(map, st.st_size);
+		return false;
+	}
+	t->header = header;
+	t->records = (const case_record*)(header + 1);
+	t->size = st.st_size;
+	return true;
+}
+
+//
+// Worker processes
+//
+
+// Each worker runs a contiguous part of the range and sends its failures back through a pipe when it is done.
+// The parts are in order and so are the failures within one, reading the workers in turn keeps the case order.
+static bool run_workers(runner* run, const table* tables, u32 num_tables, u64 first, u64 last, u32 jobs)
+{
+	pid_t pids[jobs];
+	int fds[jobs];
+	bool ok = true;
+
+	fflush(stdout);
+	for (u32 w = 0; w < jobs; w++) {
+		u64 from = first + (last - first) * w / jobs, to = first + (last - first) * (w + 1) / jobs;
+		int pipe_fds[2];
+		if (pipe(pipe_fds) || (pids[w] = fork()) < 0) {
+			fprintf(stderr, "cannot start worker %u\n", (unsigned)w);
+			exit(1);
+		}
+
+		if (!pids[w]) {
+			close(pipe_fds[0]);
+			run_range(run, tables, num_tables, from, to);
+			if (write(pipe_fds[1], &run->cached, sizeof(run->cached)) != sizeof(run->cached))
+				_exit(1);
+			const u8* p = (const u8*)run->failures;
+			size_t left = run->num_failures * sizeof(failure);
+			while (left) {
+				ssize_t n = write(pipe_fds[1], p, left);
+				if (n <= 0)
+					_exit(1);
+				p += n;
+				left -= n;
+			}
+			_exit(0);
+		}
+		close(pipe_fds[1]);
+		fds[w] = pipe_fds[0];
+	}
+
+	for (u32 w = 0; w < jobs; w++) {
+		failure f;
+		u64 cached;
+		size_t got = 0;
+		ssize_t n;
+		bool complete = read(fds[w], &cached, sizeof(cached)) == sizeof(cached);
+		if (complete)
+			run->cached += cached;
+		while (complete && (n = read(fds[w], (u8*)&f + got, sizeof(f) - got)) > 0) {
+			got += n;
+			if (got == sizeof(f)) {
+				add_failure(run, f.table, f.record, f.result);
+				got = 0;
+			}
+		}
+		close(fds[w]);
+
+		int status;
+		waitpid(pids[w], &status, 0);
+		if (!WIFEXITED(status) || WEXITSTATUS(status) || !complete || got) {
+			u64 from = first + (last - first) * w / jobs, to = first + (last - first) * (w + 1) / jobs;
+			fprintf(stderr, "worker %u, cases %llu to %llu, did not finish\n", (unsigned)w,
+				(unsigned long long)from, (unsigned long long)to - 1);
+			ok = false;
+		}
+	}
+	return ok;
+}
+
+static double seconds(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+int main(int argc, char** argv)
+{
+	static runner run;
+	static table tables[256];
+	u32 num_tables = 0, shard = 0, shards = 1;
+	long jobs = sysconf(_SC_NPROCESSORS_ONLN);
+	bool usage = false;
+
+	run.op = ~0u;
+	for (int i = 1; i < argc; i++) {
+		if (!strcmp(argv[i], "--interpreter"))
+			run.interpreter = true;
+		else if (!strncmp(argv[i], "--shard=", 8))
+			usage |= sscanf(argv[i] + 8, "%u/%u", &shard, &shards) != 2 || shard >= shards;
+		else if (!strncmp(argv[i], "--jobs=", 7))
+			usage |= (jobs = atol(argv[i] + 7)) < 1;
+		else if (!strncmp(argv[i], "--cache=", 8))
+			run.cache_dir = argv[i] + 8;
+		else if (argv[i][0] == '-' || num_tables == sizeof(tables) / sizeof(tables[0]))
+			usage = true;
+		else if (!map_table(&tables[num_tables++], argv[i]))
+			return 1;
+	}
+	if (usage || !num_tables) {
+		fprintf(stderr, "usage: %s [--interpreter] [--shard=i/n] [--jobs=n] [--cache=dir] table.bin...\n", argv[0]);
+		return 2;
+	}
+	if (run.cache_dir) {
+		mkdir(run.cache_dir, 0777);
+		if (!hash_build(run.build_id)) {
+			fprintf(stderr, "cannot read the executable to identify the build, running without the cache\n");
+			run.cache_dir = NULL;
+		}
+	}
+
+	// Shard i of n takes the i-th of n contiguous parts of the cases of every table, in order
+	u64 total = 0;
+	for (u32 t = 0; t < num_tables; t++)
+		total += tables[t].header->count;
+	u64 first = total * shard / shards, last = total * (shard + 1) / shards;
+
+	// Small ranges are not worth a process
+	if ((u64)jobs > (last - first) / MIN_CASES_PER_JOB)
+		jobs = (last - first) / MIN_CASES_PER_JOB;
+
+	double start = seconds();
+	bool ok = true;
+	if (jobs > 1)
+		ok = run_workers(&run, tables, num_tables, first, last, jobs);
+	else
+		run_range(&run, tables, num_tables, first, last);
+	double elapsed = seconds() - start;
+
+	for (u32 i = 0; i < run.num_failures; i++) {
+		const failure* f = &run.failures[i];
+		print_failure(tables[f->table].header, &tables[f->table].records[f->record], f->result);
+	}
+	printf("%u of %llu cases failed (%.0f cases/s", (unsigned)run.num_failures, (unsigned long long)(last - first),
+		elapsed > 0 ? (last - first) / elapsed : 0.0);
+	if (run.cache_dir)
+		printf(", %llu from the cache", (unsigned long long)run.cached);
+	if (shards > 1)
+		printf(", shard %u of %u", (unsigned)shard, (unsigned)shards);
+	printf(")\n");
+
+	for (u32 t = 0; t < num_tables; t++)
+		munmap((void*)tables[t].header, tables[t].size);
+	free(run.failures);
+	return ok && !run.num_failures ? 0 : 1;
+}
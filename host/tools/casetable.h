@@ -0,0 +1,119 @@
+/*
+ * Packed test case tables
+ * casec compiles a .cases text file into a table that caserun maps and runs without parsing. The table is a
+ * 64-byte header followed by 64-byte records, so that each record is one cache line of the mapping. Records are
+ * sorted by instruction, in file order within one, so that consecutive cases share a program.
+ */
+
+#pragma once
+#include <string.h>
+#include <3ds/types.h>
+#include "shader.h"
+
+#define CASE_TABLE_MAGIC   0x45534350 // "PCSE"
+#define CASE_TABLE_VERSION 1
+
+typedef struct {
+	u32 magic;
+	u32 version;
+	u32 record_size;
+	u32 count;         // records following the header
+	char source[48];   // name of the .cases file
+} case_table_header;
+
+typedef struct {
+	u8 op;             // PICA_OP_*
+	u8 check;          // bit i: component i of the result is compared (0 = x)
+	u8 ulps;           // tolerance of the comparison
+	u8 reserved;
+	u32 line;          // in the source file
+	u8 src[3][4][3];   // float24 operands, little endian, unused sources are zero
+	float expected[4];
+	u32 reserved2;
+} case_record;
+
+typedef char case_record_is_a_cache_line[sizeof(case_record) == 64 && sizeof(case_table_header) == 64 ? 1 : -1];
+
+typedef struct {
+	const char* name;
+	u32 op;
+	int sources;
+} case_instruction;
+
+// mova has no float result, its cases expect (a0.x, a0.y) in x and y
+static const case_instruction case_instructions[] = {
+	{ "add",  PICA_OP_ADD,  2 },
+	{ "dp3",  PICA_OP_DP3,  2 },
+	{ "dp4",  PICA_OP_DP4,  2 },
+	{ "dph",  PICA_OP_DPH,  2 },
+	{ "ex2",  PICA_OP_EX2,  1 },
+	{ "lg2",  PICA_OP_LG2,  1 },
+	{ "mul",  PICA_OP_MUL,  2 },
+	{ "sge",  PICA_OP_SGE,  2 },
+	{ "slt",  PICA_OP_SLT,  2 },
+	{ "flr",  PICA_OP_FLR,  1 },
+	{ "max",  PICA_OP_MAX,  2 },
+	{ "min",  PICA_OP_MIN,  2 },
+	{ "rcp",  PICA_OP_RCP,  1 },
+	{ "rsq",  PICA_OP_RSQ,  1 },
+	{ "mova", PICA_OP_MOVA, 1 },
+	{ "mov",  PICA_OP_MOV,  1 },
+	{ "dphi", PICA_OP_DPHI, 2 },
+	{ "sgei", PICA_OP_SGEI, 2 },
+	{ "slti", PICA_OP_SLTI, 2 },
+	{ "mad",  PICA_OP_MAD,  3 },
+};
+#define NUM_CASE_INSTRUCTIONS (sizeof(case_instructions) / sizeof(case_instructions[0]))
+
+static inline const case_instruction* case_instruction_of(u32 op)
+{
+	for (u32 i = 0; i < NUM_CASE_INSTRUCTIONS; i++)
+		if (case_instructions[i].op == op)
+			return &case_instructions[i];
+	return NULL;
+}
+
+#define CASE_SWIZZLE_XYZW 0x1B
+#define CASE_DESC(mask) ((mask) | (CASE_SWIZZLE_XYZW << 5) | (CASE_SWIZZLE_XYZW << 14) | (CASE_SWIZZLE_XYZW << 23))
+
+// The program a case runs: op o0, v0, v1 (, v2) and end. mova loads a0 from v0 and reads c[a0.x].x and
+// c[a0.y].y to o0.xy, the float uniforms hold their own index so the result is the address registers, or 1
+// out of range.
+static inline void case_build_program(pica_shader_setup* setup, u32 op)
+{
+	u32 n = 0;
+
+	memset(setup, 0, sizeof(*setup));
+	setup->opdesc[0] = CASE_DESC(0xF);
+	setup->opdesc[1] = CASE_DESC(0xC);
+	setup->opdesc[2] = CASE_DESC(0x8);
+	setup->opdesc[3] = CASE_DESC(0x4);
+	for (int i = 0; i < PICA_SHADER_NUM_FLOAT_UNIFORMS; i++)
+		for (int c = 0; c < 4; c++)
+			setup->f[i][c] = i;
+
+	if (op == PICA_OP_MOVA) {
+		setup->code[n++] = (PICA_OP_MOVA << 26) | (0x00 << 12) | 1;
+		setup->code[n++] = (PICA_OP_MOV << 26) | (0 << 21) | (1 << 19) | (0x20 << 12) | 2;
+		setup->code[n++] = (PICA_OP_MOV << 26) | (0 << 21) | (2 << 19) | (0x20 << 12) | 3;
+	} else if (op == PICA_OP_MAD) {
+		setup->code[n++] = (PICA_OP_MAD << 26) | (0 << 24) | (0 << 17) | (1 << 10) | (2 << 5);
+	} else if (pica_op_is_inverted(op)) {
+		setup->code[n++] = (op << 26) | (0 << 21) | (0 << 14) | (1 << 7);
+	} else {
+		setup->code[n++] = (op << 26) | (0 << 21) | (0 << 12) | (1 << 7);
+	}
+	setup->code[n++] = PICA_OP_END << 26;
+}
+
+static inline u32 case_get_f24(const u8* bytes)
+{
+	return bytes[0] | (bytes[1] << 8) | (bytes[2] << 16);
+}
+
+static inline void case_set_f24(u8* bytes, u32 value)
+{
+	bytes[0] = value;
+	bytes[1] = value >> 8;
+	bytes[2] = value >> 16;
+}
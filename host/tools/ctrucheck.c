@@ -0,0 +1,614 @@
+/*
+ * Checks of the libctru stand-in and the parts of the model the suites do not exercise
+ * usage: ctrucheck [indexed] [memory] [snapshot]...
+ *
+ * indexed: draws triangle grids expanded with GPU_DrawArray and indexed with 16-bit and 8-bit index buffers. The
+ * indexed draws must render the same image as the expanded one, and the vertex cache must count the hits and
+ * misses of a 32-entry FIFO emptied at every draw, also for the expanded draw once deduplication is on.
+ *
+ * memory: frees pointers that are not allocations, which must be counted and change nothing (the stand-in prints
+ * them), rewinds the heap to a checkpoint, which must keep the count of bad frees, and runs random allocations
+ * and frees in the linear heap and VRAM, checking that no block overwrites another. An allocation overlapping a
+ * live one aborts in the arena itself.
+ *
+ * snapshot: takes a snapshot once a frame is rendered and the next one begun, writes a given number of heap pages,
+ * renders and shows frames, leaks blocks, and restores. The heaps, the registers, the shader setup and the
+ * framebuffer must be the bytes they were, the leaks counted, and the pages copied back the ones written.
+ *
+ * Prints each failure and exits with 1 if there was any.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <3ds.h>
+#include "pica.h"
+#include "ctru.h"
+
+static int failures;
+
+#define CHECK(cond, ...) \
+	do { \
+		if (!(cond)) { \
+			printf(__VA_ARGS__); \
+			printf("\n"); \
+			failures++; \
+		} \
+	} while (0)
+
+//
+// Rendering
+//
+
+#define CMD_BUF_SIZE 0x40000
+
+static u32 *colorBuf, *depthBuf, *cmdBuf;
+
+// mov o0, v0; mov o1, v1; end
+static u32 code[] = {
+	(0x13 << 26) | (0 << 21) | (0 << 12) | 0,
+	(0x13 << 26) | (1 << 21) | (1 << 12) | 0,
+	0x22 << 26,
+};
+static u32 opdescs[] = { 0xF | (0x1B << 5) | (0x1B << 14) };
+static DVLP_s dvlp;
+static DVLE_s dvle;
+static DVLE_outEntry_s outputs[] = {
+	{ RESULT_POSITION, 0, 0xF, { 0 } },
+	{ RESULT_COLOR, 1, 0xF, { 0 } },
+};
+static shaderProgram_s program;
+
+typedef struct { float x, y, z, w; float r, g, b, a; } vertex;
+
+static void renderInit(void)
+{
+	colorBuf = vramAlloc(400*240*4);
+	depthBuf = vramAlloc(400*240*4);
+	cmdBuf = linearAlloc(CMD_BUF_SIZE*4);
+	GPU_Init(NULL);
+	GPU_Reset(NULL, cmdBuf, CMD_BUF_SIZE);
+
+	dvlp.codeSize = sizeof(code)/sizeof(code[0]);
+	dvlp.codeData = code;
+	dvlp.opdescSize = 1;
+	dvlp.opcdescData = opdescs;
+	dvle.type = VERTEX_SHDR;
+	dvle.dvlp = &dvlp;
+	dvle.outTableSize = sizeof(outputs)/sizeof(outputs[0]);
+	dvle.outTableData = outputs;
+	DVLE_GenerateOutmap(&dvle);
+	shaderProgramInit(&program);
+	shaderProgramSetVsh(&program, &dvle);
+}
+
+static void renderExit(void)
+{
+	shaderProgramFree(&program);
+	linearFree(cmdBuf);
+	vramFree(depthBuf);
+	vramFree(colorBuf);
+}
+
+// Starts a frame drawing the vertices at vbo: positions are clip coordinates, colors are passed through
+static void frameBegin(const vertex* vbo)
+{
+	u32 noDepthAccess[2] = { 0, 0 };
+
+	memset(colorBuf, 0, 400*240*4);
+	GPU_SetViewport((u32*)osConvertVirtToPhys((u32)depthBuf), (u32*)osConvertVirtToPhys((u32)colorBuf), 0, 0, 240, 400);
+	GPU_DepthMap(-1.0f, 0.0f);
+	GPU_SetScissorTest(GPU_SCISSOR_DISABLE, 0, 0, 240, 400);
+	GPU_SetFaceCulling(GPU_CULL_NONE);
+	GPU_SetStencilTest(false, GPU_ALWAYS, 0x00, 0xFF, 0x00);
+	GPU_SetDepthTestAndWriteMask(false, GPU_ALWAYS, GPU_WRITE_COLOR);
+	GPUCMD_AddIncrementalWrites(GPUREG_DEPTHBUFFER_READ, noDepthAccess, 2);
+	GPU_SetAlphaBlending(GPU_BLEND_ADD, GPU_BLEND_ADD, GPU_ONE, GPU_ZERO, GPU_ONE, GPU_ZERO);
+	GPU_SetAlphaTest(false, GPU_ALWAYS, 0x00);
+	for (int i = 0; i < 6; i++)
+		GPU_SetTexEnv(i,
+			GPU_TEVSOURCES(i ? GPU_PREVIOUS : GPU_PRIMARY_COLOR, 0, 0),
+			GPU_TEVSOURCES(i ? GPU_PREVIOUS : GPU_PRIMARY_COLOR, 0, 0),
+			GPU_TEVOPERANDS(0, 0, 0), GPU_TEVOPERANDS(0, 0, 0),
+			GPU_REPLACE, GPU_REPLACE, 0xFFFFFFFF);
+
+	shaderProgramUse(&program);
+	GPU_SetAttributeBuffers(2, (u32*)osConvertVirtToPhys((u32)vbo),
+		GPU_ATTRIBFMT(0, 4, GPU_FLOAT) | GPU_ATTRIBFMT(1, 4, GPU_FLOAT), 0xFFC, 0x10,
+		1, (u32[]) { 0x0 }, (u64[]) { 0x10 }, (u8[]) { 2 });
+}
+
+static void frameFinish(void)
+{
+	GPU_FinishDrawing();
+	GPUCMD_Finalize();
+	GPUCMD_FlushAndRun(NULL);
+	gspWaitForP3D();
+	GPUCMD_SetBufferOffset(0);
+}
+
+//
+// Indexed draws and the vertex cache
+//
+
+// GPU_DrawElements always emits 16-bit index buffers. Same commands, bit 31 of the index buffer config selects
+// 16-bit indices. offset is relative to the attribute buffers base address.
+static void drawElements(GPU_Primitive_t primitive, u32 offset, u32 n, bool shortIndices)
+{
+	GPUCMD_AddMaskedWrite(GPUREG_PRIMITIVE_CONFIG, 0x2, primitive);
+	GPUCMD_AddMaskedWrite(GPUREG_RESTART_PRIMITIVE, 0x2, 0x00000001);
+	GPUCMD_AddWrite(GPUREG_INDEXBUFFER_CONFIG, (shortIndices ? 0x80000000 : 0) | (offset & 0x0FFFFFFF));
+	GPUCMD_AddWrite(GPUREG_NUMVERTICES, n);
+	GPUCMD_AddWrite(GPUREG_VERTEX_OFFSET, 0x00000000);
+
+	GPUCMD_AddMaskedWrite(GPUREG_GEOSTAGE_CONFIG, 0x2, 0x00000100);
+	GPUCMD_AddMaskedWrite(GPUREG_0253, 0x2, 0x00000100);
+
+	GPUCMD_AddMaskedWrite(GPUREG_0245, 0x1, 0x00000000);
+	GPUCMD_AddWrite(GPUREG_DRAWELEMENTS, 0x00000001);
+	GPUCMD_AddMaskedWrite(GPUREG_0245, 0x1, 0x00000001);
+	GPUCMD_AddWrite(GPUREG_0231, 0x00000001);
+}
+
+// Hits and misses of a FIFO of PICA_VERTEX_CACHE_SIZE indices that starts empty
+static void expectedCacheCounts(const u16* indices, u32 n, u64* hits, u64* misses)
+{
+	u32 cache[PICA_VERTEX_CACHE_SIZE], valid = 0, next = 0;
+
+	*hits = *misses = 0;
+	for (u32 i = 0; i < n; i++) {
+		u32 j;
+		for (j = 0; j < valid && cache[j] != indices[i]; j++)
+			;
+		if (j < valid) {
+			(*hits)++;
+			continue;
+		}
+		(*misses)++;
+		cache[next] = indices[i];
+		next = (next + 1) % PICA_VERTEX_CACHE_SIZE;
+		if (valid < PICA_VERTEX_CACHE_SIZE)
+			valid++;
+	}
+}
+
+static void cacheDelta(const pica_vertex_cache_stats* before, u64* hits, u64* misses)
+{
+	pica_vertex_cache_stats now;
+	pica_vertex_cache_get_stats(&now);
+	*hits = now.hits - before->hits;
+	*misses = now.misses - before->misses;
+}
+
+// A grid of size x size vertices with distinct positions and colors, two triangles per cell
+static void checkGrid(u32 size, bool shortIndices)
+{
+	u32 count = size * size, n = (size - 1) * (size - 1) * 6;
+	u32 indexOffset = (count * sizeof(vertex) + 15) & ~15;
+	u8* buffer = linearAlloc(indexOffset + n * 2);
+	vertex* grid = (vertex*)buffer;
+	vertex* expanded = linearAlloc(n * sizeof(vertex));
+	u16* indices = malloc(n * sizeof(u16));
+	u32 *expectedImage = malloc(400*240*4);
+	pica_vertex_cache_stats before;
+	u64 hits, misses, expectedHits, expectedMisses;
+	u32 i, x, y, k = 0;
+
+	for (y = 0; y < size; y++)
+		for (x = 0; x < size; x++) {
+			vertex* v = &grid[y * size + x];
+			v->x = -0.9f + 1.8f * x / (size - 1);
+			v->y = -0.9f + 1.8f * y / (size - 1);
+			v->z = 0.5f;
+			v->w = 1.0f;
+			v->r = (float)x / (size - 1);
+			v->g = (float)y / (size - 1);
+			v->b = (float)((x * 7 + y * 3) % size) / (size - 1);
+			v->a = 1.0f;
+		}
+	for (y = 0; y + 1 < size; y++)
+		for (x = 0; x + 1 < size; x++) {
+			u16 a = y * size + x, b = a + 1, c = a + size, d = c + 1;
+			u16 quad[6] = { a, b, c, c, b, d };
+			memcpy(&indices[k], quad, sizeof(quad));
+			k += 6;
+		}
+	for (i = 0; i < n; i++) {
+		expanded[i] = grid[indices[i]];
+		if (shortIndices)
+			((u16*)(buffer + indexOffset))[i] = indices[i];
+		else
+			buffer[indexOffset + i] = indices[i];
+	}
+	expectedCacheCounts(indices, n, &expectedHits, &expectedMisses);
+
+	// Expanded, not cached
+	pica_vertex_cache_set_dedup(false);
+	pica_vertex_cache_get_stats(&before);
+	frameBegin(expanded);
+	GPU_DrawArray(GPU_TRIANGLES, n);
+	frameFinish();
+	cacheDelta(&before, &hits, &misses);
+	memcpy(expectedImage, colorBuf, 400*240*4);
+	for (i = 0; i < 400*240 && !expectedImage[i]; i++)
+		;
+	CHECK(i < 400*240, "%ux%u grid: nothing rendered", size, size);
+	CHECK(hits == 0 && misses == 0, "%ux%u grid: non-indexed draw counted %llu hits and %llu misses", size, size,
+		(unsigned long long)hits, (unsigned long long)misses);
+
+	// Indexed
+	pica_vertex_cache_get_stats(&before);
+	frameBegin(grid);
+	drawElements(GPU_TRIANGLES, indexOffset, n, shortIndices);
+	frameFinish();
+	cacheDelta(&before, &hits, &misses);
+	CHECK(!memcmp(colorBuf, expectedImage, 400*240*4), "%ux%u grid: %u-bit indexed draw renders another image",
+		size, size, shortIndices ? 16 : 8);
+	CHECK(hits == expectedHits && misses == expectedMisses,
+		"%ux%u grid: %u-bit indexed draw counted %llu hits and %llu misses, expected %llu and %llu", size, size,
+		shortIndices ? 16 : 8, (unsigned long long)hits, (unsigned long long)misses,
+		(unsigned long long)expectedHits, (unsigned long long)expectedMisses);
+
+	// Expanded and deduplicated by inputs, the vertices are distinct so the counts are the indexed ones
+	pica_vertex_cache_set_dedup(true);
+	pica_vertex_cache_get_stats(&before);
+	frameBegin(expanded);
+	GPU_DrawArray(GPU_TRIANGLES, n);
+	frameFinish();
+	cacheDelta(&before, &hits, &misses);
+	pica_vertex_cache_set_dedup(false);
+	CHECK(!memcmp(colorBuf, expectedImage, 400*240*4), "%ux%u grid: deduplicated draw renders another image",
+		size, size);
+	CHECK(hits == expectedHits && misses == expectedMisses,
+		"%ux%u grid: deduplicated draw counted %llu hits and %llu misses, expected %llu and %llu", size, size,
+		(unsigned long long)hits, (unsigned long long)misses,
+		(unsigned long long)expectedHits, (unsigned long long)expectedMisses);
+
+	printf("%ux%u grid, %u-bit indices: %u vertices, %llu hits, %llu misses\n", size, size, shortIndices ? 16 : 8,
+		n, (unsigned long long)expectedHits, (unsigned long long)expectedMisses);
+
+	free(expectedImage);
+	free(indices);
+	linearFree(expanded);
+	linearFree(buffer);
+}
+
+static void checkIndexed(void)
+{
+	renderInit();
+	checkGrid(16, false);  // 256 vertices, the most 8-bit indices reach
+	checkGrid(16, true);
+	checkGrid(64, true);   // 23814 indices, more than a shading chunk
+	renderExit();
+}
+
+//
+// Heap arenas
+//
+
+typedef struct {
+	u8* p;
+	u32 size;
+	u8 tag;
+} allocation;
+
+// Frees of pointers that are not allocations are counted and leave the arena as it was
+static void checkBadFrees(void)
+{
+	ctru_memory_stats before, after;
+	u32 local;
+
+	ctru_memory_get_stats(&before);
+	u8* a = linearAlloc(0x100);
+	linearFree(a + 0x80);   // inside a block
+	vramFree(a);            // another region
+	linearFree(&local);     // outside the heap
+	linearFree(a);
+	linearFree(a);          // twice
+	ctru_memory_get_stats(&after);
+	CHECK(after.bad_frees - before.bad_frees == 4, "bad frees: counted %u, expected 4",
+		after.bad_frees - before.bad_frees);
+	CHECK(after.live == before.live, "bad frees: %u live allocations, expected %u", after.live, before.live);
+
+	u8* b = linearAlloc(0x100);
+	u8* c = linearAlloc(0x100);
+	CHECK(b && c && (b + 0x100 <= c || c + 0x100 <= b), "bad frees: the next allocations overlap");
+	linearFree(c);
+	linearFree(b);
+}
+
+// Rewinding releases what was allocated since the checkpoint, counting what was still live, and brings back
+// what was freed since
+static void checkRewind(void)
+{
+	ctru_memory_stats before, after;
+
+	u8* kept = linearAlloc(0x1000);
+	u8* keptVram = vramAlloc(0x1000);
+	ctru_memory_checkpoint();
+	ctru_memory_get_stats(&before);
+
+	u8* a = linearAlloc(0x2000);
+	u8* b = vramAlloc(0x800);
+	u8* c = linearAlloc(0x100);
+	linearFree(c);
+	linearFree(kept);
+	linearFree(c);     // bad frees made before the rewind are still counted after it
+	vramFree(b + 0x80);
+	u32 leaks = ctru_memory_rewind();
+	ctru_memory_get_stats(&after);
+	CHECK(leaks == 2, "rewind: %u leaks, expected 2", leaks);
+	CHECK(after.live == before.live, "rewind: %u live allocations, expected %u", after.live, before.live);
+	CHECK(after.bad_frees == before.bad_frees + 2, "rewind: %u bad frees, expected %u", after.bad_frees,
+		before.bad_frees + 2);
+	before.bad_frees = after.bad_frees;
+
+	// The top is back where it was, the allocations of the checkpoint are live again
+	u8* a2 = linearAlloc(0x2000);
+	u8* b2 = vramAlloc(0x800);
+	CHECK(a2 == a && b2 == b, "rewind: the allocations after it do not start where the ones before it did");
+	linearFree(a2);
+	vramFree(b2);
+	linearFree(kept);
+	vramFree(keptVram);
+	ctru_memory_get_stats(&after);
+	CHECK(after.bad_frees == before.bad_frees, "rewind: the blocks of the checkpoint are not live");
+	CHECK(after.live == before.live - 2, "rewind: %u live allocations after freeing everything, expected %u",
+		after.live, before.live - 2);
+}
+
+// Random allocations and frees in both regions: every block is inside its region, holds 16-byte aligned data
+// and keeps it until it is freed, so no two live blocks overlap
+#define RANDOM_OPS  20000
+#define RANDOM_LIVE 256
+
+static u32 randomState = 1;
+
+static u32 randomNext(void)
+{
+	randomState = randomState * 1103515245 + 12345;
+	return randomState >> 8;
+}
+
+static bool blockIntact(const allocation* a)
+{
+	for (u32 i = 0; i < a->size; i++)
+		if (a->p[i] != a->tag)
+			return false;
+	return true;
+}
+
+static void checkRandom(void)
+{
+	static allocation live[2][RANDOM_LIVE];
+	u32 count[2] = { 0, 0 }, maxSize[2] = { 0x10000, 0x4000 }, corrupted = 0, misplaced = 0;
+	ctru_memory_stats before, after;
+
+	ctru_memory_get_stats(&before);
+	for (u32 op = 0; op < RANDOM_OPS; op++) {
+		u32 r = randomNext() & 1;
+		bool alloc = count[r] == 0 || (count[r] < RANDOM_LIVE && randomNext() % 3 != 0);
+
+		if (alloc) {
+			allocation* a = &live[r][count[r]];
+			a->size = 1 + randomNext() % maxSize[r];
+			a->p = r ? vramAlloc(a->size) : linearAlloc(a->size);
+			a->tag = (u8)(op | 1);
+			if (!a->p) {
+				CHECK(false, "random: no room for %u bytes with %u blocks live", a->size, count[r]);
+				break;
+			}
+			if (((uintptr_t)a->p & 15) || !osConvertVirtToPhys((u32)a->p) ||
+				!osConvertVirtToPhys((u32)(a->p + a->size - 1)))
+				misplaced++;
+			memset(a->p, a->tag, a->size);
+			count[r]++;
+		} else {
+			u32 i = randomNext() % count[r];
+			if (!blockIntact(&live[r][i]))
+				corrupted++;
+			if (r)
+				vramFree(live[r][i].p);
+			else
+				linearFree(live[r][i].p);
+			live[r][i] = live[r][--count[r]];
+		}
+	}
+	for (u32 r = 0; r < 2; r++)
+		for (u32 i = 0; i < count[r]; i++) {
+			if (!blockIntact(&live[r][i]))
+				corrupted++;
+			if (r)
+				vramFree(live[r][i].p);
+			else
+				linearFree(live[r][i].p);
+		}
+
+	ctru_memory_get_stats(&after);
+	CHECK(!misplaced, "random: %u blocks misaligned or outside their region", misplaced);
+	CHECK(!corrupted, "random: %u blocks overwritten by another one", corrupted);
+	CHECK(after.live == before.live && after.bad_frees == before.bad_frees,
+		"random: %u live allocations and %u bad frees after freeing everything, expected %u and %u",
+		after.live, after.bad_frees, before.live, before.bad_frees);
+}
+
+static void checkMemory(void)
+{
+	checkBadFrees();
+	checkRewind();
+	checkRandom();
+}
+
+//
+// Snapshots
+//
+
+static u8 *linearCopy, *vramCopy, *framebufferCopy;
+static pica_state picaCopy;
+static int bufferCopy;
+static long pageSize;
+
+static void saveState(void)
+{
+	memcpy(linearCopy, (u8*)LINEAR_VADDR, LINEAR_SIZE);
+	memcpy(vramCopy, (u8*)VRAM_VADDR, VRAM_SIZE);
+	picaCopy = pica;
+	bufferCopy = ctru_gfx_get_buffer();
+	memcpy(framebufferCopy, gfxGetFramebuffer(GFX_TOP, GFX_LEFT, NULL, NULL), 240*400*3);
+}
+
+// Pages of the heaps whose contents are not the saved ones
+static u32 changedPages(void)
+{
+	u32 pages = 0, i;
+	for (i = 0; i < LINEAR_SIZE; i += pageSize)
+		pages += memcmp(linearCopy + i, (u8*)LINEAR_VADDR + i, pageSize) != 0;
+	for (i = 0; i < VRAM_SIZE; i += pageSize)
+		pages += memcmp(vramCopy + i, (u8*)VRAM_VADDR + i, pageSize) != 0;
+	return pages;
+}
+
+// Restores the snapshot and compares everything with the saved copy, returns the pages the restore copied back
+static u32 restoreAndCompare(const char* test, u32 expectedLeaks)
+{
+	ctru_snapshot_stats before, after;
+
+	ctru_snapshot_get_stats(&before);
+	u32 leaks = ctru_snapshot_restore();
+	ctru_snapshot_get_stats(&after);
+
+	CHECK(leaks == expectedLeaks, "%s: %u leaks, expected %u", test, leaks, expectedLeaks);
+	CHECK(!memcmp(linearCopy, (u8*)LINEAR_VADDR, LINEAR_SIZE), "%s: the linear heap is not restored", test);
+	CHECK(!memcmp(vramCopy, (u8*)VRAM_VADDR, VRAM_SIZE), "%s: VRAM is not restored", test);
+	CHECK(!memcmp(pica.regs, picaCopy.regs, sizeof(pica.regs)), "%s: the registers are not restored", test);
+	CHECK(!memcmp(&pica.vs, &picaCopy.vs, sizeof(pica.vs)), "%s: the shader setup is not restored", test);
+	CHECK(ctru_gfx_get_buffer() == bufferCopy &&
+		!memcmp(framebufferCopy, gfxGetFramebuffer(GFX_TOP, GFX_LEFT, NULL, NULL), 240*400*3),
+		"%s: the framebuffer is not restored", test);
+	return after.pages - before.pages;
+}
+
+// Renders the triangle and shows it like the suites' gpuFrameEnd does
+static void drawFrame(const vertex* vbo)
+{
+	frameBegin(vbo);
+	GPU_DrawArray(GPU_TRIANGLES, 3);
+	frameFinish();
+	GX_SetDisplayTransfer(NULL, colorBuf, GX_BUFFER_DIM(240, 400),
+		(u32*)gfxGetFramebuffer(GFX_TOP, GFX_LEFT, NULL, NULL), GX_BUFFER_DIM(240, 400),
+		GX_TRANSFER_IN_FORMAT(GX_TRANSFER_FMT_RGBA8) | GX_TRANSFER_OUT_FORMAT(GX_TRANSFER_FMT_RGB8));
+	gspWaitForPPF();
+}
+
+// Returns the pages it changed
+static u32 drawTest(vertex* vbo)
+{
+	vbo[1].x = 0.9f;
+	drawFrame(vbo);
+	gfxSwapBuffersGpu();
+	GPU_SetFaceCulling(GPU_CULL_BACK_CCW);
+	linearAlloc(0x1000);
+	vramAlloc(0x1000);
+	return changedPages();
+}
+
+static void checkSnapshot(void)
+{
+	static const u32 touched[] = { 1, 3, 16, 64 };
+	vertex* vbo;
+	u8* scratch;
+	u32 pages, changed, i;
+
+	pageSize = sysconf(_SC_PAGESIZE);
+	linearCopy = malloc(LINEAR_SIZE);
+	vramCopy = malloc(VRAM_SIZE);
+	framebufferCopy = malloc(240*400*3);
+
+	// The state every test starts from: a frame rendered and shown, the next one begun
+	gfxInitDefault();
+	renderInit();
+	vbo = linearAlloc(3 * sizeof(vertex));
+	scratch = linearAlloc(65 * pageSize);
+	vbo[0] = (vertex) { -0.5f, -0.5f, 0.5f, 1.0f, 1.0f, 0.0f, 0.0f, 1.0f };
+	vbo[1] = (vertex) {  0.5f, -0.5f, 0.5f, 1.0f, 0.0f, 1.0f, 0.0f, 1.0f };
+	vbo[2] = (vertex) { -0.5f,  0.5f, 0.5f, 1.0f, 0.0f, 0.0f, 1.0f, 1.0f };
+	drawFrame(vbo);
+	gfxSwapBuffersGpu();
+	frameBegin(vbo);
+	ctru_snapshot_take();
+	saveState();
+
+	pages = restoreAndCompare("nothing written", 0);
+	CHECK(pages == 0, "nothing written: %u pages copied back", pages);
+
+	// Whole pages of a block allocated before the snapshot, each one is copied back once
+	u8* firstPage = (u8*)(((uintptr_t)scratch + pageSize - 1) & ~(uintptr_t)(pageSize - 1));
+	for (i = 0; i < sizeof(touched) / sizeof(touched[0]); i++) {
+		char test[32];
+		snprintf(test, sizeof(test), "%u pages written", touched[i]);
+		memset(firstPage, i + 1, touched[i] * pageSize);
+		firstPage[0] = 0; // twice to the same page
+		pages = restoreAndCompare(test, 0);
+		CHECK(pages == touched[i], "%s: %u pages copied back", test, pages);
+	}
+
+	// A test that draws, shows the result and leaks a block of each heap, twice: the same pages are copied back
+	changed = drawTest(vbo);
+	pages = restoreAndCompare("frame drawn", 2);
+	CHECK(changed > 0 && pages >= changed, "frame drawn: %u pages copied back, %u changed", pages, changed);
+	printf("snapshot: a frame drawn changes %u pages, %u are copied back\n", changed, pages);
+	drawTest(vbo);
+	i = restoreAndCompare("frame drawn again", 2);
+	CHECK(i == pages, "frame drawn again: %u pages copied back, %u the first time", i, pages);
+
+	linearFree(scratch);
+	linearFree(vbo);
+	renderExit();
+	gfxExit();
+	free(framebufferCopy);
+	free(vramCopy);
+	free(linearCopy);
+}
+
+//
+// Main
+//
+
+typedef struct {
+	const char* name;
+	void (*run)(void);
+} check;
+
+static const check checks[] = {
+	{ "indexed", checkIndexed },
+	{ "memory", checkMemory },
+	{ "snapshot", checkSnapshot },
+};
+#define NUM_CHECKS (sizeof(checks) / sizeof(checks[0]))
+
+int main(int argc, char** argv)
+{
+	u32 i;
+	int a;
+
+	for (a = 1; a < argc; a++) {
+		for (i = 0; i < NUM_CHECKS && strcmp(argv[a], checks[i].name); i++)
+			;
+		if (i == NUM_CHECKS) {
+			fprintf(stderr, "unknown check %s\n", argv[a]);
+			return 2;
+		}
+	}
+
+	for (i = 0; i < NUM_CHECKS; i++) {
+		bool selected = argc == 1;
+		for (a = 1; a < argc; a++)
+			selected |= !strcmp(argv[a], checks[i].name);
+		if (selected)
+			checks[i].run();
+	}
+
+	printf("%d failures\n", failures);
+	return failures ? 1 : 0;
+}
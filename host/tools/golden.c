@@ -0,0 +1,655 @@
+/*
+ * Golden results of exhaustive sweeps
+ * usage: golden record [--src2 v] [--src3 v] [--threads n] op out.gold
+ *        golden check [--threads n] [--reports n] file.gold [other.gold]
+ *        golden lookup file.gold value...
+ *        golden import out.gold dump.bin...
+ *
+ * record runs an instruction on the batch engine for each of the 2^24 float24 values of its first source,
+ * the other sources fixed (0 by default), and stores the x of every result. check runs the same sweep again
+ * and compares it with the stored one, or compares two stored sweeps of the same configuration. lookup
+ * prints the stored results for some values of the first source.
+ *
+ * The results, in the order of the float24 bits of the input, are cut into blocks of GOLDEN_BLOCK. A block
+ * holds its first result and the differences between consecutive ones, as 32-bit integers, packed with the
+ * fewest bits that cover their range above the smallest. Neighbouring inputs give close results, and the
+ * ranges that overflow or flush to zero give equal ones, so the rcp, rsq, ex2, lg2 and flr sweeps take 0.7 to
+ * 2.7 bits per result instead of 32. The index of the block offsets gives random access to any input, and
+ * blocks are decoded and compared in parallel on the shader units' threads, without ever holding a whole
+ * sweep in memory.
+ * NaN results match any NaN, like shaderdiff does.
+ *
+ * import turns the <op>-dump.bin files of dump-tests, the results of an instruction on the device, into a golden
+ * file of the same layout. The dumps may cover the inputs in several parts, overlapping parts must agree. Their
+ * results are float24 values, so sweeps are truncated to float24 before they are compared with an imported file.
+ * Every golden file carries the CRC-32 of its index and blocks, checked whenever it is mapped.
+ */
+
+#include <fcntl.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "float24.h"
+#include "shader.h"
+#include "shader_batch.h"
+#include "units.h"
+#include "casetable.h"
+
+#define GOLDEN_MAGIC   0x444C4750 // "PGLD"
+#define GOLDEN_VERSION 2
+#define GOLDEN_COUNT   (1 << 24)
+#define GOLDEN_BLOCK   1024
+#define NUM_BLOCKS     (GOLDEN_COUNT / GOLDEN_BLOCK)
+
+// Flags of golden files
+#define GOLDEN_FLOAT24 0x1 // the results are float24 values, imported from the device
+
+// dump-tests' <op>-dump.bin, a header and one 3-byte little endian float24 result per input
+#define DUMP_MAGIC   0x504D4450 // "PDMP"
+#define DUMP_VERSION 1
+
+typedef struct {
+	u32 magic;
+	u32 version;
+	u32 op;            // PICA_OP_*
+	u32 count;         // results, GOLDEN_COUNT
+	u32 block_size;    // results per block, GOLDEN_BLOCK
+	u32 num_blocks;
+	float src[2];      // the second and third sources, in every component
+	u64 data_size;     // bytes of blocks after the index
+	u32 flags;         // GOLDEN_*
+	u32 checksum;      // CRC-32 of the index and the blocks
+	u32 reserved[4];
+} golden_header;       // followed by num_blocks + 1 block offsets (u64, from the first block) and the blocks
+
+typedef struct {
+	u32 first;         // result of the first input of the block
+	u32 base;          // smallest difference between consecutive results, as s32
+	u8 width;          // bits of each packed difference above base
+	u8 scale;          // low zero bits every difference above base shares, not stored
+	u8 reserved[6];
+} block_header;        // followed by (GOLDEN_BLOCK - 1) * width bits in u64 words
+
+typedef struct {
+	u32 magic;
+	u32 version;
+	u32 op;            // PICA_OP_*
+	u32 first;         // first input
+	u32 count;         // results following the header
+	u32 checksum;      // CRC-32 of the results
+	u32 reserved[2];
+} dump_header;
+
+#define MAX_BLOCK_SIZE (sizeof(block_header) + ((GOLDEN_BLOCK - 1) * 32 + 63) / 64 * 8)
+
+typedef struct {
+	const golden_header* header;
+	const u64* index;
+	const u8* data;
+	size_t size;
+} golden_file;
+
+//
+// Blocks
+//
+
+static u32 crc32(u32 crc, const void* data, size_t size)
+{
+	static u32 table[256];
+	const u8* p = data;
+
+	if (!table[1]) {
+		for (u32 i = 0; i < 256; i++) {
+			u32 c = i;
+			for (int j = 0; j < 8; j++)
+				c = (c >> 1) ^ (c & 1 ? 0xEDB88320 : 0);
+			table[i] = c;
+		}
+	}
+
+	crc = ~crc;
+	while (size--)
+		crc = table[(crc ^ *p++) & 0xFF] ^ (crc >> 8);
+	return ~crc;
+}
+
+static size_t encode_block(const u32* v, u8* out)
+{
+	block_header* h = (block_header*)out;
+	u64* words = (u64*)(h + 1);
+	s64 lo = (s32)(v[1] - v[0]), hi = lo;
+	u64 bits = 0;
+
+	for (u32 i = 2; i < GOLDEN_BLOCK; i++) {
+		s64 d = (s32)(v[i] - v[i - 1]);
+		lo = d < lo ? d : lo;
+		hi = d > hi ? d : hi;
+	}
+	for (u32 i = 1; i < GOLDEN_BLOCK; i++)
+		bits |= (u64)((s32)(v[i] - v[i - 1]) - lo);
+
+	// Float24 results converted to float32 all end with 7 zero bits, and so do their differences
+	memset(h, 0, sizeof(*h));
+	h->first = v[0];
+	h->base = (u32)lo;
+	h->scale = bits ? __builtin_ctzll(bits) : 0;
+	h->width = hi > lo ? 64 - __builtin_clzll((u64)(hi - lo) >> h->scale) : 0;
+
+	u32 num_words = ((GOLDEN_BLOCK - 1) * h->width + 63) / 64;
+	memset(words, 0, num_words * sizeof(u64));
+	for (u32 i = 1; i < GOLDEN_BLOCK; i++) {
+		u64 x = (u64)((s32)(v[i] - v[i - 1]) - lo) >> h->scale;
+		u32 bit = (i - 1) * h->width, shift = bit % 64;
+		words[bit / 64] |= x << shift;
+		if (shift + h->width > 64)
+			words[bit / 64 + 1] |= x >> (64 - shift);
+	}
+	return sizeof(*h) + num_words * sizeof(u64);
+}
+
+// Decodes the results up to and including v[last]
+static void decode_block(const u8* in, u32* v, u32 last)
+{
+	const block_header* h = (const block_header*)in;
+	const u64* words = (const u64*)(h + 1);
+	u64 mask = (1ull << h->width) - 1;
+
+	v[0] = h->first;
+	for (u32 i = 1; i <= last; i++) {
+		u32 bit = (i - 1) * h->width, shift = bit % 64;
+		u64 x = h->width ? words[bit / 64] >> shift : 0;
+		if (shift + h->width > 64)
+			x |= words[bit / 64 + 1] << (64 - shift);
+		v[i] = v[i - 1] + ((u32)(x & mask) << h->scale) + h->base;
+	}
+}
+
+//
+// Sweeps
+//
+
+typedef struct {
+	u32 op;
+	float src[2];
+	pica_shader_setup setup;
+	pica_shader_program program;
+
+	// record
+	u8* blocks;                 // NUM_BLOCKS slots of MAX_BLOCK_SIZE
+	u32* block_sizes;
+	const u32* imported;        // results of the dumps, instead of a sweep
+
+	// check
+	const golden_file* golden;
+	const golden_file* other;   // compared with golden instead of a fresh sweep when set
+	u32* mismatches;            // by block
+	bool float24;               // compare at float24 precision
+} sweep_job;
+
+// Results of the inputs [first, first + GOLDEN_BLOCK)
+static void sweep_block(const sweep_job* job, u32 first, u32* results)
+{
+	pica_shader_batch batch;
+
+	for (u32 i = 0; i < GOLDEN_BLOCK; i += PICA_SHADER_LANES) {
+		memset(&batch, 0, sizeof(batch));
+		for (u32 lane = 0; lane < PICA_SHADER_LANES; lane++) {
+			float value = f24_to_f32(first + i + lane);
+			for (int c = 0; c < 4; c++) {
+				batch.input[0][c][lane] = value;
+				batch.input[1][c][lane] = job->src[0];
+				batch.input[2][c][lane] = job->src[1];
+			}
+		}
+		pica_shader_batch_run(&batch, &job->program, &job->setup);
+		for (u32 lane = 0; lane < PICA_SHADER_LANES; lane++)
+			results[i + lane] = f32_to_bits(batch.output[0][0][lane]);
+	}
+}
+
+static void record_blocks(void* arg, pica_shader_unit* unit, u32 first, u32 count)
+{
+	sweep_job* job = arg;
+	u32 results[GOLDEN_BLOCK];
+
+	for (u32 b = first; b < first + count; b++) {
+		const u32* v = results;
+		if (job->imported)
+			v = job->imported + (size_t)b * GOLDEN_BLOCK;
+		else
+			sweep_block(job, b * GOLDEN_BLOCK, results);
+		job->block_sizes[b] = encode_block(v, job->blocks + (size_t)b * MAX_BLOCK_SIZE);
+	}
+}
+
+static bool same_result(const sweep_job* job, u32 a, u32 b)
+{
+	// Truncated like the device truncates its results to fit its registers
+	if (job->float24) {
+		a = f32_to_bits(f24_to_f32(f32_to_f24(f32_from_bits(a))));
+		b = f32_to_bits(f24_to_f32(f32_to_f24(f32_from_bits(b))));
+	}
+	return a == b || (isnan(f32_from_bits(a)) && isnan(f32_from_bits(b)));
+}
+
+static void fresh_block(const sweep_job* job, u32 b, u32* results)
+{
+	if (job->other)
+		decode_block(job->other->data + job->other->index[b], results, GOLDEN_BLOCK - 1);
+	else
+		sweep_block(job, b * GOLDEN_BLOCK, results);
+}
+
+static void check_blocks(void* arg, pica_shader_unit* unit, u32 first, u32 count)
+{
+	sweep_job* job = arg;
+	u32 golden[GOLDEN_BLOCK], fresh[GOLDEN_BLOCK];
+
+	for (u32 b = first; b < first + count; b++) {
+		decode_block(job->golden->data + job->golden->index[b], golden, GOLDEN_BLOCK - 1);
+		fresh_block(job, b, fresh);
+		u32 bad = 0;
+		for (u32 i = 0; i < GOLDEN_BLOCK; i++)
+			bad += !same_result(job, golden[i], fresh[i]);
+		job->mismatches[b] = bad;
+	}
+}
+
+static void prepare(sweep_job* job)
+{
+	case_build_program(&job->setup, job->op);
+	pica_shader_batch_compile(&job->program, &job->setup);
+	if (!job->program.valid) {
+		fprintf(stderr, "the batch engine cannot run this program\n");
+		exit(1);
+	}
+}
+
+//
+// Files
+//
+
+static bool map_golden(golden_file* g, const char* path)
+{
+	int fd = open(path, O_RDONLY);
+	struct stat st;
+	if (fd < 0 || fstat(fd, &st) || (size_t)st.st_size < sizeof(golden_header)) {
+		fprintf(stderr, "cannot read %s\n", path);
+		if (fd >= 0)
+			close(fd);
+		return false;
+	}
+	void* map = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+	close(fd);
+	if (map == MAP_FAILED) {
+		fprintf(stderr, "cannot map %s\n", path);
+		return false;
+	}
+
+	const golden_header* h = map;
+	size_t index_size = (NUM_BLOCKS + 1) * sizeof(u64);
+	if (h->magic != GOLDEN_MAGIC || h->version != GOLDEN_VERSION || h->count != GOLDEN_COUNT ||
+		h->block_size != GOLDEN_BLOCK || h->num_blocks != NUM_BLOCKS ||
+		(size_t)st.st_size != sizeof(*h) + index_size + h->data_size) {
+		fprintf(stderr, "%s is not a golden file of this version\n", path);
+		munmap(map, st.st_size);
+		return false;
+	}
+	g->header = h;
+	g->index = (const u64*)(h + 1);
+	g->data = (const u8*)g->index + index_size;
+	g->size = st.st_size;
+
+	if (crc32(0, g->index, index_size + h->data_size) != h->checksum) {
+		fprintf(stderr, "%s: the checksum does not match\n", path);
+		munmap(map, st.st_size);
+		return false;
+	}
+
+	// Decoding trusts the widths, a block must be as long as its width says
+	for (u32 b = 0; b < NUM_BLOCKS; b++) {
+		const block_header* block = (const block_header*)(g->data + g->index[b]);
+		if (g->index[b] > g->index[b + 1] || g->index[b + 1] > h->data_size ||
+			g->index[b + 1] - g->index[b] < sizeof(block_header) || block->width > 32 || block->scale > 31 ||
+			g->index[b + 1] - g->index[b] != sizeof(block_header) + ((GOLDEN_BLOCK - 1) * block->width + 63) / 64 * 8) {
+			fprintf(stderr, "%s: block %u is damaged\n", path, (unsigned)b);
+			munmap(map, st.st_size);
+			return false;
+		}
+	}
+	return true;
+}
+
+static const case_instruction* find_instruction(const char* name)
+{
+	for (u32 i = 0; i < NUM_CASE_INSTRUCTIONS; i++)
+		if (!strcmp(case_instructions[i].name, name))
+			return &case_instructions[i];
+	return NULL;
+}
+
+static double seconds(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+// Writes the header, the index and the blocks the job encoded, returns the size of the file or 0
+static u64 write_golden(const char* path, golden_header* header, const sweep_job* job)
+{
+	static u64 index[NUM_BLOCKS + 1];
+	for (u32 b = 0; b < NUM_BLOCKS; b++)
+		index[b + 1] = index[b] + job->block_sizes[b];
+
+	header->magic = GOLDEN_MAGIC;
+	header->version = GOLDEN_VERSION;
+	header->count = GOLDEN_COUNT;
+	header->block_size = GOLDEN_BLOCK;
+	header->num_blocks = NUM_BLOCKS;
+	header->data_size = index[NUM_BLOCKS];
+	header->checksum = crc32(0, index, sizeof(index));
+	for (u32 b = 0; b < NUM_BLOCKS; b++)
+		header->checksum = crc32(header->checksum, job->blocks + (size_t)b * MAX_BLOCK_SIZE, job->block_sizes[b]);
+
+	FILE* f = fopen(path, "wb");
+	bool ok = f && fwrite(header, sizeof(*header), 1, f) == 1 && fwrite(index, sizeof(index), 1, f) == 1;
+	for (u32 b = 0; ok && b < NUM_BLOCKS; b++)
+		ok = fwrite(job->blocks + (size_t)b * MAX_BLOCK_SIZE, job->block_sizes[b], 1, f) == 1;
+	if (!f || fclose(f) || !ok) {
+		fprintf(stderr, "cannot write %s\n", path);
+		remove(path);
+		return 0;
+	}
+	return sizeof(*header) + sizeof(index) + header->data_size;
+}
+
+static bool alloc_blocks(sweep_job* job)
+{
+	job->blocks = malloc((size_t)NUM_BLOCKS * MAX_BLOCK_SIZE);
+	job->block_sizes = calloc(NUM_BLOCKS, sizeof(u32));
+	if (!job->blocks || !job->block_sizes) {
+		fprintf(stderr, "out of memory\n");
+		return false;
+	}
+	return true;
+}
+
+//
+// Commands
+//
+
+static int record(const char* name, const float* src, const char* path)
+{
+	const case_instruction* ins = find_instruction(name);
+	if (!ins) {
+		fprintf(stderr, "unknown instruction %s\n", name);
+		return 2;
+	}
+
+	static sweep_job job;
+	job.op = ins->op;
+	job.src[0] = f24_round(src[0]);
+	job.src[1] = f24_round(src[1]);
+	prepare(&job);
+	if (!alloc_blocks(&job))
+		return 1;
+
+	double start = seconds();
+	pica_units_run(NUM_BLOCKS, record_blocks, &job);
+	double elapsed = seconds() - start;
+
+	golden_header header;
+	memset(&header, 0, sizeof(header));
+	header.op = ins->op;
+	header.src[0] = job.src[0];
+	header.src[1] = job.src[1];
+	u64 size = write_golden(path, &header, &job);
+	if (!size)
+		return 1;
+
+	printf("%s: %u results in %.2f s, %.1f MiB, %.2f bits per result\n", name, GOLDEN_COUNT, elapsed,
+		size / 1048576.0, size * 8.0 / GOLDEN_COUNT);
+	free(job.blocks);
+	free(job.block_sizes);
+	return 0;
+}
+
+// Reads a dump into results, marking the inputs it covers. Returns the opcode or -1.
+static int read_dump(const char* path, u32* results, u8* covered)
+{
+	FILE* f = fopen(path, "rb");
+	dump_header h;
+	if (!f || fread(&h, sizeof(h), 1, f) != 1) {
+		fprintf(stderr, "cannot read %s\n", path);
+		if (f)
+			fclose(f);
+		return -1;
+	}
+	if (h.magic != DUMP_MAGIC || h.version != DUMP_VERSION || h.first > GOLDEN_COUNT ||
+		h.count > GOLDEN_COUNT - h.first || !case_instruction_of(h.op)) {
+		fprintf(stderr, "%s is not a dump of this version\n", path);
+		fclose(f);
+		return -1;
+	}
+
+	// One more byte than the results, to notice trailing data
+	u8* data = malloc((size_t)h.count * 3 + 1);
+	if (!data) {
+		fprintf(stderr, "out of memory\n");
+		fclose(f);
+		return -1;
+	}
+	size_t got = fread(data, 1, (size_t)h.count * 3 + 1, f);
+	fclose(f);
+	if (got != (size_t)h.count * 3) {
+		fprintf(stderr, "%s: expected %u results\n", path, (unsigned)h.count);
+		free(data);
+		return -1;
+	}
+	if (crc32(0, data, got) != h.checksum) {
+		fprintf(stderr, "%s: the checksum does not match\n", path);
+		free(data);
+		return -1;
+	}
+
+	for (u32 i = 0; i < h.count; i++) {
+		u32 input = h.first + i;
+		u32 bits = f32_to_bits(f24_to_f32(case_get_f24(data + 3 * i)));
+		if (covered[input] && results[input] != bits) {
+			fprintf(stderr, "%s: input %06x (%g) differs from an earlier dump\n", path, (unsigned)input,
+				f24_to_f32(input));
+			free(data);
+			return -1;
+		}
+		results[input] = bits;
+		covered[input] = 1;
+	}
+	free(data);
+	return h.op;
+}
+
+static int import(const char* path, char** dumps, int count)
+{
+	static sweep_job job;
+	u32* results = malloc(GOLDEN_COUNT * sizeof(u32));
+	u8* covered = calloc(GOLDEN_COUNT, 1);
+	int op = -1;
+
+	if (!results || !covered) {
+		fprintf(stderr, "out of memory\n");
+		return 1;
+	}
+	for (int i = 0; i < count; i++) {
+		int dump_op = read_dump(dumps[i], results, covered);
+		if (dump_op < 0)
+			return 1;
+		if (op >= 0 && dump_op != op) {
+			fprintf(stderr, "%s is a dump of %s, not %s\n", dumps[i], case_instruction_of(dump_op)->name,
+				case_instruction_of(op)->name);
+			return 1;
+		}
+		op = dump_op;
+	}
+
+	u32 missing = 0, first_missing = 0;
+	for (u32 i = GOLDEN_COUNT; i-- > 0;) {
+		if (!covered[i]) {
+			missing++;
+			first_missing = i;
+		}
+	}
+	if (missing) {
+		fprintf(stderr, "the dumps miss %u inputs, from %06x (%g)\n", (unsigned)missing, (unsigned)first_missing,
+			f24_to_f32(first_missing));
+		return 1;
+	}
+
+	job.op = op;
+	job.imported = results;
+	if (!alloc_blocks(&job))
+		return 1;
+	pica_units_run(NUM_BLOCKS, record_blocks, &job);
+
+	golden_header header;
+	memset(&header, 0, sizeof(header));
+	header.op = op;
+	header.flags = GOLDEN_FLOAT24;
+	u64 size = write_golden(path, &header, &job);
+	if (!size)
+		return 1;
+
+	printf("%s: %u results from %d dump%s, %.1f MiB, %.2f bits per result\n", case_instruction_of(op)->name,
+		GOLDEN_COUNT, count, count > 1 ? "s" : "", size / 1048576.0, size * 8.0 / GOLDEN_COUNT);
+	free(results);
+	free(covered);
+	free(job.blocks);
+	free(job.block_sizes);
+	return 0;
+}
+
+static void print_result(const char* label, u32 bits)
+{
+	printf("%s %08x (%g)", label, (unsigned)bits, f32_from_bits(bits));
+}
+
+static int check(const char* path, const char* other_path, u32 max_reports)
+{
+	static golden_file golden, other;
+	static sweep_job job;
+
+	if (!map_golden(&golden, path) || (other_path && !map_golden(&other, other_path)))
+		return 1;
+	if (other_path && (other.header->op != golden.header->op ||
+		memcmp(other.header->src, golden.header->src, sizeof(golden.header->src)))) {
+		fprintf(stderr, "%s and %s are sweeps of different configurations\n", path, other_path);
+		return 1;
+	}
+
+	job.op = golden.header->op;
+	memcpy(job.src, golden.header->src, sizeof(job.src));
+	job.golden = &golden;
+	job.other = other_path ? &other : NULL;
+	job.float24 = ((golden.header->flags | (other_path ? other.header->flags : 0)) & GOLDEN_FLOAT24) != 0;
+	job.mismatches = calloc(NUM_BLOCKS, sizeof(u32));
+	if (!other_path)
+		prepare(&job);
+
+	double start = seconds();
+	pica_units_run(NUM_BLOCKS, check_blocks, &job);
+	double elapsed = seconds() - start;
+
+	// The reports go through the blocks in order, whatever thread found what
+	u64 total = 0;
+	u32 reports = 0;
+	for (u32 b = 0; b < NUM_BLOCKS; b++) {
+		total += job.mismatches[b];
+		if (!job.mismatches[b] || reports >= max_reports)
+			continue;
+
+		u32 expected[GOLDEN_BLOCK], actual[GOLDEN_BLOCK];
+		decode_block(golden.data + golden.index[b], expected, GOLDEN_BLOCK - 1);
+		fresh_block(&job, b, actual);
+		for (u32 i = 0; i < GOLDEN_BLOCK && reports < max_reports; i++) {
+			if (same_result(&job, expected[i], actual[i]))
+				continue;
+			u32 input = b * GOLDEN_BLOCK + i;
+			printf("input %06x (%g):", (unsigned)input, f24_to_f32(input));
+			print_result(" golden", expected[i]);
+			print_result(other_path ? ", other" : ", now", actual[i]);
+			printf("\n");
+			reports++;
+		}
+	}
+
+	printf("%llu of %u results differ (%.2f s, %.0f M results/s)\n", (unsigned long long)total, GOLDEN_COUNT,
+		elapsed, GOLDEN_COUNT / elapsed * 1e-6);
+	free(job.mismatches);
+	return total ? 1 : 0;
+}
+
+static int lookup(const char* path, char** values, int count)
+{
+	static golden_file golden;
+	if (!map_golden(&golden, path))
+		return 1;
+
+	for (int i = 0; i < count; i++) {
+		u32 input = f32_to_f24(strtof(values[i], NULL));
+		u32 b = input / GOLDEN_BLOCK, results[GOLDEN_BLOCK];
+		decode_block(golden.data + golden.index[b], results, input % GOLDEN_BLOCK);
+		printf("input %06x (%g):", (unsigned)input, f24_to_f32(input));
+		print_result("", results[input % GOLDEN_BLOCK]);
+		printf("\n");
+	}
+	return 0;
+}
+
+static int usage(const char* name)
+{
+	fprintf(stderr, "usage: %s record [--src2 v] [--src3 v] [--threads n] op out.gold\n"
+		"       %s check [--threads n] [--reports n] file.gold [other.gold]\n"
+		"       %s lookup file.gold value...\n"
+		"       %s import out.gold dump.bin...\n", name, name, name, name);
+	return 2;
+}
+
+int main(int argc, char** argv)
+{
+	float src[2] = { 0.0f, 0.0f };
+	u32 max_reports = 16;
+	int i;
+
+	if (argc < 2)
+		return usage(argv[0]);
+
+	for (i = 2; i < argc && argv[i][0] == '-' && argv[i][1] == '-'; i += 2) {
+		if (i + 1 >= argc)
+			return usage(argv[0]);
+		if (!strcmp(argv[i], "--src2"))
+			src[0] = strtof(argv[i + 1], NULL);
+		else if (!strcmp(argv[i], "--src3"))
+			src[1] = strtof(argv[i + 1], NULL);
+		else if (!strcmp(argv[i], "--threads"))
+			pica_units_set_threads(atoi(argv[i + 1]));
+		else if (!strcmp(argv[i], "--reports"))
+			max_reports = atoi(argv[i + 1]);
+		else
+			return usage(argv[0]);
+	}
+
+	if (!strcmp(argv[1], "record") && argc - i == 2)
+		return record(argv[i], src, argv[i + 1]);
+	if (!strcmp(argv[1], "check") && (argc - i == 1 || argc - i == 2))
+		return check(argv[i], argc - i == 2 ? argv[i + 1] : NULL, max_reports);
+	if (!strcmp(argv[1], "lookup") && argc - i >= 2)
+		return lookup(argv[i], &argv[i + 1], argc - i - 1);
+	if (!strcmp(argv[1], "import") && argc - i >= 2)
+		return import(argv[i], &argv[i + 1], argc - i - 1);
+	return usage(argv[0]);
+}
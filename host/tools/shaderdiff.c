@@ -0,0 +1,653 @@
+/*
+ * Differential test of the shader engines
+ * usage: shaderdiff [--ops dph,rcp,...] [--count n] [--seed s] [--exhaustive] [--threads n] [--reports n]
+ *        shaderdiff --repro op v0.x,v0.y,...,v2.w
+ *
+ * Every case runs one instruction on the interpreter (pica_shader_run), on the batch engine
+ * (pica_shader_batch_run) and on a double precision reference written from the instruction semantics.
+ * The two engines must agree bit for bit, NaNs aside. The reference must agree exactly for the instructions
+ * that round once, within 2 ulps for rcp, rsq, ex2 and lg2, and within the float rounding bound of the sum
+ * for dot products and mad. Cases where a float intermediate overflows are not checked against it.
+ *
+ * Operands are float24 values, random or special (zeros, infinities, NaN, the extremes), derived from the
+ * seed and the case number so that runs are reproducible with any number of threads. --exhaustive goes
+ * through the 2^24 float24 values of the first operand for the one-operand instructions instead.
+ * Mismatches are shrunk, operands that can be 0 or 1 without hiding the mismatch are, and printed as
+ * --repro command lines.
+ */
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "float24.h"
+#include "shader.h"
+#include "shader_batch.h"
+#include "units.h"
+
+#define CHUNK (1 << 16)
+#define MAX_REPORTS 64
+
+enum { CHECK_EXACT, CHECK_ULPS, CHECK_SUM };
+
+typedef struct {
+	const char* name;
+	u32 op;
+	int sources;   // operands read, v0 to v2
+	int check;     // CHECK_*, against the reference
+} instruction;
+
+static const instruction instructions[] = {
+	{ "add",  PICA_OP_ADD,  2, CHECK_EXACT },
+	{ "mul",  PICA_OP_MUL,  2, CHECK_EXACT },
+	{ "mad",  PICA_OP_MAD,  3, CHECK_SUM },
+	{ "dp3",  PICA_OP_DP3,  2, CHECK_SUM },
+	{ "dp4",  PICA_OP_DP4,  2, CHECK_SUM },
+	{ "dph",  PICA_OP_DPH,  2, CHECK_SUM },
+	{ "dphi", PICA_OP_DPHI, 2, CHECK_SUM },
+	{ "sge",  PICA_OP_SGE,  2, CHECK_EXACT },
+	{ "sgei", PICA_OP_SGEI, 2, CHECK_EXACT },
+	{ "slt",  PICA_OP_SLT,  2, CHECK_EXACT },
+	{ "slti", PICA_OP_SLTI, 2, CHECK_EXACT },
+	{ "min",  PICA_OP_MIN,  2, CHECK_EXACT },
+	{ "max",  PICA_OP_MAX,  2, CHECK_EXACT },
+	{ "flr",  PICA_OP_FLR,  1, CHECK_EXACT },
+	{ "mova", PICA_OP_MOVA, 1, CHECK_EXACT },
+	{ "rcp",  PICA_OP_RCP,  1, CHECK_ULPS },
+	{ "rsq",  PICA_OP_RSQ,  1, CHECK_ULPS },
+	{ "ex2",  PICA_OP_EX2,  1, CHECK_ULPS },
+	{ "lg2",  PICA_OP_LG2,  1, CHECK_ULPS },
+};
+#define NUM_INSTRUCTIONS (sizeof(instructions) / sizeof(instructions[0]))
+
+#define MAX_ULPS 2
+
+// Operands v0-v2 and results o0-o1 of a case
+typedef struct {
+	float in[3][4];
+	float out[3][2][4]; // interpreter, batch engine, reference
+	bool overflow;      // a float intermediate overflowed, the reference is not comparable
+} test_case;
+
+enum { ENGINE_INTERPRETER, ENGINE_BATCH, ENGINE_REFERENCE };
+static const char* engine_names[] = { "interpreter", "batch", "reference" };
+
+//
+// Programs
+//
+
+#define SWIZZLE_XYZW 0x1B
+#define DESC_XYZW (0xF | (SWIZZLE_XYZW << 5) | (SWIZZLE_XYZW << 14) | (SWIZZLE_XYZW << 23))
+#define DESC_XY   (0xC | (SWIZZLE_XYZW << 5) | (SWIZZLE_XYZW << 14) | (SWIZZLE_XYZW << 23))
+
+// op o0, v0, v1 (, v2) and end. mova loads a0 from v0 and reads c[a0.x] and c[a0.y] to o0 and o1, the
+// float uniforms hold their own index so the results are the address registers, or 1 out of range.
+static void build_program(pica_shader_setup* setup, const instruction* ins)
+{
+	u32 n = 0;
+
+	memset(setup, 0, sizeof(*setup));
+	setup->opdesc[0] = DESC_XYZW;
+	setup->opdesc[1] = DESC_XY;
+	for (int i = 0; i < PICA_SHADER_NUM_FLOAT_UNIFORMS; i++)
+		for (int c = 0; c < 4; c++)
+			setup->f[i][c] = i;
+
+	if (ins->op == PICA_OP_MOVA) {
+		setup->code[n++] = (PICA_OP_MOVA << 26) | (0x00 << 12) | 1;
+		setup->code[n++] = (PICA_OP_MOV << 26) | (0 << 21) | (1 << 19) | (0x20 << 12);
+		setup->code[n++] = (PICA_OP_MOV << 26) | (1 << 21) | (2 << 19) | (0x20 << 12);
+	} else if (ins->op == PICA_OP_MAD) {
+		setup->code[n++] = (PICA_OP_MAD << 26) | (0 << 24) | (0 << 17) | (1 << 10) | (2 << 5);
+	} else if (pica_op_is_inverted(ins->op)) {
+		setup->code[n++] = (ins->op << 26) | (0 << 21) | (0 << 14) | (1 << 7);
+	} else {
+		setup->code[n++] = (ins->op << 26) | (0 << 21) | (0 << 12) | (1 << 7);
+	}
+	setup->code[n++] = PICA_OP_END << 26;
+}
+
+//
+// Reference
+//
+
+static bool overflows(double x)
+{
+	return fabs(x) > 3.4028234663852886e38;
+}
+
+// pica_mul in double, products of floats are exact
+static double ref_mul(double a, double b)
+{
+	if ((isinf(a) && b == 0) || (isinf(b) && a == 0))
+		return 0;
+	return a * b;
+}
+
+// Computes the reference and the sum of the magnitudes of its terms, for CHECK_SUM
+static void reference(const instruction* ins, test_case* t, double magnitude[4])
+{
+	const float* a = t->in[0];
+	const float* b = t->in[1];
+	const float* c = t->in[2];
+	float* out = t->out[ENGINE_REFERENCE][0];
+	int i;
+
+	memset(t->out[ENGINE_REFERENCE], 0, sizeof(t->out[ENGINE_REFERENCE]));
+	t->overflow = false;
+
+	switch (ins->op) {
+	case PICA_OP_ADD:
+		for (i = 0; i < 4; i++)
+			out[i] = (double)a[i] + b[i];
+		break;
+
+	case PICA_OP_MUL:
+		for (i = 0; i < 4; i++)
+			out[i] = ref_mul(a[i], b[i]);
+		break;
+
+	case PICA_OP_MAD:
+		for (i = 0; i < 4; i++) {
+			double p = ref_mul(a[i], b[i]);
+			t->overflow |= overflows(p) || overflows(p + c[i]);
+			out[i] = p + c[i];
+			magnitude[i] = fabs(p) + fabs(c[i]);
+		}
+		break;
+
+	case PICA_OP_DP3:
+	case PICA_OP_DP4:
+	case PICA_OP_DPH:
+	case PICA_OP_DPHI: {
+		int count = ins->op == PICA_OP_DP3 ? 3 : 4;
+		bool homogeneous = ins->op == PICA_OP_DPH || ins->op == PICA_OP_DPHI;
+		double dot = 0, sum = 0;
+		for (i = 0; i < count; i++) {
+			double p = ref_mul((homogeneous && i == 3) ? 1.0 : a[i], b[i]);
+			t->overflow |= overflows(p) || overflows(dot + p);
+			dot += p;
+			sum += fabs(p);
+		}
+		for (i = 0; i < 4; i++) {
+			out[i] = dot;
+			magnitude[i] = sum;
+		}
+		break;
+	}
+
+	case PICA_OP_SGE:
+	case PICA_OP_SGEI:
+		for (i = 0; i < 4; i++)
+			out[i] = (double)a[i] >= b[i];
+		break;
+
+	case PICA_OP_SLT:
+	case PICA_OP_SLTI:
+		for (i = 0; i < 4; i++)
+			out[i] = (double)a[i] < b[i];
+		break;
+
+	case PICA_OP_MIN:
+		for (i = 0; i < 4; i++)
+			out[i] = (double)a[i] < b[i] ? a[i] : b[i];
+		break;
+
+	case PICA_OP_MAX:
+		for (i = 0; i < 4; i++)
+			out[i] = (double)a[i] > b[i] ? a[i] : b[i];
+		break;
+
+	case PICA_OP_FLR:
+		for (i = 0; i < 4; i++)
+			out[i] = floor(a[i]);
+		break;
+
+	case PICA_OP_MOVA:
+		// Truncated to an integer, then used as the index of a float uniform
+		for (int r = 0; r < 2; r++) {
+			double index = trunc(a[r]);
+			float value = (index >= 0 && index < PICA_SHADER_NUM_FLOAT_UNIFORMS) ? (int)index : 1.0f;
+			for (i = 0; i < 4; i++)
+				t->out[ENGINE_REFERENCE][r][i] = value;
+		}
+		break;
+
+	case PICA_OP_RCP:
+	case PICA_OP_RSQ:
+	case PICA_OP_EX2:
+	case PICA_OP_LG2: {
+		double x = a[0], r;
+		if (ins->op == PICA_OP_RCP)
+			r = 1.0 / x;
+		else if (ins->op == PICA_OP_RSQ)
+			r = 1.0 / sqrt(x);
+		else if (ins->op == PICA_OP_EX2)
+			r = exp2(x);
+		else
+			r = log2(x);
+		for (i = 0; i < 4; i++)
+			out[i] = r;
+		break;
+	}
+	}
+}
+
+//
+// Comparisons
+//
+
+static bool same_bits(float a, float b)
+{
+	return (isnan(a) && isnan(b)) || f32_to_bits(a) == f32_to_bits(b);
+}
+
+// Distance in representable floats, across zero
+static u32 ulps(float a, float b)
+{
+	s32 x = f32_to_bits(a), y = f32_to_bits(b);
+	if (x < 0)
+		x = (s32)0x80000000 - x;
+	if (y < 0)
+		y = (s32)0x80000000 - y;
+	return x > y ? (u32)x - (u32)y : (u32)y - (u32)x;
+}
+
+static bool close_to_reference(const instruction* ins, float value, float ref, double magnitude)
+{
+	if (isnan(value) || isnan(ref))
+		return isnan(value) && isnan(ref);
+
+	switch (ins->check) {
+	case CHECK_ULPS:
+		return value == ref || ulps(value, ref) <= MAX_ULPS;
+	case CHECK_SUM:
+		// Every rounding of the float evaluation is within half an ulp of the magnitude of the terms
+		return value == ref || fabs((double)value - ref) <= 4 * ldexp(magnitude, -24);
+	default:
+		return same_bits(value, ref);
+	}
+}
+
+// Output registers the program writes
+static int outputs(const instruction* ins)
+{
+	return ins->op == PICA_OP_MOVA ? 2 : 1;
+}
+
+// Returns the engines that disagree as a bit mask of (1 << engine), 0 when they all agree
+static u32 check(const instruction* ins, test_case* t)
+{
+	double magnitude[4] = { 0 };
+	u32 bad = 0;
+
+	reference(ins, t, magnitude);
+	for (int r = 0; r < outputs(ins); r++) {
+		for (int c = 0; c < 4; c++) {
+			float interpreter = t->out[ENGINE_INTERPRETER][r][c];
+			if (!same_bits(interpreter, t->out[ENGINE_BATCH][r][c]))
+				bad |= (1 << ENGINE_INTERPRETER) | (1 << ENGINE_BATCH);
+			if (!t->overflow && !close_to_reference(ins, interpreter, t->out[ENGINE_REFERENCE][r][c], magnitude[c]))
+				bad |= (1 << ENGINE_INTERPRETER) | (1 << ENGINE_REFERENCE);
+		}
+	}
+	return bad;
+}
+
+//
+// Operands
+//
+
+static u64 splitmix64(u64 x)
+{
+	x += 0x9E3779B97F4A7C15ull;
+	x = (x ^ (x >> 30)) * 0xBF58476D1CE4E5B9ull;
+	x = (x ^ (x >> 27)) * 0x94D049BB133111EBull;
+	return x ^ (x >> 31);
+}
+
+static const u32 special_values[] = {
+	0x000000, 0x800000, // +0, -0
+	0x3F0000, 0xBF0000, // 1, -1
+	0x3E0000, 0x400000, // 0.5, 2
+	0x7F0000, 0xFF0000, // +inf, -inf
+	0x7F0001,           // NaN
+	0x010000, 0x810000, // smallest normals
+	0x7EFFFF, 0xFEFFFF, // largest finite
+	0x3EFFFF, 0x3F0001, // around 1
+};
+#define NUM_SPECIAL_VALUES (sizeof(special_values) / sizeof(special_values[0]))
+
+static float random_operand(u64 bits)
+{
+	switch (bits & 7) {
+	case 0:
+		return f24_to_f32(special_values[(bits >> 3) % NUM_SPECIAL_VALUES]);
+	case 1:
+		return f24_to_f32((bits >> 3) & 0xFFFFFF); // any float24, NaNs included
+	default: {
+		// Exponents within 2^-16 and 2^16, where the suites' values are
+		u32 sign = (bits >> 3) & 1;
+		u32 exponent = 63 - 16 + ((bits >> 4) % 33);
+		u32 mantissa = (bits >> 16) & 0xFFFF;
+		return f24_to_f32((sign << 23) | (exponent << 16) | mantissa);
+	}
+	}
+}
+
+typedef struct {
+	const instruction* ins;
+	const pica_shader_setup* setup;
+	const pica_shader_program* program;
+	u64 seed;
+	u64 base;         // case number of the first case of the chunk
+	bool exhaustive;
+
+	u64 mismatches;   // updated atomically
+	u32 num_reports;
+	test_case reports[MAX_REPORTS];
+	u32 report_engines[MAX_REPORTS];
+	u64 report_index[MAX_REPORTS];
+} diff_job;
+
+static void generate(const diff_job* job, u64 index, test_case* t)
+{
+	memset(t->in, 0, sizeof(t->in));
+	if (job->exhaustive) {
+		t->in[0][0] = f24_to_f32(index & 0xFFFFFF);
+		return;
+	}
+
+	// One hash per case, an xorshift for its operands
+	u64 state = splitmix64(job->seed ^ splitmix64(index)) | 1;
+	for (int s = 0; s < job->ins->sources; s++) {
+		for (int c = 0; c < 4; c++) {
+			state ^= state << 13;
+			state ^= state >> 7;
+			state ^= state << 17;
+			t->in[s][c] = random_operand(state);
+		}
+	}
+
+	// Comparisons are most interesting between equal values
+	if (job->ins->sources >= 2 && (state >> 60) == 0)
+		memcpy(t->in[1], t->in[0], sizeof(t->in[0]));
+}
+
+//
+// Engines
+//
+
+static void run_interpreter(const diff_job* job, pica_shader_unit* unit, test_case* t)
+{
+	memcpy(unit->input, t->in, sizeof(t->in));
+	memset(unit->output, 0, 2 * sizeof(unit->output[0]));
+	unit->trace = NULL;
+	unit->budget = 0;
+	memset(unit->addr, 0, sizeof(unit->addr));
+	pica_shader_run(unit, job->setup);
+	memcpy(t->out[ENGINE_INTERPRETER], unit->output, sizeof(t->out[ENGINE_INTERPRETER]));
+}
+
+static void run_batch(const diff_job* job, pica_shader_batch* batch, test_case* t, u32 n)
+{
+	for (u32 lane = 0; lane < PICA_SHADER_LANES; lane++)
+		for (int s = 0; s < 3; s++)
+			for (int c = 0; c < 4; c++)
+				batch->input[s][c][lane] = lane < n ? t[lane].in[s][c] : 0.0f;
+	memset(batch->addr, 0, sizeof(batch->addr));
+
+	pica_shader_batch_run(batch, job->program, job->setup);
+
+	for (u32 lane = 0; lane < n; lane++)
+		for (int r = 0; r < 2; r++)
+			for (int c = 0; c < 4; c++)
+				t[lane].out[ENGINE_BATCH][r][c] = batch->output[r][c][lane];
+}
+
+static void record(diff_job* job, const test_case* t, u64 index, u32 engines)
+{
+	__atomic_fetch_add(&job->mismatches, 1, __ATOMIC_RELAXED);
+	u32 slot = __atomic_fetch_add(&job->num_reports, 1, __ATOMIC_RELAXED);
+	if (slot >= MAX_REPORTS)
+		return;
+	job->reports[slot] = *t;
+	job->report_engines[slot] = engines;
+	job->report_index[slot] = index;
+}
+
+static void diff_cases(void* arg, pica_shader_unit* unit, u32 first, u32 count)
+{
+	static __thread pica_shader_batch batch;
+	diff_job* job = arg;
+	test_case cases[PICA_SHADER_LANES];
+
+	for (u32 k = first; k < first + count; k += PICA_SHADER_LANES) {
+		u32 n = first + count - k < PICA_SHADER_LANES ? first + count - k : PICA_SHADER_LANES;
+
+		for (u32 i = 0; i < n; i++) {
+			generate(job, job->base + k + i, &cases[i]);
+			run_interpreter(job, unit, &cases[i]);
+		}
+		run_batch(job, &batch, cases, n);
+
+		for (u32 i = 0; i < n; i++) {
+			u32 engines = check(job->ins, &cases[i]);
+			if (engines)
+				record(job, &cases[i], job->base + k + i, engines);
+		}
+	}
+}
+
+// Runs a single case on every engine
+static u32 run_case(diff_job* job, test_case* t)
+{
+	static pica_shader_unit unit;
+	static pica_shader_batch batch;
+
+	memset(&unit, 0, sizeof(unit));
+	run_interpreter(job, &unit, t);
+	run_batch(job, &batch, t, 1);
+	return check(job->ins, t);
+}
+
+//
+// Reports
+//
+
+// Sets the operands that do not matter to the mismatch to 0 or 1
+static void shrink(diff_job* job, test_case* t, u32 engines)
+{
+	static const float simple[] = { 0.0f, 1.0f };
+
+	for (int s = 0; s < job->ins->sources; s++) {
+		for (int c = 0; c < 4; c++) {
+			for (int v = 0; v < 2; v++) {
+				test_case attempt = *t;
+				if (same_bits(attempt.in[s][c], simple[v]))
+					break;
+				attempt.in[s][c] = simple[v];
+				if (run_case(job, &attempt) == engines) {
+					*t = attempt;
+					break;
+				}
+			}
+		}
+	}
+	run_case(job, t);
+}
+
+static void print_vector(const char* name, const float* v)
+{
+	printf("    %-12s (%.9g, %.9g, %.9g, %.9g)\n", name, v[0], v[1], v[2], v[3]);
+}
+
+static void print_case(const instruction* ins, const test_case* t)
+{
+	char name[32];
+
+	for (int s = 0; s < ins->sources; s++) {
+		snprintf(name, sizeof(name), "v%d", s);
+		print_vector(name, t->in[s]);
+	}
+	for (int e = 0; e < 3; e++) {
+		for (int r = 0; r < outputs(ins); r++) {
+			snprintf(name, sizeof(name), "%s o%d", engine_names[e], r);
+			print_vector(name, t->out[e][r]);
+		}
+	}
+}
+
+static void print_repro(const instruction* ins, const test_case* t)
+{
+	printf("    shaderdiff --repro %s ", ins->name);
+	for (int s = 0; s < ins->sources; s++)
+		for (int c = 0; c < 4; c++)
+			printf("%s%08x", s || c ? "," : "", (unsigned)f32_to_bits(t->in[s][c]));
+	printf("\n");
+}
+
+static void report(diff_job* job, u32 max_reports)
+{
+	u32 count = job->num_reports < MAX_REPORTS ? job->num_reports : MAX_REPORTS;
+	if (count > max_reports)
+		count = max_reports;
+
+	for (u32 i = 0; i < count; i++) {
+		test_case* t = &job->reports[i];
+		u32 engines = job->report_engines[i];
+
+		shrink(job, t, engines);
+		printf("%s: case %llu,", job->ins->name, (unsigned long long)job->report_index[i]);
+		for (int e = 0; e < 3; e++)
+			if (engines & (1 << e))
+				printf(" %s", engine_names[e]);
+		printf(" disagree\n");
+		print_case(job->ins, t);
+		print_repro(job->ins, t);
+	}
+}
+
+static const instruction* find_instruction(const char* name, size_t length)
+{
+	for (u32 i = 0; i < NUM_INSTRUCTIONS; i++)
+		if (strlen(instructions[i].name) == length && !strncmp(instructions[i].name, name, length))
+			return &instructions[i];
+	return NULL;
+}
+
+static int repro(const char* name, const char* operands)
+{
+	static pica_shader_setup setup;
+	static pica_shader_program program;
+	const instruction* ins = find_instruction(name, strlen(name));
+	if (!ins) {
+		fprintf(stderr, "unknown instruction %s\n", name);
+		return 2;
+	}
+
+	diff_job job = { ins, &setup, &program };
+	test_case t;
+	memset(&t, 0, sizeof(t));
+	for (int i = 0; i < 12 && *operands; i++) {
+		char* end;
+		t.in[i / 4][i % 4] = f32_from_bits(strtoul(operands, &end, 16));
+		operands = *end == ',' ? end + 1 : end;
+	}
+
+	build_program(&setup, ins);
+	pica_shader_batch_compile(&program, &setup);
+	u32 engines = run_case(&job, &t);
+	printf("%s: %s\n", ins->name, engines ? "engines disagree" : "engines agree");
+	print_case(ins, &t);
+	return engines ? 1 : 0;
+}
+
+static double seconds(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+int main(int argc, char** argv)
+{
+	const char* ops = NULL;
+	u64 count = 1 << 24;
+	u64 seed = 1;
+	bool exhaustive = false;
+	u32 max_reports = 8;
+
+	for (int i = 1; i < argc; i++) {
+		if (!strcmp(argv[i], "--ops") && i + 1 < argc)
+			ops = argv[++i];
+		else if (!strcmp(argv[i], "--count") && i + 1 < argc)
+			count = strtoull(argv[++i], NULL, 0);
+		else if (!strcmp(argv[i], "--seed") && i + 1 < argc)
+			seed = strtoull(argv[++i], NULL, 0);
+		else if (!strcmp(argv[i], "--exhaustive"))
+			exhaustive = true;
+		else if (!strcmp(argv[i], "--threads") && i + 1 < argc)
+			pica_units_set_threads(atoi(argv[++i]));
+		else if (!strcmp(argv[i], "--reports") && i + 1 < argc)
+			max_reports = atoi(argv[++i]);
+		else if (!strcmp(argv[i], "--repro") && i + 2 < argc)
+			return repro(argv[i + 1], argv[i + 2]);
+		else {
+			fprintf(stderr, "usage: %s [--ops dph,rcp,...] [--count n] [--seed s] [--exhaustive] [--threads n] [--reports n]\n"
+				"       %s --repro op v0.x,v0.y,...\n", argv[0], argv[0]);
+			return 2;
+		}
+	}
+
+	static pica_shader_setup setup;
+	static pica_shader_program program;
+	static diff_job job;
+	u64 total_cases = 0, total_mismatches = 0;
+	double start = seconds();
+
+	for (u32 i = 0; i < NUM_INSTRUCTIONS; i++) {
+		const instruction* ins = &instructions[i];
+		if (ops) {
+			const char* p = strstr(ops, ins->name);
+			size_t length = strlen(ins->name);
+			while (p && ((p != ops && p[-1] != ',') || (p[length] && p[length] != ',')))
+				p = strstr(p + 1, ins->name);
+			if (!p)
+				continue;
+		}
+
+		bool all = exhaustive && ins->sources == 1;
+		if (exhaustive && !all) {
+			printf("%s: not exhaustive, it has more than one operand\n", ins->name);
+			continue;
+		}
+		u64 cases = all ? 1 << 24 : count;
+
+		build_program(&setup, ins);
+		pica_shader_batch_compile(&program, &setup);
+		memset(&job, 0, sizeof(job));
+		job.ins = ins;
+		job.setup = &setup;
+		job.program = &program;
+		job.seed = seed;
+		job.exhaustive = all;
+
+		double op_start = seconds();
+		for (job.base = 0; job.base < cases; job.base += CHUNK)
+			pica_units_run(cases - job.base < CHUNK ? cases - job.base : CHUNK, diff_cases, &job);
+		double elapsed = seconds() - op_start;
+
+		printf("%s: %llu cases, %llu mismatches, %.1f M cases/s\n", ins->name, (unsigned long long)cases,
+			(unsigned long long)job.mismatches, cases / elapsed * 1e-6);
+		report(&job, max_reports);
+		total_cases += cases;
+		total_mismatches += job.mismatches;
+	}
+
+	double elapsed = seconds() - start;
+	printf("%llu cases, %llu mismatches, %.1f M instructions/s over the three engines\n",
+		(unsigned long long)total_cases, (unsigned long long)total_mismatches, total_cases * 3 / elapsed * 1e-6);
+	return total_mismatches ? 1 : 0;
+}
@@ -0,0 +1,541 @@
+/*
+ * Coverage guided fuzzer of the shader engines
+ * usage: shaderfuzz [--seed s] [--execs n] [--time seconds] [--budget instructions] [--out dir]
+ *        shaderfuzz --replay finding.bin
+ *
+ * Generates and mutates small shader programs (any opcode, operand descriptor, flow control and relative
+ * addressing) with random uniforms and inputs, and runs each of them on PICA_SHADER_LANES vertices with the
+ * interpreter and, when it accepts the program, the batch engine. The interpreter records the instructions
+ * it executes: the edges between consecutive ones, bucketed by hit count like AFL does, are the coverage, and
+ * a program reaching a new edge or count joins the corpus.
+ *
+ * Findings are written to the output directory:
+ *   crash-N.bin    an engine raised SIGSEGV, SIGBUS or SIGFPE
+ *   hang-N.bin     the interpreter ran out of its instruction budget on a new path
+ *   diverge-N.bin  the interpreter and the batch engine disagree on an output, the step count or the budget
+ * --replay runs one of them again and prints what each engine did.
+ *
+ * Runs are sandboxed: every engine gets an instruction budget, every run starts from cleared units, and
+ * programs, corpus and coverage live in fixed buffers, so nothing is allocated while fuzzing.
+ */
+
+#include <math.h>
+#include <setjmp.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <sys/stat.h>
+#include "float24.h"
+#include "shader.h"
+#include "shader_batch.h"
+
+#define MAX_CODE     64
+#define NUM_OPDESCS  16
+#define NUM_INPUTS   4          // v0-v3 are set, the other inputs stay zero
+#define CORPUS_SIZE  2048
+#define MAP_SIZE     (1 << 16)
+#define DEFAULT_BUDGET 4096
+#define MAX_FINDINGS 100        // of each kind
+
+#define FINDING_MAGIC 0x5A465350 // "PSFZ"
+
+typedef struct {
+	u32 magic;
+	u32 length;                 // instructions, an END follows them
+	u32 code[MAX_CODE];
+	u32 opdesc[NUM_OPDESCS];
+	float f[PICA_SHADER_NUM_FLOAT_UNIFORMS][4];
+	u8 i[4][4];
+	u16 b;
+	u32 entry;
+	float input[PICA_SHADER_LANES][NUM_INPUTS][4];
+} program;
+
+static program corpus[CORPUS_SIZE];
+static u32 corpus_count;
+
+// Hit count buckets of every edge seen so far, and of those seen in hangs
+static u8 virgin[MAP_SIZE], virgin_hangs[MAP_SIZE];
+static u8 hits[MAP_SIZE];
+static u32 edges_seen;
+
+static u32 budget = DEFAULT_BUDGET;
+static const char* out_dir = "fuzz-findings";
+
+//
+// Random programs
+//
+
+static u64 rng_state = 1;
+
+static u32 rnd(void)
+{
+	rng_state ^= rng_state << 13;
+	rng_state ^= rng_state >> 7;
+	rng_state ^= rng_state << 17;
+	return rng_state >> 32;
+}
+
+static u32 below(u32 n)
+{
+	return n ? rnd() % n : 0;
+}
+
+static const u32 alu_ops[] = {
+	PICA_OP_ADD, PICA_OP_DP3, PICA_OP_DP4, PICA_OP_DPH, PICA_OP_DST, PICA_OP_EX2, PICA_OP_LG2, PICA_OP_LITP,
+	PICA_OP_MUL, PICA_OP_SGE, PICA_OP_SLT, PICA_OP_FLR, PICA_OP_MAX, PICA_OP_MIN, PICA_OP_RCP, PICA_OP_RSQ,
+	PICA_OP_MOVA, PICA_OP_MOV, PICA_OP_DPHI, PICA_OP_DSTI, PICA_OP_SGEI, PICA_OP_SLTI,
+};
+
+static const u32 flow_ops[] = {
+	PICA_OP_BREAK, PICA_OP_NOP, PICA_OP_END, PICA_OP_BREAKC, PICA_OP_CALL, PICA_OP_CALLC, PICA_OP_CALLU,
+	PICA_OP_IFU, PICA_OP_IFC, PICA_OP_LOOP, PICA_OP_EMIT, PICA_OP_SETEMIT, PICA_OP_JMPC, PICA_OP_JMPU,
+};
+
+#define COUNT(a) (sizeof(a) / sizeof((a)[0]))
+
+static u32 random_instruction(u32 length)
+{
+	u32 kind = below(16);
+
+	// Common format: destination, address register, sources, any field value is valid
+	if (kind < 8)
+		return (alu_ops[below(COUNT(alu_ops))] << 26) | (rnd() & 0x03FFFF80) | below(NUM_OPDESCS);
+
+	// mad and madi, the descriptor field only has 5 bits
+	if (kind < 10)
+		return ((PICA_OP_MADI + below(16)) << 26) | (rnd() & 0x03FFFFE0) | below(NUM_OPDESCS);
+
+	if (kind < 11)
+		return ((PICA_OP_CMP + below(2)) << 26) | (rnd() & 0x03FFFF80) | below(NUM_OPDESCS);
+
+	// Flow control: targets within the program, short blocks, conditions and uniforms at random
+	return (flow_ops[below(COUNT(flow_ops))] << 26) | (rnd() & 0x03C00000) | (below(length + 1) << 10) | below(8);
+}
+
+static float random_value(void)
+{
+	static const float special[] = { 0.0f, -0.0f, 1.0f, -1.0f, 0.5f, 2.0f, 95.0f, 96.0f, -1.5f, INFINITY, -INFINITY, NAN };
+	u32 kind = below(4);
+
+	if (kind == 0)
+		return special[below(COUNT(special))];
+	if (kind == 1)
+		return f24_to_f32(rnd() & 0xFFFFFF);
+	return f24_round(((s32)below(2001) - 1000) / 64.0f);
+}
+
+static void random_program(program* p)
+{
+	memset(p, 0, sizeof(*p));
+	p->magic = FINDING_MAGIC;
+	p->length = 1 + below(16);
+	for (u32 k = 0; k < p->length; k++)
+		p->code[k] = random_instruction(p->length);
+	for (u32 k = 0; k < NUM_OPDESCS; k++)
+		p->opdesc[k] = rnd();
+	for (u32 k = 0; k < PICA_SHADER_NUM_FLOAT_UNIFORMS; k++)
+		for (int c = 0; c < 4; c++)
+			p->f[k][c] = random_value();
+	for (u32 k = 0; k < 4; k++) {
+		p->i[k][0] = below(8);
+		p->i[k][1] = below(8);
+		p->i[k][2] = below(3) - 1;
+	}
+	p->b = rnd();
+	for (u32 lane = 0; lane < PICA_SHADER_LANES; lane++)
+		for (u32 r = 0; r < NUM_INPUTS; r++)
+			for (int c = 0; c < 4; c++)
+				p->input[lane][r][c] = random_value();
+}
+
+static void mutate(program* p)
+{
+	for (u32 n = 1 + below(4); n; n--) {
+		u32 k = below(p->length);
+
+		switch (below(10)) {
+		case 0:
+			p->code[k] ^= 1 << below(32);
+			break;
+		case 1:
+			p->code[k] = random_instruction(p->length);
+			break;
+		case 2:
+			p->opdesc[below(NUM_OPDESCS)] = rnd();
+			break;
+		case 3:
+			// Retarget a flow control instruction
+			p->code[k] = (p->code[k] & ~(0xFFF << 10)) | (below(p->length + 1) << 10);
+			break;
+		case 4: {
+			u32 j = below(p->length), word = p->code[k];
+			p->code[k] = p->code[j];
+			p->code[j] = word;
+			break;
+		}
+		case 5:
+			if (p->length < MAX_CODE) {
+				memmove(&p->code[k + 1], &p->code[k], (p->length - k) * sizeof(u32));
+				p->code[k] = random_instruction(p->length);
+				p->length++;
+			}
+			break;
+		case 6:
+			if (p->length > 1) {
+				memmove(&p->code[k], &p->code[k + 1], (p->length - k - 1) * sizeof(u32));
+				p->length--;
+			}
+			break;
+		case 7: {
+			// Splice in instructions of another corpus entry
+			const program* other = &corpus[below(corpus_count)];
+			u32 from = below(other->length), count = 1 + below(other->length - from);
+			if (k + count > p->length)
+				count = p->length - k;
+			memcpy(&p->code[k], &other->code[from], count * sizeof(u32));
+			break;
+		}
+		case 8:
+			if (below(2))
+				p->f[below(PICA_SHADER_NUM_FLOAT_UNIFORMS)][below(4)] = random_value();
+			else if (below(2))
+				p->i[below(4)][below(3)] = below(2) ? below(8) : rnd();
+			else
+				p->b ^= 1 << below(16);
+			break;
+		default:
+			p->input[below(PICA_SHADER_LANES)][below(NUM_INPUTS)][below(4)] = random_value();
+			break;
+		}
+	}
+}
+
+//
+// Execution
+//
+
+typedef struct {
+	bool ended[PICA_SHADER_LANES];
+	u32 steps[PICA_SHADER_LANES];
+	float output[PICA_SHADER_LANES][16][4];
+} engine_result;
+
+static pica_shader_setup setup;
+static pica_shader_program compiled;
+static pica_shader_unit unit;
+static pica_shader_batch batch;
+static u16* trace;
+
+static engine_result interpreter_result, batch_result;
+static bool batch_ran;
+
+static sigjmp_buf crash_jump;
+static volatile sig_atomic_t crash_signal;
+
+static void on_crash(int sig)
+{
+	crash_signal = sig;
+	siglongjmp(crash_jump, 1);
+}
+
+static void expand(const program* p)
+{
+	memset(&setup, 0, sizeof(setup));
+	memcpy(setup.code, p->code, p->length * sizeof(u32));
+	setup.code[p->length] = PICA_OP_END << 26;
+	memcpy(setup.opdesc, p->opdesc, sizeof(p->opdesc));
+	memcpy(setup.f, p->f, sizeof(p->f));
+	memcpy(setup.i, p->i, sizeof(p->i));
+	setup.b = p->b;
+	setup.entry = p->entry;
+}
+
+static u8 bucket(u8 count)
+{
+	if (count <= 3)
+		return 1 << (count - 1);
+	if (count <= 7)
+		return 0x08;
+	if (count <= 15)
+		return 0x10;
+	if (count <= 31)
+		return 0x20;
+	if (count <= 127)
+		return 0x40;
+	return 0x80;
+}
+
+// Counts the edges between the instructions of the trace
+static void collect_edges(u32 steps)
+{
+	u32 previous = 0;
+	for (u32 s = 0; s < steps; s++) {
+		u32 current = (trace[s] * 0x9E3779B1u) >> 16;
+		u8* count = &hits[(current ^ previous) & (MAP_SIZE - 1)];
+		if (*count < 255)
+			(*count)++;
+		previous = current >> 1;
+	}
+}
+
+// Merges the hits of the run into a virgin map, returns whether they had anything new
+static bool merge_hits(u8* map, bool count_edges)
+{
+	bool found = false;
+	for (u32 k = 0; k < MAP_SIZE; k++) {
+		if (!hits[k])
+			continue;
+		u8 b = bucket(hits[k]);
+		if (!(map[k] & b)) {
+			if (count_edges && !map[k])
+				edges_seen++;
+			map[k] |= b;
+			found = true;
+		}
+	}
+	return found;
+}
+
+static void run_engines(const program* p)
+{
+	expand(p);
+
+	// The interpreter, vertex by vertex from a cleared unit
+	memset(hits, 0, sizeof(hits));
+	for (u32 lane = 0; lane < PICA_SHADER_LANES; lane++) {
+		memset(&unit, 0, sizeof(unit));
+		memcpy(unit.input, p->input[lane], sizeof(p->input[lane]));
+		unit.budget = budget;
+		unit.trace = trace;
+		unit.trace_capacity = budget;
+		interpreter_result.ended[lane] = pica_shader_run(&unit, &setup);
+		interpreter_result.steps[lane] = unit.steps;
+		memcpy(interpreter_result.output[lane], unit.output, sizeof(unit.output));
+		collect_edges(unit.steps);
+	}
+
+	// The batch engine, all the lanes at once
+	pica_shader_batch_compile(&compiled, &setup);
+	batch_ran = compiled.valid;
+	if (!batch_ran)
+		return;
+
+	memset(&batch, 0, sizeof(batch));
+	batch.budget = budget;
+	for (u32 lane = 0; lane < PICA_SHADER_LANES; lane++)
+		for (u32 r = 0; r < NUM_INPUTS; r++)
+			for (int c = 0; c < 4; c++)
+				batch.input[r][c][lane] = p->input[lane][r][c];
+	bool ended = pica_shader_batch_run(&batch, &compiled, &setup);
+	for (u32 lane = 0; lane < PICA_SHADER_LANES; lane++) {
+		batch_result.ended[lane] = ended;
+		batch_result.steps[lane] = batch.steps;
+		for (int r = 0; r < 16; r++)
+			for (int c = 0; c < 4; c++)
+				batch_result.output[lane][r][c] = batch.output[r][c][lane];
+	}
+}
+
+static bool same_bits(float a, float b)
+{
+	return (isnan(a) && isnan(b)) || f32_to_bits(a) == f32_to_bits(b);
+}
+
+// First lane where the engines disagree, -1 if none
+static int find_divergence(void)
+{
+	if (!batch_ran)
+		return -1;
+	for (u32 lane = 0; lane < PICA_SHADER_LANES; lane++) {
+		if (interpreter_result.ended[lane] != batch_result.ended[lane] ||
+			interpreter_result.steps[lane] != batch_result.steps[lane])
+			return lane;
+		for (int r = 0; r < 16; r++)
+			for (int c = 0; c < 4; c++)
+				if (!same_bits(interpreter_result.output[lane][r][c], batch_result.output[lane][r][c]))
+					return lane;
+	}
+	return -1;
+}
+
+//
+// Findings
+//
+
+static void save_finding(const char* kind, u32* count, const program* p)
+{
+	char path[256];
+	if (*count >= MAX_FINDINGS)
+		return;
+
+	snprintf(path, sizeof(path), "%s/%s-%u.bin", out_dir, kind, (unsigned)(*count)++);
+	FILE* f = fopen(path, "wb");
+	if (!f) {
+		fprintf(stderr, "cannot write %s\n", path);
+		return;
+	}
+	fwrite(p, sizeof(*p), 1, f);
+	fclose(f);
+	printf("%s\n", path);
+}
+
+static void print_result(const char* name, const engine_result* r, u32 lane)
+{
+	printf("  %s: %s after %u instructions\n", name, r->ended[lane] ? "ended" : "out of budget", (unsigned)r->steps[lane]);
+	for (int reg = 0; reg < 16; reg++) {
+		const float* o = r->output[lane][reg];
+		if (o[0] || o[1] || o[2] || o[3])
+			printf("    o%-2d (%.9g, %.9g, %.9g, %.9g)\n", reg, o[0], o[1], o[2], o[3]);
+	}
+}
+
+static int replay(const char* path)
+{
+	static program p;
+	FILE* f = fopen(path, "rb");
+	if (!f || fread(&p, sizeof(p), 1, f) != 1 || p.magic != FINDING_MAGIC || !p.length || p.length > MAX_CODE) {
+		fprintf(stderr, "%s: not a shaderfuzz finding\n", path);
+		return 2;
+	}
+	fclose(f);
+
+	for (u32 k = 0; k < p.length; k++) {
+		pica_instr instr;
+		pica_shader_decode(p.code[k], p.opdesc, &instr);
+		printf("%3u: %08x  op 0x%02x\n", (unsigned)k, (unsigned)p.code[k], (unsigned)instr.op);
+	}
+
+	signal(SIGSEGV, on_crash);
+	signal(SIGBUS, on_crash);
+	signal(SIGFPE, on_crash);
+	if (sigsetjmp(crash_jump, 1)) {
+		printf("crashed with signal %d\n", (int)crash_signal);
+		return 1;
+	}
+	run_engines(&p);
+
+	int lane = find_divergence();
+	printf("batch engine: %s\n", !batch_ran ? "rejects the program" : lane < 0 ? "agrees" : "disagrees");
+	lane = lane < 0 ? 0 : lane;
+	printf("lane %d\n", lane);
+	print_result("interpreter", &interpreter_result, lane);
+	if (!batch_ran)
+		return 0;
+	print_result("batch", &batch_result, lane);
+	for (int r = 0; r < 16; r++) {
+		for (int c = 0; c < 4; c++) {
+			float a = interpreter_result.output[lane][r][c], b = batch_result.output[lane][r][c];
+			if (!same_bits(a, b))
+				printf("  o%d.%c: %08x on the interpreter, %08x on the batch engine\n", r, "xyzw"[c],
+					(unsigned)f32_to_bits(a), (unsigned)f32_to_bits(b));
+		}
+	}
+	return 0;
+}
+
+static double seconds(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+int main(int argc, char** argv)
+{
+	// Everything main reads after a crash jumps back to sigsetjmp is static, locals could be clobbered
+	static u64 max_execs;
+	static double max_time;
+
+	for (int i = 1; i < argc; i++) {
+		if (!strcmp(argv[i], "--seed") && i + 1 < argc)
+			rng_state = strtoull(argv[++i], NULL, 0) | 1;
+		else if (!strcmp(argv[i], "--execs") && i + 1 < argc)
+			max_execs = strtoull(argv[++i], NULL, 0);
+		else if (!strcmp(argv[i], "--time") && i + 1 < argc)
+			max_time = atof(argv[++i]);
+		else if (!strcmp(argv[i], "--budget") && i + 1 < argc)
+			budget = atoi(argv[++i]);
+		else if (!strcmp(argv[i], "--out") && i + 1 < argc)
+			out_dir = argv[++i];
+		else if (!strcmp(argv[i], "--replay") && i + 1 < argc) {
+			budget = budget ? budget : DEFAULT_BUDGET;
+			trace = calloc(budget, sizeof(u16));
+			return replay(argv[++i]);
+		} else {
+			fprintf(stderr, "usage: %s [--seed s] [--execs n] [--time seconds] [--budget instructions] [--out dir]\n"
+				"       %s --replay finding.bin\n", argv[0], argv[0]);
+			return 2;
+		}
+	}
+
+	if (!budget)
+		budget = DEFAULT_BUDGET;
+	trace = calloc(budget, sizeof(u16));
+	if (!trace)
+		return 1;
+	mkdir(out_dir, 0777);
+
+	signal(SIGSEGV, on_crash);
+	signal(SIGBUS, on_crash);
+	signal(SIGFPE, on_crash);
+
+	static program candidate;
+	static u32 crashes, hangs, divergences;
+	static u64 execs, batch_execs;
+	static double start, last_status;
+	start = last_status = seconds();
+
+	for (;;) {
+		double now = seconds();
+		if ((max_execs && execs >= max_execs) || (max_time && now - start >= max_time))
+			break;
+		if (now - last_status >= 5) {
+			printf("%llu execs (%.0f/s), corpus %u, %u edges, %.0f%% on the batch engine, "
+				"%u crashes, %u hangs, %u divergences\n", (unsigned long long)execs, execs / (now - start),
+				(unsigned)corpus_count, (unsigned)edges_seen, 100.0 * batch_execs / execs, crashes, hangs, divergences);
+			fflush(stdout);
+			last_status = now;
+		}
+
+		// Fresh programs until the corpus has a few, mutations of its entries after that
+		if (corpus_count < 16 || below(16) == 0) {
+			random_program(&candidate);
+		} else {
+			candidate = corpus[below(corpus_count)];
+			mutate(&candidate);
+		}
+		execs++;
+
+		if (sigsetjmp(crash_jump, 1)) {
+			save_finding("crash", &crashes, &candidate);
+			continue;
+		}
+		run_engines(&candidate);
+		batch_execs += batch_ran;
+
+		bool hung = false;
+		for (u32 lane = 0; lane < PICA_SHADER_LANES; lane++)
+			hung |= !interpreter_result.ended[lane];
+
+		if (find_divergence() >= 0)
+			save_finding("diverge", &divergences, &candidate);
+		if (hung && merge_hits(virgin_hangs, false))
+			save_finding("hang", &hangs, &candidate);
+
+		if (merge_hits(virgin, true) && !hung) {
+			if (corpus_count < CORPUS_SIZE)
+				corpus[corpus_count++] = candidate;
+			else
+				corpus[below(CORPUS_SIZE)] = candidate;
+		}
+	}
+
+	double elapsed = seconds() - start;
+	printf("%llu execs in %.1f s (%.0f/s), corpus %u, %u edges, %u crashes, %u hangs, %u divergences\n",
+		(unsigned long long)execs, elapsed, execs / elapsed, (unsigned)corpus_count, (unsigned)edges_seen,
+		crashes, hangs, divergences);
+	return crashes || divergences ? 1 : 0;
+}
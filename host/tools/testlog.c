@@ -0,0 +1,175 @@
+/*
+ * Converts the result logs the suites write with testLogFlush() to CSV or JSON
+ * usage: testlog [--csv | --json] <suite>-results.bin...
+ */
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <3ds/types.h>
+#include "float24.h"
+
+#define TEST_LOG_MAGIC 0x474C5450
+#define HEADER_SIZE    32
+#define RECORD_SIZE    96 // version 1, later versions may append fields
+
+// Fields of test_record_t in the suites' test.h, stored little-endian
+typedef struct {
+	char suite[9];
+	char name[33];
+	u32 test;
+	bool failed;
+	float inputs[8];
+	u32 expected, actual;
+	u64 ticks;
+} record;
+
+static u32 read_u32(const u8* p)
+{
+	return p[0] | (p[1] << 8) | (p[2] << 16) | ((u32)p[3] << 24);
+}
+
+static void parse_record(const u8* p, record* r)
+{
+	memcpy(r->suite, p, 8);
+	r->suite[8] = 0;
+	memcpy(r->name, p + 8, 32);
+	r->name[32] = 0;
+	r->test = p[40] | (p[41] << 8);
+	r->failed = p[42] | p[43];
+	for (int i = 0; i < 8; i++)
+		r->inputs[i] = f32_from_bits(read_u32(p + 44 + 4 * i));
+	r->expected = read_u32(p + 76);
+	r->actual = read_u32(p + 80);
+	r->ticks = read_u32(p + 88) | ((u64)read_u32(p + 92) << 32);
+}
+
+// JSON has no literals for infinities and NaNs, they are written as strings
+static void print_float(float f, bool json)
+{
+	if (isfinite(f))
+		printf("%.9g", f);
+	else if (json)
+		printf("\"%s\"", isnan(f) ? "nan" : f > 0 ? "inf" : "-inf");
+	else
+		printf("%s", isnan(f) ? "nan" : f > 0 ? "inf" : "-inf");
+}
+
+static void print_string(const char* s, bool json)
+{
+	putchar('"');
+	for (; *s; s++) {
+		if (*s == '"')
+			printf(json ? "\\\"" : "\"\"");
+		else if (*s == '\\' && json)
+			printf("\\\\");
+		else
+			putchar(*s);
+	}
+	putchar('"');
+}
+
+static void print_record(const record* r, double tick_rate, bool json, bool first)
+{
+	int i;
+
+	if (json) {
+		printf("%s\n  {\"suite\": ", first ? "" : ",");
+		print_string(r->suite, true);
+		printf(", \"test\": %u, \"name\": ", r->test);
+		print_string(r->name, true);
+		printf(", \"failed\": %s, \"inputs\": [", r->failed ? "true" : "false");
+		for (i = 0; i < 8; i++) {
+			if (i)
+				printf(", ");
+			print_float(r->inputs[i], true);
+		}
+		printf("], \"expected\": \"%06x\", \"actual\": \"%06x\", \"ticks\": %llu, \"us\": %.3f}",
+			r->expected, r->actual, (unsigned long long)r->ticks, r->ticks * 1e6 / tick_rate);
+		return;
+	}
+
+	print_string(r->suite, false);
+	printf(",%u,", r->test);
+	print_string(r->name, false);
+	printf(",%d", r->failed);
+	for (i = 0; i < 8; i++) {
+		putchar(',');
+		print_float(r->inputs[i], false);
+	}
+	printf(",%06x,%06x,%llu,%.3f\n", r->expected, r->actual, (unsigned long long)r->ticks, r->ticks * 1e6 / tick_rate);
+}
+
+static bool convert(const char* path, bool json, bool* first)
+{
+	FILE* f = fopen(path, "rb");
+	if (!f) {
+		fprintf(stderr, "%s: cannot open\n", path);
+		return false;
+	}
+
+	u8 header[HEADER_SIZE];
+	if (fread(header, HEADER_SIZE, 1, f) != 1 || read_u32(header) != TEST_LOG_MAGIC) {
+		fprintf(stderr, "%s: not a result log\n", path);
+		fclose(f);
+		return false;
+	}
+
+	u32 record_size = read_u32(header + 8);
+	u32 count = read_u32(header + 12);
+	u32 dropped = read_u32(header + 16);
+	u32 tick_rate = read_u32(header + 20);
+	if (record_size < RECORD_SIZE || !tick_rate) {
+		fprintf(stderr, "%s: unsupported record size %u\n", path, record_size);
+		fclose(f);
+		return false;
+	}
+	if (dropped)
+		fprintf(stderr, "%s: the %u oldest records were overwritten\n", path, dropped);
+
+	u8* data = malloc(record_size);
+	bool ok = true;
+	for (u32 i = 0; i < count; i++) {
+		if (fread(data, record_size, 1, f) != 1) {
+			fprintf(stderr, "%s: truncated after %u of %u records\n", path, i, count);
+			ok = false;
+			break;
+		}
+		record r;
+		parse_record(data, &r);
+		print_record(&r, tick_rate, json, *first);
+		*first = false;
+	}
+
+	free(data);
+	fclose(f);
+	return ok;
+}
+
+int main(int argc, char** argv)
+{
+	bool json = false, first = true, ok = true;
+	int i = 1;
+
+	if (i < argc && !strcmp(argv[i], "--json"))
+		json = true, i++;
+	else if (i < argc && !strcmp(argv[i], "--csv"))
+		i++;
+	if (i >= argc) {
+		fprintf(stderr, "usage: %s [--csv | --json] <suite>-results.bin...\n", argv[0]);
+		return 2;
+	}
+
+	if (json)
+		printf("[");
+	else
+		printf("suite,test,name,failed,input0,input1,input2,input3,input4,input5,input6,input7,expected,actual,ticks,us\n");
+
+	for (; i < argc; i++)
+		ok &= convert(argv[i], json, &first);
+
+	if (json)
+		printf("\n]\n");
+	return ok ? 0 : 1;
+}
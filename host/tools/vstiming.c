@@ -0,0 +1,145 @@
+/*
+ * Predicts the cycles per vertex of a vertex shader with the timing model of pica/timing.h
+ * usage: vstiming [--costs benchfit.csv] [--units n] shader.shbin [dvle]
+ *
+ * The shader runs once on inputs of (0, 0, 0, 1) with the constants of its DVLE, flow control
+ * that depends on the inputs or on uniforms set at run time follows that path.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <3ds.h>
+#include "float24.h"
+#include "timing.h"
+
+static u32* read_file(const char* path, u32* size)
+{
+	FILE* f = fopen(path, "rb");
+	if (!f)
+		return NULL;
+
+	fseek(f, 0, SEEK_END);
+	long length = ftell(f);
+	fseek(f, 0, SEEK_SET);
+
+	u32* data = malloc(length + 4);
+	if (data && fread(data, 1, length, f) != (size_t)length) {
+		free(data);
+		data = NULL;
+	}
+	fclose(f);
+	*size = length;
+	return data;
+}
+
+// The state shaderProgramUse would upload for the DVLE, before any uniform the application sets
+static void setup_from_dvle(pica_shader_setup* setup, const DVLE_s* dvle)
+{
+	memset(setup, 0, sizeof(*setup));
+
+	u32 size = dvle->dvlp->codeSize < PICA_SHADER_CODE_SIZE ? dvle->dvlp->codeSize : PICA_SHADER_CODE_SIZE;
+	memcpy(setup->code, dvle->dvlp->codeData, size * sizeof(u32));
+	size = dvle->dvlp->opdescSize < PICA_SHADER_OPDESC_SIZE ? dvle->dvlp->opdescSize : PICA_SHADER_OPDESC_SIZE;
+	memcpy(setup->opdesc, dvle->dvlp->opcdescData, size * sizeof(u32));
+	setup->entry = dvle->mainOffset;
+
+	for (u32 i = 0; i < dvle->constTableSize; i++) {
+		const DVLE_constEntry_s* c = &dvle->constTableData[i];
+		switch (c->type) {
+		case DVLE_CONST_BOOL:
+			if (c->id < 16 && (c->data[0] & 1))
+				setup->b |= 1 << c->id;
+			break;
+		case DVLE_CONST_u8:
+			if (c->id < 4)
+				for (int j = 0; j < 4; j++)
+					setup->i[c->id][j] = c->data[0] >> (8 * j);
+			break;
+		case DVLE_CONST_FLOAT24:
+			if ((c->id & 0xFF) < PICA_SHADER_NUM_FLOAT_UNIFORMS)
+				for (int j = 0; j < 4; j++)
+					setup->f[c->id & 0xFF][j] = f24_to_f32(c->data[j]);
+			break;
+		}
+	}
+}
+
+int main(int argc, char** argv)
+{
+	pica_timing_costs costs;
+	const char* costs_path = NULL;
+	const char* path = NULL;
+	u32 index = 0;
+	int units = 0;
+
+	pica_timing_default_costs(&costs);
+
+	for (int i = 1; i < argc; i++) {
+		if (!strcmp(argv[i], "--costs") && i + 1 < argc)
+			costs_path = argv[++i];
+		else if (!strcmp(argv[i], "--units") && i + 1 < argc)
+			units = atoi(argv[++i]);
+		else if (!path)
+			path = argv[i];
+		else
+			index = atoi(argv[i]);
+	}
+
+	if (!path) {
+		fprintf(stderr, "usage: %s [--costs benchfit.csv] [--units n] shader.shbin [dvle]\n", argv[0]);
+		return 2;
+	}
+
+	// Fitted costs are per unit, so the unit count applies before they are loaded
+	if (units > 0)
+		costs.units = units;
+	if (costs_path && !pica_timing_load_costs(&costs, costs_path)) {
+		fprintf(stderr, "%s: cannot open\n", costs_path);
+		return 1;
+	}
+
+	u32 size;
+	u32* data = read_file(path, &size);
+	DVLB_s* dvlb = data ? DVLB_ParseFile(data, size) : NULL;
+	if (!dvlb) {
+		fprintf(stderr, "%s: cannot read the shader binary\n", path);
+		return 1;
+	}
+	if (index >= dvlb->numDVLE) {
+		fprintf(stderr, "%s: no DVLE %u\n", path, (unsigned)index);
+		return 1;
+	}
+
+	static pica_shader_setup setup;
+	pica_shader_unit unit;
+	pica_timing_report report;
+
+	setup_from_dvle(&setup, &dvlb->DVLE[index]);
+	memset(&unit, 0, sizeof(unit));
+	for (int i = 0; i < 16; i++)
+		unit.input[i][3] = 1.0f;
+
+	bool ended = pica_timing_estimate(&costs, &setup, &unit, &report);
+	if (!ended)
+		fprintf(stderr, "%s: the shader did not end within %u instructions\n", path, PICA_SHADER_MAX_STEPS);
+
+	printf("%s DVLE %u: %u instructions, %u cycles per unit, %u stalled\n", path, (unsigned)index,
+		(unsigned)report.instructions, (unsigned)report.shader_cycles, (unsigned)report.stall_cycles);
+	printf("%u inputs (%u cycles), %u outputs (%u cycles)\n", (unsigned)report.inputs, (unsigned)report.input_cycles,
+		(unsigned)report.outputs, (unsigned)report.output_cycles);
+	printf("%.2f cycles per vertex with %u units, %s bound\n", report.cycles_per_vertex, (unsigned)costs.units, report.bound);
+
+	printf("critical path:\n");
+	printf("  pc     op       issue  stall\n");
+	for (u32 i = 0; i < report.path_length; i++) {
+		const pica_timing_step* step = &report.path[i];
+		printf("  0x%03x  %-7s  %5u  %5u\n", (unsigned)step->pc, pica_timing_op_name(step->op),
+			(unsigned)step->start, (unsigned)step->stall);
+	}
+
+	pica_timing_report_free(&report);
+	DVLB_Free(dvlb);
+	free(data);
+	return ended ? 0 : 1;
+}
@@ -8,6 +8,10 @@
 static u32 *colorBuf, *depthBuf;
 static u32 *cmdBuf;
 
+// Region of interest, the whole screen with depth unless gpuSetRegion says otherwise
+static u32 regionX = 0, regionY = 0, regionW = 240, regionH = 400;
+static bool regionDepth = true;
+
 void gpuInit(void)
 {
 	colorBuf = vramAlloc(400*240*4);
@@ -25,16 +29,50 @@ void gpuExit(void)
 	vramFree(colorBuf);
 }
 
+void gpuSetRegion(u32 x, u32 y, u32 w, u32 h, bool depth)
+{
+	regionX = x;
+	regionY = y;
+	regionW = w;
+	regionH = h;
+	regionDepth = depth;
+}
+
+static bool gpuRegionIsFull(void)
+{
+	return regionX == 0 && regionY == 0 && regionW == 240 && regionH == 400;
+}
+
 void gpuClearBuffers(u32 clearColor)
 {
-	GX_SetMemoryFill(NULL,
-		colorBuf, clearColor, &colorBuf[240*400], GX_FILL_TRIGGER | GX_FILL_32BIT_DEPTH,
-		depthBuf, 0,          &depthBuf[240*400], GX_FILL_TRIGGER | GX_FILL_32BIT_DEPTH);
-	gspWaitForPSC0(); // Wait for the fill to complete
+	GPU_PROFILE_START(start);
+
+	// Fill the tiles that hold the region, one range per row of tiles unless the region spans whole rows
+	u32 first = (regionX & ~7) * 8;
+	u32 last = (((regionX + regionW - 1) | 7) + 1) * 8;
+	bool wholeRows = first == 0 && last == 240*8;
+	u32 ty;
+
+	for (ty = regionY & ~7; ty < regionY + regionH; ty += 8) {
+		u32 offset = ty*240 + first;
+		u32 end = wholeRows ? (((regionY + regionH - 1) | 7) + 1)*240 : ty*240 + last;
+
+		GX_SetMemoryFill(NULL,
+			&colorBuf[offset], clearColor, &colorBuf[end], GX_FILL_TRIGGER | GX_FILL_32BIT_DEPTH,
+			regionDepth ? &depthBuf[offset] : NULL, 0, &depthBuf[end], GX_FILL_TRIGGER | GX_FILL_32BIT_DEPTH);
+		gspWaitForPSC0(); // Wait for the fill to complete
+
+		if (wholeRows)
+			break;
+	}
+
+	GPU_PROFILE_STOP(GPU_PHASE_CLEAR, start);
 }
 
 void gpuFrameBegin(void)
 {
+	GPU_PROFILE_START(start);
+
 	// Configure the viewport and the depth linear conversion function
 	GPU_SetViewport(
 		(u32*)osConvertVirtToPhys((u32)depthBuf),
@@ -42,12 +80,29 @@ void gpuFrameBegin(void)
 		0, 0, 240, 400); // The top screen is physically 240x400 pixels
 	GPU_DepthMap(-1.0f, 0.0f); // calculate the depth value from the Z coordinate in the following way: -1.0*z + 0.0
 
+	// Only rasterize the region of interest, the viewport stays full screen since it defines the
+	// transform and the layout of the buffers. Window rows go bottom to top, unlike the region's.
+	// The scissor is written every frame so that going back to the full screen turns it off.
+	if (gpuRegionIsFull())
+		GPU_SetScissorTest(GPU_SCISSOR_DISABLE, 0, 0, 240, 400);
+	else
+		GPU_SetScissorTest(GPU_SCISSOR_NORMAL,
+			regionX, 400 - regionY - regionH,
+			regionX + regionW, 400 - regionY);
+
 	// Configure some boilerplate
 	GPU_SetFaceCulling(GPU_CULL_BACK_CCW);
 	GPU_SetStencilTest(false, GPU_ALWAYS, 0x00, 0xFF, 0x00);
 	GPU_SetStencilOp(GPU_KEEP, GPU_KEEP, GPU_KEEP);
 	GPU_SetBlendingColor(0,0,0,0);
-	GPU_SetDepthTestAndWriteMask(true, GPU_GREATER, GPU_WRITE_ALL);
+	if (regionDepth) {
+		GPU_SetDepthTestAndWriteMask(true, GPU_GREATER, GPU_WRITE_ALL);
+	} else {
+		// Neither test nor write depth so the depth buffer is never accessed
+		u32 noDepthAccess[2] = { 0, 0 }; // depth buffer read, depth buffer write
+		GPU_SetDepthTestAndWriteMask(false, GPU_ALWAYS, GPU_WRITE_COLOR);
+		GPUCMD_AddIncrementalWrites(GPUREG_DEPTHBUFFER_READ, noDepthAccess, 2);
+	}
 
 	// This is unknown
 	GPUCMD_AddMaskedWrite(GPUREG_0062, 0x1, 0);
@@ -60,26 +115,76 @@ void gpuFrameBegin(void)
 	int i;
 	for (i = 0; i < 6; i ++)
 		GPU_SetDummyTexEnv(i);
+
+	GPU_PROFILE_STOP(GPU_PHASE_FRAME_BEGIN, start);
 }
 
-void gpuFrameEnd(void)
+void gpuFrameFinish(void)
 {
+	GPU_PROFILE_START(flushStart);
+
 	// Finish rendering
 	GPU_FinishDrawing();
 	GPUCMD_Finalize();
 	GPUCMD_FlushAndRun(NULL);
+	GPU_PROFILE_STOP(GPU_PHASE_FLUSH, flushStart);
+
+	GPU_PROFILE_START(waitStart);
 	gspWaitForP3D(); // Wait for the rendering to complete
+	GPU_PROFILE_STOP(GPU_PHASE_P3D_WAIT, waitStart);
+
+	// Reset the command buffer
+	GPUCMD_SetBufferOffset(0);
+}
+
+void gpuFrameEnd(void)
+{
+	gpuFrameFinish();
+
+	GPU_PROFILE_START(transferStart);
 
 	// Transfer the GPU output to the framebuffer
 	GX_SetDisplayTransfer(NULL, colorBuf, GX_BUFFER_DIM(240, 400),
 		(u32*)gfxGetFramebuffer(GFX_TOP, GFX_LEFT, NULL, NULL), GX_BUFFER_DIM(240, 400),
 		DISPLAY_TRANSFER_FLAGS);
-	gspWaitForPPF(); // Wait for the transfer to complete
+	GPU_PROFILE_STOP(GPU_PHASE_TRANSFER, transferStart);
 
-	// Reset the command buffer
-	GPUCMD_SetBufferOffset(0);
+	GPU_PROFILE_START(waitStart);
+	gspWaitForPPF(); // Wait for the transfer to complete
+	GPU_PROFILE_STOP(GPU_PHASE_PPF_WAIT, waitStart);
 };
 
+// The color buffer is made of 8x8 tiles stored row after row, the pixels of a tile are in Morton order
+static u32 gpuTiledOffset(u32 x, u32 y)
+{
+	u32 i = (x & 1) | ((y & 1) << 1) | ((x & 2) << 1) | ((y & 2) << 2) | ((x & 4) << 2) | ((y & 4) << 3);
+	return (y & ~7) * 240 + (x & ~7) * 8 + i;
+}
+
+void gpuReadPixels(u32 x, u32 y, u32 w, u32 h, u32* out)
+{
+	// Invalidate the rows of tiles that hold the rectangle at once
+	u32 first = (y & ~7) * 240;
+	u32 last = (((y + h - 1) | 7) + 1) * 240;
+	GSPGPU_InvalidateDataCache(NULL, (u8*)&colorBuf[first], (last - first) * 4);
+
+	u32 i, j;
+	for (j = 0; j < h; j++) {
+		for (i = 0; i < w; i++) {
+			// RGBA8 pixels are stored as ABGR bytes, rotate them to 0xAARRGGBB
+			u32 pixel = colorBuf[gpuTiledOffset(x + i, y + j)];
+			*out++ = (pixel >> 8) | (pixel << 24);
+		}
+	}
+}
+
+u32 gpuReadPixel(u32 x, u32 y)
+{
+	u32 pixel;
+	gpuReadPixels(x, y, 1, 1, &pixel);
+	return pixel;
+}
+
 void GPU_SetDummyTexEnv(int id)
 {
 	GPU_SetTexEnv(id,
@@ -91,3 +196,90 @@ void GPU_SetDummyTexEnv(int id)
 		GPU_REPLACE,
 		0xFFFFFFFF);
 }
+
+#ifdef PROFILE
+#include <stdio.h>
+
+#ifndef SYSCLOCK_ARM11
+#define SYSCLOCK_ARM11 268111856
+#endif
+
+// Log-linear histograms: values below 16 ticks are exact, above that each power of two is split in 8 buckets,
+// so percentiles are off by less than 12.5%. Samples are added with atomic operations only.
+#define PROFILE_BUCKETS 240
+
+typedef struct {
+	u32 count;
+	u32 min, max;
+	u32 buckets[PROFILE_BUCKETS];
+} gpuHistogram;
+
+static gpuHistogram profile[GPU_PHASE_COUNT];
+
+static const char* const phaseNames[GPU_PHASE_COUNT] = {
+	"clear", "frame begin", "render", "flush", "P3D wait", "transfer", "PPF wait", "verify",
+};
+
+static u32 gpuProfileBucket(u32 ticks)
+{
+	if (ticks < 16)
+		return ticks;
+	u32 msb = 31 - __builtin_clz(ticks);
+	return ((msb - 2) << 3) | ((ticks >> (msb - 3)) & 7);
+}
+
+// Largest value that falls in the bucket
+static u32 gpuProfileBucketMax(u32 bucket)
+{
+	if (bucket < 16)
+		return bucket;
+	u32 shift = (bucket >> 3) - 1;
+	return (((8 | (bucket & 7)) + 1) << shift) - 1;
+}
+
+void gpuProfileAdd(gpuPhase phase, u64 ticks)
+{
+	gpuHistogram* h = &profile[phase];
+	u32 value = ticks > 0xFFFFFFFF ? 0xFFFFFFFF : (u32)ticks;
+	u32 old;
+
+	// The first sample initializes min through the zero count
+	if (__atomic_fetch_add(&h->count, 1, __ATOMIC_RELAXED) == 0)
+		__atomic_store_n(&h->min, value, __ATOMIC_RELAXED);
+	old = __atomic_load_n(&h->min, __ATOMIC_RELAXED);
+	while (value < old && !__atomic_compare_exchange_n(&h->min, &old, value, true, __ATOMIC_RELAXED, __ATOMIC_RELAXED));
+	old = __atomic_load_n(&h->max, __ATOMIC_RELAXED);
+	while (value > old && !__atomic_compare_exchange_n(&h->max, &old, value, true, __ATOMIC_RELAXED, __ATOMIC_RELAXED));
+
+	__atomic_fetch_add(&h->buckets[gpuProfileBucket(value)], 1, __ATOMIC_RELAXED);
+}
+
+static u32 gpuProfilePercentile(const gpuHistogram* h, u32 percent)
+{
+	u32 rank = (h->count * percent + 99) / 100, seen = 0, i;
+	for (i = 0; i < PROFILE_BUCKETS; i++) {
+		seen += h->buckets[i];
+		if (seen >= rank) {
+			u32 value = gpuProfileBucketMax(i);
+			return value < h->max ? value : h->max;
+		}
+	}
+	return h->max;
+}
+
+void gpuProfileReport(void)
+{
+	int i;
+
+	printf("%-12s %6s %9s %9s %9s (us)\n", "phase", "n", "min", "p50", "p99");
+	for (i = 0; i < GPU_PHASE_COUNT; i++) {
+		const gpuHistogram* h = &profile[i];
+		if (!h->count)
+			continue;
+		printf("%-12s %6u %9.1f %9.1f %9.1f\n", phaseNames[i], (unsigned)h->count,
+			h->min * 1e6 / SYSCLOCK_ARM11,
+			gpuProfilePercentile(h, 50) * 1e6 / SYSCLOCK_ARM11,
+			gpuProfilePercentile(h, 99) * 1e6 / SYSCLOCK_ARM11);
+	}
+}
+#endif
@@ -31,7 +31,7 @@ static int uLoc_src1_uniform;
 static vector_4f expected_result;
 
 static void Test_MOVA_RoundsTowardsZero(void) {
-	printf("Test: MOVA_RoundsTowardsZero\n");
+	testBegin("MOVA_RoundsTowardsZero");
 	src1_uniform.x = 0.9f, expected_result.x = 0.0f;
 	src1_uniform.y = 0.9f, expected_result.y = 0.0f;
 	src1_uniform.z = 0.9f, expected_result.z = 0.0f;
@@ -51,7 +51,7 @@ static int tests_count =  (sizeof(tests)/sizeof(tests[0]));
 static void sceneInit(void);
 static void sceneRender(void);
 static void sceneExit(void);
-static void Verify(void);
+static void Verify(int test);
 
 #define CLEAR_COLOR 0x0
 
@@ -60,6 +60,7 @@ int main(void)
 	// Initialize graphics
 	gfxInitDefault();
 	gpuInit();
+	gpuSetRegion(0, 0, 1, 1, false); // Tests only write the pixel Verify reads
 	consoleInit(GFX_BOTTOM, NULL);
 
 	// Initialize the scene
@@ -71,26 +72,38 @@ int main(void)
 	{
 		tests[i]();
 			gpuFrameBegin();
+			testSnapshot();
+			GPU_PROFILE_START(renderStart);
 				sceneRender();
-			gpuFrameEnd();
-		Verify();
+			GPU_PROFILE_STOP(GPU_PHASE_RENDER, renderStart);
+			gpuFrameFinish();
+		GPU_PROFILE_START(verifyStart);
+		Verify(i);
+		GPU_PROFILE_STOP(GPU_PHASE_VERIFY, verifyStart);
 
 		gpuClearBuffers(CLEAR_COLOR);
+#ifndef HEADLESS
 		gspWaitForVBlank();  // Synchronize with the start of VBlank
 		gfxSwapBuffersGpu(); // Swap the framebuffers so that the frame that we rendered last frame is now visible
+#endif
 
 		// Flush the framebuffers out of the data cache (not necessary with pure GPU rendering)
 		//gfxFlushBuffers();
 	}
 
 	// End of tests
-	printf("Tests ends. Press start to exit.\n");
+	testSummary(tests_count);
+	testLogFlush("mova");
+	gpuProfileReport();
+#ifndef HEADLESS
+	printf("Press start to exit.\n");
 	while(true) {
 		gspWaitForVBlank();
 		hidScanInput();
 		if (hidKeysDown() & KEY_START)
 			break;
 	}
+#endif
 
 	// Deinitialize the scene
 	sceneExit();
@@ -101,14 +114,14 @@ int main(void)
 	return 0;
 }
 
-static void Verify(void) {
-	u32 final_result = ((unsigned*)gfxGetFramebuffer(GFX_TOP, GFX_LEFT, NULL, NULL))[0];
-	if ((unsigned)(expected_result.z * 255.0f) != (final_result & 0xFF))
-		printf("Failure final.z = %x\n, expected = %x\n", (unsigned)(final_result & 0xFF), (unsigned)(expected_result.z*255.0f));
-	if ((unsigned)(expected_result.y * 255.0f) != ((final_result >> 8) & 0xFF))
-		printf("Failure final.y = %x\n, expected = %x\n", (unsigned)((final_result >> 8) & 0xFF), (unsigned)(expected_result.y*255.0f));
-	if ((unsigned)(expected_result.x * 255.0f) != ((final_result >> 16) & 0xFF))
-		printf("Failure final.x = %x\n, expected = %x\n", (unsigned)((final_result >> 16) & 0xFF), (unsigned)(expected_result.x*255.0f));
+static void Verify(int test) {
+	u32 final_result = gpuReadPixel(0, 0);
+	unsigned expected_x = (unsigned)(expected_result.x * 255.0f);
+	unsigned expected_y = (unsigned)(expected_result.y * 255.0f);
+	unsigned expected_z = (unsigned)(expected_result.z * 255.0f);
+	unsigned expected = (expected_x << 16) | (expected_y << 8) | expected_z;
+	float inputs[] = { src1_uniform.x, src1_uniform.y, src1_uniform.z, src1_uniform.w };
+	testResult(test, inputs, sizeof(inputs)/sizeof(inputs[0]), expected, final_result & 0xFFFFFF);
 }
 
 typedef struct { float x, y, z; float r, g, b, a; } vertex;
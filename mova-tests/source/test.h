@@ -1,5 +1,148 @@
 #pragma once
+#include <stdio.h>
+#include <string.h>
+#include <3ds.h>
+#if defined(HEADLESS) && !defined(_3DS)
+#include <snapshot.h>
+#endif
 
 typedef void (*test_t)(void);;
 #define SETUP 0
 #define VERIFY 1
+
+// Unattended runs (make HEADLESS=1) never wait for VBlank or input. Failures are recorded rather than
+// printed as they happen and testSummary() reports them once every test ran.
+// make QUIET=1 also drops the test names from the console.
+
+// Every result is appended to an in-memory log of fixed-size records, testLogFlush() writes it to
+// <suite>-results.bin (on the SD card on the device) in one go. host/tools/testlog converts it to JSON or CSV.
+#define TEST_LOG_MAGIC    0x474C5450 // "PTLG"
+#define TEST_LOG_VERSION  1
+#define TEST_LOG_CAPACITY 1024       // records, the oldest ones are overwritten past that
+#define TEST_TICKS_PER_SECOND 268111856 // svcGetSystemTick() rate
+
+typedef struct {
+	u32 magic;
+	u32 version;
+	u32 record_size;
+	u32 count;       // records following the header
+	u32 dropped;     // records overwritten because the log was full
+	u32 tick_rate;
+	u32 reserved[2];
+} test_log_header_t;
+
+typedef struct {
+	char suite[8];
+	char name[32];
+	u16 test;
+	u16 failed;
+	float inputs[8];  // values the test sets, x y z w of each input
+	u32 expected;     // 0xRRGGBB
+	u32 actual;
+	u32 reserved;
+	u64 ticks;        // from testBegin() to testResult(), from batchDraw() to the readback with batch.h
+} test_record_t;
+
+static test_record_t test_log[TEST_LOG_CAPACITY];
+static u32 test_log_count;
+static int failures_count;
+
+static const char* test_name = "";
+static u64 test_start;
+
+static void testBegin(const char* name)
+{
+	test_name = name;
+#ifndef QUIET
+	printf("Test: %s\n", name);
+#endif
+	test_start = svcGetSystemTick();
+}
+
+// Suites that render a frame per test call this once the frame is begun. In the host -headless builds the first
+// call takes a snapshot of the emulated state and the later ones go back to it, putting back the registers, heap
+// blocks and framebuffers the previous test changed (see host/README.md). It does nothing on the device.
+static inline void testSnapshot(void)
+{
+#if defined(HEADLESS) && !defined(_3DS)
+	static bool taken;
+	if (taken)
+		ctru_snapshot_restore();
+	else
+		ctru_snapshot_take();
+	taken = true;
+#endif
+}
+
+// Records a result timed by the caller, for tests that share their timing like the batch.h ones
+static void testResultTicks(int test, const float* inputs, int num_inputs, unsigned expected, unsigned actual, u64 ticks)
+{
+	test_record_t* r = &test_log[test_log_count++ % TEST_LOG_CAPACITY];
+
+	memset(r, 0, sizeof(*r));
+	strncpy(r->name, test_name, sizeof(r->name) - 1);
+	r->test = test;
+	r->failed = expected != actual;
+	memcpy(r->inputs, inputs, num_inputs * sizeof(float));
+	r->expected = expected;
+	r->actual = actual;
+	r->ticks = ticks;
+
+	if (!r->failed)
+		return;
+
+	failures_count++;
+#if !defined(HEADLESS) && !defined(QUIET)
+	printf("Failure final = %06x, expected = %06x\n", actual, expected);
+#endif
+}
+
+static inline void testResult(int test, const float* inputs, int num_inputs, unsigned expected, unsigned actual)
+{
+	testResultTicks(test, inputs, num_inputs, expected, actual, svcGetSystemTick() - test_start);
+}
+
+static void testSummary(int tests_count)
+{
+	printf("Tests ends. %d of %d tests failed.\n", failures_count, tests_count);
+#ifdef HEADLESS
+	u32 i = test_log_count > TEST_LOG_CAPACITY ? test_log_count - TEST_LOG_CAPACITY : 0;
+	for (; i < test_log_count; i++) {
+		test_record_t* r = &test_log[i % TEST_LOG_CAPACITY];
+		if (r->failed)
+			printf("Test %d %s: final = %06x, expected = %06x\n", r->test, r->name, (unsigned)r->actual, (unsigned)r->expected);
+	}
+#endif
+}
+
+static void testLogFlush(const char* suite)
+{
+	char path[64];
+	u32 first = test_log_count > TEST_LOG_CAPACITY ? test_log_count - TEST_LOG_CAPACITY : 0;
+	test_log_header_t header = {
+		TEST_LOG_MAGIC, TEST_LOG_VERSION, sizeof(test_record_t),
+		test_log_count - first, first, TEST_TICKS_PER_SECOND, { 0, 0 },
+	};
+	u32 i;
+
+#ifdef _3DS
+	snprintf(path, sizeof(path), "sdmc:/%s-results.bin", suite);
+#else
+	snprintf(path, sizeof(path), "%s-results.bin", suite);
+#endif
+	FILE* f = fopen(path, "wb");
+	if (!f) {
+		printf("Cannot write %s\n", path);
+		return;
+	}
+
+	for (i = 0; i < TEST_LOG_CAPACITY; i++)
+		strncpy(test_log[i].suite, suite, sizeof(test_log[i].suite));
+
+	// Oldest records first
+	fwrite(&header, sizeof(header), 1, f);
+	if (first)
+		fwrite(&test_log[first % TEST_LOG_CAPACITY], sizeof(test_record_t), TEST_LOG_CAPACITY - first % TEST_LOG_CAPACITY, f);
+	fwrite(test_log, sizeof(test_record_t), first ? first % TEST_LOG_CAPACITY : test_log_count, f);
+	fclose(f);
+}
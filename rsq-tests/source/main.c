@@ -9,32 +9,41 @@
 // Testing the RSQ shader instruction
 
 // For each test:
-// Draws a 1px by 1px quad in the bottom-left corner using a vertex shader
-// The shader instruction is used to output the color of this quad.
+// Draws one single-pixel triangle per component of the result, at the start of the bottom-left row
+// The vertex shader encodes the component its vertices select as the color of the triangle (the float24
+// encoding of test.h), so that the exact result bits are read back rather than 8 bits of their value.
 // The framebuffer is then read to verify the results
 
 // The exact RSQ shader command under test:
-// rsq outclr.xyz, src1_uniform
+// rsq r0.xyz, src1_uniform
 
 // shader uniform src1_uniform
 static vector_4f src1_uniform;
 static int uLoc_src1_uniform;
 
-// Expected result
+// Components of the result that are read back
+#define RESULT_COMPONENTS 3
+
+// Expected result, and how many float24 ulps the result may be from it
 static vector_4f expected_result;
+static u32 expected_ulps;
 
 static void Test_RSQ_UseOnlyFirstComponent(void) {
-	printf("Test: RSQ_UseOnlyFirstComponent\n");
+	testBegin("RSQ_UseOnlyFirstComponent");
 	src1_uniform.x = 1.0f, expected_result.x = 1.0f;
 	src1_uniform.y = 100.0f, expected_result.y = 1.0f; // and not 0.1f
 	src1_uniform.z = 100.0f, expected_result.z = 1.0f; // and not 0.1f
+	expected_ulps = 0; // exact in the dump-tests sweep of the host model, no device dump yet
 }
 
 static void Test_RSQ_Simple(void) {
-	printf("Test: RSQ_Simple\n");
+	testBegin("RSQ_Simple");
 	src1_uniform.x = 100.0f, expected_result.x = 0.1f;
 	src1_uniform.y = 1.0f, expected_result.y = 0.1f; // and not 1.0f
 	src1_uniform.z = 1.0f, expected_result.z = 0.1f; // and not 1.0f
+	// The square root reciprocal is approximated. The dump-tests sweep of the host model, not of a device, gives
+	// 0x3B9999 (1 ulp below), a device dump has yet to confirm the bound.
+	expected_ulps = 2;
 }
 
 static test_t tests[] = {
@@ -51,7 +60,7 @@ static int tests_count =  (sizeof(tests)/sizeof(tests[0]));
 static void sceneInit(void);
 static void sceneRender(void);
 static void sceneExit(void);
-static void Verify(void);
+static void Verify(int test);
 
 #define CLEAR_COLOR 0x0
 
@@ -60,6 +69,7 @@ int main(void)
 	// Initialize graphics
 	gfxInitDefault();
 	gpuInit();
+	gpuSetRegion(0, 0, RESULT_COMPONENTS, 1, false); // Tests only write the pixels Verify reads
 	consoleInit(GFX_BOTTOM, NULL);
 
 	// Initialize the scene
@@ -71,26 +81,38 @@ int main(void)
 	{
 		tests[i]();
 			gpuFrameBegin();
+			testSnapshot();
+			GPU_PROFILE_START(renderStart);
 				sceneRender();
-			gpuFrameEnd();
-		Verify();
+			GPU_PROFILE_STOP(GPU_PHASE_RENDER, renderStart);
+			gpuFrameFinish();
+		GPU_PROFILE_START(verifyStart);
+		Verify(i);
+		GPU_PROFILE_STOP(GPU_PHASE_VERIFY, verifyStart);
 
 		gpuClearBuffers(CLEAR_COLOR);
+#ifndef HEADLESS
 		gspWaitForVBlank();  // Synchronize with the start of VBlank
 		gfxSwapBuffersGpu(); // Swap the framebuffers so that the frame that we rendered last frame is now visible
+#endif
 
 		// Flush the framebuffers out of the data cache (not necessary with pure GPU rendering)
 		//gfxFlushBuffers();
 	}
 
 	// End of tests
-	printf("Tests ends. Press start to exit.\n");
+	testSummary(tests_count);
+	testLogFlush("rsq");
+	gpuProfileReport();
+#ifndef HEADLESS
+	printf("Press start to exit.\n");
 	while(true) {
 		gspWaitForVBlank();
 		hidScanInput();
 		if (hidKeysDown() & KEY_START)
 			break;
 	}
+#endif
 
 	// Deinitialize the scene
 	sceneExit();
@@ -101,25 +123,33 @@ int main(void)
 	return 0;
 }
 
-static void Verify(void) {
-	u32 final_result = ((unsigned*)gfxGetFramebuffer(GFX_TOP, GFX_LEFT, NULL, NULL))[0];
-	if ((unsigned)(expected_result.z * 255.0f) != (final_result & 0xFF))
-		printf("Failure final.z = %x\n, expected = %x\n", (unsigned)(final_result & 0xFF), (unsigned)(expected_result.z*255.0f));
-	if ((unsigned)(expected_result.y * 255.0f) != ((final_result >> 8) & 0xFF))
-		printf("Failure final.y = %x\n, expected = %x\n", (unsigned)((final_result >> 8) & 0xFF), (unsigned)(expected_result.y*255.0f));
-	if ((unsigned)(expected_result.x * 255.0f) != ((final_result >> 16) & 0xFF))
-		printf("Failure final.x = %x\n, expected = %x\n", (unsigned)((final_result >> 16) & 0xFF), (unsigned)(expected_result.x*255.0f));
+static void Verify(int test) {
+	u32 pixels[RESULT_COMPONENTS], actual[RESULT_COMPONENTS];
+	u32 expected[RESULT_COMPONENTS] = {
+		testF24(expected_result.x), testF24(expected_result.y), testF24(expected_result.z),
+	};
+	gpuReadPixels(0, 0, RESULT_COMPONENTS, 1, pixels);
+	for (int i = 0; i < RESULT_COMPONENTS; i++)
+		actual[i] = testDecodeF24(pixels[i]);
+	float inputs[] = { src1_uniform.x, src1_uniform.y, src1_uniform.z, src1_uniform.w };
+	testResultF24(test, inputs, sizeof(inputs)/sizeof(inputs[0]), expected, actual, RESULT_COMPONENTS, expected_ulps);
 }
 
-typedef struct { float x, y, z; float r, g, b, a; } vertex;
+// One triangle per component, around the center of pixel (i, 0) of gpuReadPixels: vertex y runs along the row.
+// The last attribute selects the component of the result the shader encodes.
+typedef struct { float x, y, z; float component; } vertex;
 
 static vertex vertex_list[] =
 {
-		{ 0.0f, 1.0f, 0.5f, 1.0f, 1.0f, 1.0f, 1.0f },
-		{ 1.0f, 0.0f, 0.5f, 1.0f, 1.0f, 1.0f, 1.0f },
-		{ 1.0f, 1.0f, 0.5f, 1.0f, 1.0f, 1.0f, 1.0f },
-		{ 0.0f, 1.0f, 0.5f, 1.0f, 1.0f, 1.0f, 1.0f },
-
+		{ 0.0f, 0.0f, 0.5f, 0.0f },
+		{ 1.5f, 0.0f, 0.5f, 0.0f },
+		{ 0.0f, 1.5f, 0.5f, 0.0f },
+		{ 0.0f, 1.0f, 0.5f, 1.0f },
+		{ 1.5f, 1.0f, 0.5f, 1.0f },
+		{ 0.0f, 2.5f, 0.5f, 1.0f },
+		{ 0.0f, 2.0f, 0.5f, 2.0f },
+		{ 1.5f, 2.0f, 0.5f, 2.0f },
+		{ 0.0f, 3.5f, 0.5f, 2.0f },
 };
 
 static int vertex_list_count = sizeof(vertex_list)/sizeof(vertex_list[0]);
@@ -145,21 +175,14 @@ static void sceneInit(void)
 	// Compute the projection matrix
 	m4x4_ortho_tilt(&projection, 0.0, 400.0, 0.0, 240.0, 0.0, 1.0);
 
-	// Create the VBO (vertex buffer object)
+	// Create the VBO (vertex buffer object), the same for every test
 	vbo_data = linearAlloc(sizeof(vertex_list));
 	memcpy(vbo_data, vertex_list, sizeof(vertex_list));
+	GSPGPU_FlushDataCache(NULL, (u8*)vbo_data, sizeof(vertex_list));
 }
 
 static void sceneRender(void)
 {
-	for (int i = 0; i < vertex_list_count; i++) {
-		vertex_list[i].r = 0.f;
-		vertex_list[i].g = 0.f;
-		vertex_list[i].b = 0.f;
-		vertex_list[i].a = 0.f;
-	}
-	memcpy(vbo_data, vertex_list, sizeof(vertex_list));
-
 	// Bind the shader program
 	shaderProgramUse(&program);
 
@@ -173,11 +196,14 @@ static void sceneRender(void)
 				  GPU_REPLACE, GPU_REPLACE, // RGB, Alpha
 				  0xFFFFFFFF);
 
+	// The alpha channel holds data, store the colors as they are
+	GPU_SetAlphaBlending(GPU_BLEND_ADD, GPU_BLEND_ADD, GPU_ONE, GPU_ZERO, GPU_ONE, GPU_ZERO);
+
 	// Configure the "attribute buffers" (that is, the vertex input buffers)
 	GPU_SetAttributeBuffers(
 			2, // Number of inputs per vertex
 			(u32*)osConvertVirtToPhys((u32)vbo_data), // Location of the VBO
-			GPU_ATTRIBFMT(0, 3, GPU_FLOAT) | GPU_ATTRIBFMT(1, 4, GPU_FLOAT), // Format of the inputs (in this case the only input is a 3-element float vector)
+			GPU_ATTRIBFMT(0, 3, GPU_FLOAT) | GPU_ATTRIBFMT(1, 1, GPU_FLOAT), // Format of the inputs: position and component
 			0xFFC, // Unused attribute mask, in our case bit 0 is cleared since it is used
 			0x10, // Attribute permutations (here it is the identity)
 			1, // Number of buffers
@@ -192,7 +218,7 @@ static void sceneRender(void)
 	GPU_SetFloatUniform(GPU_VERTEX_SHADER, (u32) uLoc_src1_uniform, (u32*)&src1_uniform, 1);
 
 	// Draw the VBO
-	GPU_DrawArray(GPU_TRIANGLE_STRIP, vertex_list_count);
+	GPU_DrawArray(GPU_TRIANGLES, vertex_list_count);
 }
 
 static void sceneExit(void)
@@ -0,0 +1,120 @@
+#pragma once
+#include <string.h>
+#include <3ds.h>
+#include "gpu.h"
+#include "test.h"
+
+// Single-draw test batches
+// Each test only sets its operands up, batchAdd() turns them into a triangle around the center of the test's own
+// pixel, with the two operands of the instruction under test as vertex attributes v1 and v2. One GPU_DrawArray
+// then renders every test of the suite and batchVerify() checks them all from a single gpuReadPixels.
+// Test i is pixel i of the BATCH_WIDTH pixels wide rectangle at (0, 0): vertex x runs along the rows, vertex y
+// along the columns. The sides are 1.5 pixels long, the triangles cover no other pixel center.
+// Every vertex is written before the only draw and flushed once, the GPU never reads vertices the CPU rewrites.
+// The tests share their frame, so each record logs the ticks from batchDraw() to the end of the readback.
+#define BATCH_WIDTH     64
+#define BATCH_MAX_TESTS (BATCH_WIDTH * 16)
+
+typedef struct { float x, y, z; float src1[4]; float src2[4]; } batch_vertex;
+
+typedef struct {
+	const char* name;
+	float inputs[8];  // src1 then src2, as they are logged
+	unsigned expected; // 0xRRGGBB
+} batch_test;
+
+static batch_test batch_tests[BATCH_MAX_TESTS];
+static int batch_count;
+static batch_vertex* batch_vbo;
+static u32 batch_pixels[BATCH_MAX_TESTS];
+static u64 batch_start;
+
+// Rows of the rectangle the batch covers, for gpuSetRegion
+static u32 batchRows(void)
+{
+	return (batch_count + BATCH_WIDTH - 1) / BATCH_WIDTH;
+}
+
+// Records the test testBegin() started last, expected holds the x, y and z of the result
+static void batchAdd(const float* src1, const float* src2, const float* expected)
+{
+	batch_test* t;
+
+	if (batch_count == BATCH_MAX_TESTS) {
+		printf("Too many tests, %s is left out\n", test_name);
+		return;
+	}
+	t = &batch_tests[batch_count++];
+	t->name = test_name;
+	memcpy(t->inputs, src1, 4 * sizeof(float));
+	memcpy(t->inputs + 4, src2, 4 * sizeof(float));
+	t->expected = ((unsigned)(expected[0] * 255.0f) << 16) | ((unsigned)(expected[1] * 255.0f) << 8) |
+		(unsigned)(expected[2] * 255.0f);
+}
+
+// Writes the vertices of every test and flushes them once
+static void batchUpload(void)
+{
+	batch_vbo = (batch_vertex*)linearAlloc(3 * batch_count * sizeof(batch_vertex));
+	for (int i = 0; i < batch_count; i++) {
+		float x = (float)(i / BATCH_WIDTH), y = (float)(i % BATCH_WIDTH);
+		batch_vertex* v = &batch_vbo[3 * i];
+		v[0].x = x;        v[0].y = y;
+		v[1].x = x + 1.5f; v[1].y = y;
+		v[2].x = x;        v[2].y = y + 1.5f;
+		for (int j = 0; j < 3; j++) {
+			v[j].z = 0.5f;
+			memcpy(v[j].src1, batch_tests[i].inputs, sizeof(v[j].src1));
+			memcpy(v[j].src2, batch_tests[i].inputs + 4, sizeof(v[j].src2));
+		}
+	}
+	GSPGPU_FlushDataCache(NULL, (u8*)batch_vbo, 3 * batch_count * sizeof(batch_vertex));
+}
+
+// Draws every test, the shader program and its uniforms are set already
+static void batchDraw(void)
+{
+	u32 buffer_offsets[1] = { 0x0 };
+	u64 attribute_map[1] = { 0x210 };
+	u8 num_attributes[1] = { 3 };
+
+	batch_start = svcGetSystemTick();
+
+	// Configure the "attribute buffers" (that is, the vertex input buffers)
+	GPU_SetAttributeBuffers(
+			3, // Number of inputs per vertex
+			(u32*)osConvertVirtToPhys((u32)(uintptr_t)batch_vbo), // Location of the VBO
+			GPU_ATTRIBFMT(0, 3, GPU_FLOAT) | GPU_ATTRIBFMT(1, 4, GPU_FLOAT) | GPU_ATTRIBFMT(2, 4, GPU_FLOAT), // Position, src1 and src2
+			0xFF8, // Unused attribute mask, bits 0 to 2 are cleared since they are used
+			0x210, // Attribute permutations (here it is the identity)
+			1, // Number of buffers
+			buffer_offsets, // Buffer offsets (placeholders)
+			attribute_map, // Attribute permutations for each buffer (identity again)
+			num_attributes); // Number of attributes for each buffer
+
+	GPU_DrawArray(GPU_TRIANGLES, 3 * batch_count);
+}
+
+// Reads every result back and logs one record per test
+static void batchVerify(void)
+{
+	u64 ticks;
+
+	gpuReadPixels(0, 0, BATCH_WIDTH, batchRows(), batch_pixels);
+	ticks = svcGetSystemTick() - batch_start;
+	for (int i = 0; i < batch_count; i++) {
+		test_name = batch_tests[i].name;
+		testResultTicks(i, batch_tests[i].inputs, 8, batch_tests[i].expected, batch_pixels[i] & 0xFFFFFF, ticks);
+	}
+}
+
+// Whether test i read back what it expected, once batchVerify() ran
+static inline bool batchPassed(int i)
+{
+	return (batch_pixels[i] & 0xFFFFFF) == batch_tests[i].expected;
+}
+
+static void batchFree(void)
+{
+	linearFree(batch_vbo);
+}
@@ -4,14 +4,14 @@
 #include "3dmath.h"
 #include "gpu.h"
 #include "test.h"
+#include "batch.h"
 #include "vshader_shbin.h"
 
 // Testing the SGE shader instruction
 
-// For each test:
-// Draws a 1px by 1px quad in the bottom-left corner using a vertex shader
-// The SGE instruction is used to output the color of this quad.
-// The framebuffer is then read to verify the results
+// Each test sets the operands of its case up, batch.h draws every case as a single-pixel triangle in one draw:
+// The SGE instruction is used to output the color of each triangle, its operands are vertex attributes.
+// The framebuffer is then read once to verify all the results
 
 // The exact SGE shader command under test:
 // sge outclr.xyz, test_vector, in_color
@@ -19,43 +19,42 @@
 // shader input color
 struct { float r, g, b; } in_color;
 
-// shader uniform test_vector
+// shader input test_vector
 static vector_4f test_vector;
-static int uLoc_test_vector;
 
 // Expected result
 static vector_4f expected_result;
 
 static void Test_SGE_ThreeComponents_Greater(void) {
-	printf("Test: SGE_ThreeComponents_Greater\n");
+	testBegin("SGE_ThreeComponents_Greater");
 	test_vector.x = 1.0f, in_color.r = 0.0f, expected_result.x = 1.0;
 	test_vector.y = 1.0f, in_color.g = 0.0f, expected_result.y = 1.0;
 	test_vector.z = 1.0f, in_color.b = 0.0f, expected_result.z = 1.0;
 }
 
 static void Test_SGE_ThreeComponents_Equal(void) {
-	printf("Test: SGE_ThreeComponents_Equal\n");
+	testBegin("SGE_ThreeComponents_Equal");
 	test_vector.x = 1.0f, in_color.r = 1.0f, expected_result.x = 1.0;
 	test_vector.y = 1.0f, in_color.g = 1.0f, expected_result.y = 1.0;
 	test_vector.z = 1.0f, in_color.b = 1.0f, expected_result.z = 1.0;
 }
 
 static void Test_SGE_ThreeComponents_Less(void) {
-	printf("Test: SGE_ThreeComponents_Less\n");
+	testBegin("SGE_ThreeComponents_Less");
 	test_vector.x = 0.0f, in_color.r = 1.0f, expected_result.x = 0.0;
 	test_vector.y = 0.0f, in_color.g = 1.0f, expected_result.y = 0.0;
 	test_vector.z = 0.0f, in_color.b = 1.0f, expected_result.z = 0.0;
 }
 
 static void Test_SGE_ThreeComponents_Mixed(void) {
-	printf("Test: SGE_ThreeComponents_Mixed\n");
+	testBegin("SGE_ThreeComponents_Mixed");
 	test_vector.x = 0.52f, in_color.r = 0.21f, expected_result.x = 1.0;
 	test_vector.y = 0.82f, in_color.g = 0.82f, expected_result.y = 1.0;
 	test_vector.z = 0.01f, in_color.b = 0.23f, expected_result.z = 0.0;
 }
 
 static void Test_SGE_ThreeComponents_BigNums(void) {
-	printf("Test: SGE_ThreeComponents_BigNums\n");
+	testBegin("SGE_ThreeComponents_BigNums");
 	test_vector.x = -1e20f, in_color.r = 1e20f, expected_result.x = 0.0;
 	test_vector.y = 1e20f, in_color.g = -1e20f, expected_result.y = 1.0;
 	test_vector.z = 1e20f, in_color.b = 1e20f, expected_result.z = 1.0;
@@ -79,7 +78,6 @@ static int tests_count =  (sizeof(tests)/sizeof(tests[0]));
 static void sceneInit(void);
 static void sceneRender(void);
 static void sceneExit(void);
-static void Verify(void);
 
 #define CLEAR_COLOR 0x0
 
@@ -90,35 +88,52 @@ int main(void)
 	gpuInit();
 	consoleInit(GFX_BOTTOM, NULL);
 
+	// Set every test up, then render and verify them all in one frame
+	for (int i = 0; i < tests_count; i++)
+	{
+		tests[i]();
+		float src1[] = { test_vector.x, test_vector.y, test_vector.z, test_vector.w };
+		float src2[] = { in_color.r, in_color.g, in_color.b, 0.0f };
+		batchAdd(src1, src2, (float[]) { expected_result.x, expected_result.y, expected_result.z });
+	}
+
 	// Initialize the scene
 	sceneInit();
+	gpuSetRegion(0, 0, BATCH_WIDTH, batchRows(), false); // Tests only write the pixels batchVerify reads
 	gpuClearBuffers(CLEAR_COLOR);
 
-	// Run one test per frame
+	gpuFrameBegin();
+	GPU_PROFILE_START(renderStart);
+		sceneRender();
+	GPU_PROFILE_STOP(GPU_PHASE_RENDER, renderStart);
+	gpuFrameFinish();
+	GPU_PROFILE_START(verifyStart);
+	batchVerify();
+	GPU_PROFILE_STOP(GPU_PHASE_VERIFY, verifyStart);
+#if !defined(HEADLESS) && !defined(QUIET)
 	for (int i = 0; i < tests_count; i++)
-	{
-		tests[i]();
-			gpuFrameBegin();
-				sceneRender();
-			gpuFrameEnd();
-		Verify();
-
-		gpuClearBuffers(CLEAR_COLOR);
-		gspWaitForVBlank();  // Synchronize with the start of VBlank
-		gfxSwapBuffersGpu(); // Swap the framebuffers so that the frame that we rendered last frame is now visible
+		if (batchPassed(i))
+			printf("%s: Success.\n", batch_tests[i].name);
+#endif
 
-		// Flush the framebuffers out of the data cache (not necessary with pure GPU rendering)
-		//gfxFlushBuffers();
-	}
+#ifndef HEADLESS
+	gspWaitForVBlank();  // Synchronize with the start of VBlank
+	gfxSwapBuffersGpu(); // Swap the framebuffers so that the frame that we rendered last frame is now visible
+#endif
 
 	// End of tests
-	printf("Tests ends. Press start to exit.\n");
+	testSummary(tests_count);
+	testLogFlush("sge");
+	gpuProfileReport();
+#ifndef HEADLESS
+	printf("Press start to exit.\n");
 	while(true) {
 		gspWaitForVBlank();
 		hidScanInput();
 		if (hidKeysDown() & KEY_START)
 			break;
 	}
+#endif
 
 	// Deinitialize the scene
 	sceneExit();
@@ -129,38 +144,11 @@ int main(void)
 	return 0;
 }
 
-static void Verify(void) {
-	u32 final_result = ((unsigned*)gfxGetFramebuffer(GFX_TOP, GFX_LEFT, NULL, NULL))[0];
-	if ((unsigned)(expected_result.z * 0xFF) != (final_result & 0xFF))
-		printf("Failure final.z = %x\n", (unsigned)(final_result & 0xFF));
-	else if ((unsigned)(expected_result.y * 0xFF) != ((final_result >> 8) & 0xFF))
-		printf("Failure final.y = %x\n", (unsigned)((final_result >> 8) & 0xFF));
-	else if ((unsigned)(expected_result.x * 0xFF) != ((final_result >> 16) & 0xFF))
-		printf("Failure final.x = %x\n", (unsigned)((final_result >> 16) & 0xFF));
-	else
-	printf("Success.\n");
-}
-
-typedef struct { float x, y, z; float r, g, b; } vertex;
-
-static vertex vertex_list[] =
-{
-		{ 0.0f, 1.0f, 0.5f, 1.0f, 1.0f, 1.0f },
-		{ 1.0f, 0.0f, 0.5f, 1.0f, 1.0f, 1.0f },
-		{ 1.0f, 1.0f, 0.5f, 1.0f, 1.0f, 1.0f },
-		{ 0.0f, 1.0f, 0.5f, 1.0f, 1.0f, 1.0f },
-
-};
-
-static int vertex_list_count = sizeof(vertex_list)/sizeof(vertex_list[0]);
-
 static DVLB_s* vshader_dvlb;
 static shaderProgram_s program;
 static int uLoc_projection;
 static matrix_4x4 projection;
 
-static void* vbo_data;
-
 static void sceneInit(void)
 {
 	// Load the vertex shader and create a shader program
@@ -170,25 +158,16 @@ static void sceneInit(void)
 
 	// Get the location of the projection matrix uniform
 	uLoc_projection = shaderInstanceGetUniformLocation(program.vertexShader, "projection");
-	uLoc_test_vector = shaderInstanceGetUniformLocation(program.vertexShader, "test_vector");
 
 	// Compute the projection matrix
 	m4x4_ortho_tilt(&projection, 0.0, 400.0, 0.0, 240.0, 0.0, 1.0);
 
-	// Create the VBO (vertex buffer object)
-	vbo_data = linearAlloc(sizeof(vertex_list));
-	memcpy(vbo_data, vertex_list, sizeof(vertex_list));
+	// Create the VBO (vertex buffer object) holding every test
+	batchUpload();
 }
 
 static void sceneRender(void)
 {
-	for (int i = 0; i < vertex_list_count; i++) {
-		vertex_list[i].r = in_color.r;
-		vertex_list[i].g = in_color.g;
-		vertex_list[i].b = in_color.b;
-	}
-	memcpy(vbo_data, vertex_list, sizeof(vertex_list));
-
 	// Bind the shader program
 	shaderProgramUse(&program);
 
@@ -202,32 +181,17 @@ static void sceneRender(void)
 				  GPU_REPLACE, GPU_REPLACE, // RGB, Alpha
 				  0xFFFFFFFF);
 
-	// Configure the "attribute buffers" (that is, the vertex input buffers)
-	GPU_SetAttributeBuffers(
-			2, // Number of inputs per vertex
-			(u32*)osConvertVirtToPhys((u32)vbo_data), // Location of the VBO
-			GPU_ATTRIBFMT(0, 3, GPU_FLOAT) | GPU_ATTRIBFMT(1, 3, GPU_FLOAT), // Format of the inputs (in this case the only input is a 3-element float vector)
-			0xFFC, // Unused attribute mask, in our case bit 0 is cleared since it is used
-			0x10, // Attribute permutations (here it is the identity)
-			1, // Number of buffers
-			(u32[]) { 0x0 }, // Buffer offsets (placeholders)
-			(u64[]) { 0x10 }, // Attribute permutations for each buffer (identity again)
-			(u8[])  { 2 }); // Number of attributes for each buffer
-
 	// Upload the projection matrix
 	GPU_SetFloatUniformMatrix(GPU_VERTEX_SHADER, uLoc_projection, &projection);
 
-	// Upload the test vector uniform
-	GPU_SetFloatUniform(GPU_VERTEX_SHADER, (u32)uLoc_test_vector, (u32*)&test_vector, 1);
-
 	// Draw the VBO
-	GPU_DrawArray(GPU_TRIANGLE_STRIP, vertex_list_count);
+	batchDraw();
 }
 
 static void sceneExit(void)
 {
 	// Free the VBO
-	linearFree(vbo_data);
+	batchFree();
 
 	// Free the shader program
 	shaderProgramFree(&program);